@@ -0,0 +1,527 @@
+#include "asmgen.h"
+#include "bytecode.h"
+#include "x86enc.h"
+
+#include <algorithm>
+
+using namespace std;
+
+static const Reg64 argRegs[6] = {RDI, RSI, RDX, RCX, R8, R9};
+
+// k si el nodo es el numero 2^k (1 <= k <= 62), si no -1
+static int powerOfTwo(const Ast& tree, NodeId id) {
+    const Expr& e = tree.exprs[id];
+    Value v;
+    if (e.kind != ExprKind::Num || !parseNumber(tree.text() + e.text.offset, e.text.length, v) ||
+        v < 2 || (v & (v - 1)) != 0)
+        return -1;
+    int k = 0;
+    while ((Value(1) << k) != v)
+        k++;
+    return k;
+}
+
+AsmGenerator::AsmGenerator()
+    : tree(nullptr), names(nullptr), err(&cerr), errors(0), checks(true), x(nullptr), fnName(0),
+      returnLabel(0), depth(0), rtNew(0), rtIndexError(0), rtDivZero(0) {}
+
+void AsmGenerator::setOutput(ostream& errStream) {
+    err = &errStream;
+}
+
+void AsmGenerator::setChecks(bool check) {
+    checks = check;
+}
+
+void AsmGenerator::error(uint32_t line, const string& message) {
+    errors++;
+    *err << "Error de compilacion en linea " << line << ": " << message << endl;
+}
+
+bool AsmGenerator::generate(const Ast& ast, const SemanticAnalyzer& resolved, ostream& out) {
+    tree = &ast;
+    names = &resolved;
+    X86Text text;
+    if (!lower(text))
+        return false;
+    text.write(out);
+    return true;
+}
+
+bool AsmGenerator::compile(const Ast& ast, const SemanticAnalyzer& resolved, ElfObject& object) {
+    tree = &ast;
+    names = &resolved;
+    X86Encoder encoder(object);
+    return lower(encoder);
+}
+
+bool AsmGenerator::lower(X86Emitter& out) {
+    const Ast& ast = *tree;
+    x = &out;
+    errors = 0;
+    literals.clear();
+    functions.clear();
+    offsets.assign(ast.vars.size(), 0);
+    globals.assign(ast.vars.size(), noAsmSymbol);
+    for (NodeId g : ast.globals)
+        globals[g] = x->variable("m0g_" + ast.str(ast.vars[g].name));
+    for (const Func& f : ast.funcs)
+        functions[f.name] = x->function("m0f_" + ast.str(f.name));
+    rtNew = x->external("m0_rt_new");
+    rtIndexError = x->external("m0_rt_index_error");
+    rtDivZero = x->external("m0_rt_div_zero");
+
+    for (const Func& f : ast.funcs)
+        function(f);
+
+    // punto de entrada que llama runtime/mini0_rt.c; rsp llega con 8 de desfase
+    Symbol mainName = ast.symbols.find("main", 4);
+    const Func* mainFunc = nullptr;
+    for (const Func& f : ast.funcs)
+        if (f.name == mainName)
+            mainFunc = &f;
+    AsmSymbol entry = x->function("mini0_entry");
+    x->begin(entry);
+    x->alu(ALU_SUB, RSP, Operand::i(8));
+    if (!mainFunc || mainFunc->params.count != 0) {
+        x->call(x->external(mainFunc ? "m0_rt_main_params" : "m0_rt_no_main"));
+    } else {
+        x->call(functions[mainName]);
+        if (mainFunc->ret == TY_VOID)
+            x->movImm(RAX, 0);
+        x->alu(ALU_ADD, RSP, Operand::i(8));
+        x->ret();
+    }
+    x->end(entry);
+    x = nullptr;
+    return errors == 0;
+}
+
+void AsmGenerator::function(const Func& f) {
+    AsmSymbol self = functions[f.name];
+    stubs.clear();
+    depth = 0;
+    fnName = x->data(tree->str(f.name));
+    returnLabel = x->label();
+
+    // parametros: los seis primeros se copian al marco, el resto ya esta en
+    // la pila del que llamo (16(%rbp) en adelante)
+    int32_t slots = 0;
+    uint32_t i = 0;
+    for (const NodeId* p = tree->begin(f.params); p != tree->end(f.params); p++, i++)
+        offsets[*p] = i < 6 ? -8 * ++slots : 16 + 8 * (int32_t)(i - 6);
+    int32_t params = slots;
+    vector<NodeId> pending(1, f.body);
+    while (!pending.empty()) {
+        NodeId id = pending.back();
+        pending.pop_back();
+        if (id == noNode)
+            continue;
+        const Block& b = tree->blocks[id];
+        for (const NodeId* v = tree->begin(b.vars); v != tree->end(b.vars); v++)
+            offsets[*v] = -8 * ++slots;
+        for (const NodeId* s = tree->begin(b.stmts); s != tree->end(b.stmts); s++) {
+            const Stmt& st = tree->stmts[*s];
+            if (st.kind == StmtKind::If)
+                pending.push_back(st.orelse);
+            if (st.kind == StmtKind::If || st.kind == StmtKind::While)
+                pending.push_back(st.body);
+        }
+    }
+
+    x->begin(self);
+    x->push(RBP);
+    x->mov(RBP, Operand::r(RSP));
+    // marco par: rsp queda alineado a 16 para las llamadas
+    if (slots > 0)
+        x->alu(ALU_SUB, RSP, Operand::i(8 * (slots + (slots & 1))));
+    for (int32_t k = 0; k < params; k++)
+        x->store(Mem::at(RBP, -8 * (k + 1)), argRegs[k]);
+    for (int32_t k = params; k < slots; k++)
+        x->storeImm(Mem::at(RBP, -8 * (k + 1)), 0);
+
+    block(f.body, false);
+
+    // se llego al final sin return: una funcion con tipo devuelve 0
+    x->movImm(RAX, 0);
+    x->place(returnLabel);
+    x->leave();
+    x->ret();
+
+    for (const Stub& s : stubs) {
+        x->place(s.label);
+        if (s.index) {
+            x->mov(RDI, Operand::r(RCX));
+            x->mov(RSI, Operand::r(RAX));
+            x->movImm(RDX, s.line);
+            x->lea(RCX, Mem::rip(fnName));
+            x->alu(ALU_AND, RSP, Operand::i(-16));
+            x->call(rtIndexError);
+        } else {
+            x->movImm(RDI, s.line);
+            x->lea(RSI, Mem::rip(fnName));
+            x->alu(ALU_AND, RSP, Operand::i(-16));
+            x->call(rtDivZero);
+        }
+    }
+    x->end(self);
+}
+
+// las variables de un bloque anidado vuelven a 0 cada vez que se entra
+void AsmGenerator::block(NodeId id, bool nested) {
+    if (id == noNode)
+        return;
+    const Block& b = tree->blocks[id];
+    if (nested)
+        for (const NodeId* v = tree->begin(b.vars); v != tree->end(b.vars); v++)
+            x->storeImm(variable(*v), 0);
+    for (const NodeId* s = tree->begin(b.stmts); s != tree->end(b.stmts); s++)
+        stmt(*s);
+}
+
+void AsmGenerator::stmt(NodeId id) {
+    const Stmt& s = tree->stmts[id];
+    switch (s.kind) {
+    case StmtKind::Assign: {
+        const Expr& target = tree->exprs[s.target];
+        if (target.kind != ExprKind::Index) {
+            expr(s.value);
+            x->store(variable(names->declOf(s.target)), RAX);
+            break;
+        }
+        Operand index, value;
+        if (simple(target.rhs, index) && simple(s.value, value)) {
+            expr(target.lhs);
+            x->mov(RCX, Operand::r(RAX));
+            x->mov(RAX, index);
+            x->mov(RDX, value);
+        } else {
+            expr(target.lhs);
+            push(RAX);
+            expr(target.rhs);
+            push(RAX);
+            expr(s.value);
+            x->mov(RDX, Operand::r(RAX));
+            pop(RAX);
+            pop(RCX);
+        }
+        indexCheck(target.line);
+        x->store(Mem::indexed(RCX, RAX, 8, 8), RDX);
+        break;
+    }
+    case StmtKind::Call:
+        call(s.value);
+        break;
+    case StmtKind::If: {
+        AsmLabel other = x->label();
+        cond(s.value, false, other);
+        block(s.body, true);
+        if (s.orelse != noNode) {
+            AsmLabel end = x->label();
+            x->jmp(end);
+            x->place(other);
+            block(s.orelse, true);
+            x->place(end);
+        } else {
+            x->place(other);
+        }
+        break;
+    }
+    case StmtKind::While: {
+        // condicion al final: un solo salto por vuelta
+        AsmLabel top = x->label(), test = x->label();
+        x->jmp(test);
+        x->place(top);
+        block(s.body, true);
+        x->place(test);
+        cond(s.value, true, top);
+        break;
+    }
+    case StmtKind::Return:
+        if (s.value != noNode)
+            expr(s.value);
+        x->jmp(returnLabel);
+        break;
+    }
+}
+
+void AsmGenerator::expr(NodeId id) {
+    const Expr& e = tree->exprs[id];
+    Operand operand;
+    switch (e.kind) {
+    case ExprKind::Num: {
+        Value v;
+        if (!parseNumber(tree->text() + e.text.offset, e.text.length, v))
+            error(e.line, "el numero " + tree->str(e.text) + " no entra en un int");
+        x->movImm(RAX, v);
+        return;
+    }
+    case ExprKind::Str:
+        x->lea(RAX, Mem::rip(literal(tree->text() + e.text.offset, e.text.length)));
+        return;
+    case ExprKind::True:
+        x->movImm(RAX, 1);
+        return;
+    case ExprKind::False:
+        x->movImm(RAX, 0);
+        return;
+    case ExprKind::Var:
+        x->mov(RAX, Operand::m(variable(names->declOf(id))));
+        return;
+    case ExprKind::Index:
+        expr(e.lhs);
+        if (simple(e.rhs, operand)) {
+            x->mov(RCX, Operand::r(RAX));
+            x->mov(RAX, operand);
+        } else {
+            push(RAX);
+            expr(e.rhs);
+            pop(RCX);
+        }
+        indexCheck(e.line);
+        x->mov(RAX, Operand::m(Mem::indexed(RCX, RAX, 8, 8)));
+        return;
+    case ExprKind::Call:
+        call(id);
+        return;
+    case ExprKind::New:
+        expr(e.rhs);
+        x->mov(RDI, Operand::r(RAX));
+        x->movImm(RSI, e.line);
+        x->lea(RDX, Mem::rip(fnName));
+        callRuntime(rtNew);
+        return;
+    case ExprKind::Unary:
+        expr(e.lhs);
+        if (e.opToken() == TK_NOT)
+            x->alu(ALU_XOR, RAX, Operand::i(1));
+        else
+            x->neg(RAX);
+        return;
+    case ExprKind::Binary:
+        break;
+    }
+
+    int op = e.opToken();
+    if (op == TK_AND || op == TK_OR) {
+        // cortocircuito: el valor del izquierdo queda en rax si decide el
+        AsmLabel end = x->label();
+        expr(e.lhs);
+        x->test(RAX, RAX);
+        x->jcc(op == TK_AND ? CC_E : CC_NE, end);
+        expr(e.rhs);
+        x->place(end);
+        return;
+    }
+
+    int k = op == TK_MUL || op == TK_DIV ? powerOfTwo(*tree, e.rhs) : -1;
+    if (k > 0) {
+        expr(e.lhs);
+        if (op == TK_MUL) {
+            x->shift(SH_SHL, RAX, (uint8_t)k);
+            return;
+        }
+        // la division redondea hacia 0: a un negativo se le suma 2^k - 1 antes
+        x->mov(RCX, Operand::r(RAX));
+        x->shift(SH_SAR, RCX, 63);
+        x->shift(SH_SHR, RCX, (uint8_t)(64 - k));
+        x->alu(ALU_ADD, RAX, Operand::r(RCX));
+        x->shift(SH_SAR, RAX, (uint8_t)k);
+        return;
+    }
+    operands(e.lhs, e.rhs, operand);
+    Cond set = CC_E;
+    switch (op) {
+    case TK_PLUS:
+        x->alu(ALU_ADD, RAX, operand);
+        return;
+    case TK_MINUS:
+        x->alu(ALU_SUB, RAX, operand);
+        return;
+    case TK_MUL:
+        x->imul(RAX, operand);
+        return;
+    case TK_DIV: {
+        // INT64_MIN / -1 no entra (idiv lo trata como error): da la vuelta con neg
+        x->mov(RCX, operand);
+        AsmLabel zero = x->label(), divide = x->label(), done = x->label();
+        stubs.push_back({zero, false, e.line});
+        x->test(RCX, RCX);
+        x->jcc(CC_E, zero);
+        x->alu(ALU_CMP, RCX, Operand::i(-1));
+        x->jcc(CC_NE, divide);
+        x->neg(RAX);
+        x->jmp(done);
+        x->place(divide);
+        x->cqo();
+        x->idiv(RCX);
+        x->place(done);
+        return;
+    }
+    case TK_LT: set = CC_L; break;
+    case TK_LE: set = CC_LE; break;
+    case TK_GT: set = CC_G; break;
+    case TK_GE: set = CC_GE; break;
+    case TK_EQ: set = CC_E; break;
+    case TK_NEQ: set = CC_NE; break;
+    }
+    x->alu(ALU_CMP, RAX, operand);
+    x->set(set, RAX);
+}
+
+// el izquierdo queda en rax; el derecho se usa directo si es simple y si no
+// se calcula en rcx guardando el izquierdo en la pila
+void AsmGenerator::operands(NodeId lhs, NodeId rhs, Operand& right) {
+    expr(lhs);
+    if (simple(rhs, right))
+        return;
+    push(RAX);
+    expr(rhs);
+    x->mov(RCX, Operand::r(RAX));
+    pop(RAX);
+    right = Operand::r(RCX);
+}
+
+// argumentos en el orden de Mini-0 (izquierda a derecha). Los del septimo en
+// adelante van a una zona reservada antes, que queda arriba de la pila al
+// llamar; rsp tiene que estar alineado a 16 en el call
+void AsmGenerator::call(NodeId id) {
+    const Expr& e = tree->exprs[id];
+    int n = (int)e.args.count;
+    int onStack = max(0, n - 6);
+    int reserve = onStack + ((depth + onStack) & 1);
+    if (reserve > 0) {
+        x->alu(ALU_SUB, RSP, Operand::i(8 * reserve));
+        depth += reserve;
+    }
+    int base = depth;
+    int i = 0;
+    for (const NodeId* a = tree->begin(e.args); a != tree->end(e.args); a++, i++) {
+        expr(*a);
+        if (i < 6)
+            push(RAX);
+        else
+            x->store(Mem::at(RSP, 8 * (depth - base + i - 6)), RAX);
+    }
+    for (int k = min(n, 6) - 1; k >= 0; k--)
+        pop(argRegs[k]);
+    x->call(functions[e.sym]);
+    if (reserve > 0) {
+        x->alu(ALU_ADD, RSP, Operand::i(8 * reserve));
+        depth -= reserve;
+    }
+}
+
+void AsmGenerator::cond(NodeId id, bool when, AsmLabel target) {
+    const Expr& e = tree->exprs[id];
+    if (e.kind == ExprKind::Unary && e.opToken() == TK_NOT) {
+        cond(e.lhs, !when, target);
+        return;
+    }
+    if (e.kind == ExprKind::True || e.kind == ExprKind::False) {
+        if ((e.kind == ExprKind::True) == when)
+            x->jmp(target);
+        return;
+    }
+    int op = e.kind == ExprKind::Binary ? e.opToken() : 0;
+    if (op == TK_AND || op == TK_OR) {
+        // 'a and b' es verdadero si no falla ninguno; 'a or b', si vale alguno
+        bool stopWhen = op == TK_OR;
+        if (when == stopWhen) {
+            cond(e.lhs, when, target);
+            cond(e.rhs, when, target);
+        } else {
+            AsmLabel skip = x->label();
+            cond(e.lhs, stopWhen, skip);
+            cond(e.rhs, when, target);
+            x->place(skip);
+        }
+        return;
+    }
+
+    // comparacion y salto juntos, sin armar el 0/1
+    static const int compares[6] = {TK_LT, TK_LE, TK_GT, TK_GE, TK_EQ, TK_NEQ};
+    static const Cond jumps[6] = {CC_L, CC_LE, CC_G, CC_GE, CC_E, CC_NE};
+    for (int k = 0; k < 6; k++) {
+        if (op != compares[k])
+            continue;
+        Operand right;
+        operands(e.lhs, e.rhs, right);
+        x->alu(ALU_CMP, RAX, right);
+        x->jcc(when ? jumps[k] : opposite(jumps[k]), target);
+        return;
+    }
+    expr(id);
+    x->test(RAX, RAX);
+    x->jcc(when ? CC_NE : CC_E, target);
+}
+
+bool AsmGenerator::simple(NodeId id, Operand& operand) {
+    const Expr& e = tree->exprs[id];
+    Value v;
+    switch (e.kind) {
+    case ExprKind::Num:
+        if (!parseNumber(tree->text() + e.text.offset, e.text.length, v) || v > INT32_MAX)
+            return false;
+        operand = Operand::i((int32_t)v);
+        return true;
+    case ExprKind::True:
+        operand = Operand::i(1);
+        return true;
+    case ExprKind::False:
+        operand = Operand::i(0);
+        return true;
+    case ExprKind::Var:
+        operand = Operand::m(variable(names->declOf(id)));
+        return true;
+    default:
+        return false;
+    }
+}
+
+// sin crear (rcx = 0) o indice fuera de [0, largo): una comparacion sin signo
+void AsmGenerator::indexCheck(uint32_t line) {
+    if (!checks)
+        return;
+    AsmLabel fail = x->label();
+    stubs.push_back({fail, true, line});
+    x->test(RCX, RCX);
+    x->jcc(CC_E, fail);
+    x->alu(ALU_CMP, RAX, Operand::m(Mem::at(RCX, 0)));
+    x->jcc(CC_AE, fail);
+}
+
+Mem AsmGenerator::variable(NodeId var) const {
+    if (globals[var] != noAsmSymbol)
+        return Mem::rip(globals[var]);
+    return Mem::at(RBP, offsets[var]);
+}
+
+// los literales iguales son el mismo simbolo: == compara direcciones
+AsmSymbol AsmGenerator::literal(const char* source, size_t length) {
+    string value = unescapeLiteral(source, length);
+    auto it = literals.find(value);
+    if (it != literals.end())
+        return it->second;
+    AsmSymbol sym = x->data(value);
+    literals.emplace(move(value), sym);
+    return sym;
+}
+
+void AsmGenerator::push(Reg64 reg) {
+    x->push(reg);
+    depth++;
+}
+
+void AsmGenerator::pop(Reg64 reg) {
+    x->pop(reg);
+    depth--;
+}
+
+void AsmGenerator::callRuntime(AsmSymbol fn) {
+    if (depth & 1)
+        x->alu(ALU_SUB, RSP, Operand::i(8));
+    x->call(fn);
+    if (depth & 1)
+        x->alu(ALU_ADD, RSP, Operand::i(8));
+}
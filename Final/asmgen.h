@@ -0,0 +1,86 @@
+#ifndef ASMGEN_H
+#define ASMGEN_H
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ast.h"
+#include "elfobj.h"
+#include "semantic.h"
+#include "x86.h"
+
+using namespace std;
+
+// Traduce un AST ya chequeado a ensamblador x86-64 (sintaxis AT&T de GNU as,
+// System V). Cada funcion de Mini-0 es una funcion con la convencion de C:
+// los primeros seis argumentos en rdi, rsi, rdx, rcx, r8, r9, el resto en la
+// pila y el resultado en rax. Parametros y locales viven en el marco de la
+// funcion ([rbp - 8 * (k + 1)]; del septimo parametro en adelante, donde los
+// dejo el que llamo). Las expresiones usan rax como acumulador y la pila para
+// los operandos intermedios; un operando derecho simple (constante o
+// variable) se usa directo desde la instruccion. Multiplicar o dividir por
+// una potencia de 2 escrita como numero son desplazamientos.
+//
+// Las instrucciones salen por un X86Emitter: X86Text para el texto de
+// --emit-asm y X86Encoder para escribir el objeto directo desde memoria
+// (mini0 -c), sin pasar por 'as'. Los dos dan el mismo codigo.
+//
+// El resultado se enlaza con runtime/mini0_rt.c, que tiene main, new y los
+// mensajes de error:  cc -o programa programa.s runtime/mini0_rt.c
+class AsmGenerator {
+public:
+    AsmGenerator();
+
+    void setOutput(ostream& err);
+    void setChecks(bool check);  // false (--unchecked): los indices no se chequean
+    bool generate(const Ast& tree, const SemanticAnalyzer& names, ostream& out);  // --emit-asm
+    // mismo codigo, codificado directo a un objeto ELF (mini0 -c)
+    bool compile(const Ast& tree, const SemanticAnalyzer& names, ElfObject& object);
+
+private:
+    // salida fuera de linea hacia el runtime (indice, division por cero)
+    struct Stub {
+        AsmLabel label;
+        bool index;
+        uint32_t line;
+    };
+
+    const Ast* tree;
+    const SemanticAnalyzer* names;
+    ostream* err;
+    size_t errors;
+    bool checks;
+    X86Emitter* x;
+    AsmSymbol fnName;                           // texto con el nombre, para errores
+    AsmLabel returnLabel;
+    int depth;                                  // valores empujados sobre el marco
+    vector<int32_t> offsets;                    // por VarDecl: desplazamiento desde rbp
+    vector<AsmSymbol> globals;                  // por VarDecl: simbolo si es global
+    unordered_map<Symbol, AsmSymbol> functions;
+    AsmSymbol rtNew, rtIndexError, rtDivZero;
+    vector<Stub> stubs;
+    unordered_map<string, AsmSymbol> literals;  // texto -> simbolo
+
+    bool lower(X86Emitter& out);
+    void function(const Func& f);
+    void block(NodeId id, bool nested);
+    void stmt(NodeId id);
+    void expr(NodeId id);  // valor en rax
+    void call(NodeId id);
+    // salta a target si la condicion vale 'when'
+    void cond(NodeId id, bool when, AsmLabel target);
+    bool simple(NodeId id, Operand& operand);  // constante o variable sin evaluar nada
+    void operands(NodeId lhs, NodeId rhs, Operand& right);  // izquierdo en rax
+    void indexCheck(uint32_t line);            // arreglo en rcx, indice en rax
+
+    Mem variable(NodeId var) const;
+    AsmSymbol literal(const char* text, size_t length);
+    void push(Reg64 reg);
+    void pop(Reg64 reg);
+    void callRuntime(AsmSymbol fn);
+    void error(uint32_t line, const string& message);
+};
+
+#endif
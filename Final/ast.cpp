@@ -0,0 +1,74 @@
+#include "ast.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+
+using namespace std;
+
+void Ast::clear() {
+    // los nodos no tienen destructores: vaciar es O(1) y la capacidad se reusa
+    exprs.clear();
+    stmts.clear();
+    vars.clear();
+    blocks.clear();
+    funcs.clear();
+    lists.clear();
+    globals.clear();
+    ownText.clear();
+    symbols.clear();
+    types.clear();
+    textBase = nullptr;
+    sourceBase = nullptr;
+    sourceSize = 0;
+}
+
+List Ast::makeList(vector<NodeId>& ids, size_t from) {
+    List l{(uint32_t)lists.size(), (uint32_t)(ids.size() - from)};
+    lists.insert(lists.end(), ids.begin() + from, ids.end());
+    ids.resize(from);
+    return l;
+}
+
+Span Ast::addText(const string& s) {
+    // si los Span apuntan al fuente, primero se copia lo que usan: los
+    // offsets de los literales que ya estan siguen valiendo en ownText
+    if (textBase != ownText.data()) {
+        size_t used = 0;
+        for (const Expr& e : exprs)
+            if (e.kind == ExprKind::Num || e.kind == ExprKind::Str)
+                used = max(used, (size_t)e.text.offset + e.text.length);
+        ownText.assign(textBase ? textBase : "", textBase ? used : 0);
+    }
+    Span span{(uint32_t)ownText.size(), (uint32_t)s.size()};
+    ownText += s;
+    textBase = ownText.data();
+    return span;
+}
+
+bool Ast::same(Span a, Span b) const {
+    return a.length == b.length && memcmp(textBase + a.offset, textBase + b.offset, a.length) == 0;
+}
+
+size_t Ast::nodeCount() const {
+    return exprs.size() + stmts.size() + vars.size() + blocks.size() + funcs.size();
+}
+
+size_t Ast::bytes() const {
+    return exprs.size() * sizeof(Expr) + stmts.size() * sizeof(Stmt) +
+           vars.size() * sizeof(VarDecl) + blocks.size() * sizeof(Block) +
+           funcs.size() * sizeof(Func) + (lists.size() + globals.size()) * sizeof(NodeId) +
+           ownText.size();
+}
+
+void Ast::printStats(ostream& out, size_t sourceBytes) const {
+    out << "AST: " << nodeCount() << " nodos (" << funcs.size() << " funciones, "
+        << blocks.size() << " bloques, " << vars.size() << " variables, "
+        << stmts.size() << " comandos, " << exprs.size() << " expresiones), "
+        << bytes() << " bytes";
+    if (sourceBytes > 0)
+        out << ", " << fixed << setprecision(2) << (double)bytes() / sourceBytes
+            << " bytes por byte de fuente";
+    out << "\n";
+    symbols.printStats(out);
+}
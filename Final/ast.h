@@ -0,0 +1,153 @@
+#ifndef AST_H
+#define AST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "tokens.h"
+#include "intern.h"
+#include "types.h"
+
+using namespace std;
+
+// Arbol sintactico por indices: cada tipo de nodo vive en su propio arreglo
+// contiguo y los hijos se referencian con indices de 32 bits, no punteros.
+// Los nodos son POD: borrar todo un programa es vaciar los arreglos.
+
+typedef uint32_t NodeId;
+const NodeId noNode = 0xFFFFFFFFu;
+
+// Texto de un literal dentro de Ast::text()
+struct Span {
+    uint32_t offset;
+    uint32_t length;
+};
+
+// Rango dentro de Ast::lists (hijos de largo variable)
+struct List {
+    uint32_t first;
+    uint32_t count;
+};
+
+enum class ExprKind : uint8_t {
+    Num,      // text = digitos
+    Str,      // text = literal con comillas
+    True,
+    False,
+    Var,      // sym
+    Index,    // lhs[rhs]
+    Call,     // sym(args)
+    New,      // new [rhs] T   (type = [ ] T)
+    Unary,    // op lhs
+    Binary    // lhs op rhs  ('=' dentro de expresiones se guarda como TK_EQ)
+};
+
+struct Expr {
+    ExprKind kind;
+    uint8_t op;      // Unary/Binary: TokenType - TK_ID
+    TypeId type;     // lo pone el TypeChecker (New: ya lo pone el parser)
+    uint32_t line;
+    uint16_t column; // del primer token, desde 1 (0: no se sabe)
+    Symbol sym;      // Var, Call
+    Span text;       // Num, Str
+    NodeId lhs;
+    NodeId rhs;
+    List args;       // Call: indices de Expr
+
+    int opToken() const { return TK_ID + op; }
+};
+
+enum class StmtKind : uint8_t {
+    Assign,   // target = value   (target es Var o Index)
+    Call,     // value es un Expr Call
+    If,       // if value body else orelse   (else if = orelse con un solo If)
+    While,    // while value body loop
+    Return    // return value (noNode si no hay)
+};
+
+struct Stmt {
+    StmtKind kind;
+    uint16_t column;
+    uint32_t line;
+    NodeId target;
+    NodeId value;
+    NodeId body;     // Block
+    NodeId orelse;   // Block o noNode
+};
+
+// nombre : tipo  (globales, parametros y locales)
+struct VarDecl {
+    Symbol name;
+    TypeId type;
+    uint16_t column;
+    uint32_t line;
+};
+
+struct Block {
+    List vars;       // indices de VarDecl
+    List stmts;      // indices de Stmt
+};
+
+struct Func {
+    Symbol name;
+    TypeId ret;
+    uint16_t column;
+    uint32_t line;
+    List params;     // indices de VarDecl
+    NodeId body;     // Block
+};
+
+class Ast {
+public:
+    vector<Expr> exprs;
+    vector<Stmt> stmts;
+    vector<VarDecl> vars;
+    vector<Block> blocks;
+    vector<Func> funcs;
+    vector<NodeId> lists;
+    vector<NodeId> globals;  // VarDecl en orden de aparicion
+    Interner symbols;        // nombres de variables y funciones
+    TypeTable types;         // tipos que aparecen en el programa
+
+    void clear();
+
+    NodeId addExpr(const Expr& e) { exprs.push_back(e); return (NodeId)(exprs.size() - 1); }
+    NodeId addStmt(const Stmt& s) { stmts.push_back(s); return (NodeId)(stmts.size() - 1); }
+    NodeId addVar(const VarDecl& v) { vars.push_back(v); return (NodeId)(vars.size() - 1); }
+    NodeId addBlock(const Block& b) { blocks.push_back(b); return (NodeId)(blocks.size() - 1); }
+    NodeId addFunc(const Func& f) { funcs.push_back(f); return (NodeId)(funcs.size() - 1); }
+
+    // copia ids[from..] a la zona de listas y los saca de ids (pila de trabajo del parser)
+    List makeList(vector<NodeId>& ids, size_t from);
+    const NodeId* begin(List l) const { return lists.data() + l.first; }
+    const NodeId* end(List l) const { return lists.data() + l.first + l.count; }
+
+    // texto al que apuntan los Span (el archivo fuente, o ownText)
+    void setText(const char* base) { textBase = base; }
+    const char* text() const { return textBase; }
+    string str(Span s) const { return string(textBase + s.offset, s.length); }
+    string str(Symbol s) const { return symbols.str(s); }
+    bool same(Span a, Span b) const;
+    string ownText;  // copia de los literales cuando el fuente no queda en memoria
+    // literal nuevo (numeros que calcula el optimizador): el texto pasa a ownText
+    Span addText(const string& s);
+    // el fuente entero si quedo en memoria (nullptr si no): los errores
+    // semanticos y de tipos ubican ahi el token de cada nodo
+    void setSource(const char* base, size_t size) { sourceBase = base; sourceSize = size; }
+    const char* source() const { return sourceBase; }
+    size_t sourceLength() const { return sourceSize; }
+
+    size_t nodeCount() const;
+    size_t bytes() const;  // memoria usada por los nodos y listas
+    // nodos por tipo, bytes y bytes por byte de fuente; despues la tabla de simbolos
+    void printStats(ostream& out, size_t sourceBytes) const;
+
+private:
+    const char* textBase = nullptr;
+    const char* sourceBase = nullptr;
+    size_t sourceSize = 0;
+};
+
+#endif
@@ -0,0 +1,261 @@
+#include "batch.h"
+#include "parser.h"
+#include "semantic.h"
+#include "typecheck.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+bool collectInputs(const vector<string>& paths, vector<string>& files, ostream& err) {
+    bool ok = true;
+    for (const string& path : paths) {
+        error_code ec;
+        if (fs::is_directory(path, ec)) {
+            vector<string> found;
+            for (const auto& entry : fs::recursive_directory_iterator(path, ec)) {
+                if (entry.is_regular_file() && entry.path().extension() == ".m0")
+                    found.push_back(entry.path().string());
+            }
+            // el orden del directorio depende del sistema de archivos
+            sort(found.begin(), found.end());
+            files.insert(files.end(), found.begin(), found.end());
+        } else if (fs::exists(path, ec)) {
+            files.push_back(path);
+        } else {
+            err << "No existe: " << path << "\n";
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool checkParsed(Parser& parser, const ParserOptions& options, const string& file,
+                 SemanticAnalyzer& sema, TypeChecker& types, ostream& err) {
+    bool json = options.diagnostics == DiagFormat::Json;
+    bool ok = !parser.hasErrors();
+    if (ok) {
+        sema.setDiagnostics(&parser.diagnostics());
+        types.setDiagnostics(&parser.diagnostics());
+        const char* pass = "semantico";
+        ok = sema.check(parser.ast());
+        if (ok) {
+            pass = "de tipos";
+            ok = types.check(parser.ast(), sema);
+        }
+        if (!ok && !json) {
+            parser.flushDiagnostics(err);
+            err << "Analisis " << pass << " completado con errores\n";
+        }
+    }
+    if (json)
+        parser.writeDiagnostics(err, file);
+    return ok;
+}
+
+namespace {
+
+// Cola de un hilo: el dueno saca por delante, los demas roban por detras.
+class WorkQueue {
+public:
+    void push(size_t item) {
+        lock_guard<mutex> lock(m);
+        items.push_back(item);
+    }
+
+    bool pop(size_t& item) {
+        lock_guard<mutex> lock(m);
+        if (items.empty())
+            return false;
+        item = items.front();
+        items.pop_front();
+        return true;
+    }
+
+    bool steal(size_t& item) {
+        lock_guard<mutex> lock(m);
+        if (items.empty())
+            return false;
+        item = items.back();
+        items.pop_back();
+        return true;
+    }
+
+private:
+    mutex m;
+    deque<size_t> items;
+};
+
+struct FileResult {
+    string text;
+    bool failed = false;
+    bool skipped = false;  // --fail-fast: no se llego a analizar
+    bool done = false;
+};
+
+// Imprime los resultados terminados respetando el orden de entrada. Con
+// failFast, todo lo que viene despues del primer archivo con errores sale
+// como sin analizar, aunque algun hilo ya lo hubiera analizado: asi el
+// corte no depende de que hilo termino antes.
+class OrderedPrinter {
+public:
+    OrderedPrinter(const vector<string>& files, vector<FileResult>& results, ostream& out,
+                   bool json, bool failFast)
+        : files(files), results(results), out(out), json(json), failFast(failFast),
+          cut(false), next(0) {}
+
+    void finish(size_t index, string text, bool failed, bool skipped = false) {
+        lock_guard<mutex> lock(m);
+        results[index].text = move(text);
+        results[index].failed = failed;
+        results[index].skipped = skipped;
+        results[index].done = true;
+        while (next < results.size() && results[next].done) {
+            FileResult& r = results[next];
+            if (cut) {
+                r.failed = false;
+                r.skipped = true;
+            }
+            if (r.skipped && json) {
+                r.text = "{\"file\":";
+                appendJsonString(r.text, files[next]);
+                r.text += ",\"skipped\":true}\n";
+            } else if (r.skipped) {
+                r.text.clear();
+            }
+            if (json) {
+                // el texto ya es la linea JSON del archivo
+                out << r.text;
+            } else if (r.skipped) {
+                out << "[--]    " << files[next] << "\n";
+            } else {
+                out << (r.failed ? "[FALLO] " : "[OK]    ") << files[next] << "\n";
+            }
+            if (!json && (r.failed || !r.text.empty())) {
+                istringstream lines(r.text);
+                string line;
+                while (getline(lines, line))
+                    out << "    " << line << "\n";
+            }
+            if (r.failed && failFast)
+                cut = true;
+            r.text.clear();
+            ++next;
+        }
+    }
+
+private:
+    const vector<string>& files;
+    vector<FileResult>& results;
+    ostream& out;
+    bool json;
+    bool failFast;
+    bool cut;  // ya se imprimio el primer archivo con errores
+    mutex m;
+    size_t next;
+};
+
+} // namespace
+
+size_t runBatch(const vector<string>& files, const BatchOptions& opts, ostream& out) {
+    unsigned jobs = opts.jobs ? opts.jobs : thread::hardware_concurrency();
+    if (jobs == 0)
+        jobs = 1;
+    if (jobs > files.size())
+        jobs = files.empty() ? 1 : (unsigned)files.size();
+
+    // reparto inicial en bloques contiguos; el robo equilibra el resto
+    vector<unique_ptr<WorkQueue>> queues;
+    for (unsigned i = 0; i < jobs; i++)
+        queues.emplace_back(new WorkQueue());
+    for (size_t i = 0; i < files.size(); i++)
+        queues[i * jobs / files.size()]->push(i);
+
+    bool json = opts.parser.diagnostics == DiagFormat::Json;
+    vector<FileResult> results(files.size());
+    OrderedPrinter printer(files, results, out, json, opts.failFast);
+    // --fail-fast: el primer archivo (en orden de entrada) que fallo hasta
+    // ahora. Lo de antes se analiza siempre; lo de despues no se empieza.
+    atomic<size_t> cut(files.size());
+
+    auto worker = [&](unsigned id) {
+        Parser parser;  // un parser (y un scanner) por hilo
+        parser.setOptions(opts.parser);
+        SemanticAnalyzer sema;
+        TypeChecker types;
+        ostream quiet(nullptr);
+        size_t item;
+        while (true) {
+            bool found = queues[id]->pop(item);
+            for (unsigned k = 1; !found && k < jobs; k++)
+                found = queues[(id + k) % jobs]->steal(item);
+            if (!found)
+                break;  // no se generan tareas nuevas: todas las colas vacias
+            if (item > cut.load(memory_order_relaxed))
+                continue;  // queda sin analizar; se imprime al final
+
+            ostringstream messages;
+            parser.setOutput(json ? quiet : messages, messages);
+            parser.parse(files[item]);
+            bool failed = !checkParsed(parser, opts.parser, files[item], sema, types, messages);
+            if (failed && opts.failFast) {
+                // bajar el corte a item; otro hilo puede estar bajandolo a la vez
+                size_t first = cut.load(memory_order_relaxed);
+                while (item < first && !cut.compare_exchange_weak(first, item))
+                    continue;
+            }
+            string text = messages.str();
+            if (!json && !opts.parser.trace && !failed)
+                text.clear();  // no repetir "Analisis sintactico exitoso" por archivo
+            if (opts.astStats) {
+                ostringstream stats;
+                error_code ec;
+                uintmax_t size = fs::file_size(files[item], ec);
+                parser.ast().printStats(stats, ec ? 0 : (size_t)size);
+                text += stats.str();
+            }
+            printer.finish(item, move(text), failed);
+        }
+    };
+
+    vector<thread> threads;
+    for (unsigned i = 1; i < jobs; i++)
+        threads.emplace_back(worker, i);
+    worker(0);
+    for (thread& t : threads)
+        t.join();
+
+    // lo que no se analizo por un --fail-fast
+    for (size_t i = 0; i < files.size(); i++)
+        if (!results[i].done)
+            printer.finish(i, string(), false, true);
+
+    size_t failures = 0, skipped = 0;
+    for (const FileResult& r : results) {
+        if (r.failed)
+            failures++;
+        if (r.skipped)
+            skipped++;
+    }
+
+    size_t correct = files.size() - failures - skipped;
+    if (json) {
+        out << "{\"summary\":{\"files\":" << files.size() << ",\"ok\":" << correct
+            << ",\"failed\":" << failures << ",\"skipped\":" << skipped << "}}\n";
+        return failures;
+    }
+    out << "Resumen: " << correct << " correctos, " << failures << " con errores, "
+        << files.size() << " archivos";
+    if (skipped > 0)
+        out << ", " << skipped << " sin analizar (--fail-fast)";
+    out << "\n";
+    return failures;
+}
@@ -0,0 +1,40 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include "parser.h"
+#include "semantic.h"
+#include "typecheck.h"
+
+using namespace std;
+
+// Opciones del modo lote (varios archivos en paralelo)
+struct BatchOptions {
+    unsigned jobs = 0;      // 0 = un hilo por nucleo
+    ParserOptions parser;   // la misma para todos los hilos
+    bool astStats = false;  // tamano del AST de cada archivo
+    // los archivos despues del primero con errores (en orden de entrada) no se
+    // analizan; los de antes si, siempre, con cualquier cantidad de hilos
+    bool failFast = false;
+};
+
+// Expande directorios a sus archivos .m0 (recursivo y ordenado).
+// Devuelve false si alguna ruta no existe.
+bool collectInputs(const vector<string>& paths, vector<string>& files, ostream& err);
+
+// Nombres y tipos despues del parse de file. Los errores van a
+// parser.diagnostics(), asi --max-errors los cuenta junto con los del parse,
+// y lo que falta escribir sale en err: en texto los mensajes nuevos, en JSON
+// el objeto del archivo. true si no hubo errores.
+bool checkParsed(Parser& parser, const ParserOptions& options, const string& file,
+                 SemanticAnalyzer& sema, TypeChecker& types, ostream& err);
+
+// Analiza todos los archivos con un pool de hilos con robo de trabajo.
+// La salida sale en el orden de entrada sin importar que hilo termine antes;
+// con DiagFormat::Json es una linea JSON por archivo y una de resumen.
+// Devuelve la cantidad de archivos con errores.
+size_t runBatch(const vector<string>& files, const BatchOptions& opts, ostream& out);
+
+#endif
@@ -0,0 +1,3616 @@
+#include "bench.h"
+#include "batch.h"
+#include "parser.h"
+#include "keywords.h"
+#include "semantic.h"
+#include "typecheck.h"
+#include "vm.h"
+#include "regvm.h"
+#include "cgen.h"
+#include "asmgen.h"
+#include "elfobj.h"
+#include "irbuild.h"
+#include "irinterp.h"
+#include "passes.h"
+#include "loops.h"
+#include "ranges.h"
+#include "optimize.h"
+#include "printer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <new>
+#include <random>
+#include <sstream>
+#include <streambuf>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#ifndef _WIN32
+#include <sys/wait.h>
+#endif
+
+using namespace std;
+
+// Contador de reservas con new para el chequeo "alloc". Reemplaza el new
+// global, asi que solo se compila con -DMINI0_COUNT_ALLOCS (un binario para
+// medir; el compilador normal usa el new de la biblioteca, y ASan tambien).
+// Solo cuenta en el hilo que lo activa.
+#ifdef MINI0_COUNT_ALLOCS
+static thread_local bool countAllocs = false;
+static thread_local size_t allocCount = 0;
+
+void* operator new(size_t size) {
+    if (countAllocs)
+        allocCount++;
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    throw bad_alloc();
+}
+
+// GCC ve el free() inlineado junto a un new y avisa, pero ese new es el de arriba
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+namespace {
+
+// descarta todo lo que se le escribe (los parsers no deben imprimir al medir)
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    streamsize xsputn(const char*, streamsize n) override { return n; }
+};
+
+// mejor tiempo (segundos) de varias corridas: el minimo es mas estable que el promedio
+template <class Body>
+double bestOf(int iterations, Body body) {
+    double best = 0;
+    for (int i = 0; i < iterations; i++) {
+        auto start = chrono::steady_clock::now();
+        body();
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (i == 0 || secs < best)
+            best = secs;
+    }
+    return best;
+}
+
+size_t totalBytes(const vector<string>& files) {
+    size_t bytes = 0;
+    for (const string& f : files) {
+        FILE* fp = fopen(f.c_str(), "rb");
+        if (!fp)
+            continue;
+        fseek(fp, 0, SEEK_END);
+        bytes += (size_t)ftell(fp);
+        fclose(fp);
+    }
+    return bytes;
+}
+
+void report(ostream& out, const string& label, size_t bytes, double secs, size_t tokens = 0) {
+    double mb = (double)bytes / (1024.0 * 1024.0);
+    out << "  " << left << setw(28) << label << right
+        << fixed << setprecision(3) << setw(10) << secs * 1000.0 << " ms"
+        << setprecision(1) << setw(10) << (secs > 0 ? mb / secs : 0.0) << " MB/s";
+    if (tokens > 0) {
+        double mtok = (double)tokens / 1e6;
+        out << setprecision(2) << setw(10) << (secs > 0 ? mtok / secs : 0.0) << " Mtok/s";
+    }
+    out << "\n";
+}
+
+// solo el scanner: cuenta tokens hasta EOF con cada forma de entrada
+size_t lexFile(yyscan_t scanner, const string& file, InputMode mode, SourceBuffer& source) {
+    YY_BUFFER_STATE buffer = nullptr;
+    FILE* input = nullptr;
+    if (mode == InputMode::InMemory) {
+        if (source.open(file))
+            buffer = yy_scan_buffer(source.scanBase(), source.scanSize(), scanner);
+    } else if ((input = fopen(file.c_str(), "r")) != nullptr) {
+        buffer = yy_create_buffer(input, 16384, scanner);
+        yy_switch_to_buffer(buffer, scanner);
+    }
+    if (!buffer)
+        return 0;
+
+    size_t tokens = 0;
+    while (yylex(scanner) != 0)
+        tokens++;
+
+    yy_delete_buffer(buffer, scanner);
+    if (input)
+        fclose(input);
+    source.close();
+    return tokens;
+}
+
+// parse + analisis semantico + tipos: lo que necesita cualquier backend
+bool checkFile(const string& file, Parser& parser, SemanticAnalyzer& sema, TypeChecker& types) {
+    parser.parse(file);
+    return !parser.hasErrors() && sema.check(parser.ast()) && types.check(parser.ast(), sema);
+}
+
+// Lo que deja un parse completo (traza, mensajes y resultado de cada pasada),
+// para comparar corridas del mismo archivo
+string parseOutput(Parser& parser, const string& file) {
+    ostringstream out, err;
+    parser.setOutput(out, err);
+    SemanticAnalyzer sema;
+    TypeChecker types;
+    sema.setOutput(err);
+    types.setOutput(err);
+    bool ok = checkFile(file, parser, sema, types);
+    return out.str() + "\x01" + err.str() + (ok ? "\x01ok" : "\x01error");
+}
+
+// Chequeo de reentrancia: los archivos analizados a la vez en varios hilos,
+// un Parser (y un scanner) por hilo, deben dar exactamente lo mismo que uno
+// por uno. Cada hilo pasa por todas las variantes (traza, lexer, modo) en
+// distinto orden, asi se cruzan scanners en estados distintos.
+bool benchThreads(const vector<string>& files, int iterations, ostream& out) {
+    vector<ParserOptions> variants(4);
+    variants[1].trace = true;
+    variants[2].lexMode = LexMode::Buffered;
+    variants[3].trace = true;
+    variants[3].lexer = LexerBackend::Fast;
+    variants[3].lexMode = LexMode::Buffered;
+
+    // lo esperado, en un solo hilo
+    vector<vector<string>> expected(variants.size());
+    auto start = chrono::steady_clock::now();
+    for (size_t v = 0; v < variants.size(); v++) {
+        Parser parser;
+        parser.setOptions(variants[v]);
+        for (const string& f : files)
+            expected[v].push_back(parseOutput(parser, f));
+    }
+    double sequential = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    unsigned count = max(4u, thread::hardware_concurrency());
+    out << "threads: " << files.size() << " archivos, " << variants.size() << " variantes, "
+        << count << " hilos, " << iterations << " vueltas\n";
+
+    // mismatches[v][i]: corridas de la variante v sobre el archivo i que difirieron
+    vector<vector<atomic<size_t>>> mismatches(variants.size());
+    for (auto& m : mismatches)
+        m = vector<atomic<size_t>>(files.size());
+    atomic<size_t> parses(0);
+    start = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (unsigned t = 0; t < count; t++) {
+        threads.emplace_back([&, t] {
+            vector<unique_ptr<Parser>> parsers;
+            for (const ParserOptions& o : variants) {
+                parsers.emplace_back(new Parser());
+                parsers.back()->setOptions(o);
+            }
+            for (int round = 0; round < iterations; round++) {
+                for (size_t k = 0; k < files.size(); k++) {
+                    // cada hilo arranca en otro archivo y otra variante
+                    size_t i = (k + t) % files.size();
+                    size_t v = (k + t + (size_t)round) % variants.size();
+                    if (parseOutput(*parsers[v], files[i]) != expected[v][i])
+                        mismatches[v][i]++;
+                    parses++;
+                }
+            }
+        });
+    }
+    for (thread& th : threads)
+        th.join();
+    double parallel = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    bool ok = true;
+    for (size_t i = 0; i < files.size(); i++) {
+        size_t bad = 0;
+        for (size_t v = 0; v < variants.size(); v++)
+            bad += mismatches[v][i];
+        ok = ok && bad == 0;
+        out << "  " << (bad == 0 ? "[OK]    " : "[FALLO] ") << files[i];
+        if (bad > 0)
+            out << ": " << bad << " corridas distintas de la secuencial";
+        out << "\n";
+    }
+    out << "  " << fixed << setprecision(3) << "secuencial " << sequential * 1000.0 << " ms ("
+        << variants.size() * files.size() << " parses), en paralelo " << parallel * 1000.0
+        << " ms (" << parses.load() << " parses)\n";
+    return ok;
+}
+
+void writeExpressionProgram(const string& path, size_t n);
+
+// Texto leido a memoria + yy_scan_buffer contra FILE* + buffer de Flex, y el
+// FastLexer sobre SourceBuffer abierto readOnly (mmap de solo lectura desde
+// SourceBuffer::mapMinimum; abajo, la misma copia). Los archivos de ejemplo son
+// chicos: tambien se mide un programa generado de varios MB, donde pesa
+// como se trae el archivo (ahi se vio que un mmap con copy-on-write perdia
+// contra FILE*).
+void benchInput(const vector<string>& files, int iterations, ostream& out) {
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+
+    string path = (filesystem::temp_directory_path() / "mini0_input_bench.m0").string();
+    writeExpressionProgram(path, 40000);
+    const pair<vector<string>, string> groups[] = {
+        {files, "archivos dados"},
+        {{path}, "programa generado"},
+    };
+    const pair<InputMode, const char*> modes[] = {
+        {InputMode::Stdio, "stdio (FILE*)"},
+        {InputMode::InMemory, "en memoria (read)"},
+    };
+
+    out << "input: mejor de " << iterations << "\n";
+    for (const auto& group : groups) {
+        if (group.first.empty())
+            continue;
+        size_t bytes = totalBytes(group.first);
+        out << "  " << group.second << ": " << group.first.size() << " archivos, " << bytes
+            << " bytes\n";
+        for (const auto& mode : modes) {
+            yyscan_t scanner;
+            yylex_init(&scanner);
+            SourceBuffer source;
+            size_t tokens = 0;
+            double secs = bestOf(iterations, [&] {
+                tokens = 0;
+                for (const string& f : group.first)
+                    tokens += lexFile(scanner, f, mode.first, source);
+            });
+            report(out, string("lex ") + mode.second, bytes, secs, tokens);
+            yylex_destroy(scanner);
+        }
+        {
+            SourceBuffer source;
+            FastLexer lexer;
+            size_t tokens = 0;
+            double secs = bestOf(iterations, [&] {
+                tokens = 0;
+                for (const string& f : group.first) {
+                    if (!source.open(f, true))
+                        continue;
+                    lexer.reset(source.data(), source.size());
+                    while (lexer.next() != TK_EOF)
+                        tokens++;
+                }
+            });
+            report(out, "lex fast (mmap de lectura)", bytes, secs, tokens);
+        }
+        for (const auto& mode : modes) {
+            Parser parser;
+            parser.setOutput(sink, sink);
+            parser.setInputMode(mode.first);
+            double secs = bestOf(iterations, [&] {
+                for (const string& f : group.first)
+                    parser.parse(f);
+            });
+            report(out, string("parse ") + mode.second, bytes, secs);
+        }
+    }
+    error_code ec;
+    filesystem::remove(path, ec);
+}
+
+// tokens/seg: lexear sobre la marcha contra lexear todo primero (TokenBuffer)
+void benchTokens(const vector<string>& files, int iterations, ostream& out) {
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+    size_t bytes = totalBytes(files);
+
+    // cantidad de tokens (sin contar EOF) para poder dar tokens/seg
+    size_t count = 0;
+    {
+        Parser parser;
+        parser.setOutput(sink, sink);
+        parser.setLexMode(LexMode::Buffered);
+        for (const string& f : files) {
+            parser.parse(f);
+            count += parser.tokenBuffer().size() - 1;
+        }
+    }
+
+    out << "tokens: " << files.size() << " archivos, " << count << " tokens, "
+        << "mejor de " << iterations << "\n";
+
+    // solo llenar el TokenBuffer, sin parser
+    {
+        yyscan_t scanner;
+        yylex_init(&scanner);
+        SourceBuffer source;
+        TokenBuffer tokens;
+        double secs = bestOf(iterations, [&] {
+            for (const string& f : files) {
+                if (!source.open(f))
+                    continue;
+                YY_BUFFER_STATE buffer = yy_scan_buffer(source.scanBase(), source.scanSize(), scanner);
+                tokens.fill(scanner, source.data());
+                yy_delete_buffer(buffer, scanner);
+            }
+        });
+        report(out, "fill TokenBuffer", bytes, secs, count);
+        yylex_destroy(scanner);
+    }
+
+    const pair<LexMode, const char*> modes[] = {
+        {LexMode::Interleaved, "parse interleaved"},
+        {LexMode::Buffered, "parse buffered"},
+    };
+    for (const auto& mode : modes) {
+        Parser parser;
+        parser.setOutput(sink, sink);
+        parser.setLexMode(mode.first);
+        double secs = bestOf(iterations, [&] {
+            for (const string& f : files)
+                parser.parse(f);
+        });
+        report(out, mode.second, bytes, secs, count);
+    }
+}
+
+// lexea texto en memoria con Flex o con FastLexer (text se copia con relleno)
+void lexText(const string& text, bool fast, TokenBuffer& tokens, vector<char>& storage) {
+    storage.assign(text.begin(), text.end());
+    storage.resize(text.size() + SourceBuffer::padding, '\0');
+    if (fast) {
+        FastLexer lexer;
+        lexer.reset(storage.data(), text.size());
+        tokens.fill(lexer, storage.data());
+        return;
+    }
+    yyscan_t scanner;
+    yylex_init(&scanner);
+    YY_BUFFER_STATE buffer = yy_scan_buffer(storage.data(), text.size() + 2, scanner);
+    yyset_lineno(1, scanner);
+    tokens.fill(scanner, storage.data());
+    yy_delete_buffer(buffer, scanner);
+    yylex_destroy(scanner);
+}
+
+// compara dos flujos de tokens; si difieren explica donde
+bool sameTokens(const TokenBuffer& a, const TokenBuffer& b, string& why) {
+    size_t n = a.size() < b.size() ? a.size() : b.size();
+    for (size_t i = 0; i < n; i++) {
+        Lexeme la = a.lexeme(i), lb = b.lexeme(i);
+        if (a.kind(i) != b.kind(i) || la.offset != lb.offset || la.length != lb.length ||
+            a.line(i) != b.line(i)) {
+            why = "token " + to_string(i) + " (offset " + to_string(la.offset) + ", linea " +
+                  to_string(a.line(i)) + ")";
+            return false;
+        }
+    }
+    if (a.size() != b.size()) {
+        why = "cantidad de tokens " + to_string(a.size()) + " vs " + to_string(b.size());
+        return false;
+    }
+    const vector<TokenBuffer::LexError>& ea = a.errors();
+    const vector<TokenBuffer::LexError>& eb = b.errors();
+    for (size_t i = 0; i < ea.size() || i < eb.size(); i++) {
+        if (i >= ea.size() || i >= eb.size() || ea[i].before != eb[i].before ||
+            ea[i].lexeme.offset != eb[i].lexeme.offset || ea[i].lexeme.length != eb[i].lexeme.length ||
+            ea[i].line != eb[i].line) {
+            why = "error lexico " + to_string(i);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Prueba diferencial: FastLexer debe dar exactamente los tokens de Flex
+// (tipo, offset, largo, linea y errores) en cada archivo y en variantes
+// mutadas al azar (semilla fija) que ejercitan los casos raros.
+bool benchLexDiff(const vector<string>& files, int iterations, ostream& out) {
+    TokenBuffer flexTokens, fastTokens;
+    vector<char> storage;
+    mt19937 rng(12345);
+    // sizeof incluye el '\0' final: tambien se prueban bytes nulos en el texto
+    const char letters[] = "aZ_9 \t\r\n\"\\<>=+-*/()[]:,&!#\x01\x80\xff";
+    const string alphabet(letters, sizeof(letters));
+    bool ok = true;
+
+    out << "lexdiff: flex contra fast (" << fastLexerSimd() << "), "
+        << iterations << " mutaciones por archivo\n";
+    for (const string& f : files) {
+        SourceBuffer source;
+        if (!source.open(f))
+            continue;
+        string original(source.data(), source.size());
+
+        size_t checked = 0;
+        string why;
+        bool pass = true;
+        for (int i = 0; i <= iterations && pass; i++) {
+            string text = original;
+            if (i > 0) {
+                // unos pocos cambios: borrar, insertar o reemplazar bytes
+                int edits = 1 + (int)(rng() % 8);
+                for (int e = 0; e < edits; e++) {
+                    size_t pos = text.empty() ? 0 : rng() % (text.size() + 1);
+                    char c = alphabet[rng() % alphabet.size()];
+                    switch (rng() % 3) {
+                    case 0:
+                        if (pos < text.size())
+                            text.erase(pos, 1);
+                        break;
+                    case 1:
+                        text.insert(pos, 1, c);
+                        break;
+                    default:
+                        if (pos < text.size())
+                            text[pos] = c;
+                        break;
+                    }
+                }
+            }
+            lexText(text, false, flexTokens, storage);
+            lexText(text, true, fastTokens, storage);
+            pass = sameTokens(flexTokens, fastTokens, why);
+            checked++;
+        }
+        ok = ok && pass;
+        out << "  " << (pass ? "[OK]    " : "[FALLO] ") << f << " (" << checked << " textos)";
+        if (!pass)
+            out << ": difiere en " << why;
+        out << "\n";
+    }
+    return ok;
+}
+
+// MB/s de cada lexer llenando un TokenBuffer
+void benchLexer(const vector<string>& files, int iterations, ostream& out) {
+    size_t bytes = totalBytes(files);
+    out << "lexer: " << files.size() << " archivos, " << bytes << " bytes, mejor de "
+        << iterations << "\n";
+
+    yyscan_t scanner;
+    yylex_init(&scanner);
+    FastLexer fast;
+    SourceBuffer source;
+    TokenBuffer tokens;
+    size_t count = 0;
+
+    for (int backend = 0; backend < 2; backend++) {
+        double secs = bestOf(iterations, [&] {
+            count = 0;
+            for (const string& f : files) {
+                if (!source.open(f))
+                    continue;
+                if (backend == 0) {
+                    YY_BUFFER_STATE buffer = yy_scan_buffer(source.scanBase(), source.scanSize(), scanner);
+                    yyset_lineno(1, scanner);
+                    tokens.fill(scanner, source.data());
+                    yy_delete_buffer(buffer, scanner);
+                } else {
+                    fast.reset(source.data(), source.size());
+                    tokens.fill(fast, source.data());
+                }
+                count += tokens.size() - 1;
+            }
+        });
+        report(out, backend == 0 ? "flex" : string("fast (") + fastLexerSimd() + ")", bytes, secs, count);
+    }
+    yylex_destroy(scanner);
+}
+
+// clasificacion por comparacion contra cada palabra, para comparar con el hash
+int keywordOrIdLinear(const char* text, size_t length) {
+    for (const Keyword& k : keywordList)
+        if (k.length == length && memcmp(k.text, text, length) == 0)
+            return k.type;
+    return TK_ID;
+}
+
+// pertenencia como estaba antes en synchronize: recorrer la lista
+bool inListLinear(int token, initializer_list<int> tokens) {
+    for (int t : tokens)
+        if (t == token)
+            return true;
+    return false;
+}
+
+// Recuperacion de errores con los conjuntos de grammar.h: los archivos dados
+// (pensado para error*.m0) repetidos hasta unos 4 MB, analizados enteros, y la
+// prueba de pertenencia sola sobre sus tokens: bits contra listas.
+void benchRecovery(const vector<string>& files, int iterations, ostream& out) {
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+    string text;
+    for (const string& f : files) {
+        ifstream in(f, ios::binary);
+        text += string(istreambuf_iterator<char>(in), istreambuf_iterator<char>()) + "\n";
+    }
+    if (text.empty())
+        return;
+    string corpus;
+    while (corpus.size() < 4 * 1024 * 1024)
+        corpus += text;
+    string path = (filesystem::temp_directory_path() / "mini0_recovery_bench.m0").string();
+    {
+        ofstream f(path, ios::binary);
+        f << corpus;
+    }
+
+    Parser parser;
+    parser.setLexMode(LexMode::Buffered);
+    ostringstream messages;
+    parser.setOutput(sink, messages);
+    parser.parse(path);
+    string reported = messages.str();
+    size_t errors = (size_t)count(reported.begin(), reported.end(), '\n');
+    const TokenBuffer& tokens = parser.tokenBuffer();
+    size_t count = tokens.size() - 1;
+    out << "recovery: " << files.size() << " archivos repetidos hasta " << corpus.size()
+        << " bytes, " << count << " tokens, " << errors << " mensajes, mejor de " << iterations
+        << "\n";
+
+    parser.setOutput(sink, sink);
+    double secs = bestOf(iterations, [&] { parser.parse(path); });
+    report(out, "parse con errores", corpus.size(), secs, count);
+
+    // cada token contra el conjunto de match() y contra FIRST(exp)
+    vector<int> kinds(count);
+    for (size_t i = 0; i < count; i++)
+        kinds[i] = tokens.kind(i);
+    volatile size_t hits = 0;  // que el compilador no borre el trabajo
+    auto measure = [&](const char* label, auto member) {
+        double s = bestOf(iterations, [&] {
+            size_t n = 0;
+            for (int k : kinds)
+                n += member(k);
+            hits = hits + n;
+        });
+        out << "  " << left << setw(28) << label << right << fixed << setprecision(3)
+            << setw(10) << s * 1000.0 << " ms" << setprecision(2) << setw(10)
+            << (count > 0 ? s * 1e9 / count : 0.0) << " ns/token\n";
+    };
+    measure("match: lista (12)", [](int k) {
+        return inListLinear(k, {TK_ID, TK_END, TK_ELSE, TK_LOOP, TK_FUN, TK_RETURN, TK_IF,
+                                TK_WHILE, TK_RPAREN, TK_RBRACKET, TK_COMMA, TK_NL});
+    });
+    TokenSet recovery = (followSet(NT_EXP) | followSet(NT_BLOQUE) | firstSet(NT_FUNCION) |
+                         firstSet(NT_COMANDO).without(TK_ID)).with(TK_ID);
+    measure("match: TokenSet", [&](int k) { return recovery.has(k); });
+    measure("FIRST(exp): comparaciones", [](int k) {
+        return k == TK_ID || k == TK_LITNUM || k == TK_LITSTRING || k == TK_TRUE ||
+               k == TK_FALSE || k == TK_NEW || k == TK_LPAREN || k == TK_MINUS || k == TK_NOT;
+    });
+    measure("FIRST(exp): TokenSet", [](int k) { return firstSet(NT_EXP).has(k); });
+
+    error_code ec;
+    filesystem::remove(path, ec);
+}
+
+// Muchos errores en cascada: los archivos dados (pensado para error*.m0)
+// repetidos hasta unos 4 MB. Reportar como antes (armar cada mensaje y
+// escribirlo con endl) contra guardar registros y escribir todo de una vez,
+// a un archivo de verdad para que el flush cueste lo que cuesta; y cuanto
+// se ahorra cortando con --max-errors y --fail-fast.
+// Un registro del parser dice la linea donde empieza su token: tiene que
+// ser la del offset del lexema, asi linea y columna hablan del mismo lugar
+// (antes la linea era la del scanner despues del token: un error en un \n
+// salia con la linea siguiente y la columna de la anterior).
+bool checkPositions(const vector<string>& files, ostream& out) {
+    string path = (filesystem::temp_directory_path() / "mini0_diag_pos.m0").string();
+    {
+        ofstream f(path, ios::binary);
+        f << "fun main() : int\n"
+          << "    x : int\n"
+          << "    x = 1 +\n"
+          << "    return x\n"
+          << "end\n";
+    }
+    vector<string> inputs = files;
+    inputs.push_back(path);
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+    bool ok = true;
+    size_t checked = 0;
+    out << "diagnostics: linea de cada registro del parser (Flex, Buffered y Fast)\n";
+    for (int mode = 0; mode < 3; mode++) {
+        ParserOptions options;
+        options.diagnostics = DiagFormat::Json;
+        options.lexMode = mode == 1 ? LexMode::Buffered : LexMode::Interleaved;
+        options.lexer = mode == 2 ? LexerBackend::Fast : LexerBackend::Flex;
+        Parser parser;
+        parser.setOptions(options);
+        parser.setOutput(sink, sink);
+        for (const string& f : inputs) {
+            parser.parse(f);
+            const char* source = parser.sourceText();
+            Diagnostics& diags = parser.diagnostics();
+            for (const Diagnostic& d : diags.all()) {
+                if (d.inPool || !source || d.found + TK_ID == TK_EOF)
+                    continue;
+                uint32_t line = 1 + (uint32_t)count(source, source + d.offset, '\n');
+                checked++;
+                if (line != d.line) {
+                    ok = false;
+                    out << "  [FALLO] " << f << ": " << diags.message(d, source)
+                        << " (el token esta en la linea " << line << ", columna "
+                        << diags.column(d, source) << ")\n";
+                }
+            }
+        }
+    }
+    if (ok)
+        out << "  [OK]    " << checked << " registros con la linea de su token\n";
+    error_code ec;
+    filesystem::remove(path, ec);
+    return ok;
+}
+
+// Los registros semanticos y de tipos en JSON traen offset y length del
+// token donde empieza el nodo: no null, y ese texto es el lexema esperado
+// (despues de un string con un \n adentro, para que cuenten las lineas).
+struct SpanCase {
+    const char* name;
+    const char* program;
+    const char* code;
+    const char* lexeme;
+};
+
+const SpanCase spanCases[] = {
+    {"tipos", "fun main() : int\n    x : int\n    s : string\n    s = \"a\nb\"\n"
+              "    x = 1 + true\n    return x\nend\n", "tipo-distinto", "+"},
+    {"semantico", "fun main() : int\n    s : string\n    s = \"a\nb\"\n    return total\nend\n",
+     "no-declarada", "total"},
+};
+
+// el numero despues de "key": en line, o -1 si no esta o es null
+long jsonNumber(const string& line, const string& key) {
+    size_t at = line.find("\"" + key + "\":");
+    if (at == string::npos)
+        return -1;
+    at += key.size() + 3;
+    if (at >= line.size() || !isdigit((unsigned char)line[at]))
+        return -1;
+    return strtol(line.c_str() + at, nullptr, 10);
+}
+
+bool checkSpans(ostream& out) {
+    string path = (filesystem::temp_directory_path() / "mini0_diag_span.m0").string();
+    bool ok = true;
+    out << "diagnostics: offset y length de los registros semanticos y de tipos en JSON\n";
+    for (const SpanCase& c : spanCases) {
+        {
+            ofstream f(path, ios::binary);
+            f << c.program;
+        }
+        string program = c.program;
+        for (int mode = 0; mode < 3; mode++) {
+            ParserOptions options;
+            options.diagnostics = DiagFormat::Json;
+            options.lexMode = mode == 1 ? LexMode::Buffered : LexMode::Interleaved;
+            options.lexer = mode == 2 ? LexerBackend::Fast : LexerBackend::Flex;
+            Parser parser;
+            parser.setOptions(options);
+            SemanticAnalyzer sema;
+            TypeChecker types;
+            ostringstream json;
+            parser.parse(path);
+            checkParsed(parser, options, path, sema, types, json);
+            string line = json.str();
+            long offset = jsonNumber(line, "offset");
+            long length = jsonNumber(line, "length");
+            string got = offset < 0 || length <= 0 || (size_t)(offset + length) > program.size()
+                             ? string("null")
+                             : "'" + program.substr((size_t)offset, (size_t)length) + "'";
+            bool pass = line.find(string("\"code\":\"") + c.code + "\"") != string::npos &&
+                        got == "'" + string(c.lexeme) + "'";
+            ok = ok && pass;
+            static const char* const modes[] = {"flex", "buffered", "fast"};
+            out << "  " << (pass ? "[OK]    " : "[FALLO] ") << left << setw(10) << c.name
+                << setw(9) << modes[mode] << right << c.code << " en " << got;
+            if (!pass)
+                out << " (se esperaba '" << c.lexeme << "')";
+            out << "\n";
+        }
+    }
+    error_code ec;
+    filesystem::remove(path, ec);
+    return ok;
+}
+
+// --fail-fast en lote corta en el primer archivo con errores en el orden de
+// entrada: la salida (en texto y en JSON) tiene que ser la misma byte por
+// byte con un hilo y con cuatro, vuelta tras vuelta, sin importar que hilo
+// termine antes.
+bool checkFailFastOrder(const vector<string>& files, int iterations, ostream& out) {
+    out << "diagnostics: --fail-fast en lote, -j 1 contra -j 4\n";
+    bool ok = true;
+    for (DiagFormat format : {DiagFormat::Text, DiagFormat::Json}) {
+        BatchOptions opts;
+        opts.parser.diagnostics = format;
+        opts.parser.maxErrors = 1;  // como main con --fail-fast
+        opts.failFast = true;
+        opts.jobs = 1;
+        ostringstream expected;
+        runBatch(files, opts, expected);
+        opts.jobs = 4;
+        int rounds = max(iterations, 10);
+        int differ = 0;
+        for (int round = 0; round < rounds; round++) {
+            ostringstream got;
+            runBatch(files, opts, got);
+            if (got.str() != expected.str())
+                differ++;
+        }
+        ok = ok && differ == 0;
+        const char* label = format == DiagFormat::Json ? "json" : "texto";
+        out << "  " << (differ == 0 ? "[OK]    " : "[FALLO] ") << left << setw(6) << label
+            << right;
+        if (differ == 0)
+            out << rounds << " corridas iguales a la de un hilo\n";
+        else
+            out << differ << " de " << rounds << " corridas distintas de la de un hilo\n";
+    }
+    return ok;
+}
+
+bool benchDiagnostics(const vector<string>& files, int iterations, ostream& out) {
+    bool ok = checkPositions(files, out);
+    ok = checkSpans(out) && ok;
+    ok = checkFailFastOrder(files, iterations, out) && ok;
+    string text;
+    for (const string& f : files) {
+        ifstream in(f, ios::binary);
+        text += string(istreambuf_iterator<char>(in), istreambuf_iterator<char>()) + "\n";
+    }
+    if (text.empty())
+        return ok;
+    string corpus;
+    while (corpus.size() < 4 * 1024 * 1024)
+        corpus += text;
+    namespace fs = std::filesystem;
+    fs::path dir = filesystem::temp_directory_path();
+    string path = (dir / "mini0_diag_bench.m0").string();
+    string logPath = (dir / "mini0_diag_bench.log").string();
+    {
+        ofstream f(path, ios::binary);
+        f << corpus;
+    }
+
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+    Parser parser;
+    parser.setLexMode(LexMode::Buffered);
+    ParserOptions json;
+    json.lexMode = LexMode::Buffered;
+    json.diagnostics = DiagFormat::Json;  // los registros quedan sin escribir
+    parser.setOptions(json);
+    parser.setOutput(sink, sink);
+    parser.parse(path);
+    Diagnostics& diags = parser.diagnostics();
+    const vector<Diagnostic>& records = diags.all();
+    const char* source = parser.sourceText();
+    size_t textBytes = 0;
+    for (const Diagnostic& d : records)
+        textBytes += diags.message(d, source).size() + 1;
+    out << "diagnostics: " << corpus.size() << " bytes, " << records.size() << " errores ("
+        << sizeof(Diagnostic) << " bytes por registro, " << fixed << setprecision(1)
+        << (records.empty() ? 0.0 : (double)textBytes / records.size())
+        << " por mensaje), mejor de " << iterations << "\n";
+    if (records.empty())
+        return ok;
+
+    auto line = [&](const char* label, double secs, size_t count) {
+        out << "  " << left << setw(34) << label << right << fixed << setprecision(3)
+            << setw(10) << secs * 1000.0 << " ms" << setprecision(1) << setw(10)
+            << secs * 1e9 / count << " ns/error\n";
+    };
+    ofstream log(logPath, ios::binary);
+    double each = bestOf(iterations, [&] {
+        log.seekp(0);
+        for (const Diagnostic& d : records)
+            log << diags.message(d, source) << endl;
+    });
+    line("un mensaje y un endl por error", each, records.size());
+    double once = bestOf(iterations, [&] {
+        log.seekp(0);
+        string all;
+        for (const Diagnostic& d : records) {
+            all += diags.message(d, source);
+            all += '\n';
+        }
+        log.write(all.data(), (streamsize)all.size());
+        log.flush();
+    });
+    line("registros y una escritura", once, records.size());
+
+    // el analisis entero, escribiendo los mensajes al archivo; con yylex() por
+    // token (el default), asi cortar tambien se ahorra el resto del lexico
+    for (unsigned limit : {0u, 100u, 1u}) {
+        ParserOptions options;
+        options.maxErrors = limit;
+        parser.setOptions(options);
+        ofstream messages(logPath, ios::binary);
+        parser.setOutput(sink, messages);
+        double secs = bestOf(iterations, [&] {
+            messages.seekp(0);
+            parser.parse(path);
+        });
+        string label = limit == 0 ? "parse sin limite" : limit == 1 ? "parse --fail-fast"
+                                                                    : "parse --max-errors 100";
+        out << "  " << left << setw(34) << label << right << fixed << setprecision(3)
+            << setw(10) << secs * 1000.0 << " ms" << setw(10) << parser.diagnostics().size()
+            << (parser.diagnostics().size() == 1 ? " error\n" : " errores\n");
+    }
+
+    error_code ec;
+    filesystem::remove(path, ec);
+    filesystem::remove(logPath, ec);
+    return ok;
+}
+
+// Palabras (identificadores y reservadas) de los archivos, clasificadas con el
+// hash perfecto y con busqueda lineal; y Flex lexeando solo esas palabras.
+void benchKeywords(const vector<string>& files, int iterations, ostream& out) {
+    string words;  // todas las palabras separadas por espacios
+    vector<Lexeme> spans;
+    for (const string& f : files) {
+        SourceBuffer source;
+        if (!source.open(f, true))
+            continue;
+        FastLexer lexer;
+        lexer.reset(source.data(), source.size());
+        for (int token = lexer.next(); token != TK_EOF; token = lexer.next()) {
+            unsigned char c = (unsigned char)lexer.text()[0];
+            if (isalpha(c) || c == '_') {
+                spans.push_back({words.size(), lexer.length()});
+                words.append(lexer.text(), lexer.length());
+                words += ' ';
+            }
+        }
+    }
+    size_t keywords = 0;
+    for (const Lexeme& w : spans)
+        if (keywordOrId(words.data() + w.offset, w.length) != TK_ID)
+            keywords++;
+
+    out << "keywords: " << spans.size() << " palabras (" << keywords << " reservadas), mejor de "
+        << iterations << "\n";
+
+    volatile int sink = 0;  // que el compilador no borre el trabajo
+    const pair<int (*)(const char*, size_t), const char*> classifiers[] = {
+        {keywordOrId, "hash perfecto"},
+        {keywordOrIdLinear, "comparacion lineal"},
+    };
+    for (const auto& c : classifiers) {
+        double secs = bestOf(iterations, [&] {
+            int acc = 0;
+            for (const Lexeme& w : spans)
+                acc += c.first(words.data() + w.offset, w.length);
+            sink = sink + acc;
+        });
+        report(out, c.second, words.size(), secs, spans.size());
+    }
+
+    // Flex con la regla de identificador + hash, sobre el mismo texto
+    vector<char> storage(words.begin(), words.end());
+    storage.resize(words.size() + SourceBuffer::padding, '\0');
+    yyscan_t scanner;
+    yylex_init(&scanner);
+    double secs = bestOf(iterations, [&] {
+        YY_BUFFER_STATE buffer = yy_scan_buffer(storage.data(), words.size() + 2, scanner);
+        int acc = 0;
+        for (int token = yylex(scanner); token != 0; token = yylex(scanner))
+            acc += token;
+        sink = sink + acc;
+        yy_delete_buffer(buffer, scanner);
+    });
+    report(out, "flex (lexear palabras)", words.size(), secs, spans.size());
+    yylex_destroy(scanner);
+}
+
+// Los identificadores de los archivos internados con Interner y con un
+// unordered_map de strings (lo que se usaria sin tabla propia).
+void benchIntern(const vector<string>& files, int iterations, ostream& out) {
+    string names;
+    vector<Lexeme> ids;
+    for (const string& f : files) {
+        SourceBuffer source;
+        if (!source.open(f, true))
+            continue;
+        FastLexer lexer;
+        lexer.reset(source.data(), source.size());
+        for (int token = lexer.next(); token != TK_EOF; token = lexer.next()) {
+            if (token == TK_ID) {
+                ids.push_back({names.size(), lexer.length()});
+                names.append(lexer.text(), lexer.length());
+            }
+        }
+    }
+    out << "intern: " << ids.size() << " identificadores, mejor de " << iterations << "\n";
+
+    volatile uint32_t sink = 0;
+    Interner symbols;
+    double secs = bestOf(iterations, [&] {
+        symbols.clear();
+        uint32_t acc = 0;
+        for (const Lexeme& id : ids)
+            acc += symbols.intern(names.data() + id.offset, id.length);
+        sink = sink + acc;
+    });
+    report(out, "interner", names.size(), secs, ids.size());
+
+    secs = bestOf(iterations, [&] {
+        unordered_map<string_view, uint32_t> table;
+        uint32_t acc = 0;
+        for (const Lexeme& id : ids) {
+            auto it = table.emplace(string_view(names.data() + id.offset, id.length),
+                                    (uint32_t)table.size()).first;
+            acc += it->second;
+        }
+        sink = sink + acc;
+    });
+    report(out, "unordered_map", names.size(), secs, ids.size());
+    out << "  ";
+    symbols.printStats(out);
+}
+
+// Cuantas veces se llama a new al analizar cada archivo. El primer parse
+// calienta los buffers reusables; en el segundo, un archivo sin errores no
+// deberia reservar nada (los lexemas son vistas al texto fuente).
+// Sin el contador no mide nada: runBench lo da por omitido, no por pasado.
+#ifdef MINI0_COUNT_ALLOCS
+const bool allocCounting = true;
+#else
+const bool allocCounting = false;
+#endif
+
+bool benchAlloc(const vector<string>& files, ostream& out) {
+#ifndef MINI0_COUNT_ALLOCS
+    (void)files;
+    (void)out;
+    return false;
+#else
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+    bool ok = true;
+
+    out << "alloc: reservas con new por parse (despues de calentar)\n";
+    const pair<InputMode, const char*> modes[] = {
+        {InputMode::Stdio, "stdio"},
+        {InputMode::InMemory, "memoria"},
+    };
+    for (const string& f : files) {
+        for (const auto& mode : modes) {
+            Parser parser;
+            parser.setOutput(sink, sink);
+            parser.setInputMode(mode.first);
+            parser.parse(f);
+
+            allocCount = 0;
+            countAllocs = true;
+            parser.parse(f);
+            countAllocs = false;
+
+            // con errores se arman mensajes: ahi si se permite reservar
+            bool clean = !parser.hasErrors();
+            bool pass = !clean || allocCount == 0;
+            ok = ok && pass;
+            out << "  " << (pass ? "[OK]    " : "[FALLO] ") << left << setw(8) << mode.second
+                << right << setw(8) << allocCount << "  " << f
+                << (clean ? "" : " (con errores)") << "\n";
+        }
+    }
+    return ok;
+#endif
+}
+
+// parse completo armando el AST: tiempo y tamano de los nodos
+void benchAst(const vector<string>& files, int iterations, ostream& out) {
+    size_t bytes = totalBytes(files);
+    out << "ast: " << files.size() << " archivos, " << bytes << " bytes, mejor de "
+        << iterations << "\n";
+
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+    Parser parser;
+    parser.setOutput(sink, sink);
+    size_t nodes = 0, astBytes = 0;
+    size_t kinds[5] = {0, 0, 0, 0, 0};
+
+    double secs = bestOf(iterations, [&] {
+        nodes = astBytes = 0;
+        fill(begin(kinds), end(kinds), 0);
+        for (const string& f : files) {
+            parser.parse(f);
+            const Ast& tree = parser.ast();
+            nodes += tree.nodeCount();
+            astBytes += tree.bytes();
+            kinds[0] += tree.funcs.size();
+            kinds[1] += tree.blocks.size();
+            kinds[2] += tree.vars.size();
+            kinds[3] += tree.stmts.size();
+            kinds[4] += tree.exprs.size();
+        }
+    });
+    report(out, "parse + ast", bytes, secs);
+    out << "  nodos: " << nodes << " (" << kinds[0] << " funciones, " << kinds[1]
+        << " bloques, " << kinds[2] << " variables, " << kinds[3] << " comandos, "
+        << kinds[4] << " expresiones)\n";
+    out << "  memoria: " << astBytes << " bytes, " << fixed << setprecision(2)
+        << (bytes > 0 ? (double)astBytes / bytes : 0.0) << " bytes por byte de fuente\n";
+}
+
+// programa con expresiones largas: todos los niveles de precedencia, unarios,
+// parentesis, indices y llamadas, y '=' como comparacion
+void writeExpressionProgram(const string& path, size_t n) {
+    ofstream f(path, ios::binary);
+    f << "fun g(a : int, b : int) : int\n"
+      << "    return a - b\n"
+      << "end\n\n";
+    for (size_t i = 0; i < n; i++) {
+        f << "fun e" << i << "(a : int, b : int, v : [ ] int) : bool\n"
+          << "    x : int\n"
+          << "    x = a * 3 + b / 2 - v[a - 1] * (b + 4) / (a - -b) + g(a, b * " << i % 7 << ")\n"
+          << "    return x > a + b and not (x = a * b) or v[0] <> -x and a <= b + 1 or x >= 2 * a - b\n"
+          << "end\n\n";
+    }
+}
+
+// operador de un Expr o de un token, como lo escribe el fuente ('=' compara)
+const char* operatorSpelling(int op) {
+    switch (op) {
+    case TK_OR: return "or";
+    case TK_AND: return "and";
+    case TK_NOT: return "not";
+    case TK_EQ:
+    case TK_ASSIGN: return "=";
+    case TK_NEQ: return "<>";
+    case TK_LT: return "<";
+    case TK_LE: return "<=";
+    case TK_GT: return ">";
+    case TK_GE: return ">=";
+    case TK_PLUS: return "+";
+    case TK_MINUS: return "-";
+    case TK_MUL: return "*";
+    default: return "/";
+    }
+}
+
+// Una expresion con todos los parentesis, "(a + (b * c))": asi se comparan
+// la tabla, la cascada y lo esperado. Sin recursion, porque una cadena larga
+// de operadores es un arbol igual de profundo. expand(n, put) da las partes
+// de n en orden inverso: put(texto, largo) o put(hijo).
+struct Piece {
+    const char* text;  // nullptr: expandir node
+    size_t length;
+    uint32_t node;
+};
+
+template <class Expand>
+string parenthesised(uint32_t root, Expand expand) {
+    string s;
+    vector<Piece> pending = {{nullptr, 0, root}};
+    struct Put {
+        vector<Piece>& pending;
+        void operator()(const char* text, size_t length) { pending.push_back({text, length, 0}); }
+        void operator()(const char* text) { (*this)(text, strlen(text)); }
+        void operator()(uint32_t node) { pending.push_back({nullptr, 0, node}); }
+    } put{pending};
+    while (!pending.empty()) {
+        Piece p = pending.back();
+        pending.pop_back();
+        if (p.text)
+            s.append(p.text, p.length);
+        else
+            expand(p.node, put);
+    }
+    return s;
+}
+
+string exprShape(const Ast& t, NodeId root) {
+    return parenthesised(root, [&](uint32_t id, auto& put) {
+        if (id == noNode) {
+            put("?");
+            return;
+        }
+        const Expr& e = t.exprs[id];
+        switch (e.kind) {
+        case ExprKind::Num:
+        case ExprKind::Str: put(t.text() + e.text.offset, e.text.length); break;
+        case ExprKind::True: put("true"); break;
+        case ExprKind::False: put("false"); break;
+        case ExprKind::Var: put(t.symbols.name(e.sym), t.symbols.length(e.sym)); break;
+        case ExprKind::Index: put("]"); put(e.rhs); put("["); put(e.lhs); break;
+        case ExprKind::New: put("]"); put(e.rhs); put("new ["); break;
+        case ExprKind::Unary: put(")"); put(e.lhs); put(" "); put(operatorSpelling(e.opToken())); put("("); break;
+        case ExprKind::Binary:
+            put(")"); put(e.rhs); put(" "); put(operatorSpelling(e.opToken())); put(" ");
+            put(e.lhs); put("(");
+            break;
+        case ExprKind::Call:
+            put(")");
+            for (const NodeId* a = t.end(e.args); a != t.begin(e.args); ) {
+                put(*--a);
+                if (a != t.begin(e.args))
+                    put(", ");
+            }
+            put("(");
+            put(t.symbols.name(e.sym), t.symbols.length(e.sym));
+            break;
+        }
+    });
+}
+
+// Las expresiones que el parser pide a exp() desde los comandos (indices del
+// destino, argumentos de una llamada, condiciones, valores), en orden del
+// fuente: exp() no se llama a si misma, asi que son todas sus llamadas.
+void rootShapes(const Ast& t, vector<string>& shapes) {
+    vector<pair<const NodeId*, const NodeId*>> blocks;  // lo que falta de cada bloque abierto
+    for (const Func& f : t.funcs) {
+        const Block& body = t.blocks[f.body];
+        blocks.push_back({t.begin(body.stmts), t.end(body.stmts)});
+        while (!blocks.empty()) {
+            auto& open = blocks.back();
+            if (open.first == open.second) {
+                blocks.pop_back();
+                continue;
+            }
+            const Stmt& s = t.stmts[*open.first++];
+            switch (s.kind) {
+            case StmtKind::Assign: {
+                vector<NodeId> indices;
+                for (NodeId e = s.target; t.exprs[e].kind == ExprKind::Index; e = t.exprs[e].lhs)
+                    indices.push_back(t.exprs[e].rhs);
+                for (auto i = indices.rbegin(); i != indices.rend(); ++i)
+                    shapes.push_back(exprShape(t, *i));
+                shapes.push_back(exprShape(t, s.value));
+                break;
+            }
+            case StmtKind::Call: {
+                const Expr& call = t.exprs[s.value];
+                for (const NodeId* a = t.begin(call.args); a != t.end(call.args); ++a)
+                    shapes.push_back(exprShape(t, *a));
+                break;
+            }
+            case StmtKind::Return:
+                if (s.value != noNode)
+                    shapes.push_back(exprShape(t, s.value));
+                break;
+            case StmtKind::If:
+            case StmtKind::While:
+                shapes.push_back(exprShape(t, s.value));
+                if (s.orelse != noNode) {
+                    const Block& orelse = t.blocks[s.orelse];
+                    blocks.push_back({t.begin(orelse.stmts), t.end(orelse.stmts)});
+                }
+                {
+                    const Block& body = t.blocks[s.body];
+                    blocks.push_back({t.begin(body.stmts), t.end(body.stmts)});
+                }
+                break;
+            }
+        }
+    }
+}
+
+// La cascada recursiva que usaba Parser antes de la tabla de precedencias
+// (un par exp_X / exp_X_p por nivel: or, and, = <>, relacionales, + -, * /;
+// despues exp_unary y exp_primary), copiada aca como linea de base de
+// --bench exprs. Lee un TokenBuffer ya lexeado y de los comandos solo mira
+// los que llevan expresiones; no arma comandos ni declaraciones, no interna
+// nombres ni reporta errores: ante uno, program() devuelve false. 'calls'
+// cuenta las llamadas a las funciones de expresiones, como el contador que
+// tenia Parser.
+class CascadeParser {
+public:
+    struct Node {
+        ExprKind kind;
+        int op;
+        uint32_t token;  // literal o nombre
+        uint32_t lhs;
+        uint32_t rhs;
+        List args;       // en lists
+    };
+
+    size_t calls = 0;
+    bool tooDeep = false;         // mas anidado que maxNesting: no se siguio
+    vector<uint32_t> roots;       // lo que se pidio a exp() desde los comandos
+
+    bool program(const TokenBuffer& buffer, const char* text) {
+        tokens = &buffer;
+        base = text;
+        pos = 0;
+        calls = 0;
+        depth = 0;
+        failed = tooDeep = false;
+        nodes.clear();
+        lists.clear();
+        work.clear();
+        roots.clear();
+        while (!failed && kind() != TK_EOF) {
+            switch (kind()) {
+            case TK_IF:
+            case TK_WHILE:
+                pos++;
+                roots.push_back(exp());
+                break;
+            case TK_ELSE:
+                if (++pos, kind() == TK_IF) {
+                    pos++;
+                    roots.push_back(exp());
+                }
+                break;
+            case TK_RETURN:
+                if (++pos, kind() != TK_NL && kind() != TK_EOF)
+                    roots.push_back(exp());
+                break;
+            case TK_ID:
+                if (kind(1) == TK_LPAREN) {
+                    pos += 2;
+                    size_t from = work.size();
+                    arguments();
+                    roots.insert(roots.end(), work.begin() + from, work.end());
+                    work.resize(from);
+                    expect(TK_RPAREN);
+                } else if (kind(1) == TK_COLON) {
+                    skipLine();
+                } else {
+                    pos++;
+                    while (kind() == TK_LBRACKET) {
+                        pos++;
+                        roots.push_back(exp());
+                        expect(TK_RBRACKET);
+                    }
+                    expect(TK_ASSIGN);
+                    roots.push_back(exp());
+                }
+                break;
+            default:  // fun, end, loop, else y lineas vacias
+                skipLine();
+                break;
+            }
+            if (kind() == TK_NL)
+                pos++;
+            else if (kind() != TK_EOF)
+                failed = true;
+        }
+        return !failed;
+    }
+
+    string shape(uint32_t root) const {
+        return parenthesised(root, [&](uint32_t id, auto& put) {
+            const Node& n = nodes[id];
+            Lexeme l = tokens->lexeme(n.token);
+            switch (n.kind) {
+            case ExprKind::Num:
+            case ExprKind::Str:
+            case ExprKind::Var: put(base + l.offset, l.length); break;
+            case ExprKind::True: put("true"); break;
+            case ExprKind::False: put("false"); break;
+            case ExprKind::Index: put("]"); put(n.rhs); put("["); put(n.lhs); break;
+            case ExprKind::New: put("]"); put(n.rhs); put("new ["); break;
+            case ExprKind::Unary: put(")"); put(n.lhs); put(" "); put(operatorSpelling(n.op)); put("("); break;
+            case ExprKind::Binary:
+                put(")"); put(n.rhs); put(" "); put(operatorSpelling(n.op)); put(" ");
+                put(n.lhs); put("(");
+                break;
+            case ExprKind::Call:
+                put(")");
+                for (uint32_t a = n.args.first + n.args.count; a != n.args.first; ) {
+                    put(lists[--a]);
+                    if (a != n.args.first)
+                        put(", ");
+                }
+                put("(");
+                put(base + l.offset, l.length);
+                break;
+            }
+        });
+    }
+
+private:
+    static const int maxNesting = 1000;  // cada nivel son unas quince llamadas en la pila
+
+    const TokenBuffer* tokens = nullptr;
+    const char* base = nullptr;
+    size_t pos = 0;
+    int depth = 0;
+    bool failed = false;
+    vector<Node> nodes;
+    vector<uint32_t> lists;
+    vector<uint32_t> work;
+
+    int kind(size_t ahead = 0) const { return tokens->kind(pos + ahead); }
+
+    void expect(int token) {
+        if (kind() == token)
+            pos++;
+        else
+            failed = true;
+    }
+
+    uint32_t node(ExprKind kind, int op, uint32_t lhs, uint32_t rhs) {
+        nodes.push_back({kind, op, (uint32_t)pos, lhs, rhs, {0, 0}});
+        return (uint32_t)(nodes.size() - 1);
+    }
+
+    uint32_t exp() {
+        calls++;
+        if (++depth > maxNesting) {
+            tooDeep = failed = true;
+            pos = tokens->size() - 1;  // EOF: todo lo de arriba termina enseguida
+        }
+        uint32_t value = exp_or();
+        depth--;
+        return value;
+    }
+
+    // or
+    uint32_t exp_or() {
+        calls++;
+        uint32_t lhs = exp_and();
+        return exp_or_p(lhs);
+    }
+
+    uint32_t exp_or_p(uint32_t lhs) {
+        calls++;
+        while (kind() == TK_OR) {
+            pos++;
+            lhs = node(ExprKind::Binary, TK_OR, lhs, exp_and());
+        }
+        return lhs;
+    }
+
+    // and
+    uint32_t exp_and() {
+        calls++;
+        uint32_t lhs = exp_eq();
+        return exp_and_p(lhs);
+    }
+
+    uint32_t exp_and_p(uint32_t lhs) {
+        calls++;
+        while (kind() == TK_AND) {
+            pos++;
+            lhs = node(ExprKind::Binary, TK_AND, lhs, exp_eq());
+        }
+        return lhs;
+    }
+
+    // == <>  (dentro de una expresion '=' compara, igual que '==')
+    uint32_t exp_eq() {
+        calls++;
+        uint32_t lhs = exp_rel();
+        return exp_eq_p(lhs);
+    }
+
+    uint32_t exp_eq_p(uint32_t lhs) {
+        calls++;
+        while (kind() == TK_EQ || kind() == TK_NEQ || kind() == TK_ASSIGN) {
+            int op = kind() == TK_NEQ ? TK_NEQ : TK_EQ;
+            pos++;
+            lhs = node(ExprKind::Binary, op, lhs, exp_rel());
+        }
+        return lhs;
+    }
+
+    // < <= > >=
+    uint32_t exp_rel() {
+        calls++;
+        uint32_t lhs = exp_add();
+        return exp_rel_p(lhs);
+    }
+
+    uint32_t exp_rel_p(uint32_t lhs) {
+        calls++;
+        while (kind() == TK_LT || kind() == TK_LE || kind() == TK_GT || kind() == TK_GE) {
+            int op = kind();
+            pos++;
+            lhs = node(ExprKind::Binary, op, lhs, exp_add());
+        }
+        return lhs;
+    }
+
+    // + -
+    uint32_t exp_add() {
+        calls++;
+        uint32_t lhs = exp_mul();
+        return exp_add_p(lhs);
+    }
+
+    uint32_t exp_add_p(uint32_t lhs) {
+        calls++;
+        while (kind() == TK_PLUS || kind() == TK_MINUS) {
+            int op = kind();
+            pos++;
+            lhs = node(ExprKind::Binary, op, lhs, exp_mul());
+        }
+        return lhs;
+    }
+
+    // * /
+    uint32_t exp_mul() {
+        calls++;
+        uint32_t lhs = exp_unary();
+        return exp_mul_p(lhs);
+    }
+
+    uint32_t exp_mul_p(uint32_t lhs) {
+        calls++;
+        while (kind() == TK_MUL || kind() == TK_DIV) {
+            int op = kind();
+            pos++;
+            lhs = node(ExprKind::Binary, op, lhs, exp_unary());
+        }
+        return lhs;
+    }
+
+    // unarios
+    uint32_t exp_unary() {
+        calls++;
+        if (kind() == TK_MINUS || kind() == TK_NOT) {
+            int op = kind();
+            pos++;
+            uint32_t operand = exp_unary();
+            return node(ExprKind::Unary, op, operand, 0);
+        }
+        return exp_primary();
+    }
+
+    // primarios
+    uint32_t exp_primary() {
+        calls++;
+        switch (kind()) {
+        case TK_LITNUM:
+        case TK_LITSTRING:
+        case TK_TRUE:
+        case TK_FALSE: {
+            static const ExprKind kinds[] = {ExprKind::Num, ExprKind::Str, ExprKind::True, ExprKind::False};
+            uint32_t id = node(kinds[kind() - TK_LITNUM], 0, 0, 0);
+            pos++;
+            return id;
+        }
+        case TK_NEW: {
+            pos++;
+            expect(TK_LBRACKET);
+            uint32_t size = exp();
+            expect(TK_RBRACKET);
+            while (kind() == TK_LBRACKET) {  // tipo -> ('[' ']')* base
+                pos++;
+                expect(TK_RBRACKET);
+            }
+            if (kind() >= TK_INT && kind() <= TK_STRING)
+                pos++;
+            else
+                failed = true;
+            return node(ExprKind::New, 0, 0, size);
+        }
+        case TK_LPAREN: {
+            pos++;
+            uint32_t inner = exp();
+            expect(TK_RPAREN);
+            return inner;
+        }
+        case TK_ID: {
+            uint32_t id = node(ExprKind::Var, 0, 0, 0);
+            pos++;
+            if (kind() == TK_LPAREN) {
+                // llamada -> ID '(' listaexp ')'
+                pos++;
+                size_t from = work.size();
+                arguments();
+                nodes[id].kind = ExprKind::Call;
+                nodes[id].args = {(uint32_t)lists.size(), (uint32_t)(work.size() - from)};
+                lists.insert(lists.end(), work.begin() + from, work.end());
+                work.resize(from);
+                expect(TK_RPAREN);
+                return id;
+            }
+            // var -> ID ('[' exp ']')*
+            while (kind() == TK_LBRACKET) {
+                pos++;
+                uint32_t index = exp();
+                expect(TK_RBRACKET);
+                id = node(ExprKind::Index, 0, id, index);
+            }
+            return id;
+        }
+        default:
+            failed = true;
+            pos = tokens->size() - 1;
+            return node(ExprKind::True, 0, 0, 0);
+        }
+    }
+
+    // declaraciones y encabezados: no llevan expresiones
+    void skipLine() {
+        while (kind() != TK_NL && kind() != TK_EOF)
+            pos++;
+    }
+
+    // listaexp -> (exp (',' exp)*)?, en work
+    void arguments() {
+        if (kind() == TK_RPAREN)
+            return;
+        work.push_back(exp());
+        while (kind() == TK_COMMA) {
+            pos++;
+            work.push_back(exp());
+        }
+    }
+};
+
+// Expresiones cuyo arbol se conoce: la precedencia y la asociatividad que
+// un reanalisis del arbol impreso no puede ver
+const pair<const char*, const char*> expressionCases[] = {
+    {"a + b * c", "(a + (b * c))"},
+    {"a * b + c", "((a * b) + c)"},
+    {"a - b - c", "((a - b) - c)"},
+    {"a / b / c", "((a / b) / c)"},
+    {"a - b + c * d / e", "((a - b) + ((c * d) / e))"},
+    {"a = b + c", "(a = (b + c))"},
+    {"a = b = c", "((a = b) = c)"},
+    {"a < b + 1 = c <> d", "(((a < (b + 1)) = c) <> d)"},
+    {"a or b and c", "(a or (b and c))"},
+    {"a and b or c and d", "((a and b) or (c and d))"},
+    {"not a = b", "((not a) = b)"},
+    {"-a * b", "((- a) * b)"},
+    {"- -a - b", "((- (- a)) - b)"},
+    {"(a + b) * c", "((a + b) * c)"},
+    {"a - (b - c)", "(a - (b - c))"},
+    {"v[i + 1] * f(a, b - c)", "(v[(i + 1)] * f(a, (b - c)))"},
+    {"new [n * 2] int", "new [(n * 2)]"},
+};
+
+// Expresiones con la tabla de precedencias contra la cascada recursiva: los
+// dos tienen que dar el arbol esperado en expressionCases y el mismo arbol
+// en los archivos dados y en un programa generado con expresiones largas,
+// que ademas impreso y analizado de nuevo tiene que dar el mismo texto. Mide tokens/seg y llamadas a funciones de expresiones por token; en la
+// tabla esas llamadas son las de exp(). Los dos tiempos incluyen leer el
+// archivo y el FastLexer, pero la cascada no arma comandos ni declaraciones
+// ni interna nombres: es una cota por debajo. Las llamadas por token se
+// cuentan en los archivos que se compararon.
+bool benchExpr(const vector<string>& files, int iterations, ostream& out) {
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+    bool ok = true;
+    CascadeParser cascade;
+    vector<char> storage;
+    TokenBuffer tokens;
+
+    string path = (filesystem::temp_directory_path() / "mini0_expr_bench.m0").string();
+    string casesPath = (filesystem::temp_directory_path() / "mini0_expr_casos.m0").string();
+    string printedPath = (filesystem::temp_directory_path() / "mini0_expr_impreso.m0").string();
+
+    out << "exprs: tabla de precedencias contra cascada recursiva, mejor de " << iterations << "\n";
+    {
+        string program = "fun f()\n";
+        for (const auto& c : expressionCases)
+            program += string("    x = ") + c.first + "\n";
+        program += "end\n";
+        {
+            ofstream f(casesPath, ios::binary);
+            f << program;
+        }
+        Parser parser;
+        parser.setOutput(sink, sink);
+        parser.parse(casesPath);
+        vector<string> table;
+        if (!parser.hasErrors())
+            rootShapes(parser.ast(), table);
+        lexText(program, true, tokens, storage);
+        bool parsed = cascade.program(tokens, storage.data());
+        size_t count = sizeof expressionCases / sizeof expressionCases[0];
+        bool pass = table.size() == count && parsed && cascade.roots.size() == count;
+        for (size_t i = 0; pass && i < count; i++) {
+            string got[2] = {table[i], cascade.shape(cascade.roots[i])};
+            for (int p = 0; p < 2; p++) {
+                if (got[p] != expressionCases[i].second) {
+                    out << "    [FALLO] " << (p == 0 ? "tabla" : "cascada") << ": "
+                        << expressionCases[i].first << " da " << got[p] << ", se esperaba "
+                        << expressionCases[i].second << "\n";
+                    pass = false;
+                }
+            }
+        }
+        if (pass)
+            out << "    [OK]    " << count << " expresiones con el arbol esperado (precedencia y asociatividad)\n";
+        else if (table.size() != count || !parsed || cascade.roots.size() != count)
+            out << "    [FALLO] las expresiones de prueba no se analizaron\n";
+        ok = ok && pass;
+    }
+
+    writeExpressionProgram(path, 20000);
+    const pair<vector<string>, string> groups[] = {
+        {files, "archivos dados"},
+        {{path}, "20000 funciones con expresiones"},
+    };
+    for (const auto& group : groups) {
+        if (group.first.empty())
+            continue;
+        auto readText = [](const string& f) {
+            ifstream in(f, ios::binary);
+            return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        };
+        vector<string> texts;
+        for (const string& f : group.first)
+            texts.push_back(readText(f));
+
+        // mismo arbol, raiz por raiz; de paso cuenta tokens y llamadas
+        Parser parser;
+        parser.setLexer(LexerBackend::Fast);  // que el lexer pese poco en la medicion
+        parser.setOutput(sink, sink);
+        Parser reparser;
+        reparser.setOutput(sink, sink);
+        size_t tokenCount = 0, checkedTokens = 0, roots = 0, calls = 0, checked = 0, deep = 0;
+        bool pass = true;
+        for (size_t i = 0; i < texts.size(); i++) {
+            lexText(texts[i], true, tokens, storage);
+            tokenCount += tokens.size() - 1;
+            parser.parse(group.first[i]);
+            bool parsed = cascade.program(tokens, storage.data());
+            if (parser.hasErrors())
+                continue;
+            if (cascade.tooDeep) {
+                deep++;
+                continue;
+            }
+            calls += cascade.calls;
+            checkedTokens += tokens.size() - 1;
+            vector<string> table;
+            rootShapes(parser.ast(), table);
+            roots += table.size();
+            bool same = parsed && table.size() == cascade.roots.size();
+            for (size_t r = 0; same && r < table.size(); r++)
+                same = table[r] == cascade.shape(cascade.roots[r]);
+            if (!same) {
+                out << "    [FALLO] la tabla y la cascada dan otro arbol en " << group.first[i] << "\n";
+                pass = false;
+            }
+
+            // imprimir, volver a analizar e imprimir de nuevo: mismo texto
+            ostringstream first, second;
+            SourcePrinter().print(parser.ast(), first);
+            {
+                ofstream printed(printedPath, ios::binary);
+                printed << first.str();
+            }
+            reparser.parse(printedPath);
+            if (!reparser.hasErrors())
+                SourcePrinter().print(reparser.ast(), second);
+            if (reparser.hasErrors() || first.str() != second.str()) {
+                out << "    [FALLO] el arbol impreso de " << group.first[i] << " no da el mismo arbol\n";
+                pass = false;
+            }
+            checked++;
+        }
+
+        double tableSecs = bestOf(iterations, [&] {
+            for (const string& f : group.first)
+                parser.parse(f);
+        });
+        // la cascada tambien lee el archivo y lo lexea; la fila del lexer es
+        // lo que cuesta eso solo
+        double lexSecs = bestOf(iterations, [&] {
+            for (const string& f : group.first)
+                lexText(readText(f), true, tokens, storage);
+        });
+        double cascadeSecs = bestOf(iterations, [&] {
+            for (const string& f : group.first) {
+                lexText(readText(f), true, tokens, storage);
+                cascade.program(tokens, storage.data());
+            }
+        });
+
+        double mtok = (double)tokenCount / 1e6;
+        out << "  " << group.second << ": " << tokenCount << " tokens\n";
+        const pair<const char*, pair<double, size_t>> rows[] = {
+            {"solo lectura + lexer", {lexSecs, 0}},
+            {"tabla de precedencias", {tableSecs, roots}},
+            {"cascada recursiva", {cascadeSecs, calls}},
+        };
+        for (const auto& row : rows) {
+            double secs = row.second.first;
+            out << "    " << left << setw(26) << row.first << right << fixed << setprecision(3)
+                << setw(10) << secs * 1000.0 << " ms" << setprecision(2) << setw(10)
+                << (secs > 0 ? mtok / secs : 0.0) << " Mtok/s";
+            if (row.second.second > 0)
+                out << setw(10) << (checkedTokens > 0 ? (double)row.second.second / checkedTokens : 0.0)
+                    << " llamadas/token";
+            out << "\n";
+        }
+        ok = ok && pass;
+        if (pass) {
+            out << "    [OK]    mismo arbol en " << checked << " archivos, tambien impreso y reanalizado";
+            if (deep > 0)
+                out << " (" << deep << " demasiado anidados para la cascada)";
+            out << "\n";
+        }
+    }
+    error_code ec;
+    filesystem::remove(path, ec);
+    filesystem::remove(casesPath, ec);
+    filesystem::remove(printedPath, ec);
+    return ok;
+}
+
+// programa con un solo anidamiento de n niveles del tipo dado
+void writeNestingProgram(const string& path, const string& kind, size_t n) {
+    ofstream f(path, ios::binary);
+    f << "fun main() : int\n"
+      << "    x : int\n"
+      << "    v : [ ] int\n";
+    if (kind == "+") {
+        // sin abrir nada: el arbol queda anidado a la izquierda
+        f << "    x = 1";
+        for (size_t i = 0; i < n; i++)
+            f << " + 1";
+        f << "\n";
+    } else if (kind == "else if") {
+        f << "    if x < 1\n";
+        for (size_t i = 0; i < n; i++)
+            f << "    x = " << i << "\n"
+              << "    else if x < " << i + 2 << "\n";
+        f << "    x = 1\n"
+          << "    end\n";
+    } else if (kind == "if" || kind == "while") {
+        for (size_t i = 0; i < n; i++)
+            f << (kind == "if" ? "if x < 1\n" : "while x < 1\n");
+        f << "x = 1\n";
+        for (size_t i = 0; i < n; i++)
+            f << (kind == "if" ? "end\n" : "loop\n");
+    } else {
+        const char* open = kind == "()" ? "(" : kind == "[]" ? "v[" : "-";
+        f << "    x = ";
+        for (size_t i = 0; i < n; i++)
+            f << open;
+        f << "1";
+        if (kind != "-")
+            for (size_t i = 0; i < n; i++)
+                f << (kind == "()" ? ")" : "]");
+        f << "\n";
+    }
+    f << "    return x\n"
+      << "end\n";
+}
+
+// Anidamiento patologico: sin limite el parser no usa la pila de C++ y cada
+// token cuesta lo mismo (ns/token parejo de 10k a 1M niveles), y nombres y
+// tipos pasan sin problema; con el limite de compilar sale un solo error limpio.
+bool benchDepth(const vector<string>&, int iterations, ostream& out) {
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+    bool ok = true;
+    string path = (filesystem::temp_directory_path() / "mini0_depth_bench.m0").string();
+
+    out << "depth: anidamiento sin limite y con --max-depth " << compileDepthLimit
+        << ", mejor de " << iterations << "\n";
+    for (const char* kind : {"()", "[]", "-", "+", "if", "else if", "while"}) {
+        for (size_t n : {10000, 100000, 1000000}) {
+            writeNestingProgram(path, kind, n);
+            ParserOptions unlimited;
+            unlimited.lexMode = LexMode::Buffered;
+            Parser parser;
+            parser.setOptions(unlimited);
+            parser.setOutput(sink, sink);
+            parser.parse(path);
+            size_t tokens = parser.tokenBuffer().size() - 1;
+            bool pass = !parser.hasErrors() && parser.deepestNesting() > n;
+            double secs = bestOf(iterations, [&] { parser.parse(path); });
+            SemanticAnalyzer sema;
+            TypeChecker types;
+            bool checked = true;
+            double checkSecs = bestOf(iterations, [&] {
+                checked = sema.check(parser.ast()) && types.check(parser.ast(), sema);
+            });
+            pass = pass && checked;
+
+            // con el limite: un error que lo dice y nada mas
+            ostringstream messages;
+            ParserOptions options;
+            options.maxDepth = compileDepthLimit;
+            Parser limited;
+            limited.setOptions(options);
+            limited.setOutput(sink, messages);
+            limited.parse(path);
+            string text = messages.str();
+            pass = pass && limited.hasErrors() && text.find("anidamiento") != string::npos &&
+                   count(text.begin(), text.end(), '\n') == 2;
+            ok = ok && pass;
+            out << "  " << (pass ? "[OK]    " : "[FALLO] ") << left << setw(8) << kind << right
+                << setw(8) << n << " niveles" << fixed << setprecision(3) << setw(10)
+                << secs * 1000.0 << " ms" << setprecision(1) << setw(8)
+                << (tokens > 0 ? secs * 1e9 / tokens : 0.0) << " ns/token" << setprecision(3)
+                << setw(10) << checkSecs * 1000.0 << " ms nombres y tipos\n";
+        }
+    }
+    error_code ec;
+    filesystem::remove(path, ec);
+    return ok;
+}
+
+// programa sintetico con n funciones: cada una declara parametros y locales,
+// abre bloques anidados que ocultan nombres y llama a la anterior
+void writeScalingProgram(const string& path, size_t n) {
+    ofstream f(path, ios::binary);
+    f << "contador : int\n\n";
+    for (size_t i = 0; i < n; i++) {
+        f << "fun f" << i << "(a : int, b : int) : int\n"
+          << "    x : int\n"
+          << "    v : [ ] int\n"
+          << "    v = new [ a ] int\n"
+          << "    x = a + b * 2\n"
+          << "    while x < b\n"
+          << "        x : int\n"
+          << "        x = v[0] + contador\n"
+          << "    loop\n";
+        if (i > 0)
+            f << "    x = f" << i - 1 << "(x, b)\n";
+        f << "    return x\n"
+          << "end\n\n";
+    }
+}
+
+// Un programa que el parser acepta pero que nombres o tipos tienen que
+// rechazar: con ese codigo, en 'line' y 'column', y un mensaje que contiene 'text'
+struct Rejected {
+    const char* what;
+    DiagCode code;
+    uint32_t line;
+    uint16_t column;
+    const char* text;
+    const char* source;
+};
+
+const Rejected semaRejects[] = {
+    {"variable no declarada", DG_NO_DECLARADA, 2, 5, "variable 'x' no declarada",
+     "fun main() : int\n"
+     "    x = 1\n"
+     "    return 0\n"
+     "end\n"},
+    {"funcion no declarada", DG_NO_DECLARADA, 3, 9, "funcion 'g' no declarada",
+     "fun main() : int\n"
+     "    x : int\n"
+     "    x = g(1)\n"
+     "    return x\n"
+     "end\n"},
+    {"cantidad de argumentos", DG_ARGUMENTOS, 7, 9, "'f' espera 1",
+     "fun f(a : int) : int\n"
+     "    return a\n"
+     "end\n"
+     "\n"
+     "fun main() : int\n"
+     "    x : int\n"
+     "    x = f(1, 2)\n"
+     "    return x\n"
+     "end\n"},
+    {"variable redeclarada", DG_REDECLARADA, 3, 5, "'x' ya fue declarada en este bloque (linea 2)",
+     "fun main() : int\n"
+     "    x : int\n"
+     "    x : bool\n"
+     "    return 0\n"
+     "end\n"},
+    {"funcion redeclarada", DG_REDECLARADA, 5, 1, "la funcion 'f' ya fue declarada en la linea 1",
+     "fun f() : int\n"
+     "    return 1\n"
+     "end\n"
+     "\n"
+     "fun f() : int\n"
+     "    return 2\n"
+     "end\n"},
+};
+
+const Rejected typeRejects[] = {
+    {"return de otro tipo", DG_RETORNO, 4, 5, "la funcion 'crear' debe devolver 'int' y devuelve '[ ] int'",
+     "fun crear(n : int) : int\n"
+     "    a : [ ] int\n"
+     "    a = new [ n ] int\n"
+     "    return a\n"
+     "end\n"},
+    {"return sin tipo declarado", DG_RETORNO, 4, 5, "la funcion 'main' no devuelve valor",
+     "fun main()\n"
+     "    x : int\n"
+     "    x = 1\n"
+     "    return x\n"
+     "end\n"},
+    {"asignacion a la declarada", DG_TIPO_DISTINTO, 3, 5, "el valor asignado debe ser 'int' y es 'bool'",
+     "fun main() : int\n"
+     "    x : int\n"
+     "    x = true\n"
+     "    return x\n"
+     "end\n"},
+    {"tipo de argumento", DG_TIPO_DISTINTO, 6, 12, "el argumento 2 de 'f'",
+     "fun f(a : int, b : bool) : int\n"
+     "    return a\n"
+     "end\n"
+     "\n"
+     "fun main() : int\n"
+     "    return f(1, 2)\n"
+     "end\n"},
+    {"condicion del if", DG_TIPO_DISTINTO, 3, 5, "la condicion del if debe ser 'bool' y es 'int'",
+     "fun main() : int\n"
+     "    x : int\n"
+     "    if x\n"
+     "        x = 1\n"
+     "    end\n"
+     "    return x\n"
+     "end\n"},
+    {"condicion del while", DG_TIPO_DISTINTO, 3, 5, "la condicion del while debe ser 'bool' y es 'int'",
+     "fun main() : int\n"
+     "    x : int\n"
+     "    while x + 1\n"
+     "        x = 1\n"
+     "    loop\n"
+     "    return x\n"
+     "end\n"},
+    {"indice no int", DG_TIPO_DISTINTO, 4, 13, "el indice debe ser 'int' y es 'bool'",
+     "fun main() : int\n"
+     "    v : [ ] int\n"
+     "    v = new [ 3 ] int\n"
+     "    return v[true]\n"
+     "end\n"},
+    {"tamano de new no int", DG_TIPO_DISTINTO, 3, 9, "el tamano de new debe ser 'int' y es 'bool'",
+     "fun main() : int\n"
+     "    v : [ ] int\n"
+     "    v = new [ false ] int\n"
+     "    return 0\n"
+     "end\n"},
+};
+
+// Los programas del corpus que tienen que fallar por tipos (los originales
+// de valido2 y valido4, de antes del chequeo): si estan entre los archivos
+// medidos, cada uno tiene que dar al menos este error
+struct RejectedFile {
+    const char* name;
+    DiagCode code;
+    uint32_t line;
+    uint16_t column;
+    const char* text;
+};
+
+const RejectedFile typeRejectFiles[] = {
+    {"error8_tipos.m0", DG_RETORNO, 5, 5, "la funcion 'crearArreglo' debe devolver 'int' y devuelve '[ ] int'"},
+    {"error8_tipos.m0", DG_TIPO_DISTINTO, 12, 5, "el valor asignado debe ser '[ ] int' y es 'int'"},
+    {"error9_retorno.m0", DG_RETORNO, 16, 5, "la funcion 'main' no devuelve valor"},
+};
+
+// Analiza el programa del caso (en path) y busca el error esperado entre
+// los que dejan nombres y, si esos pasan, tipos. 'got' es el primero que hubo.
+bool rejects(const Rejected& c, const string& path, Parser& parser, string& got) {
+    if (c.source) {
+        ofstream f(path, ios::binary);
+        f << c.source;
+    }
+    got.clear();
+    parser.parse(path);
+    if (parser.hasErrors()) {
+        got = "no pasa el parser";
+        return false;
+    }
+    Diagnostics found;
+    SemanticAnalyzer sema;
+    TypeChecker types;
+    sema.setDiagnostics(&found);
+    types.setDiagnostics(&found);
+    if (sema.check(parser.ast()))
+        types.check(parser.ast(), sema);
+    bool pass = false;
+    for (const Diagnostic& d : found.all()) {
+        string text = found.message(d, nullptr);
+        bool match = d.code == c.code && d.line == c.line && found.column(d, nullptr) == c.column &&
+                     text.find(c.text) != string::npos;
+        if (got.empty() || (match && !pass))
+            got = text;
+        pass = pass || match;
+    }
+    if (got.empty())
+        got = "sin errores";
+    return pass;
+}
+
+bool checkRejects(const Rejected* cases, size_t count, const string& path, Parser& parser,
+                  ostream& out) {
+    bool ok = true;
+    for (size_t i = 0; i < count; i++) {
+        string got;
+        bool pass = rejects(cases[i], path, parser, got);
+        ok = ok && pass;
+        out << "  " << (pass ? "[OK]    " : "[FALLO] ") << left << setw(26) << cases[i].what
+            << right << got << "\n";
+    }
+    return ok;
+}
+
+// El analisis semantico (nombres y tipos) tiene que crecer lineal con el
+// tamano del programa: ns por funcion deberia quedar parejo de 1k a 100k.
+bool benchSema(const vector<string>& files, int iterations, ostream& out) {
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+    Parser parser;
+    parser.setOutput(sink, sink);
+    SemanticAnalyzer sema;
+    sema.setOutput(sink);
+    TypeChecker types;
+    types.setOutput(sink);
+    bool ok = true;
+
+    // tiempo de cada pasada; los tipos solo si los nombres estan bien
+    double nameSecs = 0, typeSecs = 0;
+    auto measure = [&] {
+        nameSecs = bestOf(iterations, [&] { sema.check(parser.ast()); });
+        typeSecs = 0;
+        if (sema.errorCount() == 0)
+            typeSecs = bestOf(iterations, [&] { types.check(parser.ast(), sema); });
+        return sema.errorCount() + (typeSecs > 0 ? types.errorCount() : 0);
+    };
+
+    out << "sema: nombres y tipos, mejor de " << iterations << "\n";
+    for (const string& f : files) {
+        parser.parse(f);
+        if (parser.hasErrors())
+            continue;
+        size_t errors = measure();
+        out << "  " << left << setw(28) << f << right << fixed << setprecision(3)
+            << setw(10) << nameSecs * 1e6 << " us" << setw(10) << typeSecs * 1e6 << " us  "
+            << errors << " errores\n";
+    }
+
+    string path = (filesystem::temp_directory_path() / "mini0_sema_bench.m0").string();
+    for (size_t n : {1000, 10000, 100000}) {
+        writeScalingProgram(path, n);
+        parser.parse(path);
+        bool pass = !parser.hasErrors() && measure() == 0;
+        ok = ok && pass;
+        out << "  " << (pass ? "[OK]    " : "[FALLO] ") << setw(7) << n << " funciones"
+            << fixed << setprecision(1) << setw(10) << nameSecs * 1e9 / n << " ns/funcion"
+            << setw(10) << typeSecs * 1e9 / n << " ns/funcion\n";
+    }
+
+    // y los programas mal formados tienen que dar su error
+    ok = checkRejects(semaRejects, size(semaRejects), path, parser, out) && ok;
+    ok = checkRejects(typeRejects, size(typeRejects), path, parser, out) && ok;
+    for (const string& f : files) {
+        string name = filesystem::path(f).filename().string();
+        for (const RejectedFile& r : typeRejectFiles) {
+            if (name != r.name)
+                continue;
+            Rejected c = {r.name, r.code, r.line, r.column, r.text, nullptr};
+            string got;
+            bool pass = rejects(c, f, parser, got);
+            ok = ok && pass;
+            out << "  " << (pass ? "[OK]    " : "[FALLO] ") << left << setw(26) << r.name
+                << right << got << "\n";
+        }
+    }
+    error_code ec;
+    filesystem::remove(path, ec);
+    return ok;
+}
+
+// El arbol entero como texto, campo por campo (sin el relleno de los
+// structs): dos parses arman el mismo arbol si dan la misma imagen
+string treeImage(const Ast& t) {
+    ostringstream s;
+    for (const Expr& e : t.exprs)
+        s << "e " << (int)e.kind << ' ' << (int)e.op << ' ' << e.type << ' ' << e.line << ':'
+          << e.column << ' ' << e.sym << ' ' << e.text.offset << '+' << e.text.length << ' '
+          << e.lhs << ' ' << e.rhs << ' ' << e.args.first << '+' << e.args.count << '\n';
+    for (const Stmt& st : t.stmts)
+        s << "s " << (int)st.kind << ' ' << st.line << ':' << st.column << ' ' << st.target << ' '
+          << st.value << ' ' << st.body << ' ' << st.orelse << '\n';
+    for (const VarDecl& v : t.vars)
+        s << "v " << v.name << ' ' << v.type << ' ' << v.line << ':' << v.column << '\n';
+    for (const Block& b : t.blocks)
+        s << "b " << b.vars.first << '+' << b.vars.count << ' ' << b.stmts.first << '+'
+          << b.stmts.count << '\n';
+    for (const Func& f : t.funcs)
+        s << "f " << f.name << ' ' << f.ret << ' ' << f.line << ':' << f.column << ' '
+          << f.params.first << '+' << f.params.count << ' ' << f.body << '\n';
+    s << "l";
+    for (NodeId id : t.lists)
+        s << ' ' << id;
+    s << "\ng";
+    for (NodeId id : t.globals)
+        s << ' ' << id;
+    s << '\n';
+    return s.str();
+}
+
+// El motor LL(1) de tabla (ll1.h) contra el descenso escrito a mano: por
+// archivo, que los dos acepten o rechacen lo mismo con los mismos mensajes,
+// armen el mismo arbol (nodo por nodo, en el mismo orden) y corten en el
+// mismo token con --max-depth; y tokens/seg de cada uno.
+bool benchLl1(const vector<string>& files, int iterations, ostream& out) {
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+    bool ok = true;
+
+    string exprPath = (filesystem::temp_directory_path() / "mini0_ll1_expr.m0").string();
+    string stmtPath = (filesystem::temp_directory_path() / "mini0_ll1_stmt.m0").string();
+    writeExpressionProgram(exprPath, 20000);
+    writeScalingProgram(stmtPath, 20000);
+    // cada forma de abrir niveles, para los cortes de --max-depth
+    vector<string> nesting;
+    for (const char* kind : {"()", "[]", "-", "+", "if", "else if", "while"}) {
+        string name = "mini0_ll1_nest" + to_string(nesting.size()) + ".m0";
+        nesting.push_back((filesystem::temp_directory_path() / name).string());
+        writeNestingProgram(nesting.back(), kind, 30);
+    }
+    const pair<vector<string>, string> groups[] = {
+        {files, "archivos dados"},
+        {{exprPath}, "20000 funciones con expresiones"},
+        {{stmtPath}, "20000 funciones con bloques"},
+        {nesting, "30 niveles de cada tipo"},
+    };
+    const pair<ParserEngine, const char*> engines[] = {
+        {ParserEngine::Descent, "descenso a mano"},
+        {ParserEngine::Table, "tabla LL(1)"},
+    };
+    const unsigned limits[] = {0, 5, 12};
+
+    out << "ll1: tabla LL(1) (" << llProductionCount << " producciones, " << LL_COUNT
+        << " no terminales, " << sizeof(llTable.rule) << " bytes) contra descenso, mejor de "
+        << iterations << "\n";
+    for (const auto& group : groups) {
+        if (group.first.empty())
+            continue;
+        size_t tokens = 0;
+        {
+            Parser parser;
+            parser.setOutput(sink, sink);
+            parser.setLexMode(LexMode::Buffered);
+            for (const string& f : group.first) {
+                parser.parse(f);
+                tokens += parser.tokenBuffer().size() - 1;
+            }
+        }
+        out << "  " << group.second << ": " << group.first.size() << " archivos, " << tokens
+            << " tokens\n";
+
+        // por archivo y por limite: aceptado o no, los mensajes, el mayor
+        // anidamiento y el arbol (tambien el que queda despues de un error)
+        vector<string> results[2];
+        double secs[2] = {0, 0};
+        for (int e = 0; e < 2; e++) {
+            ParserOptions options;
+            options.lexer = LexerBackend::Fast;  // que el lexer pese poco en la medicion
+            options.engine = engines[e].first;
+            Parser parser;
+            for (const string& f : group.first) {
+                string result;
+                for (unsigned limit : limits) {
+                    options.maxDepth = limit;
+                    parser.setOptions(options);
+                    ostringstream messages;
+                    parser.setOutput(sink, messages);
+                    parser.parse(f);
+                    result += (parser.hasErrors() ? "rechazado\n" : "aceptado\n") + messages.str() +
+                              "niveles " + to_string(parser.deepestNesting()) + "\n";
+                    result += treeImage(parser.ast());
+                }
+                results[e].push_back(move(result));
+            }
+
+            options.maxDepth = 0;
+            parser.setOptions(options);
+            parser.setOutput(sink, sink);
+            secs[e] = bestOf(iterations, [&] {
+                for (const string& f : group.first)
+                    parser.parse(f);
+            });
+            double mtok = (double)tokens / 1e6;
+            out << "    " << left << setw(28) << engines[e].second << right << fixed
+                << setprecision(3) << setw(10) << secs[e] * 1000.0 << " ms" << setprecision(2)
+                << setw(10) << (secs[e] > 0 ? mtok / secs[e] : 0.0) << " Mtok/s\n";
+        }
+        size_t differ = 0;
+        for (size_t i = 0; i < results[0].size(); i++)
+            if (results[0][i] != results[1][i]) {
+                if (differ++ == 0)
+                    out << "    primera diferencia: " << group.first[i] << "\n";
+            }
+        ok = ok && differ == 0;
+        out << "    " << (differ == 0 ? "[OK]    mismo arbol, mensajes y cortes de --max-depth 5 y 12"
+                                  : "[FALLO] difieren")
+            << fixed << setprecision(2) << " (tabla/descenso: "
+            << (secs[0] > 0 ? secs[1] / secs[0] : 0.0) << "x el tiempo)\n";
+    }
+    error_code ec;
+    filesystem::remove(exprPath, ec);
+    filesystem::remove(stmtPath, ec);
+    for (const string& path : nesting)
+        filesystem::remove(path, ec);
+    return ok;
+}
+
+// parse + chequeos + bytecode; false si el archivo no llega a compilar
+bool compileFile(const string& file, Parser& parser, SemanticAnalyzer& sema, TypeChecker& types,
+                 BytecodeCompiler& compiler, Program& program) {
+    return checkFile(file, parser, sema, types) && compiler.compile(parser.ast(), sema, program);
+}
+
+// Programas ejecutados en la VM: instrucciones por segundo (ver bench/*.m0)
+void benchVm(const vector<string>& files, int iterations, ostream& out) {
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+    Parser parser;
+    parser.setOutput(sink, sink);
+    SemanticAnalyzer sema;
+    sema.setOutput(sink);
+    TypeChecker types;
+    types.setOutput(sink);
+    BytecodeCompiler compiler;
+    compiler.setOutput(sink);
+    Program program;
+    VM vm;
+    vm.setOutput(sink);
+
+    out << "vm: mejor de " << iterations << "\n";
+    for (const string& f : files) {
+        if (!compileFile(f, parser, sema, types, compiler, program) || program.mainFunction < 0)
+            continue;
+        Value result = 0;
+        bool ok = true;
+        double secs = bestOf(iterations, [&] { ok = vm.run(program, result); });
+        double minstr = (double)vm.instructions() / 1e6;
+        out << "  " << left << setw(28) << f << right << fixed << setprecision(3)
+            << setw(10) << secs * 1000.0 << " ms" << setprecision(1) << setw(10) << minstr
+            << " Minstr" << setw(10) << (secs > 0 ? minstr / secs : 0.0) << " Minstr/s  ";
+        if (ok)
+            out << "main = " << result << "\n";
+        else
+            out << "error de ejecucion\n";
+    }
+}
+
+// Pares de opcodes de la VM de pila mas ejecutados en todos los archivos:
+// de aca salen las superinstrucciones del interprete de registros
+void benchProfile(const vector<string>& files, ostream& out) {
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+    Parser parser;
+    parser.setOutput(sink, sink);
+    SemanticAnalyzer sema;
+    sema.setOutput(sink);
+    TypeChecker types;
+    types.setOutput(sink);
+    BytecodeCompiler compiler;
+    compiler.setOutput(sink);
+    Program program;
+    VM vm;
+    vm.setOutput(sink);
+
+    vector<uint64_t> pairs, total(OP_COUNT * OP_COUNT, 0);
+    for (const string& f : files) {
+        if (!compileFile(f, parser, sema, types, compiler, program) || program.mainFunction < 0)
+            continue;
+        Value result;
+        vm.profile(program, result, pairs);
+        for (size_t i = 0; i < total.size(); i++)
+            total[i] += pairs[i];
+    }
+
+    uint64_t all = 0;
+    vector<uint64_t> single(OP_COUNT, 0);
+    for (size_t i = 0; i < total.size(); i++) {
+        all += total[i];
+        single[i % OP_COUNT] += total[i];
+    }
+    if (all == 0) {
+        out << "profile: no se ejecuto ningun programa\n";
+        return;
+    }
+    auto top = [&](const vector<uint64_t>& counts, size_t n) {
+        vector<size_t> order(counts.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = i;
+        sort(order.begin(), order.end(), [&](size_t a, size_t b) { return counts[a] > counts[b]; });
+        order.resize(min(n, order.size()));
+        return order;
+    };
+
+    out << "profile: " << all << " instrucciones de pila\n";
+    out << "  opcodes:\n";
+    for (size_t op : top(single, 10))
+        out << "    " << left << setw(26) << opcodeNames[op] << right << fixed << setprecision(1)
+            << setw(6) << 100.0 * (double)single[op] / (double)all << " %\n";
+    out << "  pares:\n";
+    for (size_t p : top(total, 15))
+        out << "    " << left << setw(26) << string(opcodeNames[p / OP_COUNT]) + " " + opcodeNames[p % OP_COUNT]
+            << right << fixed << setprecision(1) << setw(6) << 100.0 * (double)total[p] / (double)all << " %\n";
+}
+
+// Mismo programa en la VM de pila y en el interprete de registros con switch y
+// con despacho threaded, con y sin superinstrucciones. Tambien es un chequeo:
+// todos tienen que terminar igual.
+bool benchDispatch(const vector<string>& files, int iterations, ostream& out) {
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+    Parser parser;
+    parser.setOutput(sink, sink);
+    SemanticAnalyzer sema;
+    sema.setOutput(sink);
+    TypeChecker types;
+    types.setOutput(sink);
+    BytecodeCompiler compiler;
+    compiler.setOutput(sink);
+    Program program;
+    VM vm;
+    vm.setOutput(sink);
+    RegisterCompiler regCompiler;
+    regCompiler.setOutput(sink);
+    RegProgram plain, fused;
+    RegisterVM regVm;
+    regVm.setOutput(sink);
+
+    out << "dispatch: mejor de " << iterations;
+    if (!RegisterVM::threadedAvailable())
+        out << " (sin goto computado: threaded usa el switch)";
+    out << "\n";
+    bool same = true;
+    for (const string& f : files) {
+        if (!compileFile(f, parser, sema, types, compiler, program) || program.mainFunction < 0)
+            continue;
+        regCompiler.setFusion(false);
+        regCompiler.compile(parser.ast(), sema, plain);
+        regCompiler.setFusion(true);
+        regCompiler.compile(parser.ast(), sema, fused);
+
+        Value expected = 0;
+        bool expectedOk = true;
+        double base = bestOf(iterations, [&] { expectedOk = vm.run(program, expected); });
+        out << "  " << f << "  (main = " << expected << ", " << program.functions.size()
+            << " funciones, " << plain.instructions() << " / " << fused.instructions()
+            << " instrucciones de registros)\n";
+        auto line = [&](const string& label, double secs) {
+            out << "    " << left << setw(30) << label << right << fixed << setprecision(3)
+                << setw(10) << secs * 1000.0 << " ms" << setprecision(2) << setw(8)
+                << (secs > 0 ? base / secs : 0.0) << "x\n";
+        };
+        line("pila, switch", base);
+
+        struct Variant {
+            const char* label;
+            RegProgram* code;
+            Dispatch dispatch;
+        };
+        const Variant variants[] = {
+            {"registros, switch", &plain, Dispatch::Switch},
+            {"registros, switch + super", &fused, Dispatch::Switch},
+            {"registros, threaded", &plain, Dispatch::Threaded},
+            {"registros, threaded + super", &fused, Dispatch::Threaded},
+        };
+        for (const Variant& v : variants) {
+            Value result = 0;
+            bool ok = true;
+            double secs = bestOf(iterations, [&] { ok = regVm.run(*v.code, result, v.dispatch); });
+            line(v.label, secs);
+            if (ok != expectedOk || result != expected) {
+                out << "    FALLO: " << v.label << " da " << (ok ? to_string(result) : string("error"))
+                    << "\n";
+                same = false;
+            }
+        }
+    }
+    return same;
+}
+
+// codigo de salida de un comando de system()
+int runCommand(const string& command) {
+    int status = system(command.c_str());
+#ifdef _WIN32
+    return status;
+#else
+    return status != -1 && WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+}
+
+string readFile(const string& path) {
+    ifstream f(path, ios::binary);
+    ostringstream text;
+    text << f.rdbuf();
+    return text.str();
+}
+
+// Caminos a codigo nativo: --emit-c (se compila con el C del sistema),
+// --emit-asm (se ensambla y enlaza con runtime/mini0_rt.c) y -c (el objeto
+// sale de mini0 y solo se enlaza)
+enum class NativeBackend { C, Asm, Obj };
+
+const char* nativeName(NativeBackend backend) {
+    return backend == NativeBackend::C ? "c" : backend == NativeBackend::Asm ? "asm" : "obj";
+}
+
+bool writeObject(const string& path, const Ast& tree, const SemanticAnalyzer& sema,
+                 AsmGenerator& generator) {
+    ElfObject object;
+    if (!generator.compile(tree, sema, object))
+        return false;
+    vector<uint8_t> bytes;
+    object.write(bytes);
+    ofstream f(path, ios::binary);
+    f.write((const char*)bytes.data(), (streamsize)bytes.size());
+    return (bool)f.flush();
+}
+
+// Directorio temporal nuevo, mini0_<prefijo>_<numero>: dos corridas a la vez
+// no se pisan los archivos ni se reusan los de una corrida que se corto. Lo
+// borra quien lo pidio (remove_all); vacio si no se pudo crear.
+filesystem::path makeTempDir(const string& prefix) {
+    error_code ec;
+    filesystem::path base = filesystem::temp_directory_path(ec);
+    random_device random;
+    for (int attempt = 0; !ec && attempt < 100; attempt++) {
+        filesystem::path dir = base / ("mini0_" + prefix + "_" + to_string(random()));
+        if (filesystem::create_directory(dir, ec))
+            return dir;
+    }
+    return {};
+}
+
+// Lo que tiene que dar main en los programas de ejemplo, escrito a mano: si
+// el interprete fuera el unico oraculo, un error que compartiera con un
+// backend pasaria. error: parte del mensaje de ejecucion (nullptr: main
+// termina bien y devuelve value).
+struct KnownResult {
+    const char* file;
+    Value value;
+    const char* error;
+};
+
+const KnownResult knownResults[] = {
+    {"valido1.m0", 20, nullptr},
+    {"valido2.m0", 5, nullptr},
+    {"valido3.m0", 0, "no tiene funcion main"},
+    {"valido4.m0", 7, nullptr},
+    {"valido5.m0", 0, "arreglo sin crear"},
+    {"bench/calls.m0", 832040, nullptr},
+    {"bench/loops.m0", 2245502, nullptr},
+    {"bench/matrix.m0", 1356729, nullptr},
+    {"bench/sieve.m0", 148933, nullptr},
+};
+
+// el de knownResults para este archivo (por el final del camino), o nullptr
+const KnownResult* knownResult(const string& file) {
+    string path = filesystem::path(file).lexically_normal().generic_string();
+    for (const KnownResult& k : knownResults) {
+        size_t n = strlen(k.file);
+        if (path.size() >= n && path.compare(path.size() - n, n, k.file) == 0 &&
+            (path.size() == n || path[path.size() - n - 1] == '/'))
+            return &k;
+    }
+    return nullptr;
+}
+
+// De punta a punta: cada programa se traduce, se construye con el compilador
+// del sistema ($CC, si no cc) y se ejecuta. El codigo de salida y los errores
+// de ejecucion tienen que ser los mismos que da el interprete, y en los
+// programas de knownResults los dos tienen que dar lo esperado; si uno de
+// esos no pasa el analisis o no compila, es un fallo. El runtime se busca en
+// runtime/ o en $MINI0_RUNTIME.
+bool compareNative(const vector<string>& files, const vector<NativeBackend>& backends,
+                   int iterations, ostream& out) {
+    namespace fs = std::filesystem;
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+    Parser parser;
+    parser.setOutput(sink, sink);
+    SemanticAnalyzer sema;
+    sema.setOutput(sink);
+    TypeChecker types;
+    types.setOutput(sink);
+    RegisterCompiler compiler;
+    compiler.setOutput(sink);
+    RegProgram program;
+    RegisterVM vm;
+    CGenerator cgen;
+    cgen.setOutput(sink);
+    AsmGenerator asmgen;
+    asmgen.setOutput(sink);
+
+    const char* runtimeEnv = getenv("MINI0_RUNTIME");
+    error_code ec;
+    fs::path runtime = fs::absolute(runtimeEnv ? runtimeEnv : "runtime", ec);
+    if (!fs::exists(runtime / "mini0_rt.h", ec)) {
+        out << "  no se encuentra " << (runtime / "mini0_rt.h").string()
+            << " (correr desde Final/ o definir MINI0_RUNTIME)\n";
+        return false;
+    }
+    const char* ccEnv = getenv("CC");
+    string cc = ccEnv && *ccEnv ? ccEnv : "cc";
+    fs::path dir = makeTempDir("native");
+    if (dir.empty()) {
+        out << "  no se pudo crear un directorio temporal\n";
+        return false;
+    }
+    string exe = (dir / "programa").string();
+    string log = (dir / "salida.txt").string();
+    string includes = " -I \"" + runtime.string() + "\"";
+    string rtSource = " \"" + (runtime / "mini0_rt.c").string() + "\"";
+
+    bool ok = true;
+    size_t checked = 0;
+    for (const string& f : files) {
+        const KnownResult* known = knownResult(f);
+        if (!checkFile(f, parser, sema, types) || !compiler.compile(parser.ast(), sema, program)) {
+            if (known) {
+                out << "  " << f << "\n    FALLO: no pasa el analisis o no compila\n";
+                ok = false;
+            }
+            continue;
+        }
+
+        // lo que se espera: lo que hace el interprete, que tambien se
+        // chequea contra knownResults
+        ostringstream expectedErr;
+        vm.setOutput(expectedErr);
+        Value result = 0;
+        bool ran = true;
+        double vmSecs = bestOf(iterations, [&] {
+            expectedErr.str("");
+            ran = vm.run(program, result);
+        });
+        int expected = ran ? (int)(result & 0xFF) : 1;
+        out << "  " << left << setw(28) << f << right << "  salida " << setw(3) << expected
+            << fixed << setprecision(3) << "  vm " << setw(9) << vmSecs * 1000.0 << " ms";
+
+        string problem;
+        if (known && known->error &&
+            (ran || expectedErr.str().find(known->error) == string::npos)) {
+            problem = string("vm: se esperaba el error de ejecucion '") + known->error + "'";
+            if (ran)
+                problem += " y main devuelve " + to_string(result);
+        } else if (known && !known->error && (!ran || result != known->value)) {
+            problem = "vm: main deberia devolver " + to_string(known->value) + " y " +
+                      (ran ? "devuelve " + to_string(result) : string("termina con error"));
+        }
+        for (NativeBackend backend : backends) {
+            if (!problem.empty())
+                break;
+            bool isC = backend == NativeBackend::C;
+            const char* name = nativeName(backend);
+            string source = (dir / (isC ? "programa.c"
+                                    : backend == NativeBackend::Asm ? "programa.s" : "programa.o"))
+                                .string();
+            if (backend == NativeBackend::Obj) {
+                writeObject(source, parser.ast(), sema, asmgen);
+            } else {
+                ofstream code(source, ios::binary);
+                if (isC)
+                    cgen.generate(parser.ast(), sema, code);
+                else
+                    asmgen.generate(parser.ast(), sema, code);
+            }
+            string build = cc + " -O2" + includes + " -o \"" + exe + "\" \"" + source + "\"" +
+                           (isC ? "" : rtSource) + " > \"" + log + "\" 2>&1";
+            if (runCommand(build) != 0) {
+                problem = cc + " no pudo construir el programa (" + name + ")";
+                istringstream lines(readFile(log));
+                string line;
+                for (int i = 0; i < 10 && getline(lines, line); i++)
+                    problem += "\n      " + line;
+                break;
+            }
+            int status = 0;
+            double secs = bestOf(iterations, [&] {
+                status = runCommand("\"" + exe + "\" > \"" + log + "\" 2>&1");
+            });
+            out << "  " << name << " " << setw(9) << secs * 1000.0 << " ms";
+            if (status != expected || readFile(log) != expectedErr.str()) {
+                problem = string(name) + " termina con " + to_string(status);
+                string got = readFile(log);
+                if (!got.empty())
+                    problem += ": " + got.substr(0, got.size() - 1);
+                break;
+            }
+        }
+        checked++;
+        if (problem.empty()) {
+            out << "  OK\n";
+        } else {
+            out << "\n    FALLO: " << problem << "\n";
+            ok = false;
+        }
+    }
+    fs::remove_all(dir, ec);
+    out << "  " << checked << " programas comparados\n";
+    return ok;
+}
+
+bool benchEmitC(const vector<string>& files, int iterations, ostream& out) {
+    out << "emitc: C con -O2 contra el interprete, ejecucion mejor de " << iterations << "\n";
+    return compareNative(files, {NativeBackend::C}, iterations, out);
+}
+
+// programa sintetico de bucles: n vueltas afuera, 1000 adentro, con una llamada
+void writeLoopProgram(const string& path, size_t n) {
+    ofstream f(path, ios::binary);
+    f << "fun paso(x : int, k : int) : int\n"
+      << "    return (x * 31 + k) - x / 7\n"
+      << "end\n\n"
+      << "fun main() : int\n"
+      << "    i : int\n"
+      << "    j : int\n"
+      << "    acc : int\n"
+      << "    i = 0\n"
+      << "    while i < " << n << "\n"
+      << "        j = 0\n"
+      << "        while j < 1000\n"
+      << "            acc = paso(acc, j) - acc / 3 + i\n"
+      << "            if acc > 1000000000 or acc < 0 - 1000000000\n"
+      << "                acc = acc / 1000\n"
+      << "            end\n"
+      << "            j = j + 1\n"
+      << "        loop\n"
+      << "        i = i + 1\n"
+      << "    loop\n"
+      << "    return acc\n"
+      << "end\n";
+}
+
+// programa sintetico de arreglos: dos arreglos de n elementos recorridos
+// hacia adelante y hacia atras en varias pasadas
+void writeArrayProgram(const string& path, size_t n) {
+    ofstream f(path, ios::binary);
+    f << "fun main() : int\n"
+      << "    a : [ ] int\n"
+      << "    b : [ ] int\n"
+      << "    i : int\n"
+      << "    r : int\n"
+      << "    s : int\n"
+      << "    n : int\n"
+      << "    n = " << n << "\n"
+      << "    a = new [ n ] int\n"
+      << "    b = new [ n ] int\n"
+      << "    i = 0\n"
+      << "    while i < n\n"
+      << "        a[i] = i * 7919 - (i / 13) * 13\n"
+      << "        i = i + 1\n"
+      << "    loop\n"
+      << "    r = 0\n"
+      << "    while r < 20\n"
+      << "        i = 1\n"
+      << "        while i < n\n"
+      << "            b[i] = (b[i - 1] + a[i] - a[i - 1] / 2) / 2\n"
+      << "            i = i + 1\n"
+      << "        loop\n"
+      << "        i = 0\n"
+      << "        while i < n\n"
+      << "            a[i] = b[n - 1 - i] / 3 + r\n"
+      << "            i = i + 1\n"
+      << "        loop\n"
+      << "        r = r + 1\n"
+      << "    loop\n"
+      << "    s = 0\n"
+      << "    i = 0\n"
+      << "    while i < n\n"
+      << "        s = s + a[i]\n"
+      << "        i = i + 1\n"
+      << "    loop\n"
+      << "    return s\n"
+      << "end\n";
+}
+
+// programa sintetico para los bucles: una matriz de n x n guardada por filas
+// en un arreglo, con i * n, n - 1 y una global que no cambian adentro del
+// bucle y productos por la variable del bucle
+void writeMatrixProgram(const string& path, size_t n) {
+    ofstream f(path, ios::binary);
+    f << "escala : int\n\n"
+      << "fun main() : int\n"
+      << "    m : [ ] int\n"
+      << "    n : int\n"
+      << "    i : int\n"
+      << "    j : int\n"
+      << "    r : int\n"
+      << "    s : int\n"
+      << "    n = " << n << "\n"
+      << "    escala = 3\n"
+      << "    m = new [ n * n ] int\n"
+      << "    i = 0\n"
+      << "    while i < n\n"
+      << "        j = 0\n"
+      << "        while j < n\n"
+      << "            m[i * n + j] = (i * 7 + j * 5) * escala - j / 4\n"
+      << "            j = j + 1\n"
+      << "        loop\n"
+      << "        i = i + 1\n"
+      << "    loop\n"
+      << "    s = 0\n"
+      << "    r = 0\n"
+      << "    while r < 4\n"
+      << "        i = 0\n"
+      << "        while i < n - 1\n"
+      << "            j = 0\n"
+      << "            while j < n - 1\n"
+      << "                s = s + m[i * n + j] - m[(i + 1) * n + j + 1] / 2 + r * escala\n"
+      << "                j = j + 1\n"
+      << "            loop\n"
+      << "            s = s / 2\n"
+      << "            i = i + 1\n"
+      << "        loop\n"
+      << "        r = r + 1\n"
+      << "    loop\n"
+      << "    return s\n"
+      << "end\n";
+}
+
+// programa sintetico de recorridos de arreglos de largo n (parametro, asi
+// la propagacion de -O no lo vuelve constante): llenar, copiar, sumas
+// parciales, invertir, promedio de vecinos, de a dos, una criba y un
+// histograma (el indice sale de los datos y ese chequeo tiene que quedar)
+void writeKernelProgram(const string& path, size_t n) {
+    ofstream f(path, ios::binary);
+    f << "fun kernels(n : int, vueltas : int) : int\n"
+      << "    a : [ ] int\n"
+      << "    b : [ ] int\n"
+      << "    h : [ ] int\n"
+      << "    marcas : [ ] bool\n"
+      << "    i : int\n"
+      << "    j : int\n"
+      << "    r : int\n"
+      << "    s : int\n"
+      << "    a = new [ n ] int\n"
+      << "    b = new [ n ] int\n"
+      << "    h = new [ 16 ] int\n"
+      << "    marcas = new [ n + 1 ] bool\n"
+      << "    i = 0\n"
+      << "    while i < n\n"
+      << "        a[i] = i * 37 - i / 5\n"
+      << "        i = i + 1\n"
+      << "    loop\n"
+      << "    r = 0\n"
+      << "    while r < vueltas\n"
+      << "        i = 0\n"
+      << "        while i < n\n"
+      << "            b[i] = a[i]\n"
+      << "            i = i + 1\n"
+      << "        loop\n"
+      << "        i = 1\n"
+      << "        while i < n\n"
+      << "            b[i] = b[i - 1] + a[i]\n"
+      << "            i = i + 1\n"
+      << "        loop\n"
+      << "        i = 0\n"
+      << "        while i < n\n"
+      << "            a[i] = b[n - 1 - i] / 3 + r\n"
+      << "            i = i + 1\n"
+      << "        loop\n"
+      << "        i = 1\n"
+      << "        while i < n - 1\n"
+      << "            b[i] = (a[i - 1] + a[i] + a[i + 1]) / 3\n"
+      << "            i = i + 1\n"
+      << "        loop\n"
+      << "        i = 0\n"
+      << "        while i + 1 < n\n"
+      << "            s = s + a[i] * b[i + 1]\n"
+      << "            i = i + 2\n"
+      << "        loop\n"
+      << "        i = 0\n"
+      << "        while i < n\n"
+      << "            j = a[i] - (a[i] / 16) * 16\n"
+      << "            if j < 0\n"
+      << "                j = j + 16\n"
+      << "            end\n"
+      << "            h[j] = h[j] + 1\n"
+      << "            i = i + 1\n"
+      << "        loop\n"
+      << "        r = r + 1\n"
+      << "    loop\n"
+      << "    i = 2\n"
+      << "    while i <= n\n"
+      << "        if not marcas[i]\n"
+      << "            s = s + 1\n"
+      << "            j = i + i\n"
+      << "            while j <= n\n"
+      << "                marcas[j] = true\n"
+      << "                j = j + i\n"
+      << "            loop\n"
+      << "        end\n"
+      << "        i = i + 1\n"
+      << "    loop\n"
+      << "    return s + h[3]\n"
+      << "end\n\n"
+      << "fun main() : int\n"
+      << "    return kernels(" << n << ", 10)\n"
+      << "end\n";
+}
+
+// Backend de ensamblador: mismos chequeos que emitc sobre los archivos dados
+// y ademas programas generados de bucles y de arreglos, contra el interprete
+// y contra el mismo programa pasado por C
+bool benchAsm(const vector<string>& files, int iterations, ostream& out) {
+    namespace fs = std::filesystem;
+    error_code ec;
+    out << "asm: ensamblador x86-64 y C -O2 contra el interprete, ejecucion mejor de "
+        << iterations << "\n";
+    fs::path dir = makeTempDir("asm");
+    if (dir.empty()) {
+        out << "  no se pudo crear un directorio temporal\n";
+        return false;
+    }
+    string loops = (dir / "bucles.m0").string();
+    string arrays = (dir / "arreglos.m0").string();
+    writeLoopProgram(loops, 20000);
+    writeArrayProgram(arrays, 1000000);
+    vector<string> all = files;
+    all.push_back(loops);
+    all.push_back(arrays);
+
+    bool ok = compareNative(all, {NativeBackend::Asm, NativeBackend::C}, iterations, out);
+    fs::remove_all(dir, ec);
+    return ok;
+}
+
+// Objeto directo (-c): generar el .o en memoria contra escribir el
+// ensamblador y pasarlo por 'as' (un proceso por programa), que readelf lo
+// acepte sin avisos, y despues los chequeos de punta a punta de "asm" con el
+// objeto enlazado por el C del sistema. Sin readelf esa revision se omite y
+// se anota en skipped.
+bool benchObj(const vector<string>& files, int iterations, ostream& out, vector<string>& skipped) {
+    namespace fs = std::filesystem;
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+    Parser parser;
+    parser.setOutput(sink, sink);
+    SemanticAnalyzer sema;
+    sema.setOutput(sink);
+    TypeChecker types;
+    types.setOutput(sink);
+    AsmGenerator generator;
+    generator.setOutput(sink);
+
+    error_code ec;
+    const char* asEnv = getenv("AS");
+    string as = asEnv && *asEnv ? asEnv : "as";
+    out << "obj: objeto ELF desde memoria contra " << as << " sobre --emit-asm, mejor de "
+        << iterations << "\n";
+    fs::path dir = makeTempDir("obj");
+    if (dir.empty()) {
+        out << "  no se pudo crear un directorio temporal\n";
+        return false;
+    }
+    string object = (dir / "programa.o").string();
+    string assembly = (dir / "programa.s").string();
+    string log = (dir / "salida.txt").string();
+    bool readelf = runCommand("readelf --version > \"" + log + "\" 2>&1") == 0;
+    if (!readelf) {
+        out << "  [OMITIDO] readelf no esta instalado: los objetos no se revisan con readelf\n";
+        skipped.push_back("obj (revision con readelf)");
+    }
+    bool ok = true;
+    double totalObj = 0, totalAs = 0;
+    for (const string& f : files) {
+        if (!checkFile(f, parser, sema, types))
+            continue;
+        bool built = true;
+        double objSecs = bestOf(iterations, [&] {
+            built = writeObject(object, parser.ast(), sema, generator);
+        });
+        if (!built)
+            continue;
+        string problem;
+        if (readelf) {
+            int status = runCommand("readelf -W -h -S -s -r \"" + object + "\" > \"" + log + "\" 2>&1");
+            string report = readFile(log);
+            if (status != 0 || report.find("Warning") != string::npos ||
+                report.find("Error") != string::npos)
+                problem = "readelf: " + report.substr(0, report.find('\n'));
+        }
+        int asStatus = 0;
+        double asSecs = bestOf(iterations, [&] {
+            {
+                ofstream code(assembly, ios::binary);
+                generator.generate(parser.ast(), sema, code);
+            }
+            asStatus = runCommand(as + " -o \"" + object + "\" \"" + assembly + "\" > \"" + log +
+                                  "\" 2>&1");
+        });
+        if (asStatus != 0 && problem.empty())
+            problem = as + " no pudo ensamblar el programa";
+        totalObj += objSecs;
+        totalAs += asSecs;
+        out << "  " << left << setw(28) << f << right << fixed << setprecision(3) << "  obj "
+            << setw(8) << objSecs * 1000.0 << " ms  " << as << " " << setw(8) << asSecs * 1000.0
+            << " ms  x" << setprecision(0) << asSecs / max(objSecs, 1e-9);
+        if (problem.empty()) {
+            out << "  OK\n";
+        } else {
+            out << "\n    FALLO: " << problem << "\n";
+            ok = false;
+        }
+    }
+    out << fixed << setprecision(3) << "  total: obj " << totalObj * 1000.0 << " ms, " << as << " "
+        << totalAs * 1000.0 << " ms\n";
+
+    string loops = (dir / "bucles.m0").string();
+    string arrays = (dir / "arreglos.m0").string();
+    writeLoopProgram(loops, 20000);
+    writeArrayProgram(arrays, 1000000);
+    vector<string> all = files;
+    all.push_back(loops);
+    all.push_back(arrays);
+    out << "obj: objeto enlazado y --emit-asm contra el interprete, ejecucion mejor de "
+        << iterations << "\n";
+    if (!compareNative(all, {NativeBackend::Obj, NativeBackend::Asm}, iterations, out))
+        ok = false;
+    fs::remove_all(dir, ec);
+    return ok;
+}
+
+// IR en SSA: construirlo, chequearlo (recien hecho y despues de cada pase),
+// correr los pases de limpieza y ejecutarlo con el interprete del IR contra
+// el de registros. Tienen que dar el mismo main y los mismos errores de
+// ejecucion. Al final, el tiempo de cada pase sumado en todos los archivos.
+bool benchIr(const vector<string>& files, int iterations, ostream& out) {
+    namespace fs = std::filesystem;
+    error_code ec;
+    string loops = (fs::temp_directory_path(ec) / "mini0_ir_bucles.m0").string();
+    string arrays = (fs::temp_directory_path(ec) / "mini0_ir_arreglos.m0").string();
+    writeLoopProgram(loops, 2000);
+    writeArrayProgram(arrays, 100000);
+    vector<string> all = files;
+    all.push_back(loops);
+    all.push_back(arrays);
+
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+    Parser parser;
+    parser.setOutput(sink, sink);
+    SemanticAnalyzer sema;
+    sema.setOutput(sink);
+    TypeChecker types;
+    types.setOutput(sink);
+    RegisterCompiler regCompiler;
+    regCompiler.setOutput(sink);
+    RegProgram regProgram;
+    RegisterVM regVm;
+    IrBuilder builder;
+    builder.setOutput(sink);
+    IrModule module;
+    IrInterpreter interpreter;
+    PassManager passes;
+    passes.addCleanup();
+    passes.setVerify(true);
+
+    out << "ir: SSA, pases de limpieza e interprete del IR contra el de registros, mejor de "
+        << iterations << "\n";
+    out << "  " << left << setw(28) << "archivo" << right << setw(10) << "build ms" << setw(14)
+        << "instr IR" << setw(12) << "ir ms" << setw(12) << "regs ms" << "  main\n";
+    bool same = true;
+    for (const string& f : all) {
+        if (!checkFile(f, parser, sema, types) ||
+            !regCompiler.compile(parser.ast(), sema, regProgram))
+            continue;
+        bool built = true;
+        double buildSecs = bestOf(iterations, [&] { built = builder.build(parser.ast(), sema, module); });
+        if (!built)
+            continue;
+        ostringstream problems;
+        size_t before = 0, after = 0;
+        for (const IrFunction& fn : module.functions)
+            before += fn.liveInstrs();
+        passes.setOutput(problems);
+        if (!module.verify(problems) || !passes.run(module)) {
+            out << "  FALLO: IR mal formado en " << f << "\n" << problems.str();
+            same = false;
+            continue;
+        }
+        for (const IrFunction& fn : module.functions)
+            after += fn.liveInstrs();
+
+        ostringstream irErr, regErr;
+        interpreter.setOutput(irErr);
+        regVm.setOutput(regErr);
+        Value irResult = 0, regResult = 0;
+        bool irOk = true, regOk = true;
+        double irSecs = bestOf(iterations, [&] {
+            irErr.str("");
+            irOk = interpreter.run(module, irResult);
+        });
+        double regSecs = bestOf(iterations, [&] {
+            regErr.str("");
+            regOk = regVm.run(regProgram, regResult);
+        });
+        out << "  " << left << setw(28) << f << right << fixed << setprecision(3) << setw(10)
+            << buildSecs * 1000.0 << setw(7) << before << " >" << setw(5) << after << setw(12)
+            << irSecs * 1000.0 << setw(12) << regSecs * 1000.0 << "  "
+            << (irOk ? to_string(irResult) : string("error")) << "\n";
+        if (irOk != regOk || irResult != regResult || irErr.str() != regErr.str()) {
+            out << "    FALLO: registros da " << (regOk ? to_string(regResult) : string("error"))
+                << "\n" << "      ir:        " << irErr.str() << "      registros: " << regErr.str();
+            same = false;
+        }
+    }
+    out << "  pases (sumados en todos los archivos):\n";
+    passes.report(out);
+    fs::remove(loops, ec);
+    fs::remove(arrays, ec);
+    return same;
+}
+
+// El IR de un archivo tal como lo escribe --emit-ir (con -O si optimize)
+bool dumpIr(const string& file, bool optimize, string& text) {
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+    Parser parser;
+    parser.setOutput(sink, sink);
+    SemanticAnalyzer sema;
+    sema.setOutput(sink);
+    TypeChecker types;
+    types.setOutput(sink);
+    if (!checkFile(file, parser, sema, types))
+        return false;
+    if (optimize) {
+        AstOptimizer optimizer;
+        optimizer.optimize(parser.ast(), sema);
+    }
+    IrBuilder builder;
+    builder.setOutput(sink);
+    IrModule module;
+    if (!builder.build(parser.ast(), sema, module))
+        return false;
+    PassManager passes;
+    passes.setOutput(sink);
+    passes.addCleanup();
+    if (optimize) {
+        passes.add("checks", eliminateChecks);
+        passes.addLoops();
+    }
+    passes.setVerify(true);
+    if (!passes.run(module))
+        return false;
+    ostringstream dump;
+    module.dump(dump);
+    text = dump.str();
+    return true;
+}
+
+// Pruebas de regresion del IR: para cada archivo.m0 con un archivo.ir al lado
+// (la salida esperada de --emit-ir) o un archivo.O.ir (la de -O --emit-ir),
+// el IR de ahora tiene que ser identico. Cubre el IrBuilder, los pases y el
+// formato de IrModule::dump. Se regeneran con mini0 [-O] --emit-ir.
+bool benchIrDump(const vector<string>& files, ostream& out) {
+    namespace fs = std::filesystem;
+    out << "irdump: IR de --emit-ir contra los .ir esperados\n";
+    bool ok = true;
+    size_t checked = 0;
+    for (const string& f : files) {
+        for (bool optimize : {false, true}) {
+            fs::path expectedPath(f);
+            expectedPath.replace_extension(optimize ? ".O.ir" : ".ir");
+            ifstream in(expectedPath, ios::binary);
+            if (!in)
+                continue;
+            string expected((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+            string got;
+            bool pass = dumpIr(f, optimize, got) && got == expected;
+            checked++;
+            ok = ok && pass;
+            out << "  " << (pass ? "[OK]    " : "[FALLO] ") << expectedPath.string() << "\n";
+            if (pass || got.empty())
+                continue;
+            // la primera linea distinta
+            istringstream a(expected), b(got);
+            string la, lb;
+            size_t line = 1;
+            while (true) {
+                bool ea = !getline(a, la), eb = !getline(b, lb);
+                if (ea && eb)
+                    break;
+                if (ea || eb || la != lb) {
+                    out << "    linea " << line << ": se esperaba '" << (ea ? "<fin>" : la)
+                        << "' y da '" << (eb ? "<fin>" : lb) << "'\n";
+                    break;
+                }
+                line++;
+            }
+        }
+    }
+    if (checked == 0)
+        out << "  ningun .ir junto a los archivos dados\n";
+    return ok;
+}
+
+// Plegado y propagacion de constantes en el AST: cuantas operaciones (unarias
+// y binarias) quedan en los archivos dados. Tambien es un chequeo: el
+// programa optimizado tiene que dar lo mismo en el interprete de registros, y
+// el fuente que escribe --emit-optimized tiene que compilar y dar lo mismo.
+bool benchFold(const vector<string>& files, int iterations, ostream& out) {
+    namespace fs = std::filesystem;
+    error_code ec;
+    string printed = (fs::temp_directory_path(ec) / "mini0_optimizado.m0").string();
+
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+    Parser parser, reparser;
+    parser.setOutput(sink, sink);
+    reparser.setOutput(sink, sink);
+    SemanticAnalyzer sema, resema;
+    sema.setOutput(sink);
+    resema.setOutput(sink);
+    TypeChecker types;
+    types.setOutput(sink);
+    RegisterCompiler compiler;
+    compiler.setOutput(sink);
+    RegProgram program;
+    RegisterVM vm;
+    AstOptimizer optimizer;
+
+    // el mensaje sin la linea (el fuente escrito de nuevo tiene otras lineas)
+    auto message = [](const string& text) {
+        size_t at = text.find("): ");
+        return at == string::npos ? text : text.substr(at);
+    };
+    auto runChecked = [&](Ast& tree, const SemanticAnalyzer& names, Value& result, string& errors) {
+        ostringstream text;
+        vm.setOutput(text);
+        bool ok = compiler.compile(tree, names, program) && vm.run(program, result);
+        errors = text.str();
+        return ok;
+    };
+
+    out << "fold: plegado y propagacion de constantes, optimizador mejor de " << iterations << "\n";
+    out << "  " << left << setw(28) << "archivo" << right << setw(16) << "operaciones" << setw(8)
+        << "plega" << setw(8) << "propa" << setw(8) << "ident" << setw(8) << "ramas" << setw(8)
+        << "sent" << setw(10) << "ms" << "\n";
+    size_t before = 0, after = 0;
+    bool same = true;
+    for (const string& f : files) {
+        if (!checkFile(f, parser, sema, types))
+            continue;
+        Value expected = 0, result = 0;
+        string expectedErr, err;
+        bool expectedOk = runChecked(parser.ast(), sema, expected, expectedErr);
+
+        // optimizar cambia el arbol: cada vuelta despues de la primera lo
+        // vuelve a armar, y se mide solo el optimizador
+        size_t ops = AstOptimizer::countOperations(parser.ast());
+        double secs = 0;
+        for (int i = 0; i < iterations; i++) {
+            if (i > 0)
+                checkFile(f, parser, sema, types);
+            auto start = chrono::steady_clock::now();
+            optimizer.optimize(parser.ast(), sema);
+            double t = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            if (i == 0 || t < secs)
+                secs = t;
+        }
+        size_t remaining = AstOptimizer::countOperations(parser.ast());
+        before += ops;
+        after += remaining;
+        const AstOptimizer::Stats& s = optimizer.stats();
+        out << "  " << left << setw(28) << f << right << setw(8) << ops << " >" << setw(6)
+            << remaining << setw(8) << s.folded << setw(8) << s.propagated << setw(8) << s.simplified
+            << setw(8) << s.branches << setw(8) << s.statements << fixed << setprecision(3)
+            << setw(10) << secs * 1000.0 << "\n";
+
+        bool ok = runChecked(parser.ast(), sema, result, err);
+        if (ok != expectedOk || result != expected || err != expectedErr) {
+            out << "    FALLO: optimizado da " << (ok ? to_string(result) : string("error")) << " y no "
+                << (expectedOk ? to_string(expected) : string("error")) << "\n" << err;
+            same = false;
+            continue;
+        }
+        {
+            ofstream file(printed, ios::binary);
+            SourcePrinter printer;
+            printer.print(parser.ast(), file);
+        }
+        if (!checkFile(printed, reparser, resema, types)) {
+            out << "    FALLO: el fuente optimizado no compila\n";
+            same = false;
+            continue;
+        }
+        ok = runChecked(reparser.ast(), resema, result, err);
+        if (ok != expectedOk || result != expected || message(err) != message(expectedErr)) {
+            out << "    FALLO: el fuente optimizado da " << (ok ? to_string(result) : string("error"))
+                << "\n" << err;
+            same = false;
+        }
+    }
+    out << "  total: " << before << " > " << after << " operaciones";
+    if (before > 0)
+        out << fixed << setprecision(1) << " (" << 100.0 * (double)(before - after) / (double)before
+            << " % menos)";
+    out << "\n";
+    fs::remove(printed, ec);
+    return same;
+}
+
+// instrucciones en bloques que estan en algun bucle
+size_t loopInstrs(const IrModule& module, size_t& count) {
+    size_t n = 0;
+    for (const IrFunction& fn : module.functions) {
+        vector<IrLoop> loops = irFindLoops(fn, irDominators(fn));
+        vector<uint8_t> inLoop(fn.blocks.size(), 0);
+        for (const IrLoop& l : loops)
+            for (IrBlockId b : l.blocks)
+                inLoop[b] = 1;
+        for (IrBlockId b = 0; b < fn.blocks.size(); b++)
+            if (inLoop[b])
+                n += fn.blocks[b].instrs.size();
+        count += loops.size();
+    }
+    return n;
+}
+
+// Bucles en el IR: el mismo programa en el interprete del IR con solo la
+// limpieza y despues de sacar invariantes y reducir variables de induccion.
+// Cuenta las instrucciones adentro de los bucles y las que se ejecutan, y
+// mide las dos corridas; tienen que dar el mismo main y los mismos errores.
+bool benchLoops(const vector<string>& files, int iterations, ostream& out) {
+    namespace fs = std::filesystem;
+    error_code ec;
+    string loops = (fs::temp_directory_path(ec) / "mini0_licm_bucles.m0").string();
+    string arrays = (fs::temp_directory_path(ec) / "mini0_licm_arreglos.m0").string();
+    string matrix = (fs::temp_directory_path(ec) / "mini0_licm_matriz.m0").string();
+    writeLoopProgram(loops, 2000);
+    writeArrayProgram(arrays, 100000);
+    writeMatrixProgram(matrix, 700);
+    vector<string> all = files;
+    all.push_back(loops);
+    all.push_back(arrays);
+    all.push_back(matrix);
+
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+    Parser parser;
+    parser.setOutput(sink, sink);
+    SemanticAnalyzer sema;
+    sema.setOutput(sink);
+    TypeChecker types;
+    types.setOutput(sink);
+    IrBuilder builder;
+    builder.setOutput(sink);
+    IrModule module;
+    IrInterpreter interpreter;
+    PassManager cleanup, passes;
+    cleanup.addCleanup();
+    cleanup.setVerify(true);
+    passes.addLoops();
+    passes.setVerify(true);
+
+    out << "loops: invariantes y variables de induccion en el IR, interprete mejor de "
+        << iterations << "\n";
+    out << "  " << left << setw(28) << "archivo" << right << setw(7) << "bucles" << setw(16)
+        << "en bucles" << setw(26) << "ejecutadas" << setw(10) << "antes ms" << setw(10)
+        << "ahora ms" << "  main\n";
+    bool same = true;
+    for (const string& f : all) {
+        if (!checkFile(f, parser, sema, types) || !builder.build(parser.ast(), sema, module))
+            continue;
+        ostringstream problems;
+        cleanup.setOutput(problems);
+        passes.setOutput(problems);
+        if (!cleanup.run(module)) {
+            out << "  FALLO: IR mal formado en " << f << "\n" << problems.str();
+            same = false;
+            continue;
+        }
+        size_t count = 0, unused = 0;
+        size_t inBefore = loopInstrs(module, count);
+        auto measure = [&](Value& result, bool& ok, string& errors, uint64_t& steps) {
+            ostringstream text;
+            interpreter.setOutput(text);
+            double secs = bestOf(iterations, [&] {
+                text.str("");
+                ok = interpreter.run(module, result);
+            });
+            errors = text.str();
+            steps = interpreter.executed();
+            return secs;
+        };
+        Value before = 0, after = 0;
+        bool beforeOk = true, afterOk = true;
+        string beforeErr, afterErr;
+        uint64_t beforeSteps = 0, afterSteps = 0;
+        double beforeSecs = measure(before, beforeOk, beforeErr, beforeSteps);
+        if (!passes.run(module)) {
+            out << "  FALLO: los pases de bucles rompen el IR de " << f << "\n" << problems.str();
+            same = false;
+            continue;
+        }
+        size_t inAfter = loopInstrs(module, unused);
+        double afterSecs = measure(after, afterOk, afterErr, afterSteps);
+        out << "  " << left << setw(28) << f << right << setw(7) << count << setw(9) << inBefore
+            << " >" << setw(5) << inAfter << setw(13) << beforeSteps << " >" << setw(11)
+            << afterSteps << fixed << setprecision(3) << setw(10) << beforeSecs * 1000.0
+            << setw(10) << afterSecs * 1000.0 << "  " << (afterOk ? to_string(after) : string("error"))
+            << "\n";
+        if (afterOk != beforeOk || after != before || afterErr != beforeErr) {
+            out << "    FALLO: sin los pases da " << (beforeOk ? to_string(before) : string("error"))
+                << "\n" << "      antes: " << beforeErr << "      ahora: " << afterErr;
+            same = false;
+        }
+    }
+    out << "  pases (sumados en todos los archivos):\n";
+    passes.report(out);
+    fs::remove(loops, ec);
+    fs::remove(arrays, ec);
+    fs::remove(matrix, ec);
+    return same;
+}
+
+// Chequeos de indices: cada programa en el interprete del IR con todos los
+// chequeos, con los que quedan despues del analisis de rangos y sin
+// ninguno (--unchecked, solo si el programa no falla). Los dos primeros
+// tienen que dar lo mismo, errores incluidos. Cuenta los CHECK en el
+// codigo y los que se ejecutan.
+bool benchChecks(const vector<string>& files, int iterations, ostream& out) {
+    namespace fs = std::filesystem;
+    error_code ec;
+    string kernels = (fs::temp_directory_path(ec) / "mini0_checks_recorridos.m0").string();
+    string arrays = (fs::temp_directory_path(ec) / "mini0_checks_arreglos.m0").string();
+    string matrix = (fs::temp_directory_path(ec) / "mini0_checks_matriz.m0").string();
+    writeKernelProgram(kernels, 100000);
+    writeArrayProgram(arrays, 100000);
+    writeMatrixProgram(matrix, 500);
+    vector<string> all = files;
+    all.push_back(kernels);
+    all.push_back(arrays);
+    all.push_back(matrix);
+
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+    Parser parser;
+    parser.setOutput(sink, sink);
+    SemanticAnalyzer sema;
+    sema.setOutput(sink);
+    TypeChecker types;
+    types.setOutput(sink);
+    IrBuilder builder;
+    builder.setOutput(sink);
+    IrModule module;
+    IrInterpreter interpreter;
+    PassManager cleanup, ranges, none;
+    cleanup.addCleanup();
+    ranges.add("checks", eliminateChecks);
+    none.add("unchecked", removeChecks);
+
+    auto countChecks = [](const IrModule& m) {
+        size_t n = 0;
+        for (const IrFunction& fn : m.functions)
+            for (const IrBlock& b : fn.blocks)
+                for (IrValue v : b.instrs)
+                    n += fn.instrs[v].op == I_CHECK;
+        return n;
+    };
+    auto percent = [](double part, double whole) { return whole > 0 ? 100.0 * part / whole : 0.0; };
+
+    out << "checks: chequeos de indices sacados por el analisis de rangos, interprete del IR "
+           "mejor de " << iterations << "\n";
+    out << "  " << left << setw(28) << "archivo" << right << setw(17) << "en el codigo" << setw(30)
+        << "ejecutados" << setw(11) << "todos ms" << setw(10) << "-O ms" << setw(10) << "sin ms"
+        << "  main\n";
+    size_t staticBefore = 0, staticAfter = 0;
+    uint64_t runBefore = 0, runAfter = 0;
+    bool same = true;
+    for (const string& f : all) {
+        if (!checkFile(f, parser, sema, types))
+            continue;
+        Value results[3] = {0, 0, 0};
+        bool oks[3] = {true, true, true};
+        string errors[3];
+        uint64_t checks[3] = {0, 0, 0};
+        double secs[3] = {0, 0, 0};
+        size_t counts[3] = {0, 0, 0};
+        for (int mode = 0; mode < 3; mode++) {
+            if (mode == 2 && !oks[0])
+                break;
+            if (!builder.build(parser.ast(), sema, module) || !cleanup.run(module))
+                break;
+            if ((mode == 1 && !ranges.run(module)) || (mode == 2 && !none.run(module)))
+                break;
+            ostringstream problems;
+            if (!module.verify(problems)) {
+                out << "  FALLO: IR mal formado en " << f << "\n" << problems.str();
+                same = false;
+                break;
+            }
+            counts[mode] = countChecks(module);
+            ostringstream text;
+            interpreter.setOutput(text);
+            secs[mode] = bestOf(iterations, [&] {
+                text.str("");
+                oks[mode] = interpreter.run(module, results[mode]);
+            });
+            errors[mode] = text.str();
+            checks[mode] = interpreter.checked();
+        }
+        staticBefore += counts[0];
+        staticAfter += counts[1];
+        runBefore += checks[0];
+        runAfter += checks[1];
+        out << "  " << left << setw(28) << f << right << setw(6) << counts[0] << " >" << setw(4)
+            << counts[1] << fixed << setprecision(0) << setw(4) << percent((double)(counts[0] - counts[1]), (double)counts[0])
+            << "%" << setw(11) << checks[0] << " >" << setw(11) << checks[1] << setw(5)
+            << percent((double)(checks[0] - checks[1]), (double)checks[0]) << "%" << setprecision(3)
+            << setw(11) << secs[0] * 1000.0 << setw(10) << secs[1] * 1000.0 << setw(10)
+            << secs[2] * 1000.0 << "  " << (oks[0] ? to_string(results[0]) : string("error")) << "\n";
+        if (oks[1] != oks[0] || results[1] != results[0] || errors[1] != errors[0]) {
+            out << "    FALLO: con el analisis de rangos da "
+                << (oks[1] ? to_string(results[1]) : string("error")) << "\n" << errors[1];
+            same = false;
+        }
+        if (oks[0] && (!oks[2] || results[2] != results[0])) {
+            out << "    FALLO: sin chequeos da " << (oks[2] ? to_string(results[2]) : string("error"))
+                << "\n";
+            same = false;
+        }
+    }
+    out << fixed << setprecision(1) << "  sacados: " << staticBefore - staticAfter << " de "
+        << staticBefore << " en el codigo ("
+        << percent((double)(staticBefore - staticAfter), (double)staticBefore) << " %), "
+        << runBefore - runAfter << " de " << runBefore << " ejecutados ("
+        << percent((double)(runBefore - runAfter), (double)runBefore) << " %)\n";
+    fs::remove(kernels, ec);
+    fs::remove(arrays, ec);
+    fs::remove(matrix, ec);
+    return same;
+}
+
+} // namespace
+
+int runBench(const string& name, const vector<string>& files, int iterations, ostream& out) {
+    if (iterations < 1)
+        iterations = 1;
+
+    bool all = name == "all";
+    bool ran = false;
+    bool failed = false;
+    vector<string> skipped;  // mediciones que este binario no puede hacer
+    if (all || name == "threads") {
+        if (!benchThreads(files, iterations, out))
+            failed = true;
+        ran = true;
+    }
+    if (all || name == "input") {
+        benchInput(files, iterations, out);
+        ran = true;
+    }
+    if (all || name == "tokens") {
+        benchTokens(files, iterations, out);
+        ran = true;
+    }
+    if (all || name == "lexer") {
+        benchLexer(files, iterations, out);
+        ran = true;
+    }
+    if (all || name == "lexdiff") {
+        if (!benchLexDiff(files, iterations, out))
+            failed = true;
+        ran = true;
+    }
+    if (all || name == "keywords") {
+        benchKeywords(files, iterations, out);
+        ran = true;
+    }
+    if (all || name == "recovery") {
+        benchRecovery(files, iterations, out);
+        ran = true;
+    }
+    if (all || name == "diagnostics") {
+        if (!benchDiagnostics(files, iterations, out))
+            failed = true;
+        ran = true;
+    }
+    if (all || name == "intern") {
+        benchIntern(files, iterations, out);
+        ran = true;
+    }
+    if (all || name == "ast") {
+        benchAst(files, iterations, out);
+        ran = true;
+    }
+    if (all || name == "exprs") {
+        if (!benchExpr(files, iterations, out))
+            failed = true;
+        ran = true;
+    }
+    if (all || name == "depth") {
+        if (!benchDepth(files, iterations, out))
+            failed = true;
+        ran = true;
+    }
+    if (all || name == "ll1") {
+        if (!benchLl1(files, iterations, out))
+            failed = true;
+        ran = true;
+    }
+    if (all || name == "sema") {
+        if (!benchSema(files, iterations, out))
+            failed = true;
+        ran = true;
+    }
+    if (all || name == "vm") {
+        benchVm(files, iterations, out);
+        ran = true;
+    }
+    if (all || name == "profile") {
+        benchProfile(files, out);
+        ran = true;
+    }
+    if (all || name == "dispatch") {
+        if (!benchDispatch(files, iterations, out))
+            failed = true;
+        ran = true;
+    }
+    if (all || name == "emitc") {
+        if (!benchEmitC(files, iterations, out))
+            failed = true;
+        ran = true;
+    }
+    if (all || name == "asm") {
+        if (!benchAsm(files, iterations, out))
+            failed = true;
+        ran = true;
+    }
+    if (all || name == "obj") {
+        if (!benchObj(files, iterations, out, skipped))
+            failed = true;
+        ran = true;
+    }
+    if (all || name == "ir") {
+        if (!benchIr(files, iterations, out))
+            failed = true;
+        ran = true;
+    }
+    if (all || name == "irdump") {
+        if (!benchIrDump(files, out))
+            failed = true;
+        ran = true;
+    }
+    if (all || name == "fold") {
+        if (!benchFold(files, iterations, out))
+            failed = true;
+        ran = true;
+    }
+    if (all || name == "loops") {
+        if (!benchLoops(files, iterations, out))
+            failed = true;
+        ran = true;
+    }
+    if (all || name == "checks") {
+        if (!benchChecks(files, iterations, out))
+            failed = true;
+        ran = true;
+    }
+    if (all || name == "alloc") {
+        // pedido solo es un error; dentro de "all" queda como omitido
+        if (!allocCounting) {
+            out << "alloc: [OMITIDO] sin contador de reservas (compilar con "
+                   "-DMINI0_COUNT_ALLOCS)\n";
+            skipped.push_back("alloc");
+            if (!all)
+                failed = true;
+        } else if (!benchAlloc(files, out)) {
+            failed = true;
+        }
+        ran = true;
+    }
+
+    if (!ran) {
+        cerr << "Benchmark desconocido: " << name << "\n";
+        return 1;
+    }
+    for (const string& s : skipped)
+        out << "omitido (no medido, no cuenta como pasado): " << s << "\n";
+    return failed ? 1 : 0;
+}
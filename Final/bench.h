@@ -0,0 +1,14 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+// Mediciones de rendimiento del compilador (modo --bench del driver).
+// Cada medicion tiene un nombre; "all" corre todas.
+int runBench(const string& name, const vector<string>& files, int iterations, ostream& out);
+
+#endif
@@ -0,0 +1,392 @@
+#include "bytecode.h"
+
+#include <algorithm>
+#include <iomanip>
+
+using namespace std;
+
+const uint8_t opcodeOperands[OP_COUNT] = {
+    4, 2, 2, 4, 4, 2,       // CONST LOAD STORE LOAD_GLOBAL STORE_GLOBAL CLEAR
+    0, 0, 0,                // NEW_ARRAY LOAD_INDEX STORE_INDEX
+    0, 0, 0, 0, 0, 0,       // ADD SUB MUL DIV NEG NOT
+    0, 0, 0, 0, 0, 0,       // LT LE GT GE EQ NE
+    4, 4, 4, 4, 4,          // JUMP JUMP_FALSE JUMP_TRUE AND OR
+    4, 0, 0, 0,             // CALL RET RET_VOID POP
+};
+
+const char* const opcodeNames[OP_COUNT] = {
+    "const", "load", "store", "load_global", "store_global", "clear",
+    "new_array", "load_index", "store_index",
+    "add", "sub", "mul", "div", "neg", "not",
+    "lt", "le", "gt", "ge", "eq", "ne",
+    "jump", "jump_false", "jump_true", "and", "or",
+    "call", "ret", "ret_void", "pop",
+};
+
+uint32_t FunctionCode::lineAt(size_t offset) const {
+    auto it = upper_bound(lines.begin(), lines.end(), make_pair((uint32_t)offset, UINT32_MAX));
+    return it == lines.begin() ? 0 : (it - 1)->second;
+}
+
+void Program::clear() {
+    functions.clear();
+    constants.clear();
+    strings.clear();
+    globals = 0;
+    mainFunction = -1;
+}
+
+void Program::disassemble(ostream& out) const {
+    for (const FunctionCode& f : functions) {
+        out << "fun " << f.name << " (params " << f.params << ", locales " << f.locals
+            << ", pila " << f.maxStack << ")\n";
+        size_t pc = 0;
+        while (pc < f.code.size()) {
+            Opcode op = (Opcode)f.code[pc];
+            uint32_t operand = 0;
+            for (unsigned i = 0; i < opcodeOperands[op]; i++)
+                operand |= (uint32_t)f.code[pc + 1 + i] << (8 * i);
+            out << "  " << setw(5) << pc << "  " << left << setw(13) << opcodeNames[op] << right;
+            if (op == OP_CONST) {
+                Value v = constants[operand];
+                bool isString = false;
+                for (const string& s : strings)
+                    if (v == (Value)(intptr_t)s.c_str())
+                        isString = true;
+                if (isString)
+                    out << "\"" << (const char*)(intptr_t)v << "\"";
+                else
+                    out << v;
+            } else if (op == OP_CALL) {
+                out << functions[operand].name;
+            } else if (opcodeOperands[op] > 0) {
+                out << operand;
+            }
+            out << "\n";
+            pc += 1 + opcodeOperands[op];
+        }
+    }
+}
+
+BytecodeCompiler::BytecodeCompiler()
+    : tree(nullptr), names(nullptr), program(nullptr), fn(nullptr), err(&cerr),
+      errors(0), depth(0) {}
+
+void BytecodeCompiler::setOutput(ostream& errStream) {
+    err = &errStream;
+}
+
+void BytecodeCompiler::error(uint32_t line, const string& message) {
+    errors++;
+    *err << "Error de compilacion en linea " << line << ": " << message << endl;
+}
+
+bool BytecodeCompiler::compile(const Ast& ast, const SemanticAnalyzer& resolved, Program& out) {
+    tree = &ast;
+    names = &resolved;
+    program = &out;
+    errors = 0;
+    out.clear();
+    numbers.clear();
+    literals.clear();
+    slots.assign(ast.vars.size(), 0);
+    isGlobal.assign(ast.vars.size(), 0);
+
+    out.globals = (uint32_t)ast.globals.size();
+    for (size_t i = 0; i < ast.globals.size(); i++) {
+        slots[ast.globals[i]] = (uint32_t)i;
+        isGlobal[ast.globals[i]] = 1;
+    }
+
+    Symbol mainName = ast.symbols.find("main", 4);
+    out.functions.resize(ast.funcs.size());
+    for (size_t i = 0; i < ast.funcs.size(); i++) {
+        if (ast.funcs[i].name == mainName)
+            out.mainFunction = (int32_t)i;
+        function(ast.funcs[i], out.functions[i]);
+    }
+    fn = nullptr;
+    return errors == 0;
+}
+
+void BytecodeCompiler::function(const Func& f, FunctionCode& code) {
+    fn = &code;
+    depth = 0;
+    code.name = tree->str(f.name);
+    code.params = f.params.count;
+    code.locals = 0;
+    code.maxStack = 0;
+    code.returnsValue = f.ret != TY_VOID;
+    line(f.line);
+
+    for (const NodeId* p = tree->begin(f.params); p != tree->end(f.params); p++)
+        declare(*p, false);
+    block(f.body, false);
+
+    // se llego al final sin return: una funcion con tipo devuelve 0
+    if (code.returnsValue) {
+        emitU32(OP_CONST, constant(0), 1);
+        emit(OP_RET, -1);
+    } else {
+        emit(OP_RET_VOID, 0);
+    }
+}
+
+// las variables del cuerpo ya estan en 0 al entrar; las de un bloque anidado
+// se limpian cada vez que se entra al bloque (por ejemplo en cada vuelta)
+void BytecodeCompiler::declare(NodeId var, bool clear) {
+    uint32_t slot = fn->locals++;
+    if (slot > UINT16_MAX) {
+        error(tree->vars[var].line, "demasiadas variables locales en '" + fn->name + "'");
+        slot = 0;
+    }
+    slots[var] = slot;
+    isGlobal[var] = 0;
+    if (clear)
+        emitU16(OP_CLEAR, slot, 0);
+}
+
+void BytecodeCompiler::block(NodeId id, bool nested) {
+    if (id == noNode)
+        return;
+    const Block& b = tree->blocks[id];
+    for (const NodeId* v = tree->begin(b.vars); v != tree->end(b.vars); v++)
+        declare(*v, nested);
+    for (const NodeId* s = tree->begin(b.stmts); s != tree->end(b.stmts); s++)
+        stmt(*s);
+}
+
+void BytecodeCompiler::stmt(NodeId id) {
+    const Stmt& s = tree->stmts[id];
+    line(s.line);
+    switch (s.kind) {
+    case StmtKind::Assign: {
+        const Expr& target = tree->exprs[s.target];
+        if (target.kind == ExprKind::Index) {
+            expr(target.lhs);
+            expr(target.rhs);
+            expr(s.value);
+            line(target.line);
+            emit(OP_STORE_INDEX, -3);
+            break;
+        }
+        NodeId var = names->declOf(s.target);
+        expr(s.value);
+        if (isGlobal[var])
+            emitU32(OP_STORE_GLOBAL, slots[var], -1);
+        else
+            emitU16(OP_STORE, slots[var], -1);
+        break;
+    }
+    case StmtKind::Call:
+        expr(s.value);
+        if (tree->funcs[names->declOf(s.value)].ret != TY_VOID)
+            emit(OP_POP, -1);  // el valor no se usa
+        break;
+    case StmtKind::If: {
+        expr(s.value);
+        size_t skip = emitJump(OP_JUMP_FALSE, -1);
+        block(s.body, true);
+        if (s.orelse != noNode) {
+            size_t end = emitJump(OP_JUMP, 0);
+            patch(skip, fn->code.size());
+            block(s.orelse, true);
+            patch(end, fn->code.size());
+        } else {
+            patch(skip, fn->code.size());
+        }
+        break;
+    }
+    case StmtKind::While: {
+        // condicion al final: una sola instruccion de salto por vuelta
+        size_t toCond = emitJump(OP_JUMP, 0);
+        size_t top = fn->code.size();
+        block(s.body, true);
+        patch(toCond, fn->code.size());
+        line(s.line);
+        expr(s.value);
+        patch(emitJump(OP_JUMP_TRUE, -1), top);
+        break;
+    }
+    case StmtKind::Return:
+        if (s.value != noNode) {
+            expr(s.value);
+            emit(OP_RET, -1);
+        } else {
+            emit(OP_RET_VOID, 0);
+        }
+        break;
+    }
+}
+
+void BytecodeCompiler::expr(NodeId id) {
+    const Expr& e = tree->exprs[id];
+    switch (e.kind) {
+    case ExprKind::Num: {
+        Value v;
+        if (!parseNumber(tree->text() + e.text.offset, e.text.length, v))
+            error(e.line, "el numero " + tree->str(e.text) + " no entra en un int");
+        emitU32(OP_CONST, constant(v), 1);
+        break;
+    }
+    case ExprKind::Str:
+        emitU32(OP_CONST, stringConstant(tree->text() + e.text.offset, e.text.length), 1);
+        break;
+    case ExprKind::True:
+        emitU32(OP_CONST, constant(1), 1);
+        break;
+    case ExprKind::False:
+        emitU32(OP_CONST, constant(0), 1);
+        break;
+    case ExprKind::Var: {
+        NodeId var = names->declOf(id);
+        if (isGlobal[var])
+            emitU32(OP_LOAD_GLOBAL, slots[var], 1);
+        else
+            emitU16(OP_LOAD, slots[var], 1);
+        break;
+    }
+    case ExprKind::Index:
+        expr(e.lhs);
+        expr(e.rhs);
+        line(e.line);
+        emit(OP_LOAD_INDEX, -1);
+        break;
+    case ExprKind::Call: {
+        for (const NodeId* a = tree->begin(e.args); a != tree->end(e.args); a++)
+            expr(*a);
+        NodeId f = names->declOf(id);
+        int result = tree->funcs[f].ret != TY_VOID ? 1 : 0;
+        line(e.line);
+        emitU32(OP_CALL, f, result - (int)e.args.count);
+        break;
+    }
+    case ExprKind::New:
+        expr(e.rhs);
+        line(e.line);
+        emit(OP_NEW_ARRAY, 0);
+        break;
+    case ExprKind::Unary:
+        expr(e.lhs);
+        emit(e.opToken() == TK_NOT ? OP_NOT : OP_NEG, 0);
+        break;
+    case ExprKind::Binary: {
+        int op = e.opToken();
+        if (op == TK_AND || op == TK_OR) {
+            // cortocircuito: el operando derecho solo se evalua si hace falta
+            expr(e.lhs);
+            size_t end = emitJump(op == TK_AND ? OP_AND : OP_OR, -1);
+            expr(e.rhs);
+            patch(end, fn->code.size());
+            break;
+        }
+        expr(e.lhs);
+        expr(e.rhs);
+        Opcode code = OP_ADD;
+        switch (op) {
+        case TK_PLUS: code = OP_ADD; break;
+        case TK_MINUS: code = OP_SUB; break;
+        case TK_MUL: code = OP_MUL; break;
+        case TK_DIV: code = OP_DIV; line(e.line); break;
+        case TK_LT: code = OP_LT; break;
+        case TK_LE: code = OP_LE; break;
+        case TK_GT: code = OP_GT; break;
+        case TK_GE: code = OP_GE; break;
+        case TK_EQ: code = OP_EQ; break;
+        case TK_NEQ: code = OP_NE; break;
+        }
+        emit(code, -1);
+        break;
+    }
+    }
+}
+
+uint32_t BytecodeCompiler::constant(Value v) {
+    auto it = numbers.find(v);
+    if (it != numbers.end())
+        return it->second;
+    uint32_t index = (uint32_t)program->constants.size();
+    program->constants.push_back(v);
+    numbers.emplace(v, index);
+    return index;
+}
+
+string unescapeLiteral(const char* text, size_t length) {
+    string value;
+    for (size_t i = 1; i + 1 < length; i++) {
+        char c = text[i];
+        if (c == '\\' && i + 2 < length) {
+            c = text[++i];
+            if (c == 'n')
+                c = '\n';
+            else if (c == 't')
+                c = '\t';
+            else if (c == '0')
+                c = '\0';
+        }
+        value += c;
+    }
+    return value;
+}
+
+bool parseNumber(const char* digits, size_t length, Value& value) {
+    uint64_t v = 0;
+    bool fits = true;
+    for (size_t i = 0; i < length; i++) {
+        v = v * 10 + (uint64_t)(digits[i] - '0');
+        if (v > (uint64_t)INT64_MAX)
+            fits = false;
+    }
+    value = (Value)v;
+    return fits;
+}
+
+// literal -> constante con el texto ya interpretado; iguales comparten constante
+uint32_t BytecodeCompiler::stringConstant(const char* text, size_t length) {
+    string value = unescapeLiteral(text, length);
+
+    auto it = literals.find(value);
+    if (it != literals.end())
+        return it->second;
+    program->strings.push_back(value);
+    uint32_t index = (uint32_t)program->constants.size();
+    program->constants.push_back((Value)(intptr_t)program->strings.back().c_str());
+    literals.emplace(move(value), index);
+    return index;
+}
+
+void BytecodeCompiler::emit(Opcode op, int effect) {
+    fn->code.push_back(op);
+    depth = (uint32_t)((int)depth + effect);
+    fn->maxStack = max(fn->maxStack, depth);
+}
+
+void BytecodeCompiler::emitU16(Opcode op, uint32_t operand, int effect) {
+    emit(op, effect);
+    fn->code.push_back((uint8_t)operand);
+    fn->code.push_back((uint8_t)(operand >> 8));
+}
+
+void BytecodeCompiler::emitU32(Opcode op, uint32_t operand, int effect) {
+    emit(op, effect);
+    for (int i = 0; i < 4; i++)
+        fn->code.push_back((uint8_t)(operand >> (8 * i)));
+}
+
+size_t BytecodeCompiler::emitJump(Opcode op, int effect) {
+    emitU32(op, 0, effect);
+    return fn->code.size() - 4;
+}
+
+void BytecodeCompiler::patch(size_t at, size_t target) {
+    for (int i = 0; i < 4; i++)
+        fn->code[at + i] = (uint8_t)(target >> (8 * i));
+}
+
+void BytecodeCompiler::line(uint32_t line) {
+    uint32_t offset = (uint32_t)fn->code.size();
+    if (!fn->lines.empty() && fn->lines.back().first == offset)
+        fn->lines.back().second = line;
+    else if (fn->lines.empty() || fn->lines.back().second != line)
+        fn->lines.push_back({offset, line});
+}
@@ -0,0 +1,136 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ast.h"
+#include "semantic.h"
+
+using namespace std;
+
+// Todo valor de Mini-0 entra en 64 bits: int, bool (0/1), char, string
+// (puntero a una constante: los literales iguales son la misma constante, asi
+// que == compara punteros) y arreglo (puntero a un bloque: [0] es el largo y
+// los elementos siguen). Variables y elementos nuevos empiezan en 0.
+typedef int64_t Value;
+
+// Bytecode de pila: un byte de opcode seguido de sus operandos (little endian).
+enum Opcode : uint8_t {
+    OP_CONST,         // u32 indice en constants        -> valor
+    OP_LOAD,          // u16 slot local                 -> valor
+    OP_STORE,         // u16 slot local      valor ->
+    OP_LOAD_GLOBAL,   // u32 slot global                -> valor
+    OP_STORE_GLOBAL,  // u32 slot global     valor ->
+    OP_CLEAR,         // u16 slot local: vuelve a 0 (variables de un bloque)
+    OP_NEW_ARRAY,     //                     largo -> arreglo
+    OP_LOAD_INDEX,    //              arreglo indice -> valor
+    OP_STORE_INDEX,   //        arreglo indice valor ->
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_NEG,
+    OP_NOT,
+    OP_LT,
+    OP_LE,
+    OP_GT,
+    OP_GE,
+    OP_EQ,
+    OP_NE,
+    OP_JUMP,          // u32 destino (offset en el codigo de la funcion)
+    OP_JUMP_FALSE,    // u32 destino         valor ->
+    OP_JUMP_TRUE,     // u32 destino         valor ->
+    OP_AND,           // u32 destino: si el tope es 0 salta dejandolo, si no lo saca
+    OP_OR,            // u32 destino: si el tope no es 0 salta dejandolo, si no lo saca
+    OP_CALL,          // u32 funcion      args... -> resultado (si no es void)
+    OP_RET,           //                     valor ->
+    OP_RET_VOID,
+    OP_POP,
+    OP_COUNT
+};
+
+// "texto" con comillas y escapes (\n, \t, \0, \x = x) -> texto
+string unescapeLiteral(const char* text, size_t length);
+// digitos de un TK_LITNUM; false si no entra en un int de 64 bits
+bool parseNumber(const char* digits, size_t length, Value& value);
+
+// bytes de operandos de cada opcode
+extern const uint8_t opcodeOperands[OP_COUNT];
+extern const char* const opcodeNames[OP_COUNT];
+
+struct FunctionCode {
+    string name;
+    uint32_t params;
+    uint32_t locals;     // incluye los parametros
+    uint32_t maxStack;   // profundidad maxima de la pila de operandos
+    bool returnsValue;
+    vector<uint8_t> code;
+    vector<pair<uint32_t, uint32_t>> lines;  // (offset, linea), para mensajes de error
+
+    uint32_t lineAt(size_t offset) const;
+};
+
+// Programa compilado. Los string constantes viven en 'strings' (un deque no
+// mueve sus elementos) y 'constants' guarda punteros a ellos: no se copia.
+struct Program {
+    vector<FunctionCode> functions;  // mismo orden que Ast::funcs
+    vector<Value> constants;
+    deque<string> strings;
+    uint32_t globals = 0;
+    int32_t mainFunction = -1;
+
+    Program() = default;
+    Program(const Program&) = delete;
+    Program& operator=(const Program&) = delete;
+    Program(Program&&) = default;
+    Program& operator=(Program&&) = default;
+
+    void clear();
+    void disassemble(ostream& out) const;
+};
+
+// Traduce un AST ya chequeado (nombres y tipos) a bytecode. Cada VarDecl
+// recibe un slot fijo: los globales en la zona global y en cada funcion los
+// parametros primero y despues las locales de todos sus bloques.
+class BytecodeCompiler {
+public:
+    BytecodeCompiler();
+
+    void setOutput(ostream& err);
+    bool compile(const Ast& tree, const SemanticAnalyzer& names, Program& program);
+
+private:
+    const Ast* tree;
+    const SemanticAnalyzer* names;
+    Program* program;
+    FunctionCode* fn;
+    ostream* err;
+    size_t errors;
+    uint32_t depth;                    // pila de operandos en este punto
+    vector<uint32_t> slots;            // por VarDecl
+    vector<uint8_t> isGlobal;          // por VarDecl
+    unordered_map<Value, uint32_t> numbers;
+    unordered_map<string, uint32_t> literals;
+
+    void function(const Func& f, FunctionCode& code);
+    void declare(NodeId var, bool clear);
+    void block(NodeId id, bool nested);
+    void stmt(NodeId id);
+    void expr(NodeId id);
+
+    uint32_t constant(Value v);
+    uint32_t stringConstant(const char* text, size_t length);
+    void emit(Opcode op, int effect);
+    void emitU16(Opcode op, uint32_t operand, int effect);
+    void emitU32(Opcode op, uint32_t operand, int effect);
+    size_t emitJump(Opcode op, int effect);  // devuelve donde va el destino
+    void patch(size_t at, size_t target);
+    void line(uint32_t line);
+    void error(uint32_t line, const string& message);
+};
+
+#endif
@@ -0,0 +1,390 @@
+#include "cgen.h"
+#include "bytecode.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+using namespace std;
+
+CGenerator::CGenerator()
+    : tree(nullptr), names(nullptr), err(&cerr), errors(0), checks(true), temps(0) {}
+
+void CGenerator::setOutput(ostream& errStream) {
+    err = &errStream;
+}
+
+void CGenerator::setChecks(bool check) {
+    checks = check;
+}
+
+void CGenerator::error(uint32_t line, const string& message) {
+    errors++;
+    *err << "Error de compilacion en linea " << line << ": " << message << endl;
+}
+
+bool CGenerator::generate(const Ast& ast, const SemanticAnalyzer& resolved, ostream& out) {
+    tree = &ast;
+    names = &resolved;
+    errors = 0;
+    literals.clear();
+    literalDefs.clear();
+    varNames.assign(ast.vars.size(), string());
+    for (NodeId g : ast.globals)
+        varNames[g] = "g_" + ast.str(ast.vars[g].name);
+
+    string functions;
+    for (const Func& f : ast.funcs)
+        function(f, functions);
+
+    out << "/* generado por mini0 --emit-c */\n";
+    if (!checks)
+        out << "#define M0_UNCHECKED\n";
+    out << "#include \"mini0_rt.h\"\n\n";
+    if (!literalDefs.empty())
+        out << literalDefs << "\n";
+    for (NodeId g : ast.globals)
+        out << "static m0_value " << varNames[g] << ";\n";
+    if (!ast.globals.empty())
+        out << "\n";
+
+    // prototipos: las funciones se pueden llamar antes de definirse
+    Symbol mainName = ast.symbols.find("main", 4);
+    const Func* mainFunc = nullptr;
+    for (const Func& f : ast.funcs) {
+        if (f.name == mainName)
+            mainFunc = &f;
+        out << "static " << (f.ret == TY_VOID ? "void" : "m0_value") << " f_" << ast.str(f.name) << "(";
+        for (const NodeId* p = ast.begin(f.params); p != ast.end(f.params); p++)
+            out << (p == ast.begin(f.params) ? "" : ", ") << "m0_value";
+        out << (f.params.count == 0 ? "void" : "") << ");\n";
+    }
+    out << "\n" << functions;
+
+    // el codigo de salida es lo que devuelve main (mod 256), como en --run
+    out << "int main(void) {\n";
+    if (!mainFunc) {
+        out << "    fprintf(stderr, \"Error de ejecucion: el programa no tiene funcion main\\n\");\n"
+            << "    return 1;\n";
+    } else if (mainFunc->params.count != 0) {
+        out << "    fprintf(stderr, \"Error de ejecucion: main no puede recibir parametros\\n\");\n"
+            << "    return 1;\n";
+    } else if (mainFunc->ret == TY_VOID) {
+        out << "    f_main();\n"
+            << "    return 0;\n";
+    } else {
+        out << "    return (int)(f_main() & 0xFF);\n";
+    }
+    out << "}\n";
+    return errors == 0;
+}
+
+void CGenerator::function(const Func& f, string& out) {
+    fnName = tree->str(f.name);
+    body.clear();
+    indent = "    ";
+    temps = 0;
+
+    // nombres de C para parametros y locales; si un nombre se repite en otro
+    // bloque lleva un sufijo (en C todas se declaran al principio)
+    vector<NodeId> locals;
+    for (const NodeId* p = tree->begin(f.params); p != tree->end(f.params); p++)
+        locals.push_back(*p);
+    size_t params = locals.size();
+    vector<NodeId> pending(1, f.body);
+    while (!pending.empty()) {
+        NodeId id = pending.back();
+        pending.pop_back();
+        if (id == noNode)
+            continue;
+        const Block& b = tree->blocks[id];
+        for (const NodeId* v = tree->begin(b.vars); v != tree->end(b.vars); v++)
+            locals.push_back(*v);
+        for (const NodeId* s = tree->begin(b.stmts); s != tree->end(b.stmts); s++) {
+            const Stmt& st = tree->stmts[*s];
+            if (st.kind == StmtKind::If)
+                pending.push_back(st.orelse);
+            if (st.kind == StmtKind::If || st.kind == StmtKind::While)
+                pending.push_back(st.body);
+        }
+    }
+    unordered_set<string> used;
+    for (NodeId v : locals) {
+        string name = "v_" + tree->str(tree->vars[v].name);
+        for (int n = 2; used.count(name); n++)
+            name = "v_" + tree->str(tree->vars[v].name) + "_" + to_string(n);
+        used.insert(name);
+        varNames[v] = name;
+    }
+
+    out += "static ";
+    out += f.ret == TY_VOID ? "void" : "m0_value";
+    out += " f_" + fnName + "(";
+    for (size_t i = 0; i < params; i++)
+        out += (i ? ", m0_value " : "m0_value ") + varNames[locals[i]];
+    out += params == 0 ? "void) {\n" : ") {\n";
+    for (size_t i = params; i < locals.size(); i++)
+        out += "    m0_value " + varNames[locals[i]] + " = 0;\n";
+
+    block(f.body, false);
+
+    // se llego al final sin return: una funcion con tipo devuelve 0
+    bool returns = false;
+    if (f.body != noNode) {
+        const Block& b = tree->blocks[f.body];
+        returns = b.stmts.count > 0 && tree->stmts[*(tree->end(b.stmts) - 1)].kind == StmtKind::Return;
+    }
+    if (f.ret != TY_VOID && !returns)
+        emit("return 0;");
+    out += body;
+    out += "}\n\n";
+}
+
+// las variables de un bloque anidado vuelven a 0 cada vez que se entra
+void CGenerator::block(NodeId id, bool nested) {
+    if (id == noNode)
+        return;
+    const Block& b = tree->blocks[id];
+    if (nested)
+        for (const NodeId* v = tree->begin(b.vars); v != tree->end(b.vars); v++)
+            emit(varNames[*v] + " = 0;");
+    for (const NodeId* s = tree->begin(b.stmts); s != tree->end(b.stmts); s++)
+        stmt(*s);
+}
+
+void CGenerator::stmt(NodeId id) {
+    const Stmt& s = tree->stmts[id];
+    switch (s.kind) {
+    case StmtKind::Assign: {
+        const Expr& target = tree->exprs[s.target];
+        if (target.kind == ExprKind::Index) {
+            NodeId parts[3] = {target.lhs, target.rhs, s.value};
+            vector<string> v = operands(parts, 3);
+            emit("m0_store(" + v[0] + ", " + v[1] + ", " + v[2] + where(target.line) + ");");
+            break;
+        }
+        string value = expr(s.value);
+        emit(varNames[names->declOf(s.target)] + " = " + value + ";");
+        break;
+    }
+    case StmtKind::Call:
+        emit(expr(s.value) + ";");
+        break;
+    case StmtKind::If: {
+        emit("if (" + expr(s.value) + ") {");
+        string outer = indent;
+        indent += "    ";
+        block(s.body, true);
+        indent = outer;
+        if (s.orelse != noNode) {
+            emit("} else {");
+            indent += "    ";
+            block(s.orelse, true);
+            indent = outer;
+        }
+        emit("}");
+        break;
+    }
+    case StmtKind::While: {
+        // si la condicion necesita temporales se evalua dentro del bucle
+        string outer = indent;
+        string saved;
+        swap(saved, body);
+        indent += "    ";
+        string cond = expr(s.value);
+        string setup;
+        swap(setup, body);
+        swap(saved, body);
+        indent = outer;
+        if (setup.empty()) {
+            emit("while (" + cond + ") {");
+        } else {
+            emit("for (;;) {");
+            body += setup;
+            emit("    if (!" + cond + ")");
+            emit("        break;");
+        }
+        indent += "    ";
+        block(s.body, true);
+        indent = outer;
+        emit("}");
+        break;
+    }
+    case StmtKind::Return:
+        if (s.value != noNode)
+            emit("return " + expr(s.value) + ";");
+        else
+            emit("return;");
+        break;
+    }
+}
+
+string CGenerator::expr(NodeId id) {
+    const Expr& e = tree->exprs[id];
+    switch (e.kind) {
+    case ExprKind::Num: {
+        Value v;
+        if (!parseNumber(tree->text() + e.text.offset, e.text.length, v))
+            error(e.line, "el numero " + tree->str(e.text) + " no entra en un int");
+        return v > INT32_MAX ? "INT64_C(" + to_string(v) + ")" : to_string(v);
+    }
+    case ExprKind::Str:
+        return "(m0_value)(intptr_t)" + literal(tree->text() + e.text.offset, e.text.length);
+    case ExprKind::True:
+        return "1";
+    case ExprKind::False:
+        return "0";
+    case ExprKind::Var:
+        return varNames[names->declOf(id)];
+    case ExprKind::Index: {
+        NodeId parts[2] = {e.lhs, e.rhs};
+        vector<string> v = operands(parts, 2);
+        return "m0_load(" + v[0] + ", " + v[1] + where(e.line) + ")";
+    }
+    case ExprKind::Call: {
+        vector<string> v = operands(tree->begin(e.args), e.args.count);
+        string call = "f_" + tree->str(e.sym) + "(";
+        for (size_t i = 0; i < v.size(); i++)
+            call += (i ? ", " : "") + v[i];
+        return call + ")";
+    }
+    case ExprKind::New:
+        return "m0_new(" + expr(e.rhs) + where(e.line) + ")";
+    case ExprKind::Unary:
+        if (e.opToken() == TK_NOT)
+            return "(m0_value)!" + expr(e.lhs);
+        return "m0_neg(" + expr(e.lhs) + ")";
+    case ExprKind::Binary:
+        break;
+    }
+
+    int op = e.opToken();
+    if (op == TK_AND || op == TK_OR) {
+        // && y || de C ya cortan; solo hace falta un if si el operando
+        // derecho necesita temporales propios
+        const char* c = op == TK_AND ? " && " : " || ";
+        string left = expr(e.lhs);
+        string saved;
+        swap(saved, body);
+        string outer = indent;
+        indent += "    ";
+        string right = expr(e.rhs);
+        indent = outer;
+        string setup;
+        swap(setup, body);
+        swap(saved, body);
+        if (setup.empty())
+            return "(m0_value)(" + left + c + right + ")";
+        string t = temp(left);
+        emit(op == TK_AND ? "if (" + t + ") {" : "if (!" + t + ") {");
+        body += setup;
+        emit("    " + t + " = " + right + ";");
+        emit("}");
+        return t;
+    }
+
+    NodeId parts[2] = {e.lhs, e.rhs};
+    vector<string> v = operands(parts, 2);
+    switch (op) {
+    case TK_PLUS: return "m0_add(" + v[0] + ", " + v[1] + ")";
+    case TK_MINUS: return "m0_sub(" + v[0] + ", " + v[1] + ")";
+    case TK_MUL: return "m0_mul(" + v[0] + ", " + v[1] + ")";
+    case TK_DIV: return "m0_div(" + v[0] + ", " + v[1] + where(e.line) + ")";
+    case TK_LT: return "(m0_value)(" + v[0] + " < " + v[1] + ")";
+    case TK_LE: return "(m0_value)(" + v[0] + " <= " + v[1] + ")";
+    case TK_GT: return "(m0_value)(" + v[0] + " > " + v[1] + ")";
+    case TK_GE: return "(m0_value)(" + v[0] + " >= " + v[1] + ")";
+    case TK_EQ: return "(m0_value)(" + v[0] + " == " + v[1] + ")";
+    case TK_NEQ: return "(m0_value)(" + v[0] + " != " + v[1] + ")";
+    }
+    return "0";
+}
+
+vector<string> CGenerator::operands(const NodeId* ids, size_t count) {
+    // un operando va a un temporal si choca con alguno posterior
+    vector<unsigned> later(count, 0);
+    for (size_t i = count; i-- > 1;)
+        later[i - 1] = later[i] | effects(ids[i]);
+    vector<string> values;
+    for (size_t i = 0; i < count; i++) {
+        string v = expr(ids[i]);
+        unsigned mine = effects(ids[i]);
+        // una llamada puede cambiar un global que otro lee, y de dos errores
+        // posibles tiene que salir el primero
+        bool clash = ((mine & CallsOut) && (later[i] & ReadsGlobal)) ||
+                     ((mine & ReadsGlobal) && (later[i] & CallsOut)) ||
+                     ((mine & MayFail) && (later[i] & MayFail));
+        if (clash)
+            v = temp(v);
+        values.push_back(move(v));
+    }
+    return values;
+}
+
+unsigned CGenerator::effects(NodeId id) const {
+    const Expr& e = tree->exprs[id];
+    switch (e.kind) {
+    case ExprKind::Var:
+        return varNames[names->declOf(id)][0] == 'g' ? (unsigned)ReadsGlobal : 0u;
+    case ExprKind::Index:
+        return MayFail | effects(e.lhs) | effects(e.rhs);
+    case ExprKind::Call: {
+        unsigned flags = CallsOut | MayFail;
+        for (const NodeId* a = tree->begin(e.args); a != tree->end(e.args); a++)
+            flags |= effects(*a);
+        return flags;
+    }
+    case ExprKind::New:
+        return MayFail | effects(e.rhs);
+    case ExprKind::Unary:
+        return effects(e.lhs);
+    case ExprKind::Binary:
+        return (e.opToken() == TK_DIV ? (unsigned)MayFail : 0u) | effects(e.lhs) | effects(e.rhs);
+    default:
+        return 0;
+    }
+}
+
+string CGenerator::temp(const string& value) {
+    string name = "t" + to_string(++temps);
+    emit("m0_value " + name + " = " + value + ";");
+    return name;
+}
+
+string CGenerator::where(uint32_t line) const {
+    return ", " + to_string(line) + ", \"" + fnName + "\"";
+}
+
+// los literales iguales son la misma constante: == compara punteros
+string CGenerator::literal(const char* text, size_t length) {
+    string value = unescapeLiteral(text, length);
+    auto it = literals.find(value);
+    if (it != literals.end())
+        return it->second;
+    string name = "s" + to_string(literals.size() + 1);
+    string c;
+    for (unsigned char ch : value) {
+        if (ch == '"' || ch == '\\' || ch == '?') {
+            c += '\\';
+            c += (char)ch;
+        } else if (ch == '\n') {
+            c += "\\n";
+        } else if (ch == '\t') {
+            c += "\\t";
+        } else if (ch < 32 || ch > 126) {
+            char octal[5] = {'\\', (char)('0' + (ch >> 6)), (char)('0' + ((ch >> 3) & 7)),
+                             (char)('0' + (ch & 7)), 0};
+            c += octal;
+        } else {
+            c += (char)ch;
+        }
+    }
+    literalDefs += "static const char " + name + "[] = \"" + c + "\";\n";
+    literals.emplace(move(value), name);
+    return name;
+}
+
+void CGenerator::emit(const string& text) {
+    body += indent;
+    body += text;
+    body += '\n';
+}
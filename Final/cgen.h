@@ -0,0 +1,61 @@
+#ifndef CGEN_H
+#define CGEN_H
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ast.h"
+#include "semantic.h"
+
+using namespace std;
+
+// Traduce un AST ya chequeado a una unidad de C99 que incluye
+// runtime/mini0_rt.h. Cada funcion de Mini-0 es una funcion static de C y
+// cada variable una variable de C (v_ locales, g_ globales, f_ funciones, asi
+// no chocan con palabras de C), de modo que gcc -O2 las puede optimizar como
+// codigo propio. Los valores son m0_value (int64_t) igual que en la VM.
+//
+// C no fija el orden de evaluacion de los operandos y Mini-0 si (de izquierda
+// a derecha): un operando se guarda en un temporal solo cuando el orden se
+// nota (una llamada y una lectura de un global, o dos cosas que pueden dar un
+// error de ejecucion). El resto queda como una sola expresion de C.
+class CGenerator {
+public:
+    CGenerator();
+
+    void setOutput(ostream& err);
+    void setChecks(bool check);  // false (--unchecked): define M0_UNCHECKED
+    bool generate(const Ast& tree, const SemanticAnalyzer& names, ostream& out);
+
+private:
+    const Ast* tree;
+    const SemanticAnalyzer* names;
+    ostream* err;
+    size_t errors;
+    bool checks;
+    vector<string> varNames;                 // por VarDecl: nombre en C
+    unordered_map<string, string> literals;  // texto -> nombre de la constante
+    string literalDefs;
+    string body;                             // codigo de la funcion actual
+    string indent;
+    string fnName;                           // nombre de la funcion para los errores
+    uint32_t temps;
+
+    void function(const Func& f, string& out);
+    void block(NodeId id, bool nested);
+    void stmt(NodeId id);
+    string expr(NodeId id);
+    // operandos en orden; los que lo necesitan quedan en temporales
+    vector<string> operands(const NodeId* ids, size_t count);
+    enum : unsigned { ReadsGlobal = 1, CallsOut = 2, MayFail = 4 };
+    unsigned effects(NodeId id) const;  // lo que puede hacer evaluar la expresion
+    string temp(const string& value);
+    string where(uint32_t line) const;  // ", linea, "funcion"" para el runtime
+    string literal(const char* text, size_t length);
+    void emit(const string& text);
+    void error(uint32_t line, const string& message);
+};
+
+#endif
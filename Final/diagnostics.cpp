@@ -0,0 +1,347 @@
+#include "diagnostics.h"
+#include "fastlex.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+const char* tokenName(int token) {
+    switch (token) {
+        case TK_ID: return "TK_ID";
+        case TK_LITNUM: return "TK_LITNUM";
+        case TK_LITSTRING: return "TK_LITSTRING";
+        case TK_TRUE: return "TK_TRUE";
+        case TK_FALSE: return "TK_FALSE";
+        case TK_FUN: return "TK_FUN";
+        case TK_IF: return "TK_IF";
+        case TK_ELSE: return "TK_ELSE";
+        case TK_END: return "TK_END";
+        case TK_WHILE: return "TK_WHILE";
+        case TK_LOOP: return "TK_LOOP";
+        case TK_RETURN: return "TK_RETURN";
+        case TK_NEW: return "TK_NEW";
+        case TK_INT: return "TK_INT";
+        case TK_BOOL: return "TK_BOOL";
+        case TK_CHAR: return "TK_CHAR";
+        case TK_STRING: return "TK_STRING";
+        case TK_AND: return "TK_AND";
+        case TK_OR: return "TK_OR";
+        case TK_NOT: return "TK_NOT";
+        case TK_PLUS: return "TK_PLUS";
+        case TK_MINUS: return "TK_MINUS";
+        case TK_MUL: return "TK_MUL";
+        case TK_DIV: return "TK_DIV";
+        case TK_GT: return "TK_GT";
+        case TK_LT: return "TK_LT";
+        case TK_GE: return "TK_GE";
+        case TK_LE: return "TK_LE";
+        case TK_EQ: return "TK_EQ";
+        case TK_NEQ: return "TK_NEQ";
+        case TK_LPAREN: return "TK_LPAREN";
+        case TK_RPAREN: return "TK_RPAREN";
+        case TK_LBRACKET: return "TK_LBRACKET";
+        case TK_RBRACKET: return "TK_RBRACKET";
+        case TK_COLON: return "TK_COLON";
+        case TK_COMMA: return "TK_COMMA";
+        case TK_ASSIGN: return "TK_ASSIGN";
+        case TK_NL: return "TK_NL";
+        case TK_EOF: return "TK_EOF";
+        case TK_ERROR: return "TK_ERROR";
+        default: return "UNKNOWN";
+    }
+}
+
+Diagnostics::Diagnostics() : written(0), limit(0), overflow(false), linesOf(nullptr) {}
+
+void Diagnostics::clear() {
+    records.clear();
+    pool.clear();
+    written = 0;
+    overflow = false;
+    lineStarts.clear();
+    linesOf = nullptr;
+}
+
+void Diagnostics::add(const Diagnostic& d) {
+    if (full())
+        overflow = true;
+    else
+        records.push_back(d);
+}
+
+void Diagnostics::addCheck(DiagCode code, uint32_t line, uint16_t column, const string& text,
+                           const char* source, size_t size) {
+    if (full()) {
+        overflow = true;
+        return;
+    }
+    Diagnostic d{};
+    d.code = code;
+    d.found = (uint8_t)(TK_ERROR - TK_ID);
+    d.line = line;
+    d.column = column;
+    d.value = keep(text.c_str(), text.size() + 1);  // con el '\0' del final
+    lexemeAt(line, column, source, size, d);
+    records.push_back(d);
+}
+
+// El token que empieza en line:column, volviendo a lexear desde ahi. Los
+// comienzos de linea se buscan una sola vez y solo hasta la linea pedida.
+bool Diagnostics::lexemeAt(uint32_t line, uint16_t column, const char* source, size_t size,
+                           Diagnostic& d) {
+    if (!source || line == 0 || column == 0)
+        return false;
+    if (linesOf != source) {
+        lineStarts.assign(1, 0);
+        linesOf = source;
+    }
+    while (lineStarts.size() < line) {
+        size_t from = lineStarts.back();
+        const void* nl = memchr(source + from, '\n', size - from);
+        if (!nl)
+            return false;
+        lineStarts.push_back((uint32_t)((const char*)nl - source + 1));
+    }
+    size_t offset = (size_t)lineStarts[line - 1] + column - 1;
+    if (offset >= size)
+        return false;
+    FastLexer lexer;
+    lexer.reset(source + offset, size - offset);
+    if (lexer.next() == TK_EOF || lexer.offset() != 0)
+        return false;
+    d.offset = (uint32_t)offset;
+    d.length = (uint32_t)lexer.length();
+    return true;
+}
+
+uint32_t Diagnostics::keep(const char* text, size_t length) {
+    uint32_t offset = (uint32_t)pool.size();
+    pool.append(text, length);
+    return offset;
+}
+
+const char* Diagnostics::lexeme(const Diagnostic& d, const char* source) const {
+    if (d.inPool)
+        return pool.data() + d.offset;
+    return source ? source + d.offset : "";
+}
+
+// 0 lexico, 1 sintactico, 2 semantico, 3 tipos, 4 archivo
+static int kindOf(DiagCode code) {
+    switch (code) {
+        case DG_SIMBOLO: return 0;
+        case DG_NO_DECLARADA:
+        case DG_REDECLARADA:
+        case DG_ARGUMENTOS: return 2;
+        case DG_TIPO_DISTINTO:
+        case DG_RETORNO:
+        case DG_SIN_VALOR:
+        case DG_NO_ARREGLO:
+        case DG_COMPARACION: return 3;
+        case DG_ARCHIVO: return 4;
+        default: return 1;
+    }
+}
+
+string Diagnostics::message(const Diagnostic& d, const char* source) const {
+    static const char* const prefixes[] = {"Error lexico en linea ", "Error sintactico en linea ",
+                                           "Error semantico en linea ", "Error de tipos en linea "};
+    if (d.code == DG_ARCHIVO)
+        return "No se pudo abrir archivo";  // sin linea
+    string text = prefixes[kindOf(d.code)];
+    text += to_string(d.line);
+    text += ": ";
+    switch (d.code) {
+        case DG_SIMBOLO:
+            text += "simbolo invalido '";
+            text.append(lexeme(d, source), d.length);
+            text += "'";
+            break;
+        case DG_ESPERADO:
+            text += "se esperaba ";
+            text += tokenName(d.expected + TK_ID);
+            text += " y se encontro '";
+            text.append(lexeme(d, source), d.length);
+            text += "' (";
+            text += tokenName(d.found + TK_ID);
+            text += ")";
+            break;
+        case DG_TIPO: text += "tipo base esperado"; break;
+        case DG_COMANDO: text += "comando invalido"; break;
+        case DG_ASIGNACION: text += "se esperaba '=' o una llamada a funcion"; break;
+        case DG_EXPRESION: text += "expresion invalida"; break;
+        case DG_EXTRA: text += "tokens extra despues del programa"; break;
+        case DG_ANIDAMIENTO:
+            text += "anidamiento de mas de " + to_string(d.value) + " niveles (--max-depth)";
+            break;
+        case DG_NO_DECLARADA:
+        case DG_REDECLARADA:
+        case DG_ARGUMENTOS:
+        case DG_TIPO_DISTINTO:
+        case DG_RETORNO:
+        case DG_SIN_VALOR:
+        case DG_NO_ARREGLO:
+        case DG_COMPARACION:
+            text += pool.data() + d.value;
+            break;
+        case DG_ARCHIVO:
+            break;
+    }
+    return text;
+}
+
+// desde el comienzo de la linea del lexema; sin el fuente o en EOF no hay.
+// Los semanticos y de tipos traen la del nodo.
+unsigned Diagnostics::column(const Diagnostic& d, const char* source) const {
+    int kind = kindOf(d.code);
+    if (kind == 2 || kind == 3)
+        return d.column;
+    if (d.inPool || !source || d.found + TK_ID == TK_EOF)
+        return 0;
+    size_t start = d.offset;
+    while (start > 0 && source[start - 1] != '\n')
+        start--;
+    return (unsigned)(d.offset - start + 1);
+}
+
+void Diagnostics::flush(ostream& err, const char* source) {
+    if (written == records.size())
+        return;
+    string text;
+    for (; written < records.size(); written++) {
+        text += message(records[written], source);
+        text += '\n';
+    }
+    err.write(text.data(), (streamsize)text.size());
+}
+
+// Largo de la secuencia UTF-8 valida que empieza en text[i] (sin
+// sobrelargas, surrogates ni mas alla de U+10FFFF), 0 si no es valida
+static size_t utf8Length(const string& text, size_t i) {
+    unsigned char c = (unsigned char)text[i];
+    size_t n;
+    unsigned char low = 0x80, high = 0xBF;  // rango del segundo byte
+    if (c >= 0xC2 && c <= 0xDF) {
+        n = 2;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        n = 3;
+        if (c == 0xE0)
+            low = 0xA0;
+        else if (c == 0xED)
+            high = 0x9F;
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        n = 4;
+        if (c == 0xF0)
+            low = 0x90;
+        else if (c == 0xF4)
+            high = 0x8F;
+    } else {
+        return 0;
+    }
+    if (i + n > text.size())
+        return 0;
+    for (size_t k = 1; k < n; k++) {
+        unsigned char b = (unsigned char)text[i + k];
+        if (b < (k == 1 ? low : 0x80) || b > (k == 1 ? high : 0xBF))
+            return 0;
+    }
+    return n;
+}
+
+// JSON pide UTF-8 valido: los bytes de control van como \u00XX, el UTF-8
+// valido pasa tal cual y cada byte que no lo es queda como U+FFFD
+void appendJsonString(string& out, const string& text) {
+    out += '"';
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += (char)c;
+        } else if (c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof escaped, "\\u%04x", c);
+            out += escaped;
+        } else if (c < 0x80) {
+            out += (char)c;
+        } else if (size_t n = utf8Length(text, i)) {
+            out.append(text, i, n);
+            i += n - 1;
+        } else {
+            out += "\\ufffd";
+        }
+    }
+    out += '"';
+}
+
+static const char* codeName(DiagCode code) {
+    switch (code) {
+        case DG_SIMBOLO: return "simbolo-invalido";
+        case DG_ESPERADO: return "token-esperado";
+        case DG_TIPO: return "tipo-base";
+        case DG_COMANDO: return "comando-invalido";
+        case DG_ASIGNACION: return "asignacion";
+        case DG_EXPRESION: return "expresion-invalida";
+        case DG_EXTRA: return "tokens-extra";
+        case DG_ANIDAMIENTO: return "anidamiento";
+        case DG_NO_DECLARADA: return "no-declarada";
+        case DG_REDECLARADA: return "redeclarada";
+        case DG_ARGUMENTOS: return "cantidad-argumentos";
+        case DG_TIPO_DISTINTO: return "tipo-distinto";
+        case DG_RETORNO: return "retorno";
+        case DG_SIN_VALOR: return "sin-valor";
+        case DG_NO_ARREGLO: return "no-es-arreglo";
+        case DG_COMPARACION: return "comparacion";
+        case DG_ARCHIVO: return "archivo";
+    }
+    return "desconocido";
+}
+
+// {"file": ..., "errors": N, "stopped": bool, "diagnostics": [{"code", "kind",
+// "line", "column", "offset", "length", "found", "expected", "message"}]}.
+// line y column son donde empieza el token (o el nodo, en los semanticos y de
+// tipos); column 0 si no se sabe, y archivo no tiene ninguna. offset es null si
+// el lexema no esta en el fuente; en los semanticos y de tipos offset y length
+// son los del primer token del nodo (null y 0 si el fuente no estaba en
+// memoria). found solo en lexicos y sintacticos, expected solo en token-esperado.
+void Diagnostics::writeJson(ostream& err, const string& file, const char* source,
+                            bool stopped) const {
+    string out = "{\"file\":";
+    appendJsonString(out, file);
+    out += ",\"errors\":" + to_string(records.size());
+    out += stopped ? ",\"stopped\":true" : ",\"stopped\":false";
+    out += ",\"diagnostics\":[";
+    for (size_t i = 0; i < records.size(); i++) {
+        const Diagnostic& d = records[i];
+        if (i > 0)
+            out += ',';
+        out += "{\"code\":\"";
+        out += codeName(d.code);
+        static const char* const kinds[] = {"lexico", "sintactico", "semantico", "tipos",
+                                            "archivo"};
+        out += "\",\"kind\":\"";
+        out += kinds[kindOf(d.code)];
+        out += '"';
+        out += ",\"line\":" + to_string(d.line);
+        out += ",\"column\":" + to_string(column(d, source));
+        int kind = kindOf(d.code);
+        bool located = kind == 2 || kind == 3 ? d.length > 0 : !d.inPool && source;
+        out += ",\"offset\":" + (located ? to_string(d.offset) : string("null"));
+        out += ",\"length\":" + to_string(kind < 4 ? d.length : 0);
+        if (kindOf(d.code) < 2) {
+            out += ",\"found\":\"";
+            out += tokenName(d.found + TK_ID);
+            out += '"';
+        }
+        if (d.code == DG_ESPERADO) {
+            out += ",\"expected\":\"";
+            out += tokenName(d.expected + TK_ID);
+            out += '"';
+        }
+        out += ",\"message\":";
+        appendJsonString(out, message(d, source));
+        out += '}';
+    }
+    out += "]}\n";
+    err.write(out.data(), (streamsize)out.size());
+}
@@ -0,0 +1,107 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "tokens.h"
+
+using namespace std;
+
+// Errores como registros: el parser guarda que paso y donde, y los mensajes
+// se arman recien al escribirlos, todos de una vez. Los semanticos y de tipos
+// tambien tienen codigo, linea y columna (la del nodo) y el lexema donde empieza
+// el nodo; su texto ya viene armado.
+
+// Cada codigo tiene su mensaje fijo (ver Diagnostics::message)
+enum DiagCode : uint8_t {
+    DG_SIMBOLO,      // lexico: simbolo invalido
+    DG_ESPERADO,     // se esperaba 'expected' y se encontro 'found'
+    DG_TIPO,         // tipo base esperado
+    DG_COMANDO,      // comando invalido
+    DG_ASIGNACION,   // se esperaba '=' o una llamada a funcion
+    DG_EXPRESION,    // expresion invalida
+    DG_EXTRA,        // tokens extra despues del programa
+    DG_ANIDAMIENTO,  // anidamiento de mas de 'value' niveles
+    // de SemanticAnalyzer
+    DG_NO_DECLARADA,   // variable o funcion no declarada
+    DG_REDECLARADA,    // ya declarada en el mismo alcance
+    DG_ARGUMENTOS,     // cantidad de argumentos de una llamada
+    // de TypeChecker
+    DG_TIPO_DISTINTO,  // un valor no es del tipo que se pide
+    DG_RETORNO,        // return que no coincide con el tipo de la funcion
+    DG_SIN_VALOR,      // llamada a una funcion sin tipo usada como valor
+    DG_NO_ARREGLO,     // se indexa algo que no es arreglo
+    DG_COMPARACION,    // comparacion entre tipos que no se comparan
+    DG_ARCHIVO       // no se pudo abrir el archivo
+};
+
+// Como se escriben: los mensajes de siempre, o un objeto JSON por archivo
+enum class DiagFormat {
+    Text,
+    Json
+};
+
+struct Diagnostic {
+    DiagCode code;
+    uint8_t expected;  // DG_ESPERADO: token - TK_ID
+    uint8_t found;     // el token actual - TK_ID
+    bool inPool;       // el lexema se copio a Diagnostics (el fuente no queda en memoria)
+    uint32_t line;     // la del mensaje
+    uint32_t offset;   // el lexema: en el fuente, o en la zona propia si inPool
+    uint32_t length;   // semanticos y de tipos: 0 si no se sabe donde esta el lexema
+    uint32_t value;    // DG_ANIDAMIENTO: el limite; semanticos y de tipos: el texto
+    uint16_t column;   // semanticos y de tipos (los demas la sacan del offset)
+};
+
+const char* tokenName(int token);
+// con comillas y escapes; el UTF-8 valido pasa tal cual
+void appendJsonString(string& out, const string& text);
+
+// Junta los registros de un analisis. Con limite, add() deja de guardar al
+// llegar a 'limit' y full() avisa para cortar el analisis; dropped() dice si
+// alguno quedo afuera.
+class Diagnostics {
+public:
+    Diagnostics();
+
+    void clear();
+    void setLimit(unsigned maxErrors) { limit = maxErrors; }  // 0 es sin limite
+    void add(const Diagnostic& d);
+    // semanticos y de tipos: el texto va a la zona propia y, con el fuente en
+    // memoria (source, size), offset y length son los del token en line:column
+    void addCheck(DiagCode code, uint32_t line, uint16_t column, const string& text,
+                  const char* source, size_t size);
+    uint32_t keep(const char* text, size_t length);  // para lexemas fuera del fuente
+
+    bool full() const { return limit != 0 && records.size() >= limit; }
+    bool dropped() const { return overflow; }
+    size_t size() const { return records.size(); }
+    const vector<Diagnostic>& all() const { return records; }
+
+    // source: el texto al que apuntan los offsets (nullptr si no esta en memoria)
+    string message(const Diagnostic& d, const char* source) const;
+    unsigned column(const Diagnostic& d, const char* source) const;  // 0: no se sabe
+    // los mensajes que faltan escribir, en una sola escritura
+    void flush(ostream& err, const char* source);
+    // un objeto JSON en una linea con todos los registros
+    void writeJson(ostream& err, const string& file, const char* source, bool stopped) const;
+
+private:
+    vector<Diagnostic> records;
+    string pool;     // lexemas copiados
+    size_t written;  // registros que ya escribio flush
+    unsigned limit;
+    bool overflow;   // add() descarto alguno por el limite
+    // comienzo de cada linea de linesOf, hasta donde pidio addCheck
+    vector<uint32_t> lineStarts;
+    const char* linesOf;
+
+    const char* lexeme(const Diagnostic& d, const char* source) const;
+    bool lexemeAt(uint32_t line, uint16_t column, const char* source, size_t size,
+                  Diagnostic& d);
+};
+
+#endif
@@ -0,0 +1,207 @@
+#include "elfobj.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// numeros de System V / ELF64 que se usan aca
+static const uint16_t ET_REL_ = 1;
+static const uint16_t EM_X86_64_ = 62;
+static const uint32_t SHT_PROGBITS_ = 1, SHT_SYMTAB_ = 2, SHT_STRTAB_ = 3, SHT_RELA_ = 4,
+                      SHT_NOBITS_ = 8;
+static const uint64_t SHF_WRITE_ = 1, SHF_ALLOC_ = 2, SHF_EXECINSTR_ = 4, SHF_INFO_LINK_ = 0x40;
+static const uint16_t SHN_ABS_ = 0xFFF1;
+static const uint8_t STT_SECTION_ = 3, STT_FILE_ = 4;
+
+// secciones en el orden del archivo (ElfObject::Section es el indice)
+enum : uint16_t {
+    S_NULL, S_TEXT, S_RELA_TEXT, S_RODATA, S_BSS, S_NOTE, S_SYMTAB, S_STRTAB, S_SHSTRTAB, S_COUNT
+};
+
+static void put16(vector<uint8_t>& out, uint16_t v) {
+    for (int i = 0; i < 2; i++)
+        out.push_back((uint8_t)(v >> (8 * i)));
+}
+
+static void put32(vector<uint8_t>& out, uint32_t v) {
+    for (int i = 0; i < 4; i++)
+        out.push_back((uint8_t)(v >> (8 * i)));
+}
+
+static void put64(vector<uint8_t>& out, uint64_t v) {
+    for (int i = 0; i < 8; i++)
+        out.push_back((uint8_t)(v >> (8 * i)));
+}
+
+static void align(vector<uint8_t>& out, size_t to) {
+    while (out.size() % to)
+        out.push_back(0);
+}
+
+ElfObject::ElfObject() : bssSize(0), strtab(1, '\0') {
+    const Section sections[3] = {Text, Rodata, Bss};
+    for (Section s : sections) {
+        sectionSymbols[s] = (uint32_t)symbols.size();
+        symbols.push_back({0, s, STT_SECTION_, false, 0, 0});
+    }
+}
+
+void ElfObject::setSourceName(const string& name) {
+    symbols.push_back({(uint32_t)strtab.size(), SHN_ABS_, STT_FILE_, false, 0, 0});
+    strtab += name;
+    strtab += '\0';
+}
+
+uint32_t ElfObject::addSymbol(const string& name, Section section, uint64_t value, uint64_t size,
+                              SymbolKind kind, bool global) {
+    symbols.push_back({(uint32_t)strtab.size(), section, kind, global, value, size});
+    strtab += name;
+    strtab += '\0';
+    return (uint32_t)symbols.size() - 1;
+}
+
+void ElfObject::setSymbol(uint32_t symbol, uint64_t value, uint64_t size) {
+    symbols[symbol].value = value;
+    symbols[symbol].size = size;
+}
+
+uint32_t ElfObject::sectionSymbol(Section section) const {
+    return sectionSymbols[section];
+}
+
+void ElfObject::relocate(uint64_t offset, uint32_t symbol, RelocType type, int64_t addend) {
+    relocs.push_back({offset, symbol, type, addend});
+}
+
+void ElfObject::write(vector<uint8_t>& out) const {
+    // indice final de cada simbolo: el nulo, el archivo, los locales y los globales
+    vector<uint32_t> order;
+    for (int pass = 0; pass < 3; pass++)
+        for (uint32_t i = 0; i < symbols.size(); i++) {
+            const Sym& s = symbols[i];
+            int group = s.kind == STT_FILE_ ? 0 : s.global ? 2 : 1;
+            if (group == pass)
+                order.push_back(i);
+        }
+    vector<uint32_t> index(symbols.size());
+    uint32_t firstGlobal = 1;
+    for (uint32_t k = 0; k < order.size(); k++) {
+        index[order[k]] = k + 1;
+        if (!symbols[order[k]].global)
+            firstGlobal = k + 2;
+    }
+
+    string shstrtab(1, '\0');
+    uint32_t names[S_COUNT] = {0};
+    const char* const sectionNames[S_COUNT] = {"", ".text", ".rela.text", ".rodata", ".bss",
+                                               ".note.GNU-stack", ".symtab", ".strtab",
+                                               ".shstrtab"};
+    for (int s = 1; s < S_COUNT; s++) {
+        names[s] = (uint32_t)shstrtab.size();
+        shstrtab += sectionNames[s];
+        shstrtab += '\0';
+    }
+
+    // contenido de las secciones, con el encabezado de 64 bytes al principio
+    uint64_t offset[S_COUNT] = {0}, size[S_COUNT] = {0};
+    out.assign(64, 0);
+    align(out, 16);
+    offset[S_TEXT] = out.size();
+    out.insert(out.end(), text.begin(), text.end());
+    size[S_TEXT] = text.size();
+
+    align(out, 8);
+    offset[S_RELA_TEXT] = out.size();
+    for (const Reloc& r : relocs) {
+        put64(out, r.offset);
+        put64(out, ((uint64_t)index[r.symbol] << 32) | r.type);
+        put64(out, (uint64_t)r.addend);
+    }
+    size[S_RELA_TEXT] = out.size() - offset[S_RELA_TEXT];
+
+    align(out, 8);
+    offset[S_RODATA] = out.size();
+    out.insert(out.end(), rodata.begin(), rodata.end());
+    size[S_RODATA] = rodata.size();
+
+    offset[S_BSS] = out.size();
+    size[S_BSS] = bssSize;
+    offset[S_NOTE] = out.size();
+
+    align(out, 8);
+    offset[S_SYMTAB] = out.size();
+    out.insert(out.end(), 24, 0);
+    for (uint32_t i : order) {
+        const Sym& s = symbols[i];
+        put32(out, s.name);
+        out.push_back((uint8_t)((s.global ? 1 : 0) << 4 | s.kind));
+        out.push_back(0);
+        put16(out, s.section);
+        put64(out, s.value);
+        put64(out, s.size);
+    }
+    size[S_SYMTAB] = out.size() - offset[S_SYMTAB];
+
+    offset[S_STRTAB] = out.size();
+    out.insert(out.end(), strtab.begin(), strtab.end());
+    size[S_STRTAB] = strtab.size();
+
+    offset[S_SHSTRTAB] = out.size();
+    out.insert(out.end(), shstrtab.begin(), shstrtab.end());
+    size[S_SHSTRTAB] = shstrtab.size();
+
+    align(out, 8);
+    uint64_t sectionTable = out.size();
+    struct Header {
+        uint32_t type;
+        uint64_t flags;
+        uint32_t link;
+        uint32_t info;
+        uint64_t align;
+        uint64_t entsize;
+    };
+    const Header headers[S_COUNT] = {
+        {0, 0, 0, 0, 0, 0},
+        {SHT_PROGBITS_, SHF_ALLOC_ | SHF_EXECINSTR_, 0, 0, 16, 0},
+        {SHT_RELA_, SHF_INFO_LINK_, S_SYMTAB, S_TEXT, 8, 24},
+        {SHT_PROGBITS_, SHF_ALLOC_, 0, 0, 8, 0},
+        {SHT_NOBITS_, SHF_ALLOC_ | SHF_WRITE_, 0, 0, 8, 0},
+        {SHT_PROGBITS_, 0, 0, 0, 1, 0},
+        {SHT_SYMTAB_, 0, S_STRTAB, firstGlobal, 8, 24},
+        {SHT_STRTAB_, 0, 0, 0, 1, 0},
+        {SHT_STRTAB_, 0, 0, 0, 1, 0},
+    };
+    for (int s = 0; s < S_COUNT; s++) {
+        const Header& h = headers[s];
+        put32(out, names[s]);
+        put32(out, h.type);
+        put64(out, h.flags);
+        put64(out, 0);  // addr
+        put64(out, s ? offset[s] : 0);
+        put64(out, size[s]);
+        put32(out, h.link);
+        put32(out, h.info);
+        put64(out, h.align);
+        put64(out, h.entsize);
+    }
+
+    // encabezado ELF
+    vector<uint8_t> header;
+    const uint8_t ident[16] = {0x7F, 'E', 'L', 'F', 2 /* 64 bits */, 1 /* little-endian */,
+                               1 /* version */, 0 /* System V */};
+    header.insert(header.end(), ident, ident + 16);
+    put16(header, ET_REL_);
+    put16(header, EM_X86_64_);
+    put32(header, 1);             // version
+    put64(header, 0);             // entry
+    put64(header, 0);             // phoff
+    put64(header, sectionTable);  // shoff
+    put32(header, 0);             // flags
+    put16(header, 64);            // ehsize
+    put16(header, 0);             // phentsize
+    put16(header, 0);             // phnum
+    put16(header, 64);            // shentsize
+    put16(header, S_COUNT);
+    put16(header, S_SHSTRTAB);
+    copy(header.begin(), header.end(), out.begin());
+}
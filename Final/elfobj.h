@@ -0,0 +1,61 @@
+#ifndef ELFOBJ_H
+#define ELFOBJ_H
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Objeto ELF64 reubicable para x86-64 (lo que saldria de 'as'): .text,
+// .rodata, .bss, la tabla de simbolos y las reubicaciones de .text. No usa
+// <elf.h> (no esta en todos lados); los numeros son los del estandar de
+// System V y se escriben siempre en little-endian.
+class ElfObject {
+public:
+    // indice de la seccion en la tabla de secciones del archivo
+    enum Section : uint16_t { Undefined = 0, Text = 1, Rodata = 3, Bss = 4 };
+    enum SymbolKind : uint8_t { NoType = 0, Object = 1, Function = 2 };
+    enum RelocType : uint32_t { PC32 = 2, PLT32 = 4 };
+
+    ElfObject();
+
+    vector<uint8_t> text;
+    vector<uint8_t> rodata;
+    uint64_t bssSize;
+
+    void setSourceName(const string& name);  // simbolo STT_FILE
+    // los simbolos locales se escriben antes que los globales (lo pide ELF);
+    // el numero que se devuelve no cambia por eso
+    uint32_t addSymbol(const string& name, Section section, uint64_t value, uint64_t size,
+                       SymbolKind kind, bool global);
+    void setSymbol(uint32_t symbol, uint64_t value, uint64_t size);
+    uint32_t sectionSymbol(Section section) const;
+    void relocate(uint64_t offset, uint32_t symbol, RelocType type, int64_t addend);
+
+    void write(vector<uint8_t>& out) const;
+
+private:
+    struct Sym {
+        uint32_t name;  // offset en strtab
+        uint16_t section;
+        uint8_t kind;   // SymbolKind, o seccion (3) y archivo (4)
+        bool global;
+        uint64_t value;
+        uint64_t size;
+    };
+    struct Reloc {
+        uint64_t offset;
+        uint32_t symbol;
+        RelocType type;
+        int64_t addend;
+    };
+
+    string strtab;
+    vector<Sym> symbols;
+    vector<Reloc> relocs;
+    uint32_t sectionSymbols[5];
+};
+
+#endif
@@ -0,0 +1,278 @@
+#include "fastlex.h"
+#include "keywords.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Clases de caracter para el primer byte de cada token
+enum CharClass : uint8_t {
+    C_ERROR = 0,  // cualquier otro byte (incluye '\0': fin o simbolo invalido)
+    C_BLANK,      // [ \t\r]
+    C_NL,
+    C_IDSTART,    // [a-zA-Z_]
+    C_DIGIT,
+    C_QUOTE,
+    C_SINGLE,     // operadores de un caracter que nunca siguen con otro
+    C_LT,
+    C_GT,
+    C_EQ
+};
+
+struct Tables {
+    uint8_t cls[256];
+    uint8_t ident[256];      // [a-zA-Z0-9_]
+    uint16_t single[256];    // TokenType de los C_SINGLE
+
+    constexpr Tables() : cls(), ident(), single() {
+        for (int c = 'a'; c <= 'z'; c++) {
+            cls[c] = C_IDSTART;
+            cls[c - 'a' + 'A'] = C_IDSTART;
+            ident[c] = 1;
+            ident[c - 'a' + 'A'] = 1;
+        }
+        cls['_'] = C_IDSTART;
+        ident['_'] = 1;
+        for (int c = '0'; c <= '9'; c++) {
+            cls[c] = C_DIGIT;
+            ident[c] = 1;
+        }
+        cls[' '] = cls['\t'] = cls['\r'] = C_BLANK;
+        cls['\n'] = C_NL;
+        cls['"'] = C_QUOTE;
+        cls['<'] = C_LT;
+        cls['>'] = C_GT;
+        cls['='] = C_EQ;
+
+        const char ops[] = "+-*/()[]:,";
+        const uint16_t types[] = {TK_PLUS, TK_MINUS, TK_MUL, TK_DIV, TK_LPAREN, TK_RPAREN,
+                                  TK_LBRACKET, TK_RBRACKET, TK_COLON, TK_COMMA};
+        for (int i = 0; ops[i]; i++) {
+            cls[(unsigned char)ops[i]] = C_SINGLE;
+            single[(unsigned char)ops[i]] = types[i];
+        }
+    }
+};
+
+constexpr Tables tables;
+
+inline unsigned lowestBit(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(mask);
+#endif
+}
+
+// Las tres secuencias largas del lexer. Ninguna incluye '\0', asi que el
+// relleno en cero despues del texto las corta: se puede leer de a bloques
+// sin mirar el fin.
+#if defined(__AVX2__)
+
+typedef __m256i Block;
+const int blockSize = 32;
+inline Block load(const char* p) { return _mm256_loadu_si256((const __m256i*)p); }
+inline Block splat(char c) { return _mm256_set1_epi8(c); }
+inline Block eq(Block a, Block b) { return _mm256_cmpeq_epi8(a, b); }
+inline Block gt(Block a, Block b) { return _mm256_cmpgt_epi8(a, b); }
+inline Block both(Block a, Block b) { return _mm256_and_si256(a, b); }
+inline Block either(Block a, Block b) { return _mm256_or_si256(a, b); }
+inline uint32_t mask(Block a) { return (uint32_t)_mm256_movemask_epi8(a); }
+
+#elif defined(__SSE2__) || defined(_M_X64)
+
+typedef __m128i Block;
+const int blockSize = 16;
+inline Block load(const char* p) { return _mm_loadu_si128((const __m128i*)p); }
+inline Block splat(char c) { return _mm_set1_epi8(c); }
+inline Block eq(Block a, Block b) { return _mm_cmpeq_epi8(a, b); }
+inline Block gt(Block a, Block b) { return _mm_cmpgt_epi8(a, b); }
+inline Block both(Block a, Block b) { return _mm_and_si128(a, b); }
+inline Block either(Block a, Block b) { return _mm_or_si128(a, b); }
+inline uint32_t mask(Block a) { return (uint32_t)_mm_movemask_epi8(a) & 0xFFFF; }
+
+#endif
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#define MINI0_SIMD_BLOCKS 1
+
+// c en [lo, hi]; comparaciones con signo: los bytes >= 0x80 quedan afuera
+inline Block inRange(Block v, char lo, char hi) {
+    return both(gt(v, splat((char)(lo - 1))), gt(splat((char)(hi + 1)), v));
+}
+
+// avanza mientras el bloque sea todo 'match'; devuelve el primer byte que no
+template <class Match>
+inline const char* run(const char* p, Match match) {
+    const uint32_t full = blockSize == 32 ? 0xFFFFFFFFu : 0xFFFFu;
+    while (true) {
+        uint32_t m = mask(match(load(p))) ^ full;
+        if (m)
+            return p + lowestBit(m);
+        p += blockSize;
+    }
+}
+
+const char* skipBlanks(const char* p) {
+    return run(p, [](Block v) {
+        return either(either(eq(v, splat(' ')), eq(v, splat('\t'))), eq(v, splat('\r')));
+    });
+}
+
+const char* skipIdent(const char* p) {
+    return run(p, [](Block v) {
+        Block lower = either(v, splat(0x20));
+        return either(either(inRange(lower, 'a', 'z'), inRange(v, '0', '9')), eq(v, splat('_')));
+    });
+}
+
+const char* skipDigits(const char* p) {
+    return run(p, [](Block v) { return inRange(v, '0', '9'); });
+}
+
+#else
+
+const char* skipBlanks(const char* p) {
+    while (tables.cls[(unsigned char)*p] == C_BLANK)
+        p++;
+    return p;
+}
+
+const char* skipIdent(const char* p) {
+    while (tables.ident[(unsigned char)*p])
+        p++;
+    return p;
+}
+
+const char* skipDigits(const char* p) {
+    while (tables.cls[(unsigned char)*p] == C_DIGIT)
+        p++;
+    return p;
+}
+
+#endif
+
+} // namespace
+
+const char* fastLexerSimd() {
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(MINI0_SIMD_BLOCKS)
+    return "sse2";
+#else
+    return "escalar";
+#endif
+}
+
+FastLexer::FastLexer()
+        : base(nullptr),
+            end(nullptr),
+            cur(nullptr),
+            start(nullptr),
+            line(1) {
+}
+
+void FastLexer::reset(const char* data, size_t size) {
+    base = data;
+    end = data + size;
+    cur = data;
+    start = data;
+    line = 1;
+}
+
+int FastLexer::next() {
+    while (true) {
+        start = cur;
+        unsigned char c = (unsigned char)*cur;
+        switch (tables.cls[c]) {
+        case C_BLANK:
+            cur = skipBlanks(cur + 1);
+            continue;
+        case C_NL:
+            cur++;
+            line++;
+            return TK_NL;
+        case C_IDSTART:
+            cur = skipIdent(cur + 1);
+            // como en lexer.l: toda palabra es identificador salvo que sea reservada
+            return keywordOrId(start, (size_t)(cur - start));
+        case C_DIGIT:
+            cur = skipDigits(cur + 1);
+            return TK_LITNUM;
+        case C_QUOTE:
+            return scanString();
+        case C_SINGLE:
+            cur++;
+            return tables.single[c];
+        case C_LT:
+            cur++;
+            if (*cur == '>') {
+                cur++;
+                return TK_NEQ;
+            }
+            if (*cur == '=') {
+                cur++;
+                return TK_LE;
+            }
+            return TK_LT;
+        case C_GT:
+            cur++;
+            if (*cur == '=') {
+                cur++;
+                return TK_GE;
+            }
+            return TK_GT;
+        case C_EQ:
+            cur++;
+            if (*cur == '=') {
+                cur++;
+                return TK_EQ;
+            }
+            return TK_ASSIGN;
+        default:
+            if (cur >= end)
+                return TK_EOF;  // ya estamos en el relleno
+            cur++;
+            return TK_ERROR;
+        }
+    }
+}
+
+// \"([^"\\]|\\.)*\"  (el '.' de Flex no incluye '\n')
+int FastLexer::scanString() {
+    const char* p = cur + 1;
+    int newlines = 0;
+    while (p < end) {
+        char c = *p;
+        if (c == '"') {
+            cur = p + 1;
+            line += newlines;
+            return TK_LITSTRING;
+        }
+        if (c == '\\') {
+            if (p + 1 < end && p[1] != '\n') {
+                p += 2;
+                continue;
+            }
+            break;
+        }
+        if (c == '\n')
+            newlines++;
+        p++;
+    }
+    // sin comilla de cierre: Flex se queda con la regla '.' para la comilla
+    cur++;
+    return TK_ERROR;
+}
@@ -0,0 +1,40 @@
+#ifndef FASTLEX_H
+#define FASTLEX_H
+
+#include <cstddef>
+#include "tokens.h"
+
+using namespace std;
+
+// Lexer escrito a mano, alternativa al de Flex (mismos tokens, mismas lineas).
+// Clasifica cada byte con una tabla de 256 entradas y recorre las secuencias
+// de blancos, letras/digitos y digitos con SSE2 (o AVX2 si se compila con
+// -mavx2). Necesita el texto seguido de SourceBuffer::padding bytes en cero.
+class FastLexer {
+public:
+    FastLexer();
+
+    void reset(const char* data, size_t size);
+
+    // devuelve el proximo token; TK_EOF al final (y de ahi en mas)
+    int next();
+
+    size_t offset() const { return (size_t)(start - base); }
+    size_t length() const { return (size_t)(cur - start); }
+    const char* text() const { return start; }
+    int lineno() const { return line; }  // linea despues del ultimo token
+
+private:
+    const char* base;
+    const char* end;
+    const char* cur;
+    const char* start;
+    int line;
+
+    int scanString();
+};
+
+// nombre de la implementacion SIMD compilada ("avx2", "sse2" o "escalar")
+const char* fastLexerSimd();
+
+#endif
@@ -0,0 +1,296 @@
+#ifndef GRAMMAR_H
+#define GRAMMAR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include "tokens.h"
+
+using namespace std;
+
+// La gramatica de Mini-0 como datos, y sus conjuntos FIRST y FOLLOW
+// calculados por el compilador. El parser los usa para decidir (que token
+// empieza un comando, una expresion, un tipo) y para recuperarse de errores.
+// Los saltos de linea van como TK_NL donde terminan algo; las lineas en
+// blanco que el parser saltea no estan.
+
+// Conjunto de tokens: un bit por TokenType (desde TK_ID)
+struct TokenSet {
+    uint64_t bits;
+
+    constexpr TokenSet() : bits(0) {}
+    constexpr TokenSet(initializer_list<int> tokens) : bits(0) {
+        for (int token : tokens)
+            bits |= bit(token);
+    }
+
+    constexpr bool has(int token) const { return (bits & bit(token)) != 0; }
+    constexpr TokenSet with(int token) const { return fromBits(bits | bit(token)); }
+    constexpr TokenSet without(int token) const { return fromBits(bits & ~bit(token)); }
+    constexpr TokenSet operator|(TokenSet other) const { return fromBits(bits | other.bits); }
+    constexpr bool operator==(TokenSet other) const { return bits == other.bits; }
+    constexpr bool operator!=(TokenSet other) const { return bits != other.bits; }
+
+private:
+    // fuera de rango (un char suelto, 0): ningun bit
+    static constexpr uint64_t bit(int token) {
+        return (unsigned)(token - TK_ID) < 64 ? uint64_t(1) << (token - TK_ID) : 0;
+    }
+    static constexpr TokenSet fromBits(uint64_t bits) {
+        TokenSet s;
+        s.bits = bits;
+        return s;
+    }
+};
+
+static_assert(TK_ERROR - TK_ID < 64, "TokenSet tiene un bit por token");
+
+// No terminales: los mismos nombres que las funciones del parser. Las
+// expresiones van como cascada de un no terminal por nivel, que es como esta
+// escrita la gramatica; el parser las analiza con la tabla de precedencias.
+enum Nonterminal {
+    NT_PROGRAMA,
+    NT_DECL_LIST,
+    NT_DECL,
+    NT_GLOBAL,
+    NT_FUNCION,
+    NT_OPT_TIPO,
+    NT_PARAMS,
+    NT_PARAMS_TAIL,
+    NT_PARAMETRO,
+    NT_DECLVAR,
+    NT_TIPO,
+    NT_TIPOBASE,
+    NT_BLOQUE,
+    NT_DECLVAR_LIST,
+    NT_COMANDO_LIST,
+    NT_COMANDO,
+    NT_CMDIF,
+    NT_ELSE_IF_LIST,
+    NT_OPT_ELSE,
+    NT_CMDWHILE,
+    NT_CMDRETURN,
+    NT_OPT_EXP,
+    NT_CMDATRIB,
+    NT_LLAMADA,
+    NT_LISTAEXP,
+    NT_LISTAEXP_TAIL,
+    NT_VAR,
+    NT_VAR_SUFIJO,
+    NT_EXP,
+    NT_EXP_OR,
+    NT_EXP_OR_P,
+    NT_EXP_AND,
+    NT_EXP_AND_P,
+    NT_EXP_EQ,
+    NT_EXP_EQ_P,
+    NT_EXP_REL,
+    NT_EXP_REL_P,
+    NT_EXP_ADD,
+    NT_EXP_ADD_P,
+    NT_EXP_MUL,
+    NT_EXP_MUL_P,
+    NT_EXP_UNARY,
+    NT_EXP_PRIMARY,
+    NT_COUNT
+};
+
+// cabeza -> cuerpo; en el cuerpo, un valor < TK_ID es un no terminal
+struct Production {
+    int head;
+    int body[10];
+    int length;
+
+    constexpr Production(int h, initializer_list<int> symbols) : head(h), body(), length(0) {
+        for (int s : symbols)
+            body[length++] = s;
+    }
+};
+
+constexpr Production grammar[] = {
+    {NT_PROGRAMA, {NT_DECL, NT_DECL_LIST}},
+    {NT_DECL_LIST, {NT_DECL, NT_DECL_LIST}},
+    {NT_DECL_LIST, {}},
+    {NT_DECL, {NT_FUNCION}},
+    {NT_DECL, {NT_GLOBAL}},
+    {NT_GLOBAL, {NT_DECLVAR, TK_NL}},
+    {NT_FUNCION, {TK_FUN, TK_ID, TK_LPAREN, NT_PARAMS, TK_RPAREN, NT_OPT_TIPO, TK_NL,
+                  NT_BLOQUE, TK_END, TK_NL}},
+    {NT_OPT_TIPO, {TK_COLON, NT_TIPO}},
+    {NT_OPT_TIPO, {}},
+    {NT_PARAMS, {NT_PARAMETRO, NT_PARAMS_TAIL}},
+    {NT_PARAMS, {}},
+    {NT_PARAMS_TAIL, {TK_COMMA, NT_PARAMETRO, NT_PARAMS_TAIL}},
+    {NT_PARAMS_TAIL, {}},
+    {NT_PARAMETRO, {TK_ID, TK_COLON, NT_TIPO}},
+    {NT_DECLVAR, {TK_ID, TK_COLON, NT_TIPO}},
+    {NT_TIPO, {TK_LBRACKET, TK_RBRACKET, NT_TIPO}},
+    {NT_TIPO, {NT_TIPOBASE}},
+    {NT_TIPOBASE, {TK_INT}},
+    {NT_TIPOBASE, {TK_BOOL}},
+    {NT_TIPOBASE, {TK_CHAR}},
+    {NT_TIPOBASE, {TK_STRING}},
+
+    {NT_BLOQUE, {NT_DECLVAR_LIST, NT_COMANDO_LIST}},
+    {NT_DECLVAR_LIST, {NT_DECLVAR, TK_NL, NT_DECLVAR_LIST}},
+    {NT_DECLVAR_LIST, {}},
+    {NT_COMANDO_LIST, {NT_COMANDO, TK_NL, NT_COMANDO_LIST}},
+    {NT_COMANDO_LIST, {}},
+    {NT_COMANDO, {NT_CMDIF}},
+    {NT_COMANDO, {NT_CMDWHILE}},
+    {NT_COMANDO, {NT_CMDRETURN}},
+    {NT_COMANDO, {NT_CMDATRIB}},
+    {NT_CMDIF, {TK_IF, NT_EXP, TK_NL, NT_BLOQUE, NT_ELSE_IF_LIST, NT_OPT_ELSE, TK_END}},
+    {NT_ELSE_IF_LIST, {TK_ELSE, TK_IF, NT_EXP, TK_NL, NT_BLOQUE, NT_ELSE_IF_LIST}},
+    {NT_ELSE_IF_LIST, {}},
+    {NT_OPT_ELSE, {TK_ELSE, TK_NL, NT_BLOQUE}},
+    {NT_OPT_ELSE, {}},
+    {NT_CMDWHILE, {TK_WHILE, NT_EXP, TK_NL, NT_BLOQUE, TK_LOOP}},
+    {NT_CMDRETURN, {TK_RETURN, NT_OPT_EXP}},
+    {NT_OPT_EXP, {NT_EXP}},
+    {NT_OPT_EXP, {}},
+    {NT_CMDATRIB, {NT_VAR, TK_ASSIGN, NT_EXP}},
+    {NT_CMDATRIB, {NT_LLAMADA}},
+    {NT_LLAMADA, {TK_ID, TK_LPAREN, NT_LISTAEXP, TK_RPAREN}},
+    {NT_LISTAEXP, {NT_EXP, NT_LISTAEXP_TAIL}},
+    {NT_LISTAEXP, {}},
+    {NT_LISTAEXP_TAIL, {TK_COMMA, NT_EXP, NT_LISTAEXP_TAIL}},
+    {NT_LISTAEXP_TAIL, {}},
+    {NT_VAR, {TK_ID, NT_VAR_SUFIJO}},
+    {NT_VAR_SUFIJO, {TK_LBRACKET, NT_EXP, TK_RBRACKET, NT_VAR_SUFIJO}},
+    {NT_VAR_SUFIJO, {}},
+
+    {NT_EXP, {NT_EXP_OR}},
+    {NT_EXP_OR, {NT_EXP_AND, NT_EXP_OR_P}},
+    {NT_EXP_OR_P, {TK_OR, NT_EXP_AND, NT_EXP_OR_P}},
+    {NT_EXP_OR_P, {}},
+    {NT_EXP_AND, {NT_EXP_EQ, NT_EXP_AND_P}},
+    {NT_EXP_AND_P, {TK_AND, NT_EXP_EQ, NT_EXP_AND_P}},
+    {NT_EXP_AND_P, {}},
+    {NT_EXP_EQ, {NT_EXP_REL, NT_EXP_EQ_P}},
+    {NT_EXP_EQ_P, {TK_EQ, NT_EXP_REL, NT_EXP_EQ_P}},
+    {NT_EXP_EQ_P, {TK_NEQ, NT_EXP_REL, NT_EXP_EQ_P}},
+    {NT_EXP_EQ_P, {TK_ASSIGN, NT_EXP_REL, NT_EXP_EQ_P}},  // '=' compara
+    {NT_EXP_EQ_P, {}},
+    {NT_EXP_REL, {NT_EXP_ADD, NT_EXP_REL_P}},
+    {NT_EXP_REL_P, {TK_LT, NT_EXP_ADD, NT_EXP_REL_P}},
+    {NT_EXP_REL_P, {TK_LE, NT_EXP_ADD, NT_EXP_REL_P}},
+    {NT_EXP_REL_P, {TK_GT, NT_EXP_ADD, NT_EXP_REL_P}},
+    {NT_EXP_REL_P, {TK_GE, NT_EXP_ADD, NT_EXP_REL_P}},
+    {NT_EXP_REL_P, {}},
+    {NT_EXP_ADD, {NT_EXP_MUL, NT_EXP_ADD_P}},
+    {NT_EXP_ADD_P, {TK_PLUS, NT_EXP_MUL, NT_EXP_ADD_P}},
+    {NT_EXP_ADD_P, {TK_MINUS, NT_EXP_MUL, NT_EXP_ADD_P}},
+    {NT_EXP_ADD_P, {}},
+    {NT_EXP_MUL, {NT_EXP_UNARY, NT_EXP_MUL_P}},
+    {NT_EXP_MUL_P, {TK_MUL, NT_EXP_UNARY, NT_EXP_MUL_P}},
+    {NT_EXP_MUL_P, {TK_DIV, NT_EXP_UNARY, NT_EXP_MUL_P}},
+    {NT_EXP_MUL_P, {}},
+    {NT_EXP_UNARY, {TK_MINUS, NT_EXP_UNARY}},
+    {NT_EXP_UNARY, {TK_NOT, NT_EXP_UNARY}},
+    {NT_EXP_UNARY, {NT_EXP_PRIMARY}},
+    {NT_EXP_PRIMARY, {TK_LITNUM}},
+    {NT_EXP_PRIMARY, {TK_LITSTRING}},
+    {NT_EXP_PRIMARY, {TK_TRUE}},
+    {NT_EXP_PRIMARY, {TK_FALSE}},
+    {NT_EXP_PRIMARY, {TK_NEW, TK_LBRACKET, NT_EXP, TK_RBRACKET, NT_TIPO}},
+    {NT_EXP_PRIMARY, {TK_LPAREN, NT_EXP, TK_RPAREN}},
+    {NT_EXP_PRIMARY, {NT_LLAMADA}},
+    {NT_EXP_PRIMARY, {NT_VAR}},
+};
+
+constexpr int productionCount = sizeof(grammar) / sizeof(grammar[0]);
+
+// Sirve para cualquier gramatica con N no terminales cuyas reglas tengan
+// head, body y length (ll1.h usa la misma cuenta para la suya)
+template <int N>
+struct GrammarSets {
+    bool nullable[N];
+    TokenSet first[N];
+    TokenSet follow[N];
+};
+
+// FIRST de body[from..]; 'nullable' queda en si todo eso puede ser vacio
+template <int N, class Rule>
+constexpr TokenSet firstOfSequence(const GrammarSets<N>& g, const Rule& p, int from,
+                                   bool& nullable) {
+    TokenSet set;
+    for (int i = from; i < p.length; i++) {
+        int s = p.body[i];
+        if (s >= TK_ID) {
+            nullable = false;
+            return set.with(s);
+        }
+        if (s >= N)  // accion (ll1.h): no lee nada
+            continue;
+        set = set | g.first[s];
+        if (!g.nullable[s]) {
+            nullable = false;
+            return set;
+        }
+    }
+    nullable = true;
+    return set;
+}
+
+// punto fijo de siempre: primero anulables y FIRST, despues FOLLOW
+template <int N, class Rule, size_t P>
+constexpr GrammarSets<N> computeGrammarSets(const Rule (&rules)[P], int start) {
+    GrammarSets<N> g{};
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (const Rule& p : rules) {
+            bool nullable = false;
+            TokenSet first = g.first[p.head] | firstOfSequence(g, p, 0, nullable);
+            if (first != g.first[p.head] || (nullable && !g.nullable[p.head])) {
+                g.first[p.head] = first;
+                g.nullable[p.head] = g.nullable[p.head] || nullable;
+                changed = true;
+            }
+        }
+    }
+    g.follow[start] = TokenSet{TK_EOF};
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (const Rule& p : rules) {
+            for (int i = 0; i < p.length; i++) {
+                int s = p.body[i];
+                if (s >= N)  // terminal o accion
+                    continue;
+                bool restNullable = false;
+                TokenSet follow = g.follow[s] | firstOfSequence(g, p, i + 1, restNullable);
+                if (restNullable)
+                    follow = follow | g.follow[p.head];
+                if (follow != g.follow[s]) {
+                    g.follow[s] = follow;
+                    changed = true;
+                }
+            }
+        }
+    }
+    return g;
+}
+
+constexpr GrammarSets<NT_COUNT> grammarSets = computeGrammarSets<NT_COUNT>(grammar, NT_PROGRAMA);
+
+constexpr TokenSet firstSet(Nonterminal n) { return grammarSets.first[n]; }
+constexpr TokenSet followSet(Nonterminal n) { return grammarSets.follow[n]; }
+
+// Lo que el parser supone de la gramatica: si se cambia una produccion y
+// alguno deja de valer, hay que revisar el parser
+static_assert(firstSet(NT_DECL) == TokenSet{TK_FUN, TK_ID}, "FIRST(decl)");
+static_assert(firstSet(NT_TIPO) == TokenSet{TK_LBRACKET, TK_INT, TK_BOOL, TK_CHAR, TK_STRING},
+              "FIRST(tipo)");
+static_assert(firstSet(NT_COMANDO) == TokenSet{TK_IF, TK_WHILE, TK_RETURN, TK_ID},
+              "FIRST(comando)");
+static_assert(firstSet(NT_EXP) == TokenSet{TK_ID, TK_LITNUM, TK_LITSTRING, TK_TRUE, TK_FALSE,
+                                           TK_NEW, TK_LPAREN, TK_MINUS, TK_NOT},
+              "FIRST(exp)");
+static_assert(followSet(NT_BLOQUE) == TokenSet{TK_END, TK_ELSE, TK_LOOP}, "FOLLOW(bloque)");
+static_assert(followSet(NT_COMANDO) == TokenSet{TK_NL}, "FOLLOW(comando)");
+static_assert(followSet(NT_EXP) == TokenSet{TK_RPAREN, TK_RBRACKET, TK_COMMA, TK_NL},
+              "FOLLOW(exp)");
+static_assert(followSet(NT_PARAMETRO) == TokenSet{TK_COMMA, TK_RPAREN}, "FOLLOW(parametro)");
+static_assert(followSet(NT_DECLVAR) == TokenSet{TK_NL}, "FOLLOW(declvar)");
+
+#endif
@@ -0,0 +1,108 @@
+#include "intern.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+
+using namespace std;
+
+static const size_t initialSlots = 256;  // potencia de 2
+
+Interner::Interner() : slots(initialSlots), lookups(0), probes(0), maxProbe(0) {}
+
+// FNV-1a: los identificadores son cortos, no vale la pena algo mas pesado
+uint32_t Interner::hashOf(const char* text, size_t length) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        h ^= (unsigned char)text[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// casilla donde esta el nombre, o la vacia donde iria
+size_t Interner::locate(const char* text, size_t length, uint32_t hash, size_t& probe) const {
+    size_t mask = slots.size() - 1;
+    size_t i = hash & mask;
+    probe = 1;
+    while (slots[i].id != 0) {
+        if (slots[i].hash == hash) {
+            const Entry& e = entries[slots[i].id - 1];
+            if (e.length == length && memcmp(names.data() + e.offset, text, length) == 0)
+                return i;
+        }
+        i = (i + 1) & mask;
+        probe++;
+    }
+    return i;
+}
+
+Symbol Interner::intern(const char* text, size_t length) {
+    uint32_t hash = hashOf(text, length);
+    size_t probe;
+    size_t i = locate(text, length, hash, probe);
+    lookups++;
+    probes += probe;
+    maxProbe = max(maxProbe, probe);
+    if (slots[i].id != 0)
+        return slots[i].id - 1;
+
+    Symbol s = (Symbol)entries.size();
+    entries.push_back({(uint32_t)names.size(), (uint32_t)length, hash});
+    names.insert(names.end(), text, text + length);
+    slots[i] = {hash, s + 1};
+    // factor de carga maximo 1/2: los sondeos quedan cortos
+    if (entries.size() * 2 > slots.size())
+        grow();
+    return s;
+}
+
+Symbol Interner::find(const char* text, size_t length) const {
+    size_t probe;
+    size_t i = locate(text, length, hashOf(text, length), probe);
+    return slots[i].id != 0 ? slots[i].id - 1 : noSymbol;
+}
+
+// duplica la tabla; el hash guardado evita releer los nombres
+void Interner::grow() {
+    vector<Slot> old(slots.size() * 2);
+    old.swap(slots);
+    size_t mask = slots.size() - 1;
+    for (const Slot& slot : old) {
+        if (slot.id == 0)
+            continue;
+        size_t i = slot.hash & mask;
+        while (slots[i].id != 0)
+            i = (i + 1) & mask;
+        slots[i] = slot;
+    }
+}
+
+void Interner::clear() {
+    entries.clear();
+    names.clear();
+    fill(slots.begin(), slots.end(), Slot{0, 0});
+    lookups = 0;
+    probes = 0;
+    maxProbe = 0;
+}
+
+Interner::Stats Interner::stats() const {
+    Stats st;
+    st.symbols = entries.size();
+    st.slots = slots.size();
+    st.lookups = lookups;
+    st.probes = probes;
+    st.maxProbe = maxProbe;
+    st.bytes = entries.capacity() * sizeof(Entry) + names.capacity() +
+               slots.capacity() * sizeof(Slot);
+    return st;
+}
+
+void Interner::printStats(ostream& out) const {
+    Stats st = stats();
+    out << "Simbolos: " << st.symbols << " distintos, " << st.slots << " casillas, "
+        << st.lookups << " busquedas, sondeo medio " << fixed << setprecision(2)
+        << (st.lookups ? (double)st.probes / st.lookups : 0.0) << " (max "
+        << st.maxProbe << "), " << st.bytes << " bytes\n";
+}
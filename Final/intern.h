@@ -0,0 +1,69 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Cada identificador distinto recibe un numero denso (0, 1, 2, ... en orden
+// de aparicion). Las pasadas siguientes comparan simbolos, no strings.
+typedef uint32_t Symbol;
+const Symbol noSymbol = 0xFFFFFFFFu;
+
+// Tabla hash de direccionamiento abierto (sondeo lineal) sobre una zona de
+// texto propia: los nombres se copian una sola vez, al verlos por primera vez.
+// clear() conserva la memoria para el proximo archivo.
+class Interner {
+public:
+    struct Stats {
+        size_t symbols;    // identificadores distintos
+        size_t slots;      // tamano de la tabla
+        size_t lookups;    // llamadas a intern()
+        size_t probes;     // casillas miradas en total
+        size_t maxProbe;   // peor busqueda
+        size_t bytes;      // memoria reservada (tabla + nombres)
+    };
+
+    Interner();
+
+    Symbol intern(const char* text, size_t length);
+    Symbol find(const char* text, size_t length) const;  // noSymbol si no esta
+
+    size_t size() const { return entries.size(); }
+    const char* name(Symbol s) const { return names.data() + entries[s].offset; }
+    size_t length(Symbol s) const { return entries[s].length; }
+    string str(Symbol s) const { return string(name(s), length(s)); }
+
+    void clear();
+    Stats stats() const;
+    void printStats(ostream& out) const;
+
+private:
+    struct Entry {
+        uint32_t offset;  // en names
+        uint32_t length;
+        uint32_t hash;
+    };
+    // casilla vacia: id == 0; si no, id es Symbol + 1
+    struct Slot {
+        uint32_t hash;
+        uint32_t id;
+    };
+
+    vector<Entry> entries;
+    vector<char> names;
+    vector<Slot> slots;
+    size_t lookups;
+    size_t probes;
+    size_t maxProbe;
+
+    static uint32_t hashOf(const char* text, size_t length);
+    size_t locate(const char* text, size_t length, uint32_t hash, size_t& probe) const;
+    void grow();
+};
+
+#endif
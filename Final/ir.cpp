@@ -0,0 +1,381 @@
+#include "ir.h"
+
+#include <algorithm>
+
+using namespace std;
+
+const char* const irOpNames[I_COUNT] = {
+    "const", "str", "param", "phi", "add", "sub", "mul", "div", "lt", "le", "gt", "ge", "eq", "ne",
+    "neg", "not", "load_global", "store_global", "new", "check", "load", "store", "call", "jump",
+    "branch", "ret"};
+
+bool irPure(IrOp op) {
+    switch (op) {
+    case I_CONST:
+    case I_STR:
+    case I_PARAM:
+    case I_PHI:
+    case I_ADD:
+    case I_SUB:
+    case I_MUL:
+    case I_LT:
+    case I_LE:
+    case I_GT:
+    case I_GE:
+    case I_EQ:
+    case I_NE:
+    case I_NEG:
+    case I_NOT:
+    case I_LOAD_GLOBAL:
+    case I_LOAD:  // ya paso por su CHECK
+        return true;
+    default:
+        return false;
+    }
+}
+
+IrBlockId IrFunction::addBlock() {
+    IrBlock b;
+    b.succ[0] = b.succ[1] = noBlock;
+    b.succCount = 0;
+    blocks.push_back(move(b));
+    return (IrBlockId)blocks.size() - 1;
+}
+
+IrValue IrFunction::make(IrOp op, uint32_t line, int64_t imm, const IrValue* list, uint32_t count) {
+    IrInstr i;
+    i.op = op;
+    i.line = line;
+    i.imm = imm;
+    i.first = (uint32_t)operands.size();
+    i.count = count;
+    i.block = noBlock;
+    operands.insert(operands.end(), list, list + count);
+    instrs.push_back(i);
+    return (IrValue)instrs.size() - 1;
+}
+
+IrValue IrFunction::append(IrBlockId b, IrOp op, uint32_t line, int64_t imm, const IrValue* list,
+                           uint32_t count) {
+    IrValue v = make(op, line, imm, list, count);
+    instrs[v].block = b;
+    blocks[b].instrs.push_back(v);
+    return v;
+}
+
+void IrFunction::remove(IrValue v) {
+    IrBlockId b = instrs[v].block;
+    if (b == noBlock)
+        return;
+    vector<IrValue>& list = blocks[b].instrs;
+    list.erase(find(list.begin(), list.end(), v));
+    instrs[v].block = noBlock;
+}
+
+void IrFunction::jump(IrBlockId from, IrBlockId to, uint32_t line) {
+    append(from, I_JUMP, line, 0);
+    blocks[from].succ[0] = to;
+    blocks[from].succCount = 1;
+    blocks[to].preds.push_back(from);
+}
+
+void IrFunction::branch(IrBlockId from, IrValue cond, IrBlockId yes, IrBlockId no, uint32_t line) {
+    append(from, I_BRANCH, line, 0, &cond, 1);
+    blocks[from].succ[0] = yes;
+    blocks[from].succ[1] = no;
+    blocks[from].succCount = 2;
+    blocks[yes].preds.push_back(from);
+    blocks[no].preds.push_back(from);
+}
+
+bool IrFunction::terminated(IrBlockId b) const {
+    const vector<IrValue>& list = blocks[b].instrs;
+    return !list.empty() && irTerminator(instrs[list.back()].op);
+}
+
+size_t IrFunction::liveInstrs() const {
+    size_t n = 0;
+    for (const IrBlock& b : blocks)
+        n += b.instrs.size();
+    return n;
+}
+
+vector<IrBlockId> irReversePostorder(const IrFunction& f) {
+    vector<IrBlockId> order;
+    if (f.blocks.empty())
+        return order;
+    // DFS con pila explicita: (bloque, proximo sucesor a mirar)
+    vector<uint8_t> seen(f.blocks.size(), 0);
+    vector<pair<IrBlockId, uint8_t>> stack;
+    stack.push_back({0, 0});
+    seen[0] = 1;
+    while (!stack.empty()) {
+        IrBlockId b = stack.back().first;
+        uint8_t& next = stack.back().second;
+        if (next < f.blocks[b].succCount) {
+            IrBlockId s = f.blocks[b].succ[next++];
+            if (!seen[s]) {
+                seen[s] = 1;
+                stack.push_back({s, 0});
+            }
+        } else {
+            order.push_back(b);
+            stack.pop_back();
+        }
+    }
+    reverse(order.begin(), order.end());
+    return order;
+}
+
+vector<IrBlockId> irDominators(const IrFunction& f) {
+    vector<IrBlockId> idom(f.blocks.size(), noBlock);
+    vector<IrBlockId> order = irReversePostorder(f);
+    if (order.empty())
+        return idom;
+    vector<uint32_t> rank(f.blocks.size(), 0);
+    for (uint32_t k = 0; k < order.size(); k++)
+        rank[order[k]] = k;
+    idom[0] = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t k = 1; k < order.size(); k++) {
+            IrBlockId b = order[k];
+            IrBlockId best = noBlock;
+            for (IrBlockId p : f.blocks[b].preds) {
+                if (idom[p] == noBlock)
+                    continue;
+                if (best == noBlock) {
+                    best = p;
+                    continue;
+                }
+                // interseccion: subir por los dominadores hasta encontrarse
+                IrBlockId x = p, y = best;
+                while (x != y) {
+                    while (rank[x] > rank[y])
+                        x = idom[x];
+                    while (rank[y] > rank[x])
+                        y = idom[y];
+                }
+                best = x;
+            }
+            if (idom[b] != best) {
+                idom[b] = best;
+                changed = true;
+            }
+        }
+    }
+    return idom;
+}
+
+bool irDominates(const vector<IrBlockId>& idom, IrBlockId a, IrBlockId b) {
+    if (idom[b] == noBlock)
+        return false;
+    while (b != a) {
+        if (b == 0)
+            return false;
+        b = idom[b];
+    }
+    return true;
+}
+
+void IrModule::clear() {
+    functions.clear();
+    strings.clear();
+    globalNames.clear();
+    mainFunction = -1;
+}
+
+void IrModule::dump(ostream& out) const {
+    for (size_t g = 0; g < globalNames.size(); g++)
+        out << "global @" << globalNames[g] << "\n";
+    for (const IrFunction& f : functions) {
+        out << "\n";
+        dump(f, out);
+    }
+}
+
+static void printString(ostream& out, const string& s) {
+    out << '"';
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\')
+            out << '\\' << (char)c;
+        else if (c == '\n')
+            out << "\\n";
+        else if (c == '\t')
+            out << "\\t";
+        else if (c < 32 || c > 126)
+            out << "\\x" << "0123456789abcdef"[c >> 4] << "0123456789abcdef"[c & 15];
+        else
+            out << (char)c;
+    }
+    out << '"';
+}
+
+void IrModule::dump(const IrFunction& f, ostream& out) const {
+    // numeros nuevos para bloques (los vacios ya no estan) y valores; solo
+    // llevan numero las instrucciones que dejan un valor
+    auto defines = [&](const IrInstr& i) {
+        if (i.op == I_CALL)
+            return functions[(size_t)i.imm].returnsValue;
+        return !irTerminator(i.op) && i.op != I_STORE_GLOBAL && i.op != I_CHECK && i.op != I_STORE;
+    };
+    vector<uint32_t> blockName(f.blocks.size(), 0), valueName(f.instrs.size(), 0);
+    uint32_t blocks = 0, values = 0;
+    for (size_t b = 0; b < f.blocks.size(); b++) {
+        if (f.blocks[b].instrs.empty())
+            continue;
+        blockName[b] = blocks++;
+        for (IrValue v : f.blocks[b].instrs)
+            if (defines(f.instrs[v]))
+                valueName[v] = values++;
+    }
+    auto value = [&](IrValue v) {
+        return f.instrs[v].block == noBlock ? string("%?") : "%" + to_string(valueName[v]);
+    };
+    auto block = [&](IrBlockId b) { return "b" + to_string(blockName[b]); };
+
+    out << "fun @" << f.name << "(" << f.params << ")" << (f.returnsValue ? " : valor" : "")
+        << "\n";
+    for (size_t b = 0; b < f.blocks.size(); b++) {
+        const IrBlock& bl = f.blocks[b];
+        if (bl.instrs.empty())
+            continue;
+        out << block((IrBlockId)b) << ":";
+        for (size_t k = 0; k < bl.preds.size(); k++)
+            out << (k ? ", " : "  ; preds ") << block(bl.preds[k]);
+        out << "\n";
+        for (IrValue v : bl.instrs) {
+            const IrInstr& i = f.instrs[v];
+            const IrValue* a = f.args(v);
+            out << "    ";
+            if (defines(i))
+                out << value(v) << " = ";
+            out << irOpNames[i.op];
+            switch (i.op) {
+            case I_CONST:
+            case I_PARAM:
+                out << " " << i.imm;
+                break;
+            case I_STR:
+                out << " ";
+                printString(out, strings[(size_t)i.imm]);
+                break;
+            case I_PHI:
+                for (uint32_t k = 0; k < i.count; k++)
+                    out << (k ? ", [" : " [") << value(a[k]) << ", " << block(bl.preds[k]) << "]";
+                break;
+            case I_LOAD_GLOBAL:
+                out << " @" << globalNames[(size_t)i.imm];
+                break;
+            case I_STORE_GLOBAL:
+                out << " @" << globalNames[(size_t)i.imm] << ", " << value(a[0]);
+                break;
+            case I_CALL:
+                out << " @" << functions[(size_t)i.imm].name << "(";
+                for (uint32_t k = 0; k < i.count; k++)
+                    out << (k ? ", " : "") << value(a[k]);
+                out << ")";
+                break;
+            case I_JUMP:
+                out << " " << block(bl.succ[0]);
+                break;
+            case I_BRANCH:
+                out << " " << value(a[0]) << ", " << block(bl.succ[0]) << ", " << block(bl.succ[1]);
+                break;
+            default:
+                for (uint32_t k = 0; k < i.count; k++)
+                    out << (k ? ", " : " ") << value(a[k]);
+                break;
+            }
+            out << "\n";
+        }
+    }
+}
+
+bool IrModule::verify(ostream& err) const {
+    bool ok = true;
+    for (const IrFunction& f : functions)
+        if (!verify(f, err))
+            ok = false;
+    return ok;
+}
+
+bool IrModule::verify(const IrFunction& f, ostream& err) const {
+    size_t problems = 0;
+    auto fail = [&](const string& message) {
+        if (problems++ < 10)
+            err << "IR invalido en '" << f.name << "': " << message << endl;
+    };
+    vector<IrBlockId> idom = irDominators(f);
+    vector<uint32_t> position(f.instrs.size(), 0);
+    for (IrBlockId b = 0; b < f.blocks.size(); b++) {
+        const IrBlock& bl = f.blocks[b];
+        for (uint32_t k = 0; k < bl.instrs.size(); k++) {
+            IrValue v = bl.instrs[k];
+            position[v] = k;
+            if (f.instrs[v].block != b)
+                fail("%" + to_string(v) + " dice estar en otro bloque que b" + to_string(b));
+        }
+    }
+
+    for (IrBlockId b = 0; b < f.blocks.size(); b++) {
+        const IrBlock& bl = f.blocks[b];
+        string where = "b" + to_string(b);
+        if (bl.instrs.empty()) {
+            if (!bl.preds.empty())
+                fail(where + " esta vacio pero tiene predecesores");
+            continue;
+        }
+        if (!f.terminated(b))
+            fail(where + " no termina en un salto o return");
+        // cada arista aparece una vez en preds del sucesor por cada vez que esta en succ
+        for (uint8_t k = 0; k < bl.succCount; k++) {
+            const vector<IrBlockId>& p = f.blocks[bl.succ[k]].preds;
+            size_t edges = (size_t)count(bl.succ, bl.succ + bl.succCount, bl.succ[k]);
+            if ((size_t)count(p.begin(), p.end(), b) != edges)
+                fail(where + " salta a b" + to_string(bl.succ[k]) + " pero no figura en sus predecesores");
+        }
+        for (IrBlockId p : bl.preds) {
+            const IrBlock& pb = f.blocks[p];
+            if (find(pb.succ, pb.succ + pb.succCount, b) == pb.succ + pb.succCount)
+                fail(where + " tiene de predecesor a b" + to_string(p) + ", que no salta ahi");
+        }
+
+        bool phis = true;
+        for (uint32_t k = 0; k < bl.instrs.size(); k++) {
+            IrValue v = bl.instrs[k];
+            const IrInstr& i = f.instrs[v];
+            string what = "%" + to_string(v) + " (" + irOpNames[i.op] + ", " + where + ")";
+            if (irTerminator(i.op) && k + 1 != bl.instrs.size())
+                fail(what + " es un terminador en el medio del bloque");
+            if (i.op == I_PHI) {
+                if (!phis)
+                    fail(what + " esta despues de una instruccion comun");
+                if (i.count != bl.preds.size())
+                    fail(what + " tiene " + to_string(i.count) + " operandos y el bloque " +
+                         to_string(bl.preds.size()) + " predecesores");
+            } else {
+                phis = false;
+            }
+            if (idom[b] == noBlock)
+                continue;  // codigo muerto: no se mira la dominancia
+            for (uint32_t a = 0; a < i.count; a++) {
+                IrValue op = f.arg(v, a);
+                if (op >= f.instrs.size() || f.instrs[op].block == noBlock) {
+                    fail(what + " usa un valor que no esta en el programa");
+                    continue;
+                }
+                IrBlockId def = f.instrs[op].block;
+                if (i.op == I_PHI) {
+                    if (a < bl.preds.size() && idom[bl.preds[a]] != noBlock &&
+                        !irDominates(idom, def, bl.preds[a]))
+                        fail(what + " recibe %" + to_string(op) + " de un bloque que no domina");
+                } else if (def == b ? position[op] >= k : !irDominates(idom, def, b)) {
+                    fail(what + " usa %" + to_string(op) + " antes de que se defina");
+                }
+            }
+        }
+    }
+    return problems == 0;
+}
@@ -0,0 +1,135 @@
+#ifndef IR_H
+#define IR_H
+
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "bytecode.h"
+
+using namespace std;
+
+// Representacion intermedia en SSA. Cada funcion es un grafo de bloques
+// basicos; cada instruccion define a lo sumo un valor y el valor se nombra
+// con el indice de la instruccion (IrValue). Las variables locales y los
+// parametros de Mini-0 no existen como tales: cada asignacion es un valor
+// nuevo y donde se juntan caminos hay un phi. Los globales y los elementos
+// de arreglos quedan en memoria (LOAD_GLOBAL/STORE_GLOBAL, LOAD/STORE).
+//
+// El acceso a un arreglo se parte en CHECK (arreglo creado e indice en
+// rango, si no error de ejecucion) y LOAD/STORE sin chequeo, asi un pase
+// puede sacar los chequeos que sabe innecesarios.
+
+typedef uint32_t IrValue;
+typedef uint32_t IrBlockId;
+const IrValue noValue = 0xFFFFFFFFu;
+const IrBlockId noBlock = 0xFFFFFFFFu;
+
+enum IrOp : uint8_t {
+    I_CONST,         // imm
+    I_STR,           // imm = indice en IrModule::strings
+    I_PARAM,         // imm = numero de parametro
+    I_PHI,           // un operando por predecesor, en el orden de IrBlock::preds
+    I_ADD,           // a op b
+    I_SUB,
+    I_MUL,
+    I_DIV,           // error si b == 0
+    I_LT,
+    I_LE,
+    I_GT,
+    I_GE,
+    I_EQ,
+    I_NE,
+    I_NEG,           // -a
+    I_NOT,           // not a
+    I_LOAD_GLOBAL,   // imm = global
+    I_STORE_GLOBAL,  // global imm = a
+    I_NEW,           // new [a]
+    I_CHECK,         // a[b] se puede leer o escribir
+    I_LOAD,          // a[b]
+    I_STORE,         // a[b] = c
+    I_CALL,          // funcion imm con los operandos como argumentos
+    I_JUMP,          // terminadores: ir a succ[0]
+    I_BRANCH,        // si a != 0 ir a succ[0], si no a succ[1]
+    I_RETURN,        // devuelve a (sin operandos: funcion sin tipo)
+    I_COUNT
+};
+
+extern const char* const irOpNames[I_COUNT];
+
+inline bool irTerminator(IrOp op) { return op >= I_JUMP; }
+// sin efectos y sin errores: se puede borrar si nadie usa el valor
+bool irPure(IrOp op);
+
+struct IrInstr {
+    IrOp op;
+    uint32_t line;   // para los errores de ejecucion
+    int64_t imm;
+    uint32_t first;  // operandos: IrFunction::operands[first .. first + count)
+    uint32_t count;
+    IrBlockId block;  // noBlock: se saco del programa
+};
+
+struct IrBlock {
+    vector<IrValue> instrs;  // phis primero, el terminador al final
+    vector<IrBlockId> preds;
+    IrBlockId succ[2];
+    uint8_t succCount;
+};
+
+struct IrFunction {
+    string name;
+    uint32_t params = 0;
+    bool returnsValue = false;
+    vector<IrInstr> instrs;    // todas las que se crearon, en uso o no
+    vector<IrValue> operands;
+    vector<IrBlock> blocks;    // 0 es la entrada
+
+    IrValue* args(IrValue v) { return operands.data() + instrs[v].first; }
+    const IrValue* args(IrValue v) const { return operands.data() + instrs[v].first; }
+    IrValue arg(IrValue v, uint32_t k) const { return operands[instrs[v].first + k]; }
+
+    IrBlockId addBlock();
+    // crea la instruccion sin ubicarla en un bloque
+    IrValue make(IrOp op, uint32_t line, int64_t imm, const IrValue* args, uint32_t count);
+    IrValue append(IrBlockId b, IrOp op, uint32_t line, int64_t imm,
+                   const IrValue* args = nullptr, uint32_t count = 0);
+    void remove(IrValue v);  // la saca de su bloque
+    void jump(IrBlockId from, IrBlockId to, uint32_t line);
+    void branch(IrBlockId from, IrValue cond, IrBlockId yes, IrBlockId no, uint32_t line);
+    bool terminated(IrBlockId b) const;
+
+    size_t liveInstrs() const;  // las que estan en algun bloque
+};
+
+// Orden inverso de postorden desde la entrada; solo bloques alcanzables
+vector<IrBlockId> irReversePostorder(const IrFunction& f);
+// Dominador inmediato de cada bloque (Cooper, Harvey y Kennedy): la entrada
+// es su propio dominador y los bloques que no se alcanzan quedan en noBlock
+vector<IrBlockId> irDominators(const IrFunction& f);
+bool irDominates(const vector<IrBlockId>& idom, IrBlockId a, IrBlockId b);
+
+struct IrModule {
+    vector<IrFunction> functions;  // mismo orden que Ast::funcs
+    deque<string> strings;         // literales sin repetir (== compara punteros)
+    vector<string> globalNames;
+    int32_t mainFunction = -1;
+
+    IrModule() = default;
+    IrModule(const IrModule&) = delete;
+    IrModule& operator=(const IrModule&) = delete;
+
+    void clear();
+    // Texto estable para comparar contra una salida guardada: bloques y
+    // valores se numeran de nuevo en orden (b0, b1, ...; %0, %1, ...), asi lo
+    // que quedo de pases anteriores no cambia los nombres.
+    void dump(ostream& out) const;
+    void dump(const IrFunction& f, ostream& out) const;
+    // chequeos de forma: terminadores, phis y predecesores, operandos definidos
+    // en un bloque que domina el uso. Escribe lo que encuentra en err.
+    bool verify(ostream& err) const;
+    bool verify(const IrFunction& f, ostream& err) const;
+};
+
+#endif
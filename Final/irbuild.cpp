@@ -0,0 +1,355 @@
+#include "irbuild.h"
+#include "passes.h"
+
+using namespace std;
+
+IrBuilder::IrBuilder()
+    : tree(nullptr), names(nullptr), module(nullptr), fn(nullptr), err(&cerr), errors(0), cur(0),
+      zero(noValue) {}
+
+void IrBuilder::setOutput(ostream& errStream) {
+    err = &errStream;
+}
+
+void IrBuilder::error(uint32_t line, const string& message) {
+    errors++;
+    *err << "Error de compilacion en linea " << line << ": " << message << endl;
+}
+
+bool IrBuilder::build(const Ast& ast, const SemanticAnalyzer& resolved, IrModule& out) {
+    tree = &ast;
+    names = &resolved;
+    module = &out;
+    errors = 0;
+    out.clear();
+    literals.clear();
+    globalIndex.assign(ast.vars.size(), -1);
+    for (size_t g = 0; g < ast.globals.size(); g++) {
+        globalIndex[ast.globals[g]] = (int32_t)g;
+        out.globalNames.push_back(ast.str(ast.vars[ast.globals[g]].name));
+    }
+    Symbol mainName = ast.symbols.find("main", 4);
+    out.functions.resize(ast.funcs.size());
+    for (size_t i = 0; i < ast.funcs.size(); i++) {
+        if (ast.funcs[i].name == mainName)
+            out.mainFunction = (int32_t)i;
+        function(ast.funcs[i], out.functions[i]);
+    }
+    return errors == 0;
+}
+
+void IrBuilder::function(const Func& f, IrFunction& out) {
+    fn = &out;
+    out.name = tree->str(f.name);
+    out.params = f.params.count;
+    out.returnsValue = f.ret != TY_VOID;
+    defs.clear();
+    sealed.clear();
+    incomplete.clear();
+
+    cur = newBlock();
+    seal(cur);
+    zero = emit(I_CONST, f.line, 0);
+    uint32_t k = 0;
+    for (const NodeId* p = tree->begin(f.params); p != tree->end(f.params); p++, k++)
+        write(*p, cur, emit(I_PARAM, f.line, k));
+    block(f.body, true);
+
+    // se llego al final sin return: una funcion con tipo devuelve 0
+    if (!fn->terminated(cur)) {
+        if (out.returnsValue)
+            emit(I_RETURN, f.line, 0, &zero, 1);
+        else
+            emit(I_RETURN, f.line);
+    }
+    simplifyPhis(out);
+}
+
+// las variables de un bloque empiezan en 0 cada vez que se entra
+void IrBuilder::block(NodeId id, bool nested) {
+    if (id == noNode)
+        return;
+    const Block& b = tree->blocks[id];
+    if (nested)
+        for (const NodeId* v = tree->begin(b.vars); v != tree->end(b.vars); v++)
+            write(*v, cur, zero);
+    for (const NodeId* s = tree->begin(b.stmts); s != tree->end(b.stmts); s++)
+        stmt(*s);
+}
+
+void IrBuilder::stmt(NodeId id) {
+    const Stmt& s = tree->stmts[id];
+    // despues de un return: bloque sin predecesores (lo borra un pase)
+    if (fn->terminated(cur)) {
+        cur = newBlock();
+        seal(cur);
+    }
+    switch (s.kind) {
+    case StmtKind::Assign: {
+        const Expr& target = tree->exprs[s.target];
+        if (target.kind == ExprKind::Index) {
+            IrValue args[3];
+            args[0] = expr(target.lhs);
+            args[1] = expr(target.rhs);
+            args[2] = expr(s.value);
+            emit(I_CHECK, target.line, 0, args, 2);
+            emit(I_STORE, target.line, 0, args, 3);
+            break;
+        }
+        IrValue v = expr(s.value);
+        NodeId var = names->declOf(s.target);
+        if (globalIndex[var] >= 0)
+            emit(I_STORE_GLOBAL, s.line, globalIndex[var], &v, 1);
+        else
+            write(var, cur, v);
+        break;
+    }
+    case StmtKind::Call:
+        expr(s.value);
+        break;
+    case StmtKind::If: {
+        IrBlockId then = newBlock(), join = newBlock();
+        IrBlockId other = s.orelse != noNode ? newBlock() : join;
+        cond(s.value, then, other);
+        seal(then);
+        cur = then;
+        block(s.body, true);
+        if (!fn->terminated(cur))
+            fn->jump(cur, join, s.line);
+        if (s.orelse != noNode) {
+            seal(other);
+            cur = other;
+            block(s.orelse, true);
+            if (!fn->terminated(cur))
+                fn->jump(cur, join, s.line);
+        }
+        seal(join);
+        cur = join;
+        break;
+    }
+    case StmtKind::While: {
+        // el encabezado se sella cuando se sabe de donde vuelve el cuerpo
+        IrBlockId header = newBlock(), body = newBlock(), exit = newBlock();
+        fn->jump(cur, header, s.line);
+        cur = header;
+        cond(s.value, body, exit);
+        seal(body);
+        seal(exit);
+        cur = body;
+        block(s.body, true);
+        if (!fn->terminated(cur))
+            fn->jump(cur, header, s.line);
+        seal(header);
+        cur = exit;
+        break;
+    }
+    case StmtKind::Return:
+        if (s.value != noNode) {
+            IrValue v = expr(s.value);
+            emit(I_RETURN, s.line, 0, &v, 1);
+        } else {
+            emit(I_RETURN, s.line);
+        }
+        break;
+    }
+}
+
+IrValue IrBuilder::expr(NodeId id) {
+    const Expr& e = tree->exprs[id];
+    switch (e.kind) {
+    case ExprKind::Num: {
+        Value v = 0;
+        if (!parseNumber(tree->text() + e.text.offset, e.text.length, v))
+            error(e.line, "el numero " + tree->str(e.text) + " no entra en un int");
+        return emit(I_CONST, e.line, v);
+    }
+    case ExprKind::Str: {
+        string text = unescapeLiteral(tree->text() + e.text.offset, e.text.length);
+        auto it = literals.find(text);
+        if (it == literals.end()) {
+            it = literals.emplace(text, (uint32_t)module->strings.size()).first;
+            module->strings.push_back(text);
+        }
+        return emit(I_STR, e.line, it->second);
+    }
+    case ExprKind::True:
+        return emit(I_CONST, e.line, 1);
+    case ExprKind::False:
+        return emit(I_CONST, e.line, 0);
+    case ExprKind::Var: {
+        NodeId var = names->declOf(id);
+        if (globalIndex[var] >= 0)
+            return emit(I_LOAD_GLOBAL, e.line, globalIndex[var]);
+        return read(var, cur);
+    }
+    case ExprKind::Index: {
+        IrValue args[2];
+        args[0] = expr(e.lhs);
+        args[1] = expr(e.rhs);
+        emit(I_CHECK, e.line, 0, args, 2);
+        return emit(I_LOAD, e.line, 0, args, 2);
+    }
+    case ExprKind::Call: {
+        vector<IrValue> args;
+        args.reserve(e.args.count);
+        for (const NodeId* a = tree->begin(e.args); a != tree->end(e.args); a++)
+            args.push_back(expr(*a));
+        return emit(I_CALL, e.line, names->declOf(id), args.data(), (uint32_t)args.size());
+    }
+    case ExprKind::New: {
+        IrValue n = expr(e.rhs);
+        return emit(I_NEW, e.line, 0, &n, 1);
+    }
+    case ExprKind::Unary: {
+        IrValue a = expr(e.lhs);
+        return emit(e.opToken() == TK_NOT ? I_NOT : I_NEG, e.line, 0, &a, 1);
+    }
+    case ExprKind::Binary:
+        break;
+    }
+
+    int op = e.opToken();
+    if (op == TK_AND || op == TK_OR) {
+        // cortocircuito: si decide el izquierdo, el valor es el izquierdo
+        IrValue left = expr(e.lhs);
+        IrBlockId from = cur, right = newBlock(), join = newBlock();
+        if (op == TK_AND)
+            fn->branch(cur, left, right, join, e.line);
+        else
+            fn->branch(cur, left, join, right, e.line);
+        seal(right);
+        cur = right;
+        IrValue value = expr(e.rhs);
+        fn->jump(cur, join, e.line);
+        seal(join);
+        cur = join;
+        IrValue phi = newPhi(join, e.line);
+        const vector<IrBlockId>& preds = fn->blocks[join].preds;
+        IrValue args[2];
+        for (size_t k = 0; k < 2; k++)
+            args[k] = preds[k] == from ? left : value;
+        fn->instrs[phi].first = (uint32_t)fn->operands.size();
+        fn->instrs[phi].count = 2;
+        fn->operands.insert(fn->operands.end(), args, args + 2);
+        return phi;
+    }
+
+    IrValue args[2];
+    args[0] = expr(e.lhs);
+    args[1] = expr(e.rhs);
+    IrOp irop = I_ADD;
+    switch (op) {
+    case TK_PLUS: irop = I_ADD; break;
+    case TK_MINUS: irop = I_SUB; break;
+    case TK_MUL: irop = I_MUL; break;
+    case TK_DIV: irop = I_DIV; break;
+    case TK_LT: irop = I_LT; break;
+    case TK_LE: irop = I_LE; break;
+    case TK_GT: irop = I_GT; break;
+    case TK_GE: irop = I_GE; break;
+    case TK_EQ: irop = I_EQ; break;
+    case TK_NEQ: irop = I_NE; break;
+    }
+    return emit(irop, e.line, 0, args, 2);
+}
+
+// salta a yes o a no segun la condicion; and/or son saltos, no valores
+void IrBuilder::cond(NodeId id, IrBlockId yes, IrBlockId no) {
+    const Expr& e = tree->exprs[id];
+    if (e.kind == ExprKind::Unary && e.opToken() == TK_NOT) {
+        cond(e.lhs, no, yes);
+        return;
+    }
+    if (e.kind == ExprKind::True || e.kind == ExprKind::False) {
+        fn->jump(cur, e.kind == ExprKind::True ? yes : no, e.line);
+        return;
+    }
+    int op = e.kind == ExprKind::Binary ? e.opToken() : 0;
+    if (op == TK_AND || op == TK_OR) {
+        IrBlockId mid = newBlock();
+        if (op == TK_AND)
+            cond(e.lhs, mid, no);
+        else
+            cond(e.lhs, yes, mid);
+        seal(mid);
+        cur = mid;
+        cond(e.rhs, yes, no);
+        return;
+    }
+    fn->branch(cur, expr(id), yes, no, e.line);
+}
+
+IrBlockId IrBuilder::newBlock() {
+    sealed.push_back(0);
+    incomplete.emplace_back();
+    return fn->addBlock();
+}
+
+void IrBuilder::seal(IrBlockId b) {
+    for (const pair<NodeId, IrValue>& p : incomplete[b])
+        addPhiOperands(p.first, p.second);
+    incomplete[b].clear();
+    sealed[b] = 1;
+}
+
+void IrBuilder::write(NodeId var, IrBlockId b, IrValue v) {
+    defs[(uint64_t)b << 32 | var] = v;
+}
+
+IrValue IrBuilder::read(NodeId var, IrBlockId b) {
+    auto it = defs.find((uint64_t)b << 32 | var);
+    if (it != defs.end())
+        return it->second;
+    return readRecursive(var, b);
+}
+
+IrValue IrBuilder::readRecursive(NodeId var, IrBlockId b) {
+    const vector<IrBlockId>& preds = fn->blocks[b].preds;
+    IrValue v;
+    if (!sealed[b]) {
+        v = newPhi(b, tree->vars[var].line);
+        incomplete[b].push_back({var, v});
+    } else if (preds.size() == 1) {
+        v = read(var, preds[0]);
+    } else if (preds.empty()) {
+        // codigo al que no se llega: cualquier valor sirve
+        v = fn->make(I_CONST, tree->vars[var].line, 0, nullptr, 0);
+        vector<IrValue>& list = fn->blocks[b].instrs;
+        size_t at = 0;
+        while (at < list.size() && fn->instrs[list[at]].op == I_PHI)
+            at++;
+        list.insert(list.begin() + at, v);
+        fn->instrs[v].block = b;
+    } else {
+        // el phi se anota antes de mirar los predecesores: corta los ciclos
+        v = newPhi(b, tree->vars[var].line);
+        write(var, b, v);
+        addPhiOperands(var, v);
+    }
+    write(var, b, v);
+    return v;
+}
+
+IrValue IrBuilder::newPhi(IrBlockId b, uint32_t line) {
+    IrValue v = fn->make(I_PHI, line, 0, nullptr, 0);
+    vector<IrValue>& list = fn->blocks[b].instrs;
+    list.insert(list.begin(), v);
+    fn->instrs[v].block = b;
+    return v;
+}
+
+void IrBuilder::addPhiOperands(NodeId var, IrValue phi) {
+    IrBlockId b = fn->instrs[phi].block;
+    vector<IrValue> args;
+    args.reserve(fn->blocks[b].preds.size());
+    for (IrBlockId p : fn->blocks[b].preds)
+        args.push_back(read(var, p));
+    // los operandos van al final de la zona: read puede haber agregado otros
+    fn->instrs[phi].first = (uint32_t)fn->operands.size();
+    fn->instrs[phi].count = (uint32_t)args.size();
+    fn->operands.insert(fn->operands.end(), args.begin(), args.end());
+}
+
+IrValue IrBuilder::emit(IrOp op, uint32_t line, int64_t imm, const IrValue* args, uint32_t count) {
+    return fn->append(cur, op, line, imm, args, count);
+}
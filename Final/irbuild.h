@@ -0,0 +1,64 @@
+#ifndef IRBUILD_H
+#define IRBUILD_H
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ast.h"
+#include "ir.h"
+#include "semantic.h"
+
+using namespace std;
+
+// Construye el SSA directo desde el AST ya chequeado, sin pasar por una
+// forma con variables en memoria (Braun, Buchwald y otros, "Simple and
+// Efficient Construction of Static Single Assignment Form"): cada bloque
+// recuerda el ultimo valor de cada variable; si una variable se lee en un
+// bloque que no la definio se busca en los predecesores, y donde hay varios
+// se pone un phi. Un bloque se "sella" cuando ya se conocen todos sus
+// predecesores (el encabezado de un while, al terminar el cuerpo); hasta
+// entonces sus phis quedan incompletos. Al final se sacan los phis triviales
+// (todos los operandos iguales).
+class IrBuilder {
+public:
+    IrBuilder();
+
+    void setOutput(ostream& err);
+    bool build(const Ast& tree, const SemanticAnalyzer& names, IrModule& module);
+
+private:
+    const Ast* tree;
+    const SemanticAnalyzer* names;
+    IrModule* module;
+    IrFunction* fn;
+    ostream* err;
+    size_t errors;
+    IrBlockId cur;                                      // bloque donde se agrega
+    IrValue zero;                                       // const 0 de la entrada
+    vector<int32_t> globalIndex;                        // por VarDecl, -1 si es local
+    unordered_map<uint64_t, IrValue> defs;              // (bloque, VarDecl) -> valor
+    vector<uint8_t> sealed;                             // por bloque
+    vector<vector<pair<NodeId, IrValue>>> incomplete;   // por bloque: phis sin operandos
+    unordered_map<string, uint32_t> literals;
+
+    void function(const Func& f, IrFunction& out);
+    void block(NodeId id, bool nested);
+    void stmt(NodeId id);
+    IrValue expr(NodeId id);
+    void cond(NodeId id, IrBlockId yes, IrBlockId no);
+
+    IrBlockId newBlock();
+    void seal(IrBlockId b);
+    void write(NodeId var, IrBlockId b, IrValue v);
+    IrValue read(NodeId var, IrBlockId b);
+    IrValue readRecursive(NodeId var, IrBlockId b);
+    IrValue newPhi(IrBlockId b, uint32_t line);
+    void addPhiOperands(NodeId var, IrValue phi);
+    IrValue emit(IrOp op, uint32_t line, int64_t imm = 0, const IrValue* args = nullptr,
+                 uint32_t count = 0);
+    void error(uint32_t line, const string& message);
+};
+
+#endif
@@ -0,0 +1,289 @@
+#include "irinterp.h"
+
+#include <cstdlib>
+
+using namespace std;
+
+IrInterpreter::IrInterpreter() : slots(slotCount), err(&cerr), steps(0), checks(0) {}
+
+IrInterpreter::~IrInterpreter() {
+    freeHeap();
+}
+
+void IrInterpreter::setOutput(ostream& errStream) {
+    err = &errStream;
+}
+
+Value* IrInterpreter::newArray(Value length) {
+    Value* a = (Value*)calloc((size_t)length + 1, sizeof(Value));
+    if (a) {
+        a[0] = length;
+        heap.push_back(a);
+    }
+    return a;
+}
+
+void IrInterpreter::freeHeap() {
+    for (Value* a : heap)
+        free(a);
+    heap.clear();
+}
+
+void IrInterpreter::fail(const Code* code, const Step* ip, const string& message) {
+    *err << "Error de ejecucion en linea " << ip->line << " ('" << code->fn->name
+         << "'): " << message << endl;
+}
+
+// Los bloques se ponen en orden inverso de postorden (los que no se alcanzan
+// no se copian). Los phis y los PARAM no son pasos: los phis se hacen en las
+// aristas y los parametros los escribe la llamada.
+void IrInterpreter::translate(const IrModule& module, const IrFunction& f, Code& code) {
+    code.fn = &f;
+    code.steps.clear();
+    code.args.clear();
+    code.edges.clear();
+    code.moves.clear();
+    code.paramSlots.assign(f.params, noValue);
+
+    vector<uint32_t> slot(f.instrs.size(), noValue);
+    uint32_t next = 0;
+    for (const IrBlock& b : f.blocks)
+        for (IrValue v : b.instrs)
+            slot[v] = next++;
+    code.frameSize = next;
+
+    vector<IrBlockId> order = irReversePostorder(f);
+    vector<uint32_t> start(f.blocks.size(), 0);
+    uint32_t at = 0;
+    for (IrBlockId b : order) {
+        start[b] = at;
+        for (IrValue v : f.blocks[b].instrs)
+            if (f.instrs[v].op != I_PHI && f.instrs[v].op != I_PARAM)
+                at++;
+    }
+
+    auto edge = [&](IrBlockId from, IrBlockId to) {
+        Edge e;
+        e.target = start[to];
+        e.moves = (uint32_t)code.moves.size();
+        const IrBlock& succ = f.blocks[to];
+        size_t k = 0;
+        while (succ.preds[k] != from)
+            k++;
+        for (IrValue v : succ.instrs) {
+            if (f.instrs[v].op != I_PHI)
+                break;
+            code.moves.push_back({slot[v], slot[f.arg(v, (uint32_t)k)]});
+        }
+        e.count = (uint32_t)code.moves.size() - e.moves;
+        code.edges.push_back(e);
+        return (uint32_t)code.edges.size() - 1;
+    };
+
+    for (IrBlockId b : order) {
+        const IrBlock& bl = f.blocks[b];
+        for (IrValue v : bl.instrs) {
+            const IrInstr& in = f.instrs[v];
+            if (in.op == I_PHI)
+                continue;
+            if (in.op == I_PARAM) {
+                code.paramSlots[in.imm] = slot[v];
+                continue;
+            }
+            Step s;
+            s.op = in.op;
+            s.line = in.line;
+            s.imm = in.imm;
+            s.dst = slot[v];
+            s.a = in.count > 0 ? slot[f.arg(v, 0)] : noValue;
+            s.b = in.count > 1 ? slot[f.arg(v, 1)] : noValue;
+            s.c = in.count > 2 ? slot[f.arg(v, 2)] : noValue;
+            s.first = s.count = 0;
+            if (in.op == I_STR) {
+                s.imm = (Value)(intptr_t)module.strings[in.imm].c_str();
+            } else if (in.op == I_CALL) {
+                s.first = (uint32_t)code.args.size();
+                s.count = in.count;
+                for (uint32_t k = 0; k < in.count; k++)
+                    code.args.push_back(slot[f.arg(v, k)]);
+            } else if (in.op == I_JUMP) {
+                s.b = edge(b, bl.succ[0]);
+            } else if (in.op == I_BRANCH) {
+                s.b = edge(b, bl.succ[0]);
+                s.c = edge(b, bl.succ[1]);
+            }
+            code.steps.push_back(s);
+        }
+    }
+}
+
+bool IrInterpreter::run(const IrModule& module, Value& result) {
+    result = 0;
+    steps = checks = 0;
+    freeHeap();
+    if (module.mainFunction < 0) {
+        *err << "Error de ejecucion: el programa no tiene funcion main" << endl;
+        return false;
+    }
+    if (module.functions[module.mainFunction].params != 0) {
+        *err << "Error de ejecucion: main no puede recibir parametros" << endl;
+        return false;
+    }
+    codes.resize(module.functions.size());
+    for (size_t i = 0; i < module.functions.size(); i++)
+        translate(module, module.functions[i], codes[i]);
+
+    const Code* code = &codes[module.mainFunction];
+    if (code->frameSize > slots.size()) {
+        *err << "Error de ejecucion: main necesita mas pila de la que hay" << endl;
+        return false;
+    }
+    globals.assign(module.globalNames.size(), 0);
+    frames.clear();
+    Value* end = slots.data() + slots.size();
+    Value* R = slots.data();
+    const Step* ip = code->steps.data();
+    Value* g = globals.data();
+    Value value = 0;
+    bool ok = true;
+    uint64_t count = 0, checkCount = 0;
+
+    // aritmetica en uint64_t como en las VMs
+    for (;;) {
+        count++;
+        switch (ip->op) {
+        case I_CONST:
+        case I_STR:
+            R[ip->dst] = ip->imm;
+            break;
+        case I_ADD:
+            R[ip->dst] = (Value)((uint64_t)R[ip->a] + (uint64_t)R[ip->b]);
+            break;
+        case I_SUB:
+            R[ip->dst] = (Value)((uint64_t)R[ip->a] - (uint64_t)R[ip->b]);
+            break;
+        case I_MUL:
+            R[ip->dst] = (Value)((uint64_t)R[ip->a] * (uint64_t)R[ip->b]);
+            break;
+        case I_DIV: {
+            Value n = R[ip->a], d = R[ip->b];
+            if (d == 0) {
+                fail(code, ip, "division por cero");
+                goto error;
+            }
+            R[ip->dst] = d == -1 ? (Value)(0 - (uint64_t)n) : n / d;
+            break;
+        }
+        case I_LT: R[ip->dst] = R[ip->a] < R[ip->b]; break;
+        case I_LE: R[ip->dst] = R[ip->a] <= R[ip->b]; break;
+        case I_GT: R[ip->dst] = R[ip->a] > R[ip->b]; break;
+        case I_GE: R[ip->dst] = R[ip->a] >= R[ip->b]; break;
+        case I_EQ: R[ip->dst] = R[ip->a] == R[ip->b]; break;
+        case I_NE: R[ip->dst] = R[ip->a] != R[ip->b]; break;
+        case I_NEG:
+            R[ip->dst] = (Value)(0 - (uint64_t)R[ip->a]);
+            break;
+        case I_NOT:
+            R[ip->dst] = R[ip->a] == 0;
+            break;
+        case I_LOAD_GLOBAL:
+            R[ip->dst] = g[ip->imm];
+            break;
+        case I_STORE_GLOBAL:
+            g[ip->imm] = R[ip->a];
+            break;
+        case I_NEW: {
+            Value n = R[ip->a];
+            if (n < 0) {
+                fail(code, ip, "new con tamano negativo (" + to_string(n) + ")");
+                goto error;
+            }
+            Value* a = newArray(n);
+            if (!a) {
+                fail(code, ip, "no hay memoria para un arreglo de " + to_string(n) + " elementos");
+                goto error;
+            }
+            R[ip->dst] = (Value)(intptr_t)a;
+            break;
+        }
+        case I_CHECK: {
+            const Value* a = (const Value*)(intptr_t)R[ip->a];
+            Value i = R[ip->b];
+            checkCount++;
+            if (!a) {
+                fail(code, ip, "arreglo sin crear (falta new)");
+                goto error;
+            }
+            if ((uint64_t)i >= (uint64_t)a[0]) {
+                fail(code, ip, "indice " + to_string(i) + " fuera de rango (largo " + to_string(a[0]) + ")");
+                goto error;
+            }
+            break;
+        }
+        case I_LOAD:
+            R[ip->dst] = ((const Value*)(intptr_t)R[ip->a])[1 + R[ip->b]];
+            break;
+        case I_STORE:
+            ((Value*)(intptr_t)R[ip->a])[1 + R[ip->b]] = R[ip->c];
+            break;
+        case I_CALL: {
+            const Code* callee = &codes[ip->imm];
+            Value* base = R + code->frameSize;
+            if (base + callee->frameSize > end || frames.size() >= maxFrames) {
+                fail(code, ip, "desborde de pila (recursion demasiado profunda)");
+                goto error;
+            }
+            const uint32_t* args = code->args.data() + ip->first;
+            for (uint32_t k = 0; k < ip->count; k++)
+                if (callee->paramSlots[k] != noValue)
+                    base[callee->paramSlots[k]] = R[args[k]];
+            frames.push_back({code, ip + 1, R, ip->dst});
+            R = base;
+            code = callee;
+            ip = code->steps.data();
+            continue;
+        }
+        case I_JUMP:
+        case I_BRANCH: {
+            const Edge& e = code->edges[ip->op == I_JUMP || R[ip->a] != 0 ? ip->b : ip->c];
+            // en paralelo: un phi puede leer el valor que otro esta por pisar
+            if (e.count > 0) {
+                const pair<uint32_t, uint32_t>* m = code->moves.data() + e.moves;
+                scratch.resize(e.count);
+                for (uint32_t k = 0; k < e.count; k++)
+                    scratch[k] = R[m[k].second];
+                for (uint32_t k = 0; k < e.count; k++)
+                    R[m[k].first] = scratch[k];
+            }
+            ip = code->steps.data() + e.target;
+            continue;
+        }
+        case I_RETURN: {
+            value = ip->a != noValue ? R[ip->a] : 0;
+            if (frames.empty()) {
+                result = value;
+                goto done;
+            }
+            const Frame& f = frames.back();
+            R = f.base;
+            code = f.code;
+            ip = f.ip;
+            R[f.dst] = value;
+            frames.pop_back();
+            continue;
+        }
+        default:
+            fail(code, ip, string("instruccion invalida ") + irOpNames[ip->op]);
+            goto error;
+        }
+        ip++;
+    }
+
+error:
+    ok = false;
+done:
+    steps = count;
+    checks = checkCount;
+    freeHeap();
+    return ok;
+}
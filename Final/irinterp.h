@@ -0,0 +1,79 @@
+#ifndef IRINTERP_H
+#define IRINTERP_H
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "bytecode.h"
+#include "ir.h"
+
+using namespace std;
+
+// Interprete del IR, para probar los pases: lo que devuelve main y los
+// errores de ejecucion tienen que ser los mismos que en RegisterVM antes y
+// despues de optimizar. No es rapido a proposito; cada funcion se aplana una
+// vez a una lista de pasos sobre casillas (una por valor) y los phis pasan a
+// ser copias en las aristas, hechas en paralelo al saltar.
+class IrInterpreter {
+public:
+    static const size_t slotCount = 1 << 20;  // valores (8 MB)
+    static const size_t maxFrames = 1 << 18;
+
+    IrInterpreter();
+    ~IrInterpreter();
+    IrInterpreter(const IrInterpreter&) = delete;
+    IrInterpreter& operator=(const IrInterpreter&) = delete;
+
+    void setOutput(ostream& err);
+    bool run(const IrModule& module, Value& result);
+    uint64_t executed() const { return steps; }  // instrucciones de la ultima corrida
+    uint64_t checked() const { return checks; }  // de esas, cuantas fueron CHECK
+
+private:
+    struct Step {
+        IrOp op;
+        uint32_t line;
+        int64_t imm;
+        uint32_t dst;
+        uint32_t a, b, c;      // casillas, o aristas en JUMP/BRANCH
+        uint32_t first, count; // argumentos de CALL en Code::args
+    };
+    struct Edge {
+        uint32_t target;       // primer paso del bloque
+        uint32_t moves, count; // copias de los phis en Code::moves
+    };
+    struct Code {
+        const IrFunction* fn;
+        uint32_t frameSize;
+        vector<Step> steps;
+        vector<uint32_t> args;
+        vector<Edge> edges;
+        vector<pair<uint32_t, uint32_t>> moves;  // (destino, origen)
+        vector<uint32_t> paramSlots;             // noValue: el parametro no se usa
+    };
+    struct Frame {
+        const Code* code;
+        const Step* ip;  // donde sigue el que llamo
+        Value* base;
+        uint32_t dst;
+    };
+
+    vector<Code> codes;
+    vector<Value> slots;
+    vector<Frame> frames;
+    vector<Value> globals;
+    vector<Value> scratch;
+    vector<Value*> heap;
+    ostream* err;
+    uint64_t steps;
+    uint64_t checks;
+
+    void translate(const IrModule& module, const IrFunction& f, Code& code);
+    Value* newArray(Value length);
+    void freeHeap();
+    void fail(const Code* code, const Step* ip, const string& message);
+};
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef KEYWORDS_H
+#define KEYWORDS_H
+
+#include <cstddef>
+#include <cstring>
+#include "tokens.h"
+
+// Palabras reservadas. Los lexers leen toda palabra como identificador y
+// despues la clasifican con un hash perfecto armado en tiempo de compilacion:
+//   h = (primera + ultima * mult + largo) % keywordSlots
+// 'mult' lo busca el compilador; si alguna vez se agrega una palabra que choca
+// con todas, falla el static_assert de abajo.
+
+struct Keyword {
+    const char* text;
+    size_t length;
+    TokenType type;
+};
+
+constexpr Keyword keywordList[] = {
+    {"fun", 3, TK_FUN},       {"if", 2, TK_IF},         {"else", 4, TK_ELSE},
+    {"end", 3, TK_END},       {"while", 5, TK_WHILE},   {"loop", 4, TK_LOOP},
+    {"return", 6, TK_RETURN}, {"new", 3, TK_NEW},       {"true", 4, TK_TRUE},
+    {"false", 5, TK_FALSE},   {"int", 3, TK_INT},       {"bool", 4, TK_BOOL},
+    {"char", 4, TK_CHAR},     {"string", 6, TK_STRING}, {"and", 3, TK_AND},
+    {"or", 2, TK_OR},         {"not", 3, TK_NOT},
+};
+
+constexpr size_t keywordCount = sizeof(keywordList) / sizeof(keywordList[0]);
+constexpr size_t keywordSlots = 64;  // una linea de cache de indices
+constexpr size_t keywordMinLength = 2;
+constexpr size_t keywordMaxLength = 6;
+
+constexpr size_t keywordHash(unsigned char first, unsigned char last, size_t length, size_t mult) {
+    return (first + last * mult + length) % keywordSlots;
+}
+
+constexpr bool keywordHashWorks(size_t mult) {
+    bool used[keywordSlots] = {};
+    for (size_t i = 0; i < keywordCount; i++) {
+        const Keyword& k = keywordList[i];
+        size_t h = keywordHash((unsigned char)k.text[0], (unsigned char)k.text[k.length - 1],
+                               k.length, mult);
+        if (used[h])
+            return false;
+        used[h] = true;
+    }
+    return true;
+}
+
+constexpr size_t findKeywordMult() {
+    for (size_t mult = 1; mult < 256; mult++)
+        if (keywordHashWorks(mult))
+            return mult;
+    return 0;
+}
+
+constexpr size_t keywordMult = findKeywordMult();
+static_assert(keywordMult != 0, "no hay hash perfecto para las palabras reservadas");
+
+// slot -> indice en keywordList, o -1 si esta vacio
+struct KeywordTable {
+    signed char slot[keywordSlots];
+
+    constexpr KeywordTable() : slot() {
+        for (size_t i = 0; i < keywordSlots; i++)
+            slot[i] = -1;
+        for (size_t i = 0; i < keywordCount; i++) {
+            const Keyword& k = keywordList[i];
+            slot[keywordHash((unsigned char)k.text[0], (unsigned char)k.text[k.length - 1],
+                             k.length, keywordMult)] = (signed char)i;
+        }
+    }
+};
+
+constexpr KeywordTable keywordTable;
+
+// tipo de la palabra text[0..length): la reservada o TK_ID
+inline int keywordOrId(const char* text, size_t length) {
+    if (length < keywordMinLength || length > keywordMaxLength)
+        return TK_ID;
+    int index = keywordTable.slot[keywordHash((unsigned char)text[0],
+                                              (unsigned char)text[length - 1], length, keywordMult)];
+    if (index < 0)
+        return TK_ID;
+    const Keyword& k = keywordList[index];
+    if (k.length != length || memcmp(k.text, text, length) != 0)
+        return TK_ID;
+    return k.type;
+}
+
+#endif
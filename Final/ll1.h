@@ -0,0 +1,340 @@
+#ifndef LL1_H
+#define LL1_H
+
+#include <cstdint>
+#include <initializer_list>
+#include "grammar.h"
+
+using namespace std;
+
+// Mini-0 como gramatica LL(1) y la tabla de analisis que sale de ella,
+// calculada por el compilador (ParserEngine::Table). Es el lenguaje que
+// acepta el parser a mano, no el de grammar.h: las decisiones que el usa
+// con dos tokens (ID ':' declara, ID '(' llama, else if) estan factorizadas
+// para decidir despues de consumir el primero, y los saltos de linea van
+// como 'nls' justo donde el llama a skipNL. Las acciones (LlAction) arman
+// el mismo AST que el.
+
+enum LlNonterminal {
+    LL_PROGRAMA,
+    LL_DECLS,
+    LL_DECL,
+    LL_NLS,
+    LL_OPT_NL,
+    LL_FUNCION,
+    LL_OPT_TIPO,
+    LL_PARAMS,
+    LL_PARAMS_TAIL,
+    LL_DECLVAR,
+    LL_TIPO,
+    LL_TIPOBASE,
+    LL_BLOQUE,
+    LL_CUERPO,      // declaraciones y comandos: ID ':' sigue declarando
+    LL_CUERPO_ID,
+    LL_COMANDOS,
+    LL_COMANDO,
+    LL_CMD_SIN_ID,
+    LL_CMDIF,
+    LL_IF_TAIL,
+    LL_ELSE_TAIL,
+    LL_CMDWHILE,
+    LL_CMDRETURN,
+    LL_OPT_EXP,
+    LL_ATRIB_TAIL,  // despues del ID: llamada o asignacion
+    LL_ASIG,
+    LL_LISTAEXP,
+    LL_LISTAEXP_TAIL,
+    LL_VAR_SUFIJO,
+    LL_EXP,
+    LL_EXP_OR,
+    LL_EXP_OR_P,
+    LL_EXP_AND,
+    LL_EXP_AND_P,
+    LL_EXP_EQ,
+    LL_EXP_EQ_P,
+    LL_EXP_REL,
+    LL_EXP_REL_P,
+    LL_EXP_ADD,
+    LL_EXP_ADD_P,
+    LL_EXP_MUL,
+    LL_EXP_MUL_P,
+    LL_EXP_UNARY,
+    LL_EXP_PRIMARY,
+    LL_PRIMARY_TAIL,  // despues del ID: llamada o variable
+    LL_ARGS,          // en una expresion los argumentos y los indices no abren
+    LL_ARGS_TAIL,     // otra raiz: exp() los sigue en el mismo bucle
+    LL_INDEX_SUFIJO,
+    LL_COUNT
+};
+
+// Acciones semanticas: van en las producciones entre los simbolos (con
+// valores entre los no terminales y los tokens, no cuentan para FIRST ni
+// FOLLOW) y el motor las corre al sacarlas de la pila. Estan donde el parser
+// a mano arma cada nodo y llama a checkDepth, asi el arbol sale igual, en el
+// mismo orden, y --max-depth corta en el mismo token.
+enum LlAction {
+    LA_MARK = LL_COUNT,  // guarda el token actual: donde esta, su simbolo y cual es
+    LA_OPEN,      // abre un nivel (checkDepth): la raiz de exp, un parentesis, un
+    LA_CLOSE,     // indice, un new, argumentos, un unario o un operador
+    LA_LITERAL,   // numero, string, true o false: el token actual
+    LA_VAR,       // ID marcado
+    LA_TARGET,    // igual, pero la marca queda para el comando
+    LA_INDEX,     // '[' marcado, arreglo e indice
+    LA_UNARY,     // operador marcado y su operando
+    LA_BINARY,    // operador marcado y los dos lados
+    LA_NEW,       // 'new' marcado, tamanio y tipo
+    LA_LIST,      // empieza una lista en 'work'
+    LA_ARG,       // la expresion va a la lista
+    LA_CALL,      // ID marcado y la lista
+    LA_CALLSTMT,  // igual, y el comando
+    LA_NOVALUE,   // return sin valor
+    LA_RETURN,
+    LA_ASSIGN,
+    LA_TYPE,      // tipo base: el token actual
+    LA_ARRAY,
+    LA_DECLVAR,   // ID marcado y tipo
+    LA_GLOBAL,
+    LA_FUNC,      // 'fun' actual
+    LA_NAME,      // ID actual
+    LA_PARAMS,
+    LA_RET,
+    LA_ENDFUNC,
+    LA_BLOCK,     // abre un bloque (checkDepth): el del if o while que sigue
+    LA_VARS,      // terminan las declaraciones del bloque
+    LA_ENDBLOCK,
+    LA_IF,        // 'if' o 'while' marcado y la condicion
+    LA_WHILE,
+    LA_ENDWHILE,
+    LA_ELSEIF,    // 'if' marcado y la condicion, con el if abierto
+    LA_ELSE,
+    LA_ENDIF,     // sin else
+    LA_ENDELSE,
+    LA_END
+};
+
+static_assert((int)LA_END <= (int)TK_ID, "las acciones no llegan a los tokens");
+
+// Lo que pasa cuando ningun token elige produccion: los mismos mensajes y
+// conjuntos de recuperacion que el parser a mano
+enum LlError : uint8_t { LE_NONE, LE_TIPO, LE_COMANDO, LE_ASIG, LE_EXP };
+
+struct LlProduction {
+    int head;
+    int body[16];
+    int length;
+    bool otherwise;  // se elige con cualquier token que no elija a otra
+    TokenSet when;   // anulable y no otherwise: los tokens que la eligen (si
+                     // es vacio, FOLLOW de la cabeza)
+
+    constexpr LlProduction(int h, initializer_list<int> symbols, bool other = false,
+                           TokenSet only = TokenSet())
+            : head(h), body{}, length(0), otherwise(other), when(only) {
+        for (int s : symbols)
+            body[length++] = s;
+    }
+};
+
+constexpr bool LL_OTHERWISE = true;
+
+// Con dos producciones para el mismo token gana la primera (solo pasa en
+// else_tail: 'else if' encadena, no abre un bloque con un if adentro)
+constexpr LlProduction llGrammar[] = {
+    {LL_PROGRAMA, {LL_NLS, LL_DECL, LL_NLS, LL_DECLS}, LL_OTHERWISE},
+    {LL_DECLS, {LL_DECL, LL_NLS, LL_DECLS}},
+    {LL_DECLS, {}, LL_OTHERWISE},
+    {LL_DECL, {LL_FUNCION}},
+    {LL_DECL, {LL_DECLVAR, LA_GLOBAL}, LL_OTHERWISE},
+    {LL_NLS, {TK_NL, LL_NLS}},
+    {LL_NLS, {}, LL_OTHERWISE},
+    {LL_OPT_NL, {TK_NL}},
+    {LL_OPT_NL, {}, LL_OTHERWISE},
+
+    {LL_FUNCION, {LA_FUNC, TK_FUN, LA_NAME, TK_ID, TK_LPAREN, LA_LIST, LL_PARAMS, LA_PARAMS,
+                  TK_RPAREN, LL_OPT_TIPO, LL_OPT_NL, LL_BLOQUE, TK_END, LL_OPT_NL, LA_ENDFUNC},
+     LL_OTHERWISE},
+    {LL_OPT_TIPO, {TK_COLON, LL_TIPO, LA_RET}},
+    {LL_OPT_TIPO, {}, LL_OTHERWISE},
+    {LL_PARAMS, {LL_DECLVAR, LL_PARAMS_TAIL}},
+    {LL_PARAMS, {}, LL_OTHERWISE},
+    {LL_PARAMS_TAIL, {TK_COMMA, LL_DECLVAR, LL_PARAMS_TAIL}},
+    {LL_PARAMS_TAIL, {}, LL_OTHERWISE},
+    {LL_DECLVAR, {LA_MARK, TK_ID, TK_COLON, LL_TIPO, LA_DECLVAR}, LL_OTHERWISE},
+    {LL_TIPO, {TK_LBRACKET, TK_RBRACKET, LL_TIPO, LA_ARRAY}},
+    {LL_TIPO, {LL_TIPOBASE}, LL_OTHERWISE},
+    {LL_TIPOBASE, {LA_TYPE, TK_INT}},
+    {LL_TIPOBASE, {LA_TYPE, TK_BOOL}},
+    {LL_TIPOBASE, {LA_TYPE, TK_CHAR}},
+    {LL_TIPOBASE, {LA_TYPE, TK_STRING}},
+
+    // el bloque se abre antes de sus 'nls' (como openBlock) y el if, while,
+    // else if o else que lo lleva los saltea antes
+    {LL_BLOQUE, {LA_BLOCK, LL_NLS, LL_CUERPO, LA_ENDBLOCK}, LL_OTHERWISE},
+    {LL_CUERPO, {LA_MARK, TK_ID, LL_CUERPO_ID}},
+    {LL_CUERPO, {LA_VARS, LL_CMD_SIN_ID, LL_NLS, LL_COMANDOS}},
+    {LL_CUERPO, {LA_VARS}, LL_OTHERWISE},
+    {LL_CUERPO_ID, {TK_COLON, LL_TIPO, LA_DECLVAR, LL_NLS, LL_CUERPO}},
+    {LL_CUERPO_ID, {LA_VARS, LL_ATRIB_TAIL, LL_NLS, LL_COMANDOS}, LL_OTHERWISE},
+    {LL_COMANDOS, {LL_COMANDO, LL_NLS, LL_COMANDOS}},
+    {LL_COMANDOS, {}, LL_OTHERWISE},
+    {LL_COMANDO, {LA_MARK, TK_ID, LL_ATRIB_TAIL}},
+    {LL_COMANDO, {LL_CMD_SIN_ID}},
+    {LL_CMD_SIN_ID, {LL_CMDIF}},
+    {LL_CMD_SIN_ID, {LL_CMDWHILE}},
+    {LL_CMD_SIN_ID, {LL_CMDRETURN}},
+    {LL_CMDIF, {LA_MARK, TK_IF, LL_EXP, LL_NLS, LA_IF, LL_BLOQUE, LL_IF_TAIL}, LL_OTHERWISE},
+    {LL_IF_TAIL, {TK_ELSE, LL_ELSE_TAIL}},
+    {LL_IF_TAIL, {TK_END, LA_ENDIF}, LL_OTHERWISE},
+    {LL_ELSE_TAIL, {LA_MARK, TK_IF, LL_EXP, LL_NLS, LA_ELSEIF, LL_BLOQUE, LL_IF_TAIL}},
+    {LL_ELSE_TAIL, {LL_NLS, LA_ELSE, LL_BLOQUE, TK_END, LA_ENDELSE}, LL_OTHERWISE},
+    {LL_CMDWHILE, {LA_MARK, TK_WHILE, LL_EXP, LL_NLS, LA_WHILE, LL_BLOQUE, TK_LOOP, LA_ENDWHILE},
+     LL_OTHERWISE},
+    {LL_CMDRETURN, {LA_MARK, TK_RETURN, LL_OPT_EXP, LA_RETURN}, LL_OTHERWISE},
+    // return sin valor solo si ya termina el comando o el bloque
+    {LL_OPT_EXP, {LA_NOVALUE}, false, TokenSet{TK_NL, TK_END, TK_ELSE, TK_LOOP, TK_EOF}},
+    {LL_OPT_EXP, {LL_EXP}, LL_OTHERWISE},
+    {LL_ATRIB_TAIL, {TK_LPAREN, LA_LIST, LL_LISTAEXP, TK_RPAREN, LA_CALLSTMT}},
+    {LL_ATRIB_TAIL, {LA_TARGET, LL_VAR_SUFIJO, LL_ASIG}, LL_OTHERWISE},
+    {LL_ASIG, {TK_ASSIGN, LL_EXP, LA_ASSIGN}},
+    {LL_LISTAEXP, {LL_EXP, LA_ARG, LL_LISTAEXP_TAIL}},
+    {LL_LISTAEXP, {}, LL_OTHERWISE},
+    {LL_LISTAEXP_TAIL, {TK_COMMA, LL_EXP, LA_ARG, LL_LISTAEXP_TAIL}},
+    {LL_LISTAEXP_TAIL, {}, LL_OTHERWISE},
+    {LL_VAR_SUFIJO, {LA_MARK, TK_LBRACKET, LL_EXP, TK_RBRACKET, LA_INDEX, LL_VAR_SUFIJO}},
+    {LL_VAR_SUFIJO, {}, LL_OTHERWISE},
+
+    // cada operador abre un nivel despues de consumirse y lo cierra cuando
+    // su lado derecho esta completo: es el ExprFrame que exp() reduce
+    {LL_EXP, {LA_OPEN, LL_EXP_OR, LA_CLOSE}, LL_OTHERWISE},
+    {LL_EXP_OR, {LL_EXP_AND, LL_EXP_OR_P}, LL_OTHERWISE},
+    {LL_EXP_OR_P, {LA_MARK, TK_OR, LA_OPEN, LL_EXP_AND, LA_CLOSE, LA_BINARY, LL_EXP_OR_P}},
+    {LL_EXP_OR_P, {}, LL_OTHERWISE},
+    {LL_EXP_AND, {LL_EXP_EQ, LL_EXP_AND_P}, LL_OTHERWISE},
+    {LL_EXP_AND_P, {LA_MARK, TK_AND, LA_OPEN, LL_EXP_EQ, LA_CLOSE, LA_BINARY, LL_EXP_AND_P}},
+    {LL_EXP_AND_P, {}, LL_OTHERWISE},
+    {LL_EXP_EQ, {LL_EXP_REL, LL_EXP_EQ_P}, LL_OTHERWISE},
+    {LL_EXP_EQ_P, {LA_MARK, TK_EQ, LA_OPEN, LL_EXP_REL, LA_CLOSE, LA_BINARY, LL_EXP_EQ_P}},
+    {LL_EXP_EQ_P, {LA_MARK, TK_NEQ, LA_OPEN, LL_EXP_REL, LA_CLOSE, LA_BINARY, LL_EXP_EQ_P}},
+    {LL_EXP_EQ_P, {LA_MARK, TK_ASSIGN, LA_OPEN, LL_EXP_REL, LA_CLOSE, LA_BINARY, LL_EXP_EQ_P}},
+    {LL_EXP_EQ_P, {}, LL_OTHERWISE},
+    {LL_EXP_REL, {LL_EXP_ADD, LL_EXP_REL_P}, LL_OTHERWISE},
+    {LL_EXP_REL_P, {LA_MARK, TK_LT, LA_OPEN, LL_EXP_ADD, LA_CLOSE, LA_BINARY, LL_EXP_REL_P}},
+    {LL_EXP_REL_P, {LA_MARK, TK_LE, LA_OPEN, LL_EXP_ADD, LA_CLOSE, LA_BINARY, LL_EXP_REL_P}},
+    {LL_EXP_REL_P, {LA_MARK, TK_GT, LA_OPEN, LL_EXP_ADD, LA_CLOSE, LA_BINARY, LL_EXP_REL_P}},
+    {LL_EXP_REL_P, {LA_MARK, TK_GE, LA_OPEN, LL_EXP_ADD, LA_CLOSE, LA_BINARY, LL_EXP_REL_P}},
+    {LL_EXP_REL_P, {}, LL_OTHERWISE},
+    {LL_EXP_ADD, {LL_EXP_MUL, LL_EXP_ADD_P}, LL_OTHERWISE},
+    {LL_EXP_ADD_P, {LA_MARK, TK_PLUS, LA_OPEN, LL_EXP_MUL, LA_CLOSE, LA_BINARY, LL_EXP_ADD_P}},
+    {LL_EXP_ADD_P, {LA_MARK, TK_MINUS, LA_OPEN, LL_EXP_MUL, LA_CLOSE, LA_BINARY, LL_EXP_ADD_P}},
+    {LL_EXP_ADD_P, {}, LL_OTHERWISE},
+    {LL_EXP_MUL, {LL_EXP_UNARY, LL_EXP_MUL_P}, LL_OTHERWISE},
+    {LL_EXP_MUL_P, {LA_MARK, TK_MUL, LA_OPEN, LL_EXP_UNARY, LA_CLOSE, LA_BINARY, LL_EXP_MUL_P}},
+    {LL_EXP_MUL_P, {LA_MARK, TK_DIV, LA_OPEN, LL_EXP_UNARY, LA_CLOSE, LA_BINARY, LL_EXP_MUL_P}},
+    {LL_EXP_MUL_P, {}, LL_OTHERWISE},
+    {LL_EXP_UNARY, {LA_MARK, LA_OPEN, TK_MINUS, LL_EXP_UNARY, LA_CLOSE, LA_UNARY}},
+    {LL_EXP_UNARY, {LA_MARK, LA_OPEN, TK_NOT, LL_EXP_UNARY, LA_CLOSE, LA_UNARY}},
+    {LL_EXP_UNARY, {LL_EXP_PRIMARY}, LL_OTHERWISE},
+    {LL_EXP_PRIMARY, {LA_LITERAL, TK_LITNUM}},
+    {LL_EXP_PRIMARY, {LA_LITERAL, TK_LITSTRING}},
+    {LL_EXP_PRIMARY, {LA_LITERAL, TK_TRUE}},
+    {LL_EXP_PRIMARY, {LA_LITERAL, TK_FALSE}},
+    {LL_EXP_PRIMARY, {LA_MARK, TK_NEW, TK_LBRACKET, LA_OPEN, LL_EXP_OR, TK_RBRACKET, LA_CLOSE,
+                      LL_TIPO, LA_NEW}},
+    {LL_EXP_PRIMARY, {TK_LPAREN, LA_OPEN, LL_EXP_OR, TK_RPAREN, LA_CLOSE}},
+    {LL_EXP_PRIMARY, {LA_MARK, TK_ID, LL_PRIMARY_TAIL}},
+    {LL_PRIMARY_TAIL, {TK_LPAREN, LA_OPEN, LA_LIST, LL_ARGS, TK_RPAREN, LA_CLOSE, LA_CALL}},
+    {LL_PRIMARY_TAIL, {LA_VAR, LL_INDEX_SUFIJO}, LL_OTHERWISE},
+    {LL_ARGS, {LL_EXP_OR, LA_ARG, LL_ARGS_TAIL}},
+    {LL_ARGS, {}, LL_OTHERWISE},
+    {LL_ARGS_TAIL, {TK_COMMA, LL_EXP_OR, LA_ARG, LL_ARGS_TAIL}},
+    {LL_ARGS_TAIL, {}, LL_OTHERWISE},
+    {LL_INDEX_SUFIJO, {LA_MARK, TK_LBRACKET, LA_OPEN, LL_EXP_OR, TK_RBRACKET, LA_CLOSE, LA_INDEX,
+                       LL_INDEX_SUFIJO}},
+    {LL_INDEX_SUFIJO, {}, LL_OTHERWISE},
+};
+
+constexpr int llProductionCount = sizeof(llGrammar) / sizeof(llGrammar[0]);
+
+// Los no terminales sin produccion OTHERWISE: que se reporta si el token no
+// elige ninguna (LL_COMANDO no deberia llegar nunca: comandos lo pide por FIRST)
+constexpr LlError llErrorOf(int nonterminal) {
+    switch (nonterminal) {
+        case LL_TIPOBASE: return LE_TIPO;
+        case LL_COMANDO:
+        case LL_CMD_SIN_ID: return LE_COMANDO;
+        case LL_ASIG: return LE_ASIG;
+        case LL_EXP_PRIMARY: return LE_EXP;
+        default: return LE_NONE;
+    }
+}
+
+// Columna por token (desde TK_ID) y una mas para cualquier otro valor
+constexpr int llColumns = TK_ERROR - TK_ID + 2;
+constexpr uint8_t llNoRule = 0xFF;
+
+static_assert(llProductionCount < llNoRule, "las producciones entran en un byte");
+
+constexpr int llColumn(int token) {
+    unsigned column = (unsigned)(token - TK_ID);
+    return column < (unsigned)llColumns - 1 ? (int)column : llColumns - 1;
+}
+
+// La tabla M[no terminal][token] -> produccion. Se llena de la ultima a la
+// primera produccion, asi en un conflicto queda la primera; 'conflicts'
+// cuenta esas celdas y 'orphans' las celdas vacias de no terminales sin
+// error (los dos se chequean abajo).
+struct LlTable {
+    uint8_t rule[LL_COUNT][llColumns];
+    int conflicts;
+    int orphans;
+
+    constexpr LlTable() : rule{}, conflicts(0), orphans(0) {
+        GrammarSets<LL_COUNT> sets = computeGrammarSets<LL_COUNT>(llGrammar, LL_PROGRAMA);
+        bool predicted[LL_COUNT][llColumns] = {};
+        for (int n = 0; n < LL_COUNT; n++)
+            for (int c = 0; c < llColumns; c++)
+                rule[n][c] = llNoRule;
+
+        for (int i = llProductionCount - 1; i >= 0; i--) {
+            const LlProduction& p = llGrammar[i];
+            if (p.otherwise)
+                for (int c = 0; c < llColumns; c++)
+                    if (!predicted[p.head][c])
+                        rule[p.head][c] = (uint8_t)i;
+        }
+        for (int i = llProductionCount - 1; i >= 0; i--) {
+            const LlProduction& p = llGrammar[i];
+            bool nullable = false;
+            TokenSet first = firstOfSequence(sets, p, 0, nullable);
+            // una otherwise anulable no mira FOLLOW: ya tiene lo que sobra,
+            // como el parser a mano que sigue de largo sin mirar
+            if (nullable && !p.otherwise)
+                first = first | (p.when != TokenSet() ? p.when : sets.follow[p.head]);
+            for (int token = TK_ID; token <= TK_ERROR; token++) {
+                if (!first.has(token))
+                    continue;
+                int c = llColumn(token);
+                if (predicted[p.head][c])
+                    conflicts++;
+                predicted[p.head][c] = true;
+                rule[p.head][c] = (uint8_t)i;
+            }
+        }
+        for (int n = 0; n < LL_COUNT; n++)
+            for (int c = 0; c < llColumns; c++)
+                if (rule[n][c] == llNoRule && llErrorOf(n) == LE_NONE)
+                    orphans++;
+    }
+
+    constexpr uint8_t at(int nonterminal, int token) const {
+        return rule[nonterminal][llColumn(token)];
+    }
+};
+
+constexpr LlTable llTable;
+
+static_assert(llTable.conflicts == 1, "solo 'else if' deberia ser ambiguo");
+static_assert(llGrammar[llTable.at(LL_ELSE_TAIL, TK_IF)].body[1] == TK_IF, "else if encadena");
+static_assert(llTable.orphans == 0, "a un no terminal sin error le falta una otherwise");
+
+
+#endif
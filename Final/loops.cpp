@@ -0,0 +1,338 @@
+#include "loops.h"
+
+#include <algorithm>
+#include "passes.h"
+
+using namespace std;
+
+vector<IrLoop> irFindLoops(const IrFunction& f, const vector<IrBlockId>& idom) {
+    vector<IrBlockId> order = irReversePostorder(f);
+    vector<uint32_t> position(f.blocks.size(), 0);
+    for (size_t k = 0; k < order.size(); k++)
+        position[order[k]] = (uint32_t)k;
+
+    vector<IrLoop> loops;
+    vector<int32_t> loopOf(f.blocks.size(), -1);  // por encabezado
+    vector<IrBlockId> work;
+    for (IrBlockId b : order) {
+        const IrBlock& bl = f.blocks[b];
+        for (uint8_t s = 0; s < bl.succCount; s++) {
+            IrBlockId h = bl.succ[s];
+            if (!irDominates(idom, h, b))
+                continue;
+            if (loopOf[h] < 0) {
+                loopOf[h] = (int32_t)loops.size();
+                IrLoop l;
+                l.header = h;
+                l.preheader = noBlock;
+                l.contains.assign(f.blocks.size(), 0);
+                l.contains[h] = 1;
+                l.blocks.push_back(h);
+                loops.push_back(move(l));
+            }
+            IrLoop& l = loops[loopOf[h]];
+            if (find(l.latches.begin(), l.latches.end(), b) == l.latches.end())
+                l.latches.push_back(b);
+            // hacia atras desde el latch hasta chocar con el encabezado
+            work.assign(1, b);
+            while (!work.empty()) {
+                IrBlockId x = work.back();
+                work.pop_back();
+                if (l.contains[x])
+                    continue;
+                l.contains[x] = 1;
+                l.blocks.push_back(x);
+                for (IrBlockId p : f.blocks[x].preds)
+                    if (!l.contains[p] && idom[p] != noBlock)
+                        work.push_back(p);
+            }
+        }
+    }
+
+    for (IrLoop& l : loops) {
+        sort(l.blocks.begin(), l.blocks.end(),
+             [&](IrBlockId a, IrBlockId b) { return position[a] < position[b]; });
+        IrBlockId outside = noBlock;
+        size_t count = 0;
+        for (IrBlockId p : f.blocks[l.header].preds)
+            if (!l.contains[p]) {
+                outside = p;
+                count++;
+            }
+        if (count == 1 && f.blocks[outside].succCount == 1)
+            l.preheader = outside;
+    }
+    // uno que contiene a otro tiene mas bloques
+    stable_sort(loops.begin(), loops.end(),
+                [](const IrLoop& a, const IrLoop& b) { return a.blocks.size() < b.blocks.size(); });
+    return loops;
+}
+
+bool irAddPreheaders(IrFunction& f) {
+    vector<IrLoop> loops = irFindLoops(f, irDominators(f));
+    bool changed = false;
+    for (const IrLoop& loop : loops) {
+        if (loop.preheader != noBlock || loop.header == 0)
+            continue;
+        IrBlockId header = loop.header;
+        vector<IrBlockId> inside, outside;
+        for (IrBlockId p : f.blocks[header].preds)
+            (p < loop.contains.size() && loop.contains[p] ? inside : outside).push_back(p);
+        if (outside.empty())
+            continue;
+        IrBlockId pre = f.addBlock();
+        IrBlock& h = f.blocks[header];
+        uint32_t line = f.instrs[h.instrs.front()].line;
+
+        // cada phi se queda con los valores de adentro y uno solo de afuera:
+        // el mismo si habia un predecesor externo, si no un phi en pre
+        for (IrValue phi : h.instrs) {
+            if (f.instrs[phi].op != I_PHI)
+                break;
+            vector<IrValue> in, out;
+            for (size_t k = 0; k < h.preds.size(); k++) {
+                IrBlockId p = h.preds[k];
+                (p < loop.contains.size() && loop.contains[p] ? in : out)
+                    .push_back(f.arg(phi, (uint32_t)k));
+            }
+            IrValue entry = out.size() == 1
+                                ? out[0]
+                                : f.append(pre, I_PHI, f.instrs[phi].line, 0, out.data(),
+                                           (uint32_t)out.size());
+            in.push_back(entry);
+            f.instrs[phi].first = (uint32_t)f.operands.size();
+            f.instrs[phi].count = (uint32_t)in.size();
+            f.operands.insert(f.operands.end(), in.begin(), in.end());
+        }
+        for (IrBlockId p : outside) {
+            IrBlock& from = f.blocks[p];
+            for (uint8_t s = 0; s < from.succCount; s++)
+                if (from.succ[s] == header)
+                    from.succ[s] = pre;
+        }
+        f.blocks[pre].preds = outside;
+        h.preds = inside;
+        f.jump(pre, header, line);
+        changed = true;
+    }
+    return changed;
+}
+
+// antes del terminador de b
+static void placeBefore(IrFunction& f, IrBlockId b, IrValue v) {
+    vector<IrValue>& list = f.blocks[b].instrs;
+    list.insert(list.end() - 1, v);
+    f.instrs[v].block = b;
+}
+
+static IrValue emitBefore(IrFunction& f, IrBlockId b, IrOp op, uint32_t line, int64_t imm,
+                          const IrValue* args = nullptr, uint32_t count = 0) {
+    IrValue v = f.make(op, line, imm, args, count);
+    placeBefore(f, b, v);
+    return v;
+}
+
+static bool constantOf(const IrFunction& f, IrValue v, Value& value) {
+    if (f.instrs[v].op != I_CONST)
+        return false;
+    value = f.instrs[v].imm;
+    return true;
+}
+
+// no tiene efectos ni puede fallar
+static bool quiet(const IrFunction& f, IrValue v) {
+    Value d;
+    if (f.instrs[v].op == I_DIV)
+        return constantOf(f, f.arg(v, 1), d) && d != 0;
+    return irPure(f.instrs[v].op);
+}
+
+bool hoistInvariants(IrFunction& f) {
+    bool changed = irAddPreheaders(f);
+    vector<IrBlockId> idom = irDominators(f);
+    vector<IrLoop> loops = irFindLoops(f, idom);
+    for (const IrLoop& loop : loops) {
+        if (loop.preheader == noBlock)
+            continue;
+        bool stores = false, calls = false;
+        vector<int64_t> written;  // globales
+        for (IrBlockId b : loop.blocks)
+            for (IrValue v : f.blocks[b].instrs) {
+                IrOp op = f.instrs[v].op;
+                if (op == I_STORE)
+                    stores = true;
+                else if (op == I_CALL)
+                    calls = true;
+                else if (op == I_STORE_GLOBAL)
+                    written.push_back(f.instrs[v].imm);
+            }
+
+        auto outside = [&](IrValue a) {
+            IrBlockId b = f.instrs[a].block;
+            return b != noBlock && !loop.contains[b];
+        };
+        // un CHECK igual en el preencabezado o en un bloque que lo domina
+        auto checked = [&](IrValue load) {
+            for (IrBlockId b = loop.preheader;; b = idom[b]) {
+                for (IrValue c : f.blocks[b].instrs)
+                    if (f.instrs[c].op == I_CHECK && f.arg(c, 0) == f.arg(load, 0) &&
+                        f.arg(c, 1) == f.arg(load, 1))
+                        return true;
+                if (b == 0)
+                    return false;
+            }
+        };
+
+        // en orden inverso de postorden los operandos salen antes que sus usos
+        for (IrBlockId b : loop.blocks) {
+            bool first = b == loop.header;  // todavia no hubo nada que pueda fallar
+            vector<IrValue> list = f.blocks[b].instrs;
+            for (IrValue v : list) {
+                IrOp op = f.instrs[v].op;
+                if (op == I_PHI || irTerminator(op))
+                    continue;
+                bool invariant = true;
+                for (uint32_t k = 0; k < f.instrs[v].count && invariant; k++)
+                    invariant = outside(f.arg(v, k));
+                bool safe = false;
+                switch (op) {
+                case I_CONST:
+                case I_STR:
+                case I_ADD:
+                case I_SUB:
+                case I_MUL:
+                case I_LT:
+                case I_LE:
+                case I_GT:
+                case I_GE:
+                case I_EQ:
+                case I_NE:
+                case I_NEG:
+                case I_NOT:
+                    safe = true;
+                    break;
+                case I_DIV:
+                case I_CHECK:
+                    safe = first || quiet(f, v);
+                    break;
+                case I_LOAD_GLOBAL:
+                    safe = !calls &&
+                           find(written.begin(), written.end(), f.instrs[v].imm) == written.end();
+                    break;
+                case I_LOAD:
+                    safe = !stores && !calls && invariant && checked(v);
+                    break;
+                default:
+                    break;
+                }
+                if (invariant && safe) {
+                    f.remove(v);
+                    placeBefore(f, loop.preheader, v);
+                    changed = true;
+                } else if (!quiet(f, v)) {
+                    first = false;
+                }
+            }
+        }
+    }
+    return changed;
+}
+
+bool reduceInductionVariables(IrFunction& f) {
+    bool changed = irAddPreheaders(f);
+    vector<IrLoop> loops = irFindLoops(f, irDominators(f));
+    vector<IrValue> repl(f.instrs.size(), noValue);
+    bool reduced = false;
+    for (const IrLoop& loop : loops) {
+        const vector<IrBlockId>& preds = f.blocks[loop.header].preds;
+        if (loop.preheader == noBlock || preds.size() != 2)
+            continue;
+        uint32_t in = preds[0] == loop.preheader ? 0 : 1, back = 1 - in;
+        IrBlockId latch = preds[back];
+
+        // variables basicas: i = phi(inicio, i + c)
+        vector<pair<IrValue, Value>> basic;
+        for (IrValue v : f.blocks[loop.header].instrs) {
+            if (f.instrs[v].op != I_PHI)
+                break;
+            IrValue next = f.arg(v, back);
+            IrOp op = f.instrs[next].op;
+            Value c;
+            if (op == I_ADD && f.arg(next, 0) == v && constantOf(f, f.arg(next, 1), c))
+                basic.push_back({v, c});
+            else if (op == I_ADD && f.arg(next, 1) == v && constantOf(f, f.arg(next, 0), c))
+                basic.push_back({v, c});
+            else if (op == I_SUB && f.arg(next, 0) == v && constantOf(f, f.arg(next, 1), c))
+                basic.push_back({v, (Value)(0 - (uint64_t)c)});
+        }
+        if (basic.empty())
+            continue;
+
+        auto outside = [&](IrValue a) {
+            IrBlockId b = f.instrs[a].block;
+            return b != noBlock && !loop.contains[b];
+        };
+        // (i, k) -> j, para que dos i * k iguales usen el mismo phi
+        vector<pair<pair<IrValue, IrValue>, IrValue>> made;
+        for (IrBlockId b : loop.blocks) {
+            vector<IrValue> list = f.blocks[b].instrs;
+            for (IrValue v : list) {
+                if (f.instrs[v].op != I_MUL)
+                    continue;
+                IrValue i = f.arg(v, 0), k = f.arg(v, 1);
+                if (!outside(k))
+                    swap(i, k);
+                auto iv = find_if(basic.begin(), basic.end(),
+                                  [&](const pair<IrValue, Value>& p) { return p.first == i; });
+                if (iv == basic.end() || !outside(k))
+                    continue;
+                // dos constantes iguales cuentan como el mismo k
+                Value factor, other;
+                bool known = constantOf(f, k, factor);
+                IrValue j = noValue;
+                for (auto& m : made)
+                    if (m.first.first == i &&
+                        (m.first.second == k ||
+                         (known && constantOf(f, m.first.second, other) && other == factor)))
+                        j = m.second;
+                if (j == noValue) {
+                    uint32_t line = f.instrs[v].line;
+                    IrValue init = f.arg(i, in);
+                    Value a;
+                    IrValue start, step;
+                    if (known && constantOf(f, init, a)) {
+                        start = emitBefore(f, loop.preheader, I_CONST, line,
+                                           (Value)((uint64_t)a * (uint64_t)factor));
+                    } else {
+                        IrValue ops[2] = {init, k};
+                        start = emitBefore(f, loop.preheader, I_MUL, line, 0, ops, 2);
+                    }
+                    if (known) {
+                        step = emitBefore(f, loop.preheader, I_CONST, line,
+                                          (Value)((uint64_t)iv->second * (uint64_t)factor));
+                    } else {
+                        IrValue ops[2] = {emitBefore(f, loop.preheader, I_CONST, line, iv->second), k};
+                        step = emitBefore(f, loop.preheader, I_MUL, line, 0, ops, 2);
+                    }
+                    IrValue phiOps[2] = {start, start};
+                    j = f.make(I_PHI, line, 0, phiOps, 2);
+                    vector<IrValue>& header = f.blocks[loop.header].instrs;
+                    header.insert(header.begin(), j);
+                    f.instrs[j].block = loop.header;
+                    IrValue addOps[2] = {j, step};
+                    f.args(j)[back] = emitBefore(f, latch, I_ADD, line, 0, addOps, 2);
+                    made.push_back({{i, k}, j});
+                }
+                repl.resize(f.instrs.size(), noValue);
+                repl[v] = j;
+                f.remove(v);
+                reduced = true;
+            }
+        }
+    }
+    if (reduced) {
+        repl.resize(f.instrs.size(), noValue);
+        replaceUses(f, repl);
+    }
+    return changed || reduced;
+}
@@ -0,0 +1,47 @@
+#ifndef LOOPS_H
+#define LOOPS_H
+
+#include <cstdint>
+#include <vector>
+#include "ir.h"
+
+using namespace std;
+
+// Bucles naturales del IR. Una arista b -> h es de vuelta si h domina a b; el
+// bucle es h mas los bloques desde los que se llega a b sin pasar por h. Dos
+// aristas de vuelta al mismo encabezado son un solo bucle (con dos latches).
+// Como Mini-0 solo tiene while, cada while es un bucle y no hay otros.
+struct IrLoop {
+    IrBlockId header;
+    IrBlockId preheader;        // noBlock si no tiene (ver irAddPreheaders)
+    vector<IrBlockId> latches;  // los que vuelven al encabezado
+    vector<IrBlockId> blocks;   // en orden inverso de postorden, el encabezado primero
+    vector<uint8_t> contains;   // por bloque de la funcion
+};
+
+// Los de adentro primero: un bucle va antes que cualquiera que lo contenga
+vector<IrLoop> irFindLoops(const IrFunction& f, const vector<IrBlockId>& idom);
+
+// Deja a cada bucle con un preencabezado: un bloque de afuera que es el
+// unico predecesor externo del encabezado y que solo salta a el. Si hace
+// falta se crea y los phis del encabezado se reparten entre los dos.
+bool irAddPreheaders(IrFunction& f);
+
+// Pases (-O con --vm ir y --emit-ir):
+//   - hoistInvariants saca al preencabezado lo que da lo mismo en todas las
+//     vueltas: constantes, aritmetica y comparaciones sobre valores de afuera
+//     del bucle, la division por una constante distinta de 0 y las lecturas
+//     de globales que el bucle no escribe (ni llama a nadie). Lo que puede
+//     fallar (CHECK, division por una variable) solo se saca si esta en el
+//     encabezado antes de cualquier otra cosa que pueda fallar o tener
+//     efectos: el encabezado corre siempre que se entra al bucle, asi que el
+//     error es el mismo. Un LOAD se saca si su CHECK ya salio y en el bucle no
+//     hay STORE ni llamadas.
+//   - reduceInductionVariables: si i = phi(inicio, i + c) con c constante,
+//     cada i * k con k de afuera del bucle pasa a ser un phi nuevo
+//     j = phi(inicio * k, j + c * k), una suma por vuelta en vez de un
+//     producto. Con la aritmetica modulo 2^64 da exactamente lo mismo.
+bool hoistInvariants(IrFunction& f);
+bool reduceInductionVariables(IrFunction& f);
+
+#endif
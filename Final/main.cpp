@@ -1,27 +1,363 @@
 #include <iostream>
 #include <string>
+#include <vector>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
 #include "parser.h"
+#include "semantic.h"
+#include "typecheck.h"
+#include "bytecode.h"
+#include "vm.h"
+#include "regvm.h"
+#include "irbuild.h"
+#include "irinterp.h"
+#include "passes.h"
+#include "ranges.h"
+#include "optimize.h"
+#include "printer.h"
+#include "cgen.h"
+#include "asmgen.h"
+#include "elfobj.h"
+#include "batch.h"
+#include "bench.h"
 
 using namespace std;
 
+static int usage(const char* prog) {
+    cerr << "Uso: " << prog << " [--trace] [--pretokenize] [--lexer flex|fast] [--ast-stats]\n"
+         << "       [--max-depth N] [--parser descent|ll1] [--max-errors N] [--fail-fast]\n"
+         << "       [--diagnostics text|json] [-j N] archivo.m0|directorio ..." << endl;
+    cerr << "     " << prog << " [-O] [--vm register|stack|ir] --run | --bytecode archivo.m0" << endl;
+    cerr << "     " << prog << " [-O] [--unchecked] --vm ir --run archivo.m0" << endl;
+    cerr << "     " << prog << " [-O] [--unchecked] --emit-c | --emit-asm archivo.m0 > programa.c|programa.s" << endl;
+    cerr << "     " << prog << " [-O] [--unchecked] -c archivo.m0 [-o programa.o]" << endl;
+    cerr << "     " << prog << " [-O] [--unchecked] --emit-ir [--pass-times] archivo.m0" << endl;
+    cerr << "     " << prog << " --emit-optimized archivo.m0 > optimizado.m0" << endl;
+    cerr << "     " << prog << " --bench nombre [-n iteraciones] archivo.m0|directorio ..." << endl;
+    return 1;
+}
+
 int main(int argc, char* argv[]) {
-    bool trace = false;
-    const char* filename = nullptr;
-
-    if (argc == 2) {
-        filename = argv[1];
-    } else if (argc == 3 && string(argv[1]) == "--trace") {
-        trace = true;
-        filename = argv[2];
-    } else {
-        cerr << "Uso: " << argv[0] << " [--trace] archivo.m0" << endl;
-        return 1;
+    ParserOptions options;
+    bool batch = false;
+    bool astStats = false;
+    bool run = false;
+    bool dumpBytecode = false;
+    bool stackVm = false;
+    bool irVm = false;
+    bool emitIr = false;
+    bool passTimes = false;
+    bool optimize = false;
+    bool unchecked = false;
+    bool emitOptimized = false;
+    bool emitC = false;
+    bool emitAsm = false;
+    bool object = false;
+    string outPath;
+    unsigned jobs = 0;
+    bool failFast = false;
+    bool depthGiven = false;
+    string bench;
+    int iterations = 10;
+    vector<string> paths;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--trace") {
+            options.trace = true;
+        } else if (arg == "--ast-stats") {
+            astStats = true;
+        } else if (arg == "--run") {
+            run = true;
+        } else if (arg == "--bytecode") {
+            dumpBytecode = true;
+        } else if (arg == "--emit-c") {
+            emitC = true;
+        } else if (arg == "--emit-asm") {
+            emitAsm = true;
+        } else if (arg == "--emit-ir") {
+            emitIr = true;
+        } else if (arg == "--pass-times") {
+            passTimes = true;
+        } else if (arg == "-O") {
+            optimize = true;
+        } else if (arg == "--unchecked") {
+            unchecked = true;
+        } else if (arg == "--emit-optimized") {
+            emitOptimized = true;
+        } else if (arg == "-c") {
+            object = true;
+        } else if (arg == "-o") {
+            if (i + 1 >= argc)
+                return usage(argv[0]);
+            outPath = argv[++i];
+        } else if (arg == "--vm") {
+            string name = i + 1 < argc ? argv[++i] : "";
+            stackVm = name == "stack";
+            irVm = name == "ir";
+            if (name != "register" && !stackVm && !irVm)
+                return usage(argv[0]);
+        } else if (arg == "--pretokenize") {
+            options.lexMode = LexMode::Buffered;
+        } else if (arg == "--lexer") {
+            string name = i + 1 < argc ? argv[++i] : "";
+            if (name == "flex")
+                options.lexer = LexerBackend::Flex;
+            else if (name == "fast")
+                options.lexer = LexerBackend::Fast;
+            else
+                return usage(argv[0]);
+        } else if (arg == "--parser") {
+            // ll1: la tabla de ll1.h, que arma el mismo AST que el descenso
+            string name = i + 1 < argc ? argv[++i] : "";
+            if (name == "descent")
+                options.engine = ParserEngine::Descent;
+            else if (name == "ll1")
+                options.engine = ParserEngine::Table;
+            else
+                return usage(argv[0]);
+        } else if (arg == "--max-errors") {
+            // 0 es sin limite
+            if (i + 1 >= argc)
+                return usage(argv[0]);
+            try {
+                options.maxErrors = (unsigned)stoul(argv[++i]);
+            } catch (...) {
+                return usage(argv[0]);
+            }
+        } else if (arg == "--fail-fast") {
+            failFast = true;
+        } else if (arg == "--diagnostics") {
+            string name = i + 1 < argc ? argv[++i] : "";
+            if (name == "text")
+                options.diagnostics = DiagFormat::Text;
+            else if (name == "json")
+                options.diagnostics = DiagFormat::Json;
+            else
+                return usage(argv[0]);
+        } else if (arg == "--max-depth") {
+            // 0 es sin limite
+            if (i + 1 >= argc)
+                return usage(argv[0]);
+            try {
+                options.maxDepth = (unsigned)stoul(argv[++i]);
+            } catch (...) {
+                return usage(argv[0]);
+            }
+            depthGiven = true;
+        } else if (arg == "-j") {
+            if (i + 1 >= argc)
+                return usage(argv[0]);
+            try {
+                jobs = (unsigned)stoul(argv[++i]);
+            } catch (...) {
+                return usage(argv[0]);
+            }
+            batch = true;
+        } else if (arg.size() > 2 && arg.compare(0, 2, "-j") == 0) {
+            try {
+                jobs = (unsigned)stoul(arg.substr(2));
+            } catch (...) {
+                return usage(argv[0]);
+            }
+            batch = true;
+        } else if (arg == "--bench" || arg == "-n") {
+            if (i + 1 >= argc)
+                return usage(argv[0]);
+            if (arg == "--bench") {
+                bench = argv[++i];
+            } else {
+                try {
+                    iterations = stoi(argv[++i]);
+                } catch (...) {
+                    return usage(argv[0]);
+                }
+            }
+        } else {
+            paths.push_back(arg);
+        }
+    }
+
+    if (paths.empty())
+        return usage(argv[0]);
+    // --fail-fast: el primer error corta el archivo (y en lote, el lote).
+    // Con json la salida es solo JSON: sin traza ni estadisticas en el medio.
+    if (failFast)
+        options.maxErrors = 1;
+    bool json = options.diagnostics == DiagFormat::Json;
+    if (json && (options.trace || astStats))
+        return usage(argv[0]);
+
+    if (!bench.empty()) {
+        vector<string> files;
+        if (!collectInputs(paths, files, cerr))
+            return 1;
+        return runBench(bench, files, iterations, cout);
+    }
+
+    // Ejecutar: el programa se compila a codigo de registros (o a bytecode de
+    // pila con --vm stack) y se interpreta. Sin mensajes de exito; el codigo de
+    // salida es lo que devuelve main (mod 256). --emit-c escribe el programa
+    // traducido a C (compilar con -I runtime) y --emit-asm a ensamblador
+    // x86-64 (enlazar con runtime/mini0_rt.c). -c escribe el mismo codigo
+    // como objeto ELF (archivo.o, o el nombre de -o) sin llamar a 'as'.
+    // --emit-ir escribe el IR en SSA despues de los pases de limpieza y
+    // --vm ir corre ese IR; --pass-times agrega a stderr lo que tardo cada pase.
+    // -O pliega y propaga constantes en el AST antes de cualquiera de estos, y
+    // en el IR ademas saca los chequeos de indices que no pueden fallar
+    // (ranges.h) y optimiza los bucles (loops.h);
+    // --emit-optimized escribe como queda el fuente. --unchecked no chequea
+    // ningun indice: es para codigo en el que se confia, y solo lo tienen el
+    // IR y los backends de C y x86 (las VMs siempre chequean).
+    if (run || dumpBytecode || emitC || emitAsm || object || emitIr || emitOptimized) {
+        if (batch || paths.size() != 1)
+            return usage(argv[0]);
+        if (unchecked && !(irVm || emitIr || emitC || emitAsm || object))
+            return usage(argv[0]);
+        // las pasadas que siguen son recursivas: siempre con limite
+        if (!depthGiven) {
+            options.maxDepth = compileDepthLimit;
+        } else if (options.maxDepth == 0 || options.maxDepth > compileDepthLimit) {
+            cerr << "Al compilar --max-depth va de 1 a " << compileDepthLimit << endl;
+            return 1;
+        }
+        ostream quiet(nullptr);
+        Parser p;
+        p.setOptions(options);
+        p.setOutput(quiet, cerr);
+        p.parse(paths[0]);
+        SemanticAnalyzer sema;
+        TypeChecker types;
+        if (!checkParsed(p, options, paths[0], sema, types, cerr))
+            return 1;
+        if (optimize || emitOptimized) {
+            AstOptimizer optimizer;
+            optimizer.optimize(p.ast(), sema);
+        }
+        if (emitOptimized) {
+            SourcePrinter printer;
+            printer.print(p.ast(), cout);
+            return 0;
+        }
+        if (emitC) {
+            CGenerator generator;
+            generator.setChecks(!unchecked);
+            ostringstream code;
+            if (!generator.generate(p.ast(), sema, code))
+                return 1;
+            cout << code.str();
+            return 0;
+        }
+        if (emitAsm) {
+            AsmGenerator generator;
+            generator.setChecks(!unchecked);
+            ostringstream code;
+            if (!generator.generate(p.ast(), sema, code))
+                return 1;
+            cout << code.str();
+            return 0;
+        }
+        if (object) {
+            AsmGenerator generator;
+            generator.setChecks(!unchecked);
+            ElfObject elf;
+            filesystem::path source(paths[0]);
+            elf.setSourceName(source.filename().string());
+            if (!generator.compile(p.ast(), sema, elf))
+                return 1;
+            vector<uint8_t> bytes;
+            elf.write(bytes);
+            if (outPath.empty())
+                outPath = source.stem().string() + ".o";
+            ofstream file(outPath, ios::binary);
+            file.write((const char*)bytes.data(), (streamsize)bytes.size());
+            if (!file.flush()) {
+                cerr << "No se pudo escribir " << outPath << endl;
+                return 1;
+            }
+            return 0;
+        }
+        Value result;
+        if (emitIr || irVm) {
+            IrBuilder builder;
+            IrModule module;
+            if (!builder.build(p.ast(), sema, module))
+                return 1;
+            PassManager passes;
+            passes.addCleanup();
+            if (optimize) {
+                passes.add("checks", eliminateChecks);
+                passes.addLoops();
+            }
+            if (unchecked)
+                passes.add("unchecked", removeChecks);
+            passes.setVerify(true);
+            if (!passes.run(module))
+                return 1;
+            if (passTimes)
+                passes.report(cerr);
+            if (emitIr || dumpBytecode) {
+                module.dump(cout);
+                return 0;
+            }
+            IrInterpreter interpreter;
+            if (!interpreter.run(module, result))
+                return 1;
+        } else if (stackVm) {
+            BytecodeCompiler compiler;
+            Program program;
+            if (!compiler.compile(p.ast(), sema, program))
+                return 1;
+            if (dumpBytecode) {
+                program.disassemble(cout);
+                return 0;
+            }
+            VM vm;
+            if (!vm.run(program, result))
+                return 1;
+        } else {
+            RegisterCompiler compiler;
+            RegProgram program;
+            if (!compiler.compile(p.ast(), sema, program))
+                return 1;
+            if (dumpBytecode) {
+                program.disassemble(cout);
+                return 0;
+            }
+            RegisterVM vm;
+            if (!vm.run(program, result))
+                return 1;
+        }
+        return (int)(result & 0xFF);
+    }
+
+    // Un solo archivo sin -j: igual que siempre
+    if (!batch && paths.size() == 1 && !filesystem::is_directory(paths[0])) {
+        Parser p;
+        p.setOptions(options);
+
+        p.parse(paths[0]);
+        if (astStats) {
+            error_code ec;
+            uintmax_t size = filesystem::file_size(paths[0], ec);
+            p.ast().printStats(cout, ec ? 0 : (size_t)size);
+        }
+        SemanticAnalyzer sema;
+        TypeChecker types;
+        return checkParsed(p, options, paths[0], sema, types, cerr) ? 0 : 1;
     }
 
-    Parser p;
-    if (trace)
-        p.setTrace(true);
+    // Modo lote: varios archivos y/o directorios en paralelo
+    vector<string> files;
+    bool ok = collectInputs(paths, files, cerr);
 
-    p.parse(filename);
-    return p.hasErrors() ? 1 : 0;
+    BatchOptions opts;
+    opts.jobs = jobs;
+    opts.parser = options;
+    opts.astStats = astStats;
+    opts.failFast = failFast;
+    // el JSON va a stderr, como el de un solo archivo
+    size_t failures = runBatch(files, opts, json ? cerr : cout);
+    return (failures > 0 || !ok) ? 1 : 0;
 }
@@ -0,0 +1,498 @@
+#include "optimize.h"
+
+#include <algorithm>
+#include <climits>
+
+using namespace std;
+
+AstOptimizer::AstOptimizer() : tree(nullptr), names(nullptr), first(0), last(0) {}
+
+// variables declaradas en un bloque y en los que tiene adentro
+static void collectVars(const Ast& tree, NodeId id, vector<NodeId>& out) {
+    if (id == noNode)
+        return;
+    const Block& b = tree.blocks[id];
+    out.insert(out.end(), tree.begin(b.vars), tree.end(b.vars));
+    for (const NodeId* s = tree.begin(b.stmts); s != tree.end(b.stmts); s++) {
+        const Stmt& st = tree.stmts[*s];
+        if (st.kind == StmtKind::If || st.kind == StmtKind::While) {
+            collectVars(tree, st.body, out);
+            collectVars(tree, st.orelse, out);
+        }
+    }
+}
+
+void AstOptimizer::optimize(Ast& ast, const SemanticAnalyzer& resolved) {
+    tree = &ast;
+    names = &resolved;
+    counts = Stats();
+    isGlobal.assign(ast.vars.size(), 0);
+    for (NodeId g : ast.globals)
+        isGlobal[g] = 1;
+    for (const Func& f : ast.funcs)
+        function(f);
+}
+
+void AstOptimizer::function(const Func& f) {
+    vector<NodeId> vars(tree->begin(f.params), tree->end(f.params));
+    collectVars(*tree, f.body, vars);
+    declared.clear();
+    for (NodeId g : tree->globals)
+        declared[tree->vars[g].name] += 2;  // nunca es un nombre unico
+    first = 0;
+    last = 0;
+    if (!vars.empty()) {
+        first = *min_element(vars.begin(), vars.end());
+        last = *max_element(vars.begin(), vars.end()) + 1;
+    }
+    for (NodeId v : vars)
+        declared[tree->vars[v].name]++;
+
+    // los parametros no se conocen; las variables del cuerpo empiezan en 0
+    Env env;
+    env.value.assign(last - first, 0);
+    env.known.assign(last - first, 0);
+    block(f.body, env);
+}
+
+bool AstOptimizer::tracked(NodeId var) const {
+    if (var == noNode || var < first || var >= last || isGlobal[var])
+        return false;
+    TypeId t = tree->vars[var].type;
+    return t == TY_INT || t == TY_BOOL;
+}
+
+void AstOptimizer::block(NodeId id, Env& env) {
+    if (id == noNode)
+        return;
+    const Block& b = tree->blocks[id];
+    vector<NodeId> vars(tree->begin(b.vars), tree->end(b.vars));
+    vector<NodeId> input(tree->begin(b.stmts), tree->end(b.stmts));
+    vector<NodeId> stmts;
+    size_t declaredHere = vars.size();
+    for (NodeId v : vars)
+        if (tracked(v)) {
+            env.value[v - first] = 0;
+            env.known[v - first] = 1;
+        }
+
+    bool changed = false;
+    for (NodeId s : input) {
+        if (env.dead) {
+            counts.statements++;
+            changed = true;
+            continue;
+        }
+        size_t before = stmts.size();
+        stmt(s, env, vars, stmts);
+        if (stmts.size() != before + 1 || stmts.back() != s)
+            changed = true;
+    }
+    // las listas son rangos de Ast::lists: si cambian se copian al final
+    if (changed || vars.size() != declaredHere) {
+        tree->blocks[id].vars = tree->makeList(vars, 0);
+        tree->blocks[id].stmts = tree->makeList(stmts, 0);
+    }
+}
+
+// Lo que queda de la sentencia va a stmts (nada si no hace falta, varias si
+// un if se reemplaza por su rama)
+void AstOptimizer::stmt(NodeId id, Env& env, vector<NodeId>& vars, vector<NodeId>& stmts) {
+    const Stmt s = tree->stmts[id];
+    switch (s.kind) {
+    case StmtKind::Assign: {
+        const Expr& target = tree->exprs[s.target];
+        if (target.kind == ExprKind::Index) {
+            NodeId base = target.lhs, index = target.rhs;
+            NodeId newBase = expr(base, env);
+            NodeId newIndex = expr(index, env);
+            tree->exprs[s.target].lhs = newBase;
+            tree->exprs[s.target].rhs = newIndex;
+        }
+        NodeId value = expr(s.value, env);
+        tree->stmts[id].value = value;
+        if (tree->exprs[s.target].kind == ExprKind::Var) {
+            NodeId var = names->declOf(s.target);
+            if (tracked(var)) {
+                Value v = 0;
+                env.known[var - first] = constant(value, v);
+                env.value[var - first] = v;
+            }
+        }
+        stmts.push_back(id);
+        return;
+    }
+    case StmtKind::Call: {
+        NodeId value = expr(s.value, env);
+        tree->stmts[id].value = value;
+        stmts.push_back(id);
+        return;
+    }
+    case StmtKind::Return:
+        if (s.value != noNode) {
+            NodeId value = expr(s.value, env);
+            tree->stmts[id].value = value;
+        }
+        stmts.push_back(id);
+        env.dead = true;
+        return;
+    case StmtKind::If: {
+        NodeId cond = expr(s.value, env);
+        tree->stmts[id].value = cond;
+        Value v;
+        if (constant(cond, v)) {
+            counts.branches++;
+            NodeId taken = v ? s.body : s.orelse;
+            NodeId skipped = v ? s.orelse : s.body;
+            if (skipped != noNode)
+                counts.statements += tree->blocks[skipped].stmts.count;
+            if (taken == noNode)
+                return;
+            block(taken, env);
+            if (splice(taken, vars, stmts))
+                return;
+            // las variables de la rama chocan con otro nombre: queda un if true
+            tree->exprs[cond].kind = ExprKind::True;
+            tree->stmts[id].body = taken;
+            tree->stmts[id].orelse = noNode;
+            stmts.push_back(id);
+            return;
+        }
+        Env other = env;
+        block(s.body, env);
+        block(s.orelse, other);
+        merge(env, other);
+        stmts.push_back(id);
+        return;
+    }
+    case StmtKind::While: {
+        // la condicion y el cuerpo ven lo que deja cualquier vuelta anterior
+        assigned(s.body, env);
+        NodeId cond = expr(s.value, env);
+        tree->stmts[id].value = cond;
+        Value v;
+        bool known = constant(cond, v);
+        if (known && !v) {
+            counts.branches++;
+            counts.statements++;
+            return;
+        }
+        Env inside = env;
+        block(s.body, inside);
+        // sin break, de un while true solo se sale con return
+        if (known)
+            env.dead = true;
+        stmts.push_back(id);
+        return;
+    }
+    }
+}
+
+// mete las variables y sentencias de un bloque en el de afuera si ningun
+// nombre se confunde con otro (el fuente que escribe --emit-optimized tiene
+// que significar lo mismo)
+bool AstOptimizer::splice(NodeId id, vector<NodeId>& vars, vector<NodeId>& stmts) {
+    const Block& b = tree->blocks[id];
+    for (const NodeId* v = tree->begin(b.vars); v != tree->end(b.vars); v++)
+        if (declared[tree->vars[*v].name] != 1)
+            return false;
+    vars.insert(vars.end(), tree->begin(b.vars), tree->end(b.vars));
+    stmts.insert(stmts.end(), tree->begin(b.stmts), tree->end(b.stmts));
+    return true;
+}
+
+// se olvida el valor de las variables que el bloque asigna en algun lado
+void AstOptimizer::assigned(NodeId id, Env& env) {
+    if (id == noNode)
+        return;
+    const Block& b = tree->blocks[id];
+    for (const NodeId* p = tree->begin(b.stmts); p != tree->end(b.stmts); p++) {
+        const Stmt& s = tree->stmts[*p];
+        if (s.kind == StmtKind::Assign && tree->exprs[s.target].kind == ExprKind::Var) {
+            NodeId var = names->declOf(s.target);
+            if (tracked(var))
+                env.known[var - first] = 0;
+        } else if (s.kind == StmtKind::If || s.kind == StmtKind::While) {
+            assigned(s.body, env);
+            assigned(s.orelse, env);
+        }
+    }
+}
+
+void AstOptimizer::merge(Env& into, const Env& other) {
+    if (other.dead)
+        return;
+    if (into.dead) {
+        into = other;
+        return;
+    }
+    for (size_t i = 0; i < into.known.size(); i++)
+        if (into.known[i] && (!other.known[i] || other.value[i] != into.value[i]))
+            into.known[i] = 0;
+}
+
+bool AstOptimizer::constant(NodeId id, Value& value) const {
+    const Expr& e = tree->exprs[id];
+    switch (e.kind) {
+    case ExprKind::Num:
+        return parseNumber(tree->text() + e.text.offset, e.text.length, value);
+    case ExprKind::True:
+        value = 1;
+        return true;
+    case ExprKind::False:
+        value = 0;
+        return true;
+    case ExprKind::Unary:
+        if (e.opToken() == TK_MINUS && tree->exprs[e.lhs].kind == ExprKind::Num &&
+            constant(e.lhs, value)) {
+            value = (Value)(0 - (uint64_t)value);
+            return true;
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+// sin llamadas ni errores de ejecucion posibles: se puede no evaluar
+bool AstOptimizer::pure(NodeId id) const {
+    const Expr& e = tree->exprs[id];
+    switch (e.kind) {
+    case ExprKind::Num:
+    case ExprKind::Str:
+    case ExprKind::True:
+    case ExprKind::False:
+    case ExprKind::Var:
+        return true;
+    case ExprKind::Unary:
+        return pure(e.lhs);
+    case ExprKind::Binary:
+        return e.opToken() != TK_DIV && pure(e.lhs) && pure(e.rhs);
+    default:
+        return false;
+    }
+}
+
+// El nodo pasa a ser la constante; noNode si no se puede escribir en Mini-0
+// (el menor int64 no tiene literal)
+NodeId AstOptimizer::makeConstant(NodeId id, Value value, TypeId type) {
+    if (type == TY_BOOL) {
+        Expr& e = tree->exprs[id];
+        e.kind = value ? ExprKind::True : ExprKind::False;
+        e.type = TY_BOOL;
+        return id;
+    }
+    if (value == INT64_MIN)
+        return noNode;
+    Span text = tree->addText(to_string(value < 0 ? -value : value));
+    NodeId digits = id;
+    if (value < 0) {
+        Expr num{};
+        num.kind = ExprKind::Num;
+        num.type = TY_INT;
+        num.line = tree->exprs[id].line;
+        num.column = tree->exprs[id].column;
+        num.sym = noSymbol;
+        num.lhs = num.rhs = noNode;
+        num.text = text;
+        digits = tree->addExpr(num);
+        Expr& e = tree->exprs[id];
+        e.kind = ExprKind::Unary;
+        e.op = (uint8_t)(TK_MINUS - TK_ID);
+        e.lhs = digits;
+        e.rhs = noNode;
+        e.type = TY_INT;
+        return id;
+    }
+    Expr& e = tree->exprs[id];
+    e.kind = ExprKind::Num;
+    e.text = text;
+    e.type = TY_INT;
+    return id;
+}
+
+// Devuelve el nodo que queda en el lugar de id
+NodeId AstOptimizer::expr(NodeId id, Env& env) {
+    const Expr e = tree->exprs[id];
+    switch (e.kind) {
+    case ExprKind::Num:
+    case ExprKind::Str:
+    case ExprKind::True:
+    case ExprKind::False:
+        return id;
+    case ExprKind::Var: {
+        NodeId var = names->declOf(id);
+        if (!tracked(var) || !env.known[var - first])
+            return id;
+        NodeId c = makeConstant(id, env.value[var - first], tree->vars[var].type);
+        if (c == noNode)
+            return id;
+        counts.propagated++;
+        return c;
+    }
+    case ExprKind::Index: {
+        NodeId base = expr(e.lhs, env);
+        NodeId index = expr(e.rhs, env);
+        tree->exprs[id].lhs = base;
+        tree->exprs[id].rhs = index;
+        return id;
+    }
+    case ExprKind::Call:
+        for (uint32_t k = 0; k < e.args.count; k++) {
+            NodeId arg = expr(tree->lists[e.args.first + k], env);
+            tree->lists[e.args.first + k] = arg;
+        }
+        return id;
+    case ExprKind::New: {
+        NodeId size = expr(e.rhs, env);
+        tree->exprs[id].rhs = size;
+        return id;
+    }
+    case ExprKind::Unary: {
+        NodeId operand = expr(e.lhs, env);
+        tree->exprs[id].lhs = operand;
+        const Expr& in = tree->exprs[operand];
+        if (e.opToken() == TK_MINUS && in.kind == ExprKind::Num)
+            return id;  // -5 ya es una constante
+        Value v;
+        if (constant(operand, v)) {
+            NodeId c = e.opToken() == TK_NOT ? makeConstant(id, v == 0, TY_BOOL)
+                                             : makeConstant(id, (Value)(0 - (uint64_t)v), TY_INT);
+            if (c == noNode)
+                return id;
+            counts.folded++;
+            return c;
+        }
+        // not not c, - - x
+        if (in.kind == ExprKind::Unary && in.op == e.op) {
+            counts.simplified++;
+            return in.lhs;
+        }
+        return id;
+    }
+    case ExprKind::Binary:
+        break;
+    }
+    return binary(id, env);
+}
+
+NodeId AstOptimizer::binary(NodeId id, Env& env) {
+    const Expr e = tree->exprs[id];
+    int op = e.opToken();
+    NodeId lhs = expr(e.lhs, env);
+    tree->exprs[id].lhs = lhs;
+    Value a = 0, b = 0;
+    auto fold = [&](Value v, TypeId type) {
+        NodeId c = makeConstant(id, v, type);
+        if (c == noNode)
+            return id;
+        counts.folded++;
+        return c;
+    };
+
+    if (op == TK_AND || op == TK_OR) {
+        bool isAnd = op == TK_AND;
+        if (constant(lhs, a)) {
+            // false and c, true or c: decide el izquierdo y c no se evalua
+            if ((a != 0) != isAnd)
+                return fold(a != 0, TY_BOOL);
+            counts.simplified++;
+            return expr(e.rhs, env);
+        }
+        NodeId rhs = expr(e.rhs, env);
+        tree->exprs[id].rhs = rhs;
+        if (constant(rhs, b)) {
+            if ((b != 0) == isAnd) {
+                counts.simplified++;
+                return lhs;
+            }
+            if (pure(lhs))
+                return fold(b != 0, TY_BOOL);
+        }
+        return id;
+    }
+
+    NodeId rhs = expr(e.rhs, env);
+    tree->exprs[id].rhs = rhs;
+    bool knownA = constant(lhs, a), knownB = constant(rhs, b);
+    if (knownA && knownB) {
+        // misma aritmetica que las VMs: da la vuelta en uint64_t
+        uint64_t ua = (uint64_t)a, ub = (uint64_t)b;
+        switch (op) {
+        case TK_PLUS: return fold((Value)(ua + ub), TY_INT);
+        case TK_MINUS: return fold((Value)(ua - ub), TY_INT);
+        case TK_MUL: return fold((Value)(ua * ub), TY_INT);
+        case TK_DIV:
+            if (b == 0)
+                return id;  // el error queda para cuando se ejecute
+            return fold(b == -1 ? (Value)(0 - ua) : a / b, TY_INT);
+        case TK_LT: return fold(a < b, TY_BOOL);
+        case TK_LE: return fold(a <= b, TY_BOOL);
+        case TK_GT: return fold(a > b, TY_BOOL);
+        case TK_GE: return fold(a >= b, TY_BOOL);
+        case TK_EQ: return fold(a == b, TY_BOOL);
+        case TK_NEQ: return fold(a != b, TY_BOOL);
+        }
+        return id;
+    }
+
+    if (knownB && b == 0 && (op == TK_PLUS || op == TK_MINUS)) {
+        counts.simplified++;
+        return lhs;
+    }
+    if (knownA && a == 0 && op == TK_PLUS) {
+        counts.simplified++;
+        return rhs;
+    }
+    if (knownB && b == 1 && (op == TK_MUL || op == TK_DIV)) {
+        counts.simplified++;
+        return lhs;
+    }
+    if (knownA && a == 1 && op == TK_MUL) {
+        counts.simplified++;
+        return rhs;
+    }
+    if (op == TK_MUL && ((knownB && b == 0 && pure(lhs)) || (knownA && a == 0 && pure(rhs))))
+        return fold(0, TY_INT);
+    return id;
+}
+
+static size_t countExpr(const Ast& tree, NodeId id) {
+    if (id == noNode)
+        return 0;
+    const Expr& e = tree.exprs[id];
+    size_t n = e.kind == ExprKind::Unary || e.kind == ExprKind::Binary ? 1 : 0;
+    if (e.kind == ExprKind::Call) {
+        for (const NodeId* a = tree.begin(e.args); a != tree.end(e.args); a++)
+            n += countExpr(tree, *a);
+        return n;
+    }
+    if (e.kind == ExprKind::Index || e.kind == ExprKind::Unary || e.kind == ExprKind::Binary)
+        n += countExpr(tree, e.lhs);
+    if (e.kind == ExprKind::Index || e.kind == ExprKind::New || e.kind == ExprKind::Binary)
+        n += countExpr(tree, e.rhs);
+    return n;
+}
+
+static size_t countBlock(const Ast& tree, NodeId id) {
+    if (id == noNode)
+        return 0;
+    const Block& b = tree.blocks[id];
+    size_t n = 0;
+    for (const NodeId* p = tree.begin(b.stmts); p != tree.end(b.stmts); p++) {
+        const Stmt& s = tree.stmts[*p];
+        if (s.kind == StmtKind::Assign)
+            n += countExpr(tree, s.target);
+        n += countExpr(tree, s.value);
+        n += countBlock(tree, s.body);
+        n += countBlock(tree, s.orelse);
+    }
+    return n;
+}
+
+size_t AstOptimizer::countOperations(const Ast& tree) {
+    size_t n = 0;
+    for (const Func& f : tree.funcs)
+        n += countBlock(tree, f.body);
+    return n;
+}
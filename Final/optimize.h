@@ -0,0 +1,77 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "ast.h"
+#include "bytecode.h"
+#include "semantic.h"
+
+using namespace std;
+
+// Optimizaciones sobre el AST ya chequeado, antes de cualquier backend:
+//   - plegado de constantes: 2 * 3 + 1 -> 7, 5 < 10 -> true, not false -> true
+//   - propagacion: despues de "x = 5" las lecturas de x valen 5 hasta que se
+//     le asigne otra cosa. Solo locales int y bool (a una global la puede
+//     cambiar cualquier llamada); en un while se olvidan las que el cuerpo
+//     asigna y despues de un if quedan las que valen lo mismo por las dos ramas
+//   - if con condicion conocida: queda la rama que se ejecuta, metida en el
+//     bloque de afuera si sus variables no chocan con otro nombre; un while
+//     false desaparece, igual que lo que viene despues de un return
+//   - identidades: x + 0, x * 1, x / 1 -> x; true and c -> c; c or true ->
+//     true si c no tiene efectos (llamadas, indices, new, division)
+// El arbol se cambia en el lugar y las referencias de SemanticAnalyzer siguen
+// valiendo: un nodo que se reemplaza por un numero deja de ser Var o Call. Los
+// numeros nuevos van a Ast::addText; un resultado negativo es un menos unario.
+// Las multiplicaciones y divisiones por potencias de 2 quedan como estan
+// (Mini-0 no tiene desplazamientos): las pasa a shl/sar el backend x86.
+class AstOptimizer {
+public:
+    struct Stats {
+        size_t folded = 0;      // operaciones calculadas al compilar
+        size_t propagated = 0;  // lecturas de variables cambiadas por su valor
+        size_t simplified = 0;  // identidades
+        size_t branches = 0;    // if/while con la condicion conocida
+        size_t statements = 0;  // sentencias que no se ejecutan nunca
+    };
+
+    AstOptimizer();
+
+    void optimize(Ast& tree, const SemanticAnalyzer& names);
+    const Stats& stats() const { return counts; }
+
+    // operaciones (unarias y binarias) en los cuerpos de las funciones
+    static size_t countOperations(const Ast& tree);
+
+private:
+    // valores conocidos de las variables de la funcion (indice: VarDecl - first)
+    struct Env {
+        vector<Value> value;
+        vector<uint8_t> known;
+        bool dead = false;  // despues de un return: no se llega
+    };
+
+    Ast* tree;
+    const SemanticAnalyzer* names;
+    Stats counts;
+    NodeId first, last;                         // VarDecl de la funcion actual
+    vector<uint8_t> isGlobal;                   // por VarDecl
+    unordered_map<Symbol, uint32_t> declared;   // nombres de la funcion y globales
+
+    void function(const Func& f);
+    void block(NodeId id, Env& env);
+    void stmt(NodeId id, Env& env, vector<NodeId>& vars, vector<NodeId>& stmts);
+    bool splice(NodeId block, vector<NodeId>& vars, vector<NodeId>& stmts);
+    NodeId expr(NodeId id, Env& env);
+    NodeId binary(NodeId id, Env& env);
+
+    bool tracked(NodeId var) const;
+    void assigned(NodeId block, Env& env);
+    void merge(Env& into, const Env& other);
+    bool constant(NodeId id, Value& value) const;
+    bool pure(NodeId id) const;
+    NodeId makeConstant(NodeId id, Value value, TypeId type);
+};
+
+#endif
@@ -1,83 +1,258 @@
 #include "parser.h"
+
+#include <array>
+
 using namespace std;
 
 // Inicializa el parser sin tokens pendientes ni traza activa.
 Parser::Parser()
-        : currentToken(TK_EOF),
+        : scanner(nullptr),
+            inputMode(InputMode::InMemory),
+            lexMode(ParserOptions().lexMode),
+            backend(ParserOptions().lexer),
+            engine(ParserOptions().engine),
+            useBuffer(false),
+            useFast(false),
+            cursor(0),
+            scanned(0),
+            nextError(0),
+            out(&cout),
+            err(&cerr),
+            currentToken(TK_EOF),
             lookaheadToken(TK_EOF),
+            currentLine(1),
+            lookaheadLine(1),
+            currentColumn(0),
+            lookaheadColumn(0),
+            lineStart(0),
             hasLookahead(false),
             trace(false),
-            hadError(false) {}
+            hadError(false),
+            maxDepth(ParserOptions().maxDepth),
+            aborted(false),
+            stopped(false),
+            maxErrors(ParserOptions().maxErrors),
+            diagFormat(ParserOptions().diagnostics),
+            deepest(0),
+            currentLexeme{0, 0},
+            lookaheadLexeme{0, 0},
+            currentSymbol(noSymbol),
+            lookaheadSymbol(noSymbol) {
+    yylex_init(&scanner);
+}
+
+Parser::~Parser() {
+    yylex_destroy(scanner);
+}
 
 void Parser::setTrace(bool enable) {
     trace = enable;
 }
 
+// permite redirigir la salida (por ejemplo a un buffer por hilo)
+void Parser::setOutput(ostream& outStream, ostream& errStream) {
+    out = &outStream;
+    err = &errStream;
+}
+
+void Parser::setInputMode(InputMode mode) {
+    inputMode = mode;
+}
+
+void Parser::setLexMode(LexMode mode) {
+    lexMode = mode;
+}
+
+void Parser::setLexer(LexerBackend lexer) {
+    backend = lexer;
+}
+
+void Parser::setOptions(const ParserOptions& options) {
+    trace = options.trace;
+    lexMode = options.lexMode;
+    backend = options.lexer;
+    maxDepth = options.maxDepth;
+    engine = options.engine;
+    maxErrors = options.maxErrors;
+    diagFormat = options.diagnostics;
+}
+
 bool Parser::hasErrors() const {
     return hadError;
 }
 
+// pide un token al lexer elegido (modo Interleaved); pos es donde empieza
+int Parser::scanToken(Lexeme& lexeme, SourcePos& pos, Symbol& symbol) {
+    int token;
+    int line;
+    if (useFast) {
+        token = fast.next();
+        lexeme = {fast.offset(), fast.length()};
+        line = fast.lineno();
+    } else {
+        token = yylex(scanner);
+        if (token == 0)
+            token = TK_EOF;
+        lexeme = scanLexeme(token);
+        line = yyget_lineno(scanner);
+    }
+
+    // el lexer ya conto los \n del token: volver a la linea donde empezo
+    if (token == TK_NL) {
+        line--;
+    } else if (token == TK_LITSTRING) {
+        const char* text = lexemeData(lexeme);
+        for (size_t i = 0; i < lexeme.length; i++)
+            if (text[i] == '\n')
+                line--;
+    }
+    pos.line = line;
+    pos.column = columnOf(token, lexeme);
+    symbol = token == TK_ID ? tree.symbols.intern(lexemeData(lexeme), lexeme.length) : noSymbol;
+    return token;
+}
+
+// Columna del token; se llama una vez por token, en el orden del fuente,
+// y despues de un \n (o de un string que lo tiene) la linea empieza de nuevo.
+// Con los lexemas copiados (modo Stdio) no hay offsets: 0.
+int Parser::columnOf(int token, const Lexeme& lexeme) {
+    if (token == TK_EOF || !lexemesInSource())
+        return 0;
+    size_t column = lexeme.offset - lineStart + 1;
+    if (token == TK_NL) {
+        lineStart = lexeme.offset + lexeme.length;
+    } else if (token == TK_LITSTRING) {
+        const char* text = lexemeData(lexeme);
+        for (size_t i = 0; i < lexeme.length; i++)
+            if (text[i] == '\n')
+                lineStart = lexeme.offset + i + 1;
+    }
+    return column <= UINT16_MAX ? (int)column : 0;
+}
+
+// guarda el lexema del ultimo yylex como vista al texto fuente
+Lexeme Parser::scanLexeme(int token) {
+    if (token == TK_EOF)
+        return {0, 0};
+
+    const char* text = yyget_text(scanner);
+    size_t length = (size_t)yyget_leng(scanner);
+    if (inputMode == InputMode::InMemory)
+        return {(size_t)(text - source.data()), length};
+
+    Lexeme lexeme{stdioText.size(), length};
+    stdioText.append(text, length);
+    return lexeme;
+}
+
+// los lexemas apuntan al archivo en memoria (si no, a stdioText)
+bool Parser::lexemesInSource() const {
+    return inputMode == InputMode::InMemory || useBuffer || useFast;
+}
+
+const char* Parser::lexemeData(const Lexeme& lexeme) const {
+    const char* base = lexemesInSource() ? source.data() : stdioText.data();
+    return base + lexeme.offset;
+}
+
+// solo para mensajes: aqui si se copia
+string Parser::lexemeText(const Lexeme& lexeme) const {
+    return string(lexemeData(lexeme), lexeme.length);
+}
+
+// modo Buffered: el parser llega al token 'index'. Los errores lexicos que
+// estaban antes se reportan ahora, igual que cuando el scanner los encontraba.
+void Parser::reachToken(size_t index) {
+    const vector<TokenBuffer::LexError>& errors = tokens.errors();
+    while (nextError < errors.size() && errors[nextError].before <= index) {
+        const TokenBuffer::LexError& e = errors[nextError++];
+        report(DG_SIMBOLO, e.line, e.lexeme, TK_ERROR);
+    }
+    if (index > scanned)
+        scanned = index;
+}
+
 // obtiene siguiente token
 void Parser::nextToken() {
-    while (true) {
-        if (hasLookahead) {
+    // despues de stop() (aun en medio de este bucle, por un error lexico)
+    // el token actual queda EOF
+    while (!aborted) {
+        if (useBuffer) {
+            reachToken(cursor);
+            if (aborted)
+                break;
+            currentToken = tokens.kind(cursor);
+            currentLexeme = tokens.lexeme(cursor);
+            currentLine = tokens.line(cursor);
+            currentSymbol = tokens.symbol(cursor);
+            if (cursor + 1 < tokens.size()) {
+                currentColumn = columnOf(currentToken, currentLexeme);
+                cursor++;
+            } else {
+                currentColumn = 0;  // EOF (se repite)
+            }
+        } else if (hasLookahead) {
             currentToken = lookaheadToken;
             currentLexeme = lookaheadLexeme;
+            currentLine = lookaheadLine;
+            currentColumn = lookaheadColumn;
+            currentSymbol = lookaheadSymbol;
             hasLookahead = false;
         } else {
-            currentToken = yylex();
-            if (currentToken == 0)
-                currentToken = TK_EOF;
-            currentLexeme = yytext ? yytext : "";
+            // ya nadie apunta a los lexemas copiados antes
+            stdioText.clear();
+            SourcePos pos;
+            currentToken = scanToken(currentLexeme, pos, currentSymbol);
+            currentLine = pos.line;
+            currentColumn = pos.column;
         }
 
-        if (currentToken == TK_EOF)
-            currentLexeme.clear();
-
         if (currentToken == TK_ERROR) {
-            reportError(string("Error lexico en linea ") + to_string(yylineno) +
-                        ": simbolo invalido '" + currentLexeme + "'");
+            report(DG_SIMBOLO, currentLine, currentLexeme, TK_ERROR);
             hasLookahead = false;
             continue;
         }
 
         if (trace) {
-            cout << "[TOKEN] " << tokenName(currentToken) << " -> ";
+            *out << "[TOKEN] " << tokenName(currentToken) << " -> ";
             if (currentToken == TK_EOF) {
-                cout << "<EOF>";
+                *out << "<EOF>";
             } else if (currentToken == TK_NL) {
-                cout << "\\n";
+                *out << "\\n";
             } else {
-                cout << currentLexeme;
+                out->write(lexemeData(currentLexeme), currentLexeme.length);
             }
-            cout << endl;
+            *out << endl;
         }
         break;
     }
 }
 
-// mira el proximo token sin consumirlo
-int Parser::peekToken() {
-    while (true) {
+// mira el k-esimo token siguiente sin consumirlo
+int Parser::peekToken(size_t k) {
+    if (useBuffer) {
+        reachToken(cursor + k - 1);
+        return aborted ? TK_EOF : tokens.kind(cursor + k - 1);
+    }
+
+    while (!aborted) {
         if (!hasLookahead) {
-            lookaheadToken = yylex();
-            if (lookaheadToken == 0)
-                lookaheadToken = TK_EOF;
-            lookaheadLexeme = yytext ? yytext : "";
-            if (lookaheadToken == TK_EOF)
-                lookaheadLexeme.clear();
+            SourcePos pos;
+            lookaheadToken = scanToken(lookaheadLexeme, pos, lookaheadSymbol);
+            lookaheadLine = pos.line;
+            lookaheadColumn = pos.column;
             hasLookahead = true;
         }
 
         if (lookaheadToken == TK_ERROR) {
-            reportError(string("Error lexico en linea ") + to_string(yylineno) +
-                        ": simbolo invalido '" + lookaheadLexeme + "'");
+            report(DG_SIMBOLO, lookaheadLine, lookaheadLexeme, TK_ERROR);
             hasLookahead = false;
             continue;
         }
 
         return lookaheadToken;
     }
+    return TK_EOF;
 }
 
 // salta saltos de linea
@@ -86,21 +261,94 @@ void Parser::skipNL() {
         nextToken();
 }
 
-void Parser::reportError(const std::string& message) {
+// Guarda el registro; el mensaje se arma al final del analisis (con --trace
+// enseguida, para que quede entre los tokens). Llegado a maxErrors se corta.
+void Parser::report(DiagCode code, int line, const Lexeme& lexeme, int found, int expected,
+                    unsigned value) {
     hadError = true;
-    cerr << message << endl;
+    if (aborted)
+        return;
+    Diagnostic d{};
+    d.code = code;
+    d.expected = (uint8_t)(expected - TK_ID);
+    d.found = (uint8_t)(found - TK_ID);
+    d.line = (uint32_t)line;
+    d.length = (uint32_t)lexeme.length;
+    d.value = value;
+    if (lexemesInSource()) {
+        d.offset = (uint32_t)lexeme.offset;
+    } else {
+        d.inPool = true;
+        d.offset = diags.keep(lexemeData(lexeme), lexeme.length);
+    }
+    diags.add(d);
+    if (trace && diagFormat == DiagFormat::Text)
+        diags.flush(*err, sourceText());
+    if (diags.full()) {
+        stopped = true;
+        stop();
+    }
 }
 
-void Parser::synchronize(std::initializer_list<int> recoveryTokens) {
-    if (currentToken == TK_EOF)
+// De aqui en mas todo es EOF: lo abierto se cierra solo, sin mas mensajes
+void Parser::stop() {
+    aborted = true;
+    hasLookahead = false;
+    currentToken = TK_EOF;
+    currentLexeme = {0, 0};
+}
+
+// el texto al que apuntan los lexemas de los registros (si no, estan copiados)
+const char* Parser::sourceText() const {
+    return lexemesInSource() ? source.data() : nullptr;
+}
+
+// Antes de abrir un nivel mas (ExprFrame o NestFrame). Pasado maxDepth no hay
+// recuperacion que sirva: se reporta una vez y se salta a EOF, donde todo lo
+// abierto se cierra solo, sin mas mensajes y en tiempo lineal.
+void Parser::checkDepth() {
+    size_t depth = exprStack.size() + nest.size() + 1;
+    if (depth > deepest)
+        deepest = depth;
+    if (maxDepth == 0 || depth <= maxDepth || aborted)
+        return;
+    report(DG_ANIDAMIENTO, currentLine, currentLexeme, currentToken, TK_EOF, maxDepth);
+    stop();
+}
+
+// Igual, para un nodo recien armado: sus niveles mas los bloques que lo
+// contienen
+void Parser::checkHeight(uint32_t height) {
+    size_t depth = height + nest.size();
+    if (depth > deepest)
+        deepest = depth;
+    if (maxDepth == 0 || depth <= maxDepth || aborted)
         return;
+    report(DG_ANIDAMIENTO, currentLine, currentLexeme, currentToken, TK_EOF, maxDepth);
+    stop();
+}
 
+// Conjuntos de recuperacion (grammar.h): synchronize salta tokens hasta uno
+// de estos, un salto de linea o EOF.
+// match: el fin de una expresion o de un bloque, o el comienzo de un comando
+// (salvo una asignacion: un ID cualquiera) o de una funcion
+static constexpr TokenSet matchRecovery = followSet(NT_EXP) | followSet(NT_BLOQUE) |
+                                          firstSet(NT_FUNCION) |
+                                          firstSet(NT_COMANDO).without(TK_ID);
+// tipo invalido: donde termina una declaracion o un parametro, o '=' y ']'
+static constexpr TokenSet tipoRecovery = followSet(NT_PARAMETRO) | followSet(NT_DECLVAR) |
+                                         followSet(NT_BLOQUE) | TokenSet{TK_ASSIGN, TK_RBRACKET};
+// comando invalido: el que sigue, el fin del bloque o una funcion
+static constexpr TokenSet comandoRecovery = followSet(NT_COMANDO) | followSet(NT_BLOQUE) |
+                                            firstSet(NT_FUNCION);
+// expresion invalida: donde termina la expresion o el bloque
+static constexpr TokenSet expRecovery = followSet(NT_EXP) | followSet(NT_BLOQUE);
+
+// un solo test de bit por token salteado
+void Parser::synchronize(TokenSet recovery) {
     while (currentToken != TK_EOF) {
-        for (int token : recoveryTokens) {
-            if (currentToken == token) {
-                return;
-            }
-        }
+        if (recovery.has(currentToken))
+            return;
 
         if (currentToken == TK_NL) {
             nextToken();
@@ -116,13 +364,9 @@ void Parser::match(int expected) {
     if (currentToken == expected)
         nextToken();
     else {
-        reportError(string("Error sintactico en linea ") + to_string(yylineno) +
-                     ": se esperaba " + tokenName(expected) +
-                     " y se encontro '" + currentLexeme +
-                     "' (" + tokenName(currentToken) + ")");
+        report(DG_ESPERADO, currentLine, currentLexeme, currentToken, expected);
 
-        synchronize({expected, TK_END, TK_ELSE, TK_LOOP, TK_FUN, TK_RETURN,
-                     TK_IF, TK_WHILE, TK_RPAREN, TK_RBRACKET, TK_COMMA, TK_NL});
+        synchronize(matchRecovery.with(expected));
 
         if (currentToken == expected)
             nextToken();
@@ -131,94 +375,282 @@ void Parser::match(int expected) {
 
 // helpers
 bool Parser::is_decl_start() {
-    return currentToken == TK_FUN || currentToken == TK_ID;
+    return firstSet(NT_DECL).has(currentToken);
 }
 
 bool Parser::is_type_start() {
-    return currentToken == TK_INT || currentToken == TK_BOOL ||
-           currentToken == TK_CHAR || currentToken == TK_STRING ||
-           currentToken == TK_LBRACKET;
+    return firstSet(NT_TIPO).has(currentToken);
 }
 
 bool Parser::is_comando_start() {
-    return currentToken == TK_IF || currentToken == TK_WHILE ||
-           currentToken == TK_RETURN || currentToken == TK_ID;
-}
-
-const char* Parser::tokenName(int token) const {
-    switch (token) {
-        case TK_ID: return "TK_ID";
-        case TK_LITNUM: return "TK_LITNUM";
-        case TK_LITSTRING: return "TK_LITSTRING";
-        case TK_TRUE: return "TK_TRUE";
-        case TK_FALSE: return "TK_FALSE";
-        case TK_FUN: return "TK_FUN";
-        case TK_IF: return "TK_IF";
-        case TK_ELSE: return "TK_ELSE";
-        case TK_END: return "TK_END";
-        case TK_WHILE: return "TK_WHILE";
-        case TK_LOOP: return "TK_LOOP";
-        case TK_RETURN: return "TK_RETURN";
-        case TK_NEW: return "TK_NEW";
-        case TK_INT: return "TK_INT";
-        case TK_BOOL: return "TK_BOOL";
-        case TK_CHAR: return "TK_CHAR";
-        case TK_STRING: return "TK_STRING";
-        case TK_AND: return "TK_AND";
-        case TK_OR: return "TK_OR";
-        case TK_NOT: return "TK_NOT";
-        case TK_PLUS: return "TK_PLUS";
-        case TK_MINUS: return "TK_MINUS";
-        case TK_MUL: return "TK_MUL";
-        case TK_DIV: return "TK_DIV";
-        case TK_GT: return "TK_GT";
-        case TK_LT: return "TK_LT";
-        case TK_GE: return "TK_GE";
-        case TK_LE: return "TK_LE";
-        case TK_EQ: return "TK_EQ";
-        case TK_NEQ: return "TK_NEQ";
-        case TK_LPAREN: return "TK_LPAREN";
-        case TK_RPAREN: return "TK_RPAREN";
-        case TK_LBRACKET: return "TK_LBRACKET";
-        case TK_RBRACKET: return "TK_RBRACKET";
-        case TK_COLON: return "TK_COLON";
-        case TK_COMMA: return "TK_COMMA";
-        case TK_ASSIGN: return "TK_ASSIGN";
-        case TK_NL: return "TK_NL";
-        case TK_EOF: return "TK_EOF";
-        case TK_ERROR: return "TK_ERROR";
-        default: return "UNKNOWN";
-    }
+    return firstSet(NT_COMANDO).has(currentToken);
 }
 
 // inicio del analisis
 // el archivo y lanza el recorrido recursivo.
 void Parser::parse(const string& filename) {
-    yyin = fopen(filename.c_str(), "r");
-    if (!yyin) {
-        cerr << "No se pudo abrir archivo\n";
-        exit(1);
+    YY_BUFFER_STATE buffer = nullptr;
+    FILE* input = nullptr;
+    bool opened = false;
+
+    useBuffer = false;
+    useFast = backend == LexerBackend::Fast;
+    // antes de lexear: en modo Buffered los simbolos se internan en fill()
+    tree.clear();
+    work.clear();
+    exprHeight.clear();
+    stmtHeight.clear();
+    blockHeight.clear();
+    diags.clear();
+    diags.setLimit(maxErrors);
+    bool buffered = lexMode == LexMode::Buffered;
+    // FastLexer y el modo Buffered necesitan el texto entero en memoria
+    if (inputMode == InputMode::InMemory || buffered || useFast) {
+        if (source.open(filename, useFast)) {  // FastLexer no escribe: puede ir sobre un mmap
+            if (useFast) {
+                fast.reset(source.data(), source.size());
+                opened = true;
+            } else {
+                buffer = yy_scan_buffer(source.scanBase(), source.scanSize(), scanner);
+                opened = buffer != nullptr;
+            }
+        }
+    } else {
+        input = fopen(filename.c_str(), "r");
+        if (input) {
+            buffer = yy_create_buffer(input, 16384, scanner);
+            yy_switch_to_buffer(buffer, scanner);
+            opened = true;
+        }
     }
 
+    if (!opened) {
+        // no hacemos exit(): puede haber otros parsers corriendo en el proceso
+        hadError = true;
+        Diagnostic d{};
+        d.code = DG_ARCHIVO;
+        d.found = (uint8_t)(TK_ERROR - TK_ID);
+        d.inPool = true;  // no hay fuente: ni columna ni offset
+        d.offset = diags.keep("", 0);
+        diags.add(d);
+        if (diagFormat == DiagFormat::Text)
+            diags.flush(*err, nullptr);
+        if (input)
+            fclose(input);
+        return;
+    }
+
+    // el numero de linea vive en el scanner, no en el buffer
+    if (buffer)
+        yyset_lineno(1, scanner);
+    // los offsets del TokenBuffer son de 32 bits
+    useBuffer = buffered && source.size() <= UINT32_MAX;
+    if (useBuffer && useFast)
+        tokens.fill(fast, source.data(), &tree.symbols);
+    else if (useBuffer)
+        tokens.fill(scanner, source.data(), &tree.symbols);
+    run();
+
+    if (buffer)
+        yy_delete_buffer(buffer, scanner);
+    if (input)
+        fclose(input);
+    // source y tokens quedan vivos hasta el proximo parse: las vistas siguen validas
+}
+
+// analiza el buffer actual del scanner de principio a fin
+void Parser::run() {
+    hadError = false;
+    aborted = false;
+    stopped = false;
+    deepest = 0;
+    exprStack.clear();
+    nest.clear();
     hasLookahead = false;
+    cursor = 0;
+    scanned = 0;
+    nextError = 0;
     lookaheadToken = TK_EOF;
-    lookaheadLexeme.clear();
-    currentLexeme.clear();
+    lookaheadLexeme = {0, 0};
+    currentLexeme = {0, 0};
+    currentColumn = 0;
+    lookaheadColumn = 0;
+    lineStart = 0;
+    stdioText.clear();
     nextToken();
-    programa();
+    if (engine == ParserEngine::Table)
+        ll1();
+    else
+        programa();
+    tree.setText(lexemesInSource() ? source.data() : tree.ownText.data());
+    tree.setSource(sourceText(), lexemesInSource() ? source.size() : 0);
 
     if (currentToken != TK_EOF) {
-        reportError(string("Error sintactico en linea ") + to_string(yylineno) +
-                     ": tokens extra despues del programa");
+        report(DG_EXTRA, currentLine, currentLexeme, currentToken);
         while (currentToken != TK_EOF)
             nextToken();
     }
 
+    // con json la salida es solo JSON, como en lote
+    if (diagFormat == DiagFormat::Json)
+        return;
     if (!hadError)
-        cout << "Analisis sintactico exitoso\n";
-    else
-        cerr << "Analisis completado con errores\n";
-    fclose(yyin);
+        *out << "Analisis sintactico exitoso\n";
+    diags.flush(*err, sourceText());
+    if (stopped)
+        *err << "Analisis detenido despues de " << diags.size()
+             << (diags.size() == 1 ? " error" : " errores") << " (--max-errors)\n";
+    if (hadError)
+        *err << "Analisis completado con errores\n";
+}
+
+void Parser::flushDiagnostics(ostream& errStream) {
+    diags.flush(errStream, sourceText());
+    if (diags.dropped() && !stopped)
+        errStream << "Analisis detenido despues de " << diags.size()
+                  << (diags.size() == 1 ? " error" : " errores") << " (--max-errors)\n";
+}
+
+void Parser::writeDiagnostics(ostream& errStream, const string& file) const {
+    diags.writeJson(errStream, file, sourceText(), stoppedEarly());
+}
+
+// Motor LL(1): la pila tiene no terminales, acciones y tokens de ll1.h
+// (en ese orden de valores, no se pisan). Los terminales pasan por match,
+// las acciones arman el arbol (ll1Action) y los huecos de la tabla dan los
+// mismos mensajes y recuperaciones que el parser a mano, asi los
+// diagnosticos coinciden. Tampoco recursa: los niveles que abren las
+// acciones van a exprStack y nest, y maxDepth corta donde cortaria el.
+void Parser::ll1() {
+    llStack.clear();
+    llMarks.clear();
+    llValues.clear();
+    llTypes.clear();
+    llLists.clear();
+    llPending = NestFrame{};
+    llStack.push_back(LL_PROGRAMA);
+    while (!llStack.empty()) {
+        int symbol = llStack.back();
+        llStack.pop_back();
+        if (symbol >= TK_ID) {
+            match(symbol);
+            continue;
+        }
+        if (symbol >= LL_COUNT) {
+            ll1Action(symbol);
+            continue;
+        }
+        uint8_t rule = llTable.at(symbol, currentToken);
+        if (rule == llNoRule) {
+            ll1Error(symbol);
+            continue;
+        }
+        const LlProduction& p = llGrammar[rule];
+        for (int i = p.length - 1; i >= 0; i--)
+            llStack.push_back(p.body[i]);
+    }
+}
+
+// el no terminal se abandona, como cuando la funcion del parser a mano vuelve,
+// y deja lo que ella devuelve: asi las pilas de las acciones siguen parejas
+void Parser::ll1Error(int nonterminal) {
+    DiagCode code = DG_COMANDO;
+    TokenSet recovery = comandoRecovery;
+    switch (llErrorOf(nonterminal)) {
+        case LE_TIPO:
+            code = DG_TIPO;
+            recovery = tipoRecovery;
+            llTypes.push_back(TY_ERROR);
+            break;
+        case LE_ASIG:
+            // cmdatrib no arma el comando: se descartan el destino y su ID
+            code = DG_ASIGNACION;
+            llValue();
+            llMark();
+            break;
+        case LE_EXP:
+            code = DG_EXPRESION;
+            recovery = expRecovery;
+            llValues.push_back(noNode);
+            break;
+        default:
+            break;
+    }
+    report(code, currentLine, currentLexeme, currentToken);
+    synchronize(recovery);
+}
+
+// construccion del arbol 
+
+// literal: vista al fuente, o copia si el fuente no queda en memoria
+Span Parser::keep(const Lexeme& lexeme) {
+    if (lexemesInSource())
+        return {(uint32_t)lexeme.offset, (uint32_t)lexeme.length};
+    Span span{(uint32_t)tree.ownText.size(), (uint32_t)lexeme.length};
+    tree.ownText.append(lexemeData(lexeme), lexeme.length);
+    return span;
+}
+
+NodeId Parser::newExpr(ExprKind kind, SourcePos at) {
+    Expr e{};
+    e.kind = kind;
+    e.line = (uint32_t)at.line;
+    e.column = (uint16_t)at.column;
+    e.sym = noSymbol;
+    e.lhs = noNode;
+    e.rhs = noNode;
+    exprHeight.push_back(1);
+    return tree.addExpr(e);
+}
+
+NodeId Parser::binary(int op, NodeId lhs, NodeId rhs, SourcePos at) {
+    NodeId id = newExpr(ExprKind::Binary, at);
+    Expr& e = tree.exprs[id];
+    e.op = (uint8_t)(op - TK_ID);
+    e.lhs = lhs;
+    e.rhs = rhs;
+    return measure(id);
+}
+
+NodeId Parser::measure(NodeId id) {
+    const Expr& e = tree.exprs[id];
+    uint32_t height = max(exprLevels(e.lhs), exprLevels(e.rhs));
+    for (const NodeId* a = tree.begin(e.args); a != tree.end(e.args); a++)
+        height = max(height, exprLevels(*a));
+    exprHeight[id] = height + 1;
+    checkHeight(height + 1);
+    return id;
+}
+
+uint32_t Parser::levels(const Stmt& st) const {
+    return 1 + max(max(exprLevels(st.target), exprLevels(st.value)),
+                   max(blockLevels(st.body), blockLevels(st.orelse)));
+}
+
+NodeId Parser::addStmt(const Stmt& st) {
+    stmtHeight.push_back(levels(st));
+    checkHeight(stmtHeight.back());
+    return tree.addStmt(st);
+}
+
+NodeId Parser::addBlock(const Block& block) {
+    uint32_t height = 0;
+    for (const NodeId* s = tree.begin(block.stmts); s != tree.end(block.stmts); s++)
+        height = max(height, stmtHeight[*s]);
+    blockHeight.push_back(height);
+    return tree.addBlock(block);
+}
+
+static Stmt newStmt(StmtKind kind, SourcePos at) {
+    Stmt st{};
+    st.kind = kind;
+    st.line = (uint32_t)at.line;
+    st.column = (uint16_t)at.column;
+    st.target = noNode;
+    st.value = noNode;
+    st.body = noNode;
+    st.orelse = noNode;
+    return st;
 }
 
 // programa 
@@ -247,52 +679,178 @@ void Parser::decl() {
 // declaraciones 
 
 void Parser::globalDecl() {
-    declvar();
+    tree.globals.push_back(declvar());
 }
 
 // funcion: fun ID() : tipo  NL  bloque  end NL 
 // funcion -> 'fun' ID '(' params ')' opt_tipo bloque 'end'
 void Parser::funcion() {
+    Func f{};
+    f.line = (uint32_t)currentLine;
+    f.column = (uint16_t)currentColumn;
     match(TK_FUN);
+    f.name = currentSymbol;
     match(TK_ID);
     match(TK_LPAREN);
+    size_t first = work.size();
     params();
+    f.params = tree.makeList(work, first);
     match(TK_RPAREN);
-    opt_tipo();
+    f.ret = opt_tipo();
 
     // SOLO avanzar si hay salto de linea
     if (currentToken == TK_NL)
         nextToken();
 
-    bloque();  // NO pongas skipNL antes
+    f.body = bloque();  // NO pongas skipNL antes
 
     match(TK_END);
 
     if (currentToken == TK_NL)
         nextToken();
+
+    tree.addFunc(f);
 }
 
 // tipo opcional despues de ':' 
-void Parser::opt_tipo() {
+TypeId Parser::opt_tipo() {
     if (currentToken == TK_COLON) {
         match(TK_COLON);
-        tipo();     // NO LLAMES nextToken() acá
+        return tipo();     // NO LLAMES nextToken() acá
     }
+    return TY_VOID;
 }
 
 // bloque = declaraciones + comandos
-void Parser::bloque() {
+// cmdif -> 'if' exp bloque else_if_list opt_else 'end'
+// else_if_list -> 'else' 'if' exp bloque else_if_list | epsilon
+// opt_else -> 'else' bloque | epsilon
+// cmdwhile -> 'while' exp bloque 'loop'
+// Los if y while no recursan: cada bloque abierto es un NestFrame en 'nest'
+// y cuando no hay mas comandos se cierra el de arriba y se sigue con el
+// comando al que pertenece. El anidamiento no gasta pila de C++.
+NodeId Parser::bloque() {
+    NestFrame root{};
+    root.kind = NF_BLOCK;
+    openBlock(root);
+    while (true) {
+        skipNL();
+        if (currentToken == TK_IF || currentToken == TK_WHILE) {
+            NestFrame frame{};
+            frame.kind = currentToken == TK_IF ? NF_IF : NF_WHILE;
+            frame.st = newStmt(currentToken == TK_IF ? StmtKind::If : StmtKind::While, here());
+            nextToken();
+            frame.st.value = exp();
+            skipNL();
+            openBlock(frame);
+            continue;
+        }
+        if (is_comando_start()) {
+            NodeId st = comando();
+            if (st != noNode)
+                work.push_back(st);
+            continue;
+        }
+
+        // no hay mas comandos: se cierra el bloque de arriba
+        NestFrame& top = nest.back();
+        top.block.stmts = tree.makeList(work, top.first);
+        NodeId body = addBlock(top.block);
+        if (top.kind == NF_BLOCK) {  // el cuerpo de la funcion
+            nest.pop_back();
+            return body;
+        }
+        if (top.kind == NF_WHILE) {
+            Stmt st = top.st;
+            st.body = body;
+            nest.pop_back();
+            skipNL();
+            match(TK_LOOP);
+            work.push_back(addStmt(st));
+            continue;
+        }
+        if (top.kind == NF_ELSE) {
+            skipNL();
+            match(TK_END);
+            finishIf(body);
+            continue;
+        }
+        if (top.kind == NF_IF) {
+            top.st.body = body;
+            skipNL();
+            top.arms = work.size();
+        } else {
+            top.arm.body = body;
+            work.push_back(addStmt(top.arm));
+            skipNL();
+        }
+
+        // despues del cuerpo de un if o de un else if
+        if (currentToken == TK_ELSE && peekToken() == TK_IF) {
+            match(TK_ELSE);
+            top.kind = NF_ELSEIF;
+            top.arm = newStmt(StmtKind::If, here());
+            match(TK_IF);
+            top.arm.value = exp();
+            skipNL();
+        } else if (currentToken == TK_ELSE) {
+            match(TK_ELSE);
+            top.kind = NF_ELSE;
+            skipNL();
+        } else {
+            match(TK_END);
+            finishIf(noNode);
+            continue;
+        }
+        // el mismo nivel sigue con otro bloque
+        NestFrame frame = top;
+        nest.pop_back();
+        openBlock(frame);
+    }
+}
+
+// bloque -> declvar_list comando_list: deja el bloque abierto en 'nest' con
+// las variables puestas; los comandos se juntan en 'work' desde frame.first
+void Parser::openBlock(NestFrame& frame) {
+    checkDepth();
     skipNL();
+    frame.first = work.size();
     declvar_list();
+    frame.block = Block{};
+    frame.block.vars = tree.makeList(work, frame.first);
     skipNL();
-    comando_list();
+    nest.push_back(frame);
+}
+
+// cierra el if de arriba de 'nest' (con su else, o noNode), despues del 'end'
+void Parser::finishIf(NodeId orelse) {
+    NestFrame& top = nest.back();
+
+    // else if encadenados: cada uno es un if dentro del else del anterior
+    while (work.size() > top.arms) {
+        NodeId arm = work.back();
+        tree.stmts[arm].orelse = orelse;
+        // el else se cuelga despues de armar el brazo: cada uno queda un
+        // nivel mas adentro del anterior
+        stmtHeight[arm] = levels(tree.stmts[arm]);
+        checkHeight(stmtHeight[arm]);
+
+        Block wrapper{};
+        wrapper.stmts = tree.makeList(work, work.size() - 1);
+        orelse = addBlock(wrapper);
+    }
+
+    Stmt st = top.st;
+    st.orelse = orelse;
+    nest.pop_back();
+    work.push_back(addStmt(st));
 }
 
 // reconoce declaracion solo si es ID ':' 
 // declvar_list -> declvar declvar_list | epsilon
 void Parser::declvar_list() {
     while (currentToken == TK_ID && peekToken() == TK_COLON) {
-        declvar();
+        work.push_back(declvar());
         skipNL();
     }
 }
@@ -300,7 +858,7 @@ void Parser::declvar_list() {
 // params -> parametro params_tail | epsilon
 void Parser::params() {
     if (currentToken == TK_ID) {
-        parametro();
+        work.push_back(parametro());
         params_tail();
     }
 }
@@ -309,156 +867,112 @@ void Parser::params() {
 void Parser::params_tail() {
     while (currentToken == TK_COMMA) {
         match(TK_COMMA);
-        parametro();
+        work.push_back(parametro());
     }
 }
 
 // parametro -> ID ':' tipo
-void Parser::parametro() {
-    match(TK_ID);
-    match(TK_COLON);
-    tipo();
+NodeId Parser::parametro() {
+    return declvar();
 }
 
 // x : int 
 // declvar -> ID ':' tipo
-void Parser::declvar() {
+NodeId Parser::declvar() {
+    VarDecl v{};
+    v.line = (uint32_t)currentLine;
+    v.column = (uint16_t)currentColumn;
+    v.name = currentSymbol;
     match(TK_ID);
     match(TK_COLON);
-    tipo();
+    v.type = tipo();
+    return tree.addVar(v);
 }
 
-// tipo
-void Parser::tipo() {
-    if (currentToken == TK_LBRACKET) {
+// tipo -> '[' ']' tipo | tipobase, contando los '[ ]' en vez de recursar
+TypeId Parser::tipo() {
+    size_t arrays = 0;
+    while (currentToken == TK_LBRACKET) {
         match(TK_LBRACKET);
         match(TK_RBRACKET);  // << ESTA ES LA CORRECCION
-        tipo();
-    } else tipobase();
+        arrays++;
+    }
+    TypeId type = tipobase();
+    for (; arrays > 0; arrays--)
+        type = tree.types.arrayOf(type);
+    return type;
 }
 
-void Parser::tipobase() {
+TypeId Parser::tipobase() {
+    TypeId base = TY_ERROR;
+    switch (currentToken) {
+        case TK_INT: base = TY_INT; break;
+        case TK_BOOL: base = TY_BOOL; break;
+        case TK_CHAR: base = TY_CHAR; break;
+        case TK_STRING: base = TY_STRING; break;
+    }
+
     if (is_type_start())
         nextToken();
     else {
-        reportError(string("Error sintactico en linea ") + to_string(yylineno) +
-                     ": tipo base esperado");
-        synchronize({TK_COMMA, TK_RPAREN, TK_END, TK_ELSE, TK_LOOP,
-                     TK_NL, TK_ASSIGN, TK_RBRACKET});
+        report(DG_TIPO, currentLine, currentLexeme, currentToken);
+        synchronize(tipoRecovery);
     }
+    return base;
 }
 
 // comandos 
 
-void Parser::comando_list() {
-    skipNL();
-    while (is_comando_start()) {
-        comando();
-        skipNL();
-    }
-}
-
-// comando -> if | while | return | asignacion | llamada
-void Parser::comando() {
-    if (currentToken == TK_IF) cmdif();
-    else if (currentToken == TK_WHILE) cmdwhile();
-    else if (currentToken == TK_RETURN) cmdreturn();
-    else if (currentToken == TK_ID) cmdatrib();
+// comando -> if | while | return | asignacion | llamada (if y while en bloque)
+NodeId Parser::comando() {
+    if (currentToken == TK_RETURN) return cmdreturn();
+    else if (currentToken == TK_ID) return cmdatrib();
     else {
-        reportError(string("Error sintactico en linea ") + to_string(yylineno) +
-                     ": comando invalido");
-        synchronize({TK_NL, TK_END, TK_ELSE, TK_LOOP, TK_FUN, TK_EOF});
-    }
-}
-
-// if ... end
-// cmdif -> 'if' exp bloque else_if_list opt_else 'end'
-void Parser::cmdif() {
-    match(TK_IF);
-    exp();
-    skipNL();
-
-    bloque();
-    skipNL();
-
-    else_if_list();
-    opt_else();
-
-    match(TK_END);
-}
-
-void Parser::else_if_list() {
-    while (currentToken == TK_ELSE && peekToken() == TK_IF) {
-        match(TK_ELSE);
-        match(TK_IF);
-        exp();
-        skipNL();
-        bloque();
-        skipNL();
+        report(DG_COMANDO, currentLine, currentLexeme, currentToken);
+        synchronize(comandoRecovery);
+        return noNode;
     }
 }
 
-void Parser::opt_else() {
-    if (currentToken == TK_ELSE) {
-        match(TK_ELSE);
-        skipNL();
-        bloque();
-        skipNL();
-    }
-}
-
-// while ... loop 
-// cmdwhile -> 'while' exp bloque 'loop'
-void Parser::cmdwhile() {
-    match(TK_WHILE);
-    exp();
-    skipNL();
-    bloque();
-    skipNL();
-    match(TK_LOOP);
-}
-
 // return exp? 
-void Parser::cmdreturn() {
+NodeId Parser::cmdreturn() {
+    Stmt st = newStmt(StmtKind::Return, here());
     match(TK_RETURN);
-    if (currentToken != TK_NL &&
-        currentToken != TK_END &&
-        currentToken != TK_ELSE &&
-        currentToken != TK_LOOP &&
-        currentToken != TK_EOF)
-        exp();
+    // sin valor si ya termina el comando (o el bloque)
+    if (!(followSet(NT_CMDRETURN) | followSet(NT_BLOQUE)).with(TK_EOF).has(currentToken))
+        st.value = exp();
+    return addStmt(st);
 }
 
 // asignacion o llamada
 // cmdatrib -> var '=' exp | llamada
-void Parser::cmdatrib() {
+NodeId Parser::cmdatrib() {
     if (peekToken() == TK_LPAREN) {
-        llamada();
-        return;
+        Stmt st = newStmt(StmtKind::Call, here());
+        st.value = llamada();
+        return addStmt(st);
     }
 
-    var();
+    Stmt st = newStmt(StmtKind::Assign, here());
+    st.target = var();
 
     if (currentToken == TK_ASSIGN) {
         match(TK_ASSIGN);
-        exp();
+        st.value = exp();
+        return addStmt(st);
     }
     else {
-        reportError(string("Error sintactico en linea ") + to_string(yylineno) +
-                     ": se esperaba '=' o una llamada a funcion");
-        synchronize({TK_NL, TK_END, TK_ELSE, TK_LOOP, TK_FUN, TK_EOF});
+        report(DG_ASIGNACION, currentLine, currentLexeme, currentToken);
+        synchronize(comandoRecovery);
+        return noNode;
     }
 }
 
 // lista de expresiones
 // listaexp -> exp listaexp_tail | epsilon
 void Parser::listaexp() {
-    if (currentToken == TK_ID || currentToken == TK_LITNUM ||
-        currentToken == TK_LITSTRING || currentToken == TK_TRUE ||
-        currentToken == TK_FALSE || currentToken == TK_NEW ||
-        currentToken == TK_LPAREN || currentToken == TK_MINUS ||
-        currentToken == TK_NOT) {
-        exp();
+    if (firstSet(NT_EXP).has(currentToken)) {
+        work.push_back(exp());
         listaexp_tail();
     }
 }
@@ -466,154 +980,525 @@ void Parser::listaexp() {
 void Parser::listaexp_tail() {
     while (currentToken == TK_COMMA) {
         match(TK_COMMA);
-        exp();
+        work.push_back(exp());
     }
 }
 
-void Parser::llamada() {
+NodeId Parser::llamada() {
+    SourcePos at = here();
+    Symbol name = currentSymbol;
     match(TK_ID);
     match(TK_LPAREN);
+    size_t first = work.size();
     listaexp();
+    List args = tree.makeList(work, first);
     match(TK_RPAREN);
+
+    NodeId id = newExpr(ExprKind::Call, at);
+    tree.exprs[id].sym = name;
+    tree.exprs[id].args = args;
+    return measure(id);
 }
 
 // variable con indices 
-void Parser::var() {
+NodeId Parser::var() {
+    NodeId id = newExpr(ExprKind::Var, here());
+    tree.exprs[id].sym = currentSymbol;
     match(TK_ID);
-    var_sufijo();
+    return var_sufijo(id);
 }
 
-void Parser::var_sufijo() {
+NodeId Parser::var_sufijo(NodeId base) {
     while (currentToken == TK_LBRACKET) {
+        SourcePos at = here();
         match(TK_LBRACKET);
-        exp();
+        NodeId index = exp();
         match(TK_RBRACKET);
+
+        NodeId id = newExpr(ExprKind::Index, at);
+        tree.exprs[id].lhs = base;
+        tree.exprs[id].rhs = index;
+        base = measure(id);
     }
+    return base;
 }
 
 // expresiones 
 
-void Parser::exp() { exp_or(); }
-
-// or
-void Parser::exp_or() {
-    exp_and();
-    exp_or_p();
+// Fuerza de cada operador binario, indexada por token - TK_ID: or 1, and 2,
+// = <> 3, relacionales 4, + - 5, * / 6 (los unarios ligan mas que todos).
+// op es el operador que queda en el arbol: dentro de una expresion '=' compara
+// igual que '=='. Lo que no es operador tiene fuerza 0 y corta el bucle.
+struct BindingPower {
+    uint8_t power;
+    uint8_t op;  // token - TK_ID
+};
+
+static constexpr array<BindingPower, TK_ERROR - TK_ID + 1> bindingPowers = [] {
+    array<BindingPower, TK_ERROR - TK_ID + 1> table{};
+    auto set = [&](int token, int power, int op) {
+        table[token - TK_ID] = {(uint8_t)power, (uint8_t)(op - TK_ID)};
+    };
+    set(TK_OR, 1, TK_OR);
+    set(TK_AND, 2, TK_AND);
+    set(TK_EQ, 3, TK_EQ);
+    set(TK_ASSIGN, 3, TK_EQ);
+    set(TK_NEQ, 3, TK_NEQ);
+    for (int op : {TK_LT, TK_LE, TK_GT, TK_GE})
+        set(op, 4, op);
+    set(TK_PLUS, 5, TK_PLUS);
+    set(TK_MINUS, 5, TK_MINUS);
+    set(TK_MUL, 6, TK_MUL);
+    set(TK_DIV, 6, TK_DIV);
+    return table;
+}();
+
+static inline BindingPower bindingPower(int token) {
+    unsigned index = (unsigned)(token - TK_ID);
+    return index < bindingPowers.size() ? bindingPowers[index] : BindingPower{0, 0};
 }
 
-void Parser::exp_or_p() {
-    while (currentToken == TK_OR) {
-        match(TK_OR);
-        exp_and();
-    }
-}
+// exp -> unario (op exp)*: se junta a la izquierda todo operador con fuerza
+// >= minPower y el lado derecho solo se lleva los que ligan mas (todos
+// asocian a la izquierda). Sin recursion: lo abierto (parentesis, indices, new, argumentos, unarios y
+// operadores que esperan su lado derecho) va en exprStack. Cada token cuesta
+// lo mismo sin importar cuan anidado este.
+NodeId Parser::exp(int minPower) {
+    checkDepth();
+    exprStack.push_back({EF_ROOT, 0, (uint8_t)minPower, here(), noNode, noSymbol, 0});
+    NodeId value = noNode;
+    bool operand = false;  // false: se espera un operando
+    while (true) {
+        if (!operand) {
+            SourcePos at = here();
+            switch (currentToken) {
+            case TK_MINUS:
+            case TK_NOT: {
+                uint8_t op = (uint8_t)(currentToken - TK_ID);  // checkDepth puede dejar EOF
+                checkDepth();
+                exprStack.push_back({EF_UNARY, op, 0, at, noNode, noSymbol, 0});
+                nextToken();
+                continue;
+            }
+            case TK_LPAREN:
+                match(TK_LPAREN);
+                checkDepth();
+                exprStack.push_back({EF_PAREN, 0, 0, at, noNode, noSymbol, 0});
+                continue;
+            case TK_NEW:
+                match(TK_NEW);
+                match(TK_LBRACKET);
+                checkDepth();
+                exprStack.push_back({EF_NEW, 0, 0, at, noNode, noSymbol, 0});
+                continue;
+            case TK_LITNUM:
+            case TK_LITSTRING:
+                value = newExpr(currentToken == TK_LITNUM ? ExprKind::Num : ExprKind::Str, at);
+                tree.exprs[value].text = keep(currentLexeme);
+                nextToken();
+                break;
+            case TK_TRUE:
+            case TK_FALSE:
+                value = newExpr(currentToken == TK_TRUE ? ExprKind::True : ExprKind::False, at);
+                nextToken();
+                break;
+            case TK_ID:
+                if (peekToken() == TK_LPAREN) {
+                    // llamada -> ID '(' listaexp ')'
+                    Symbol name = currentSymbol;
+                    match(TK_ID);
+                    match(TK_LPAREN);
+                    checkDepth();
+                    exprStack.push_back({EF_ARGS, 0, 0, at, noNode, name, work.size()});
+                    if (firstSet(NT_EXP).has(currentToken))
+                        continue;
+                    value = closeCall(exprStack.back());
+                    exprStack.pop_back();
+                    break;
+                }
+                // var -> ID var_sufijo
+                value = newExpr(ExprKind::Var, at);
+                tree.exprs[value].sym = currentSymbol;
+                match(TK_ID);
+                if (currentToken == TK_LBRACKET) {
+                    SourcePos open = here();
+                    match(TK_LBRACKET);
+                    checkDepth();
+                    exprStack.push_back({EF_INDEX, 0, 0, open, value, noSymbol, 0});
+                    continue;
+                }
+                break;
+            default:
+                report(DG_EXPRESION, currentLine, currentLexeme, currentToken);
+                synchronize(expRecovery);
+                value = noNode;
+                break;
+            }
+            operand = true;
+        }
 
-// and
-void Parser::exp_and() {
-    exp_eq();
-    exp_and_p();
-}
+        // hay un operando completo: primero los unarios que lo esperaban
+        while (exprStack.back().kind == EF_UNARY) {
+            const ExprFrame& f = exprStack.back();
+            NodeId id = newExpr(ExprKind::Unary, f.at);
+            tree.exprs[id].op = f.op;
+            tree.exprs[id].lhs = value;
+            value = measure(id);
+            exprStack.pop_back();
+        }
+        // despues los operadores que ligan al menos tanto como el que sigue
+        BindingPower bp = bindingPower(currentToken);
+        while (exprStack.back().kind == EF_BINARY && exprStack.back().power >= bp.power) {
+            const ExprFrame& f = exprStack.back();
+            value = binary(TK_ID + f.op, f.node, value, f.at);
+            exprStack.pop_back();
+        }
+        bp = bindingPower(currentToken);  // si binary corto por maxDepth, ya es EOF
+        ExprFrame& top = exprStack.back();
+        int floor = top.kind == EF_BINARY ? top.power + 1 : top.kind == EF_ROOT ? top.power : 1;
+        if (bp.power > 0 && bp.power >= floor) {
+            SourcePos at = here();
+            nextToken();
+            checkDepth();
+            exprStack.push_back({EF_BINARY, bp.op, bp.power, at, value, noSymbol, 0});
+            operand = false;
+            continue;
+        }
 
-void Parser::exp_and_p() {
-    while (currentToken == TK_AND) {
-        match(TK_AND);
-        exp_eq();
+        // el operando termina el contexto de arriba
+        ExprFrame f = top;
+        exprStack.pop_back();
+        switch (f.kind) {
+        case EF_ROOT:
+            return value;
+        case EF_PAREN:
+            match(TK_RPAREN);
+            break;
+        case EF_INDEX: {
+            match(TK_RBRACKET);
+            NodeId id = newExpr(ExprKind::Index, f.at);
+            tree.exprs[id].lhs = f.node;
+            tree.exprs[id].rhs = value;
+            value = measure(id);
+            if (currentToken == TK_LBRACKET) {
+                SourcePos open = here();
+                match(TK_LBRACKET);
+                checkDepth();
+                exprStack.push_back({EF_INDEX, 0, 0, open, value, noSymbol, 0});
+                operand = false;
+            }
+            break;
+        }
+        case EF_NEW: {
+            match(TK_RBRACKET);
+            TypeId type = tree.types.arrayOf(tipo());
+            NodeId id = newExpr(ExprKind::New, f.at);
+            tree.exprs[id].rhs = value;
+            tree.exprs[id].type = type;
+            value = measure(id);
+            break;
+        }
+        case EF_ARGS:
+            work.push_back(value);
+            if (currentToken == TK_COMMA) {
+                match(TK_COMMA);
+                exprStack.push_back(f);
+                operand = false;
+                break;
+            }
+            value = closeCall(f);
+            break;
+        default:
+            break;
+        }
     }
 }
 
-// == <>
-void Parser::exp_eq() {
-    exp_rel();
-    exp_eq_p();
+// listaexp ya esta en 'work': ')' y el nodo de la llamada
+NodeId Parser::closeCall(const ExprFrame& frame) {
+    List args = tree.makeList(work, frame.first);
+    match(TK_RPAREN);
+    NodeId id = newExpr(ExprKind::Call, frame.at);
+    tree.exprs[id].sym = frame.sym;
+    tree.exprs[id].args = args;
+    return measure(id);
 }
 
-void Parser::exp_eq_p() {
-    while (currentToken == TK_EQ ||
-           currentToken == TK_NEQ ||
-           currentToken == TK_ASSIGN) {
-        nextToken();
-        exp_rel();
-    }
-}
+// motor LL(1): acciones 
 
-// < <= > >=
-void Parser::exp_rel() {
-    exp_add();
-    exp_rel_p();
+Parser::LlMark Parser::llMark() {
+    if (llMarks.empty())
+        return {here(), noSymbol, TK_EOF};
+    LlMark mark = llMarks.back();
+    llMarks.pop_back();
+    return mark;
 }
 
-void Parser::exp_rel_p() {
-    while (currentToken == TK_LT || currentToken == TK_LE ||
-           currentToken == TK_GT || currentToken == TK_GE) {
-        nextToken();
-        exp_add();
-    }
+NodeId Parser::llValue() {
+    if (llValues.empty())
+        return noNode;
+    NodeId value = llValues.back();
+    llValues.pop_back();
+    return value;
 }
 
-// + - 
-void Parser::exp_add() {
-    exp_mul();
-    exp_add_p();
+TypeId Parser::llType() {
+    if (llTypes.empty())
+        return TY_ERROR;
+    TypeId type = llTypes.back();
+    llTypes.pop_back();
+    return type;
 }
 
-void Parser::exp_add_p() {
-    while (currentToken == TK_PLUS || currentToken == TK_MINUS) {
-        nextToken();
-        exp_mul();
-    }
+size_t Parser::llList() {
+    if (llLists.empty())
+        return work.size();
+    size_t first = min(llLists.back(), work.size());
+    llLists.pop_back();
+    return first;
 }
 
-// * / 
-void Parser::exp_mul() {
-    exp_unary();
-    exp_mul_p();
+// la lista de argumentos ya esta en 'work' (ver closeCall)
+NodeId Parser::llCall(const LlMark& name) {
+    List args = tree.makeList(work, llList());
+    NodeId id = newExpr(ExprKind::Call, name.at);
+    tree.exprs[id].sym = name.sym;
+    tree.exprs[id].args = args;
+    return measure(id);
 }
 
-void Parser::exp_mul_p() {
-    while (currentToken == TK_MUL || currentToken == TK_DIV) {
-        nextToken();
-        exp_unary();
+// Una accion de ll1.h: lo que hace el parser a mano en el mismo punto (en
+// exp, bloque, funcion, declvar, tipo y los comandos)
+void Parser::ll1Action(int action) {
+    switch (action) {
+    case LA_MARK:
+        llMarks.push_back({here(), currentSymbol, currentToken});
+        break;
+    case LA_OPEN:
+        // la tabla no necesita los ExprFrame: solo cuentan para checkDepth
+        checkDepth();
+        exprStack.push_back({EF_ROOT, 0, 0, here(), noNode, noSymbol, 0});
+        break;
+    case LA_CLOSE:
+        if (!exprStack.empty())
+            exprStack.pop_back();
+        break;
+    case LA_LITERAL: {
+        bool text = currentToken == TK_LITNUM || currentToken == TK_LITSTRING;
+        ExprKind kind = currentToken == TK_LITNUM      ? ExprKind::Num
+                        : currentToken == TK_LITSTRING ? ExprKind::Str
+                        : currentToken == TK_TRUE      ? ExprKind::True
+                                                       : ExprKind::False;
+        NodeId id = newExpr(kind, here());
+        if (text)
+            tree.exprs[id].text = keep(currentLexeme);
+        llValues.push_back(id);
+        break;
     }
-}
-
-// unarios 
-void Parser::exp_unary() {
-    if (currentToken == TK_MINUS || currentToken == TK_NOT) {
-        nextToken();
-        exp_unary();
+    case LA_VAR:
+    case LA_TARGET: {
+        LlMark name = llMark();
+        if (action == LA_TARGET)
+            llMarks.push_back(name);
+        NodeId id = newExpr(ExprKind::Var, name.at);
+        tree.exprs[id].sym = name.sym;
+        llValues.push_back(id);
+        break;
     }
-    else exp_primary();
-}
+    case LA_INDEX: {
+        LlMark open = llMark();
+        NodeId index = llValue();
+        NodeId base = llValue();
+        NodeId id = newExpr(ExprKind::Index, open.at);
+        tree.exprs[id].lhs = base;
+        tree.exprs[id].rhs = index;
+        llValues.push_back(measure(id));
+        break;
+    }
+    case LA_UNARY: {
+        LlMark op = llMark();
+        NodeId operand = llValue();
+        NodeId id = newExpr(ExprKind::Unary, op.at);
+        tree.exprs[id].op = (uint8_t)(op.token - TK_ID);
+        tree.exprs[id].lhs = operand;
+        llValues.push_back(measure(id));
+        break;
+    }
+    case LA_BINARY: {
+        LlMark op = llMark();
+        NodeId rhs = llValue();
+        NodeId lhs = llValue();
+        llValues.push_back(binary(TK_ID + bindingPower(op.token).op, lhs, rhs, op.at));
+        break;
+    }
+    case LA_NEW: {
+        LlMark at = llMark();
+        TypeId type = tree.types.arrayOf(llType());
+        NodeId size = llValue();
+        NodeId id = newExpr(ExprKind::New, at.at);
+        tree.exprs[id].rhs = size;
+        tree.exprs[id].type = type;
+        llValues.push_back(measure(id));
+        break;
+    }
+    case LA_LIST:
+        llLists.push_back(work.size());
+        break;
+    case LA_ARG:
+        work.push_back(llValue());
+        break;
+    case LA_CALL:
+        llValues.push_back(llCall(llMark()));
+        break;
+    case LA_CALLSTMT: {
+        LlMark name = llMark();
+        Stmt st = newStmt(StmtKind::Call, name.at);
+        st.value = llCall(name);
+        work.push_back(addStmt(st));
+        break;
+    }
+    case LA_NOVALUE:
+        llValues.push_back(noNode);
+        break;
+    case LA_RETURN: {
+        NodeId value = llValue();
+        Stmt st = newStmt(StmtKind::Return, llMark().at);
+        st.value = value;
+        work.push_back(addStmt(st));
+        break;
+    }
+    case LA_ASSIGN: {
+        NodeId value = llValue();
+        NodeId target = llValue();
+        Stmt st = newStmt(StmtKind::Assign, llMark().at);
+        st.target = target;
+        st.value = value;
+        work.push_back(addStmt(st));
+        break;
+    }
+    case LA_TYPE:
+        switch (currentToken) {
+            case TK_INT: llTypes.push_back(TY_INT); break;
+            case TK_BOOL: llTypes.push_back(TY_BOOL); break;
+            case TK_CHAR: llTypes.push_back(TY_CHAR); break;
+            default: llTypes.push_back(TY_STRING); break;
+        }
+        break;
+    case LA_ARRAY:
+        llTypes.push_back(tree.types.arrayOf(llType()));
+        break;
+    case LA_DECLVAR: {
+        TypeId type = llType();
+        LlMark name = llMark();
+        VarDecl v{};
+        v.line = (uint32_t)name.at.line;
+        v.column = (uint16_t)name.at.column;
+        v.name = name.sym;
+        v.type = type;
+        work.push_back(tree.addVar(v));
+        break;
+    }
+    case LA_GLOBAL:
+        if (!work.empty()) {
+            tree.globals.push_back(work.back());
+            work.pop_back();
+        }
+        break;
+    case LA_FUNC:
+        llFunc = Func{};
+        llFunc.line = (uint32_t)currentLine;
+        llFunc.column = (uint16_t)currentColumn;
+        llFunc.ret = TY_VOID;
+        break;
+    case LA_NAME:
+        llFunc.name = currentSymbol;
+        break;
+    case LA_PARAMS:
+        llFunc.params = tree.makeList(work, llList());
+        break;
+    case LA_RET:
+        llFunc.ret = llType();
+        break;
+    case LA_ENDFUNC:
+        tree.addFunc(llFunc);
+        break;
 
-// primarios 
-void Parser::exp_primary() {
-    if (currentToken == TK_LITNUM) match(TK_LITNUM);
-    else if (currentToken == TK_LITSTRING) match(TK_LITSTRING);
-    else if (currentToken == TK_TRUE) match(TK_TRUE);
-    else if (currentToken == TK_FALSE) match(TK_FALSE);
-    else if (currentToken == TK_NEW) {
-        match(TK_NEW);
-        match(TK_LBRACKET);
-        exp();
-        match(TK_RBRACKET);
-        tipo();
+    // los bloques, como en bloque(): el NestFrame se abre con checkDepth y
+    // queda en 'nest' (antes de las declaraciones: ahi no se arma ningun nodo)
+    case LA_BLOCK:
+        checkDepth();
+        llPending.first = work.size();
+        llPending.block = Block{};
+        nest.push_back(llPending);
+        llPending = NestFrame{};
+        break;
+    case LA_VARS: {
+        NestFrame& top = nest.back();
+        top.block.vars = tree.makeList(work, top.first);
+        break;
     }
-    else if (currentToken == TK_LPAREN) {
-        match(TK_LPAREN);
-        exp();
-        match(TK_RPAREN);
+    case LA_ENDBLOCK: {
+        NestFrame& top = nest.back();
+        top.block.stmts = tree.makeList(work, top.first);
+        NodeId body = addBlock(top.block);
+        switch (top.kind) {
+        case NF_BLOCK:
+            llFunc.body = body;
+            nest.pop_back();
+            break;
+        case NF_WHILE:
+            llWhile = top.st;
+            llWhile.body = body;
+            nest.pop_back();
+            break;
+        case NF_IF:
+            top.st.body = body;
+            top.arms = work.size();
+            break;
+        case NF_ELSEIF:
+            top.arm.body = body;
+            work.push_back(addStmt(top.arm));
+            break;
+        case NF_ELSE:
+            llElse = body;
+            break;
+        }
+        break;
     }
-    else if (currentToken == TK_ID) {
-        if (peekToken() == TK_LPAREN) {
-            llamada();
+    case LA_IF:
+    case LA_WHILE: {
+        NodeId cond = llValue();
+        llPending = NestFrame{};
+        llPending.kind = action == LA_IF ? NF_IF : NF_WHILE;
+        llPending.st = newStmt(action == LA_IF ? StmtKind::If : StmtKind::While, llMark().at);
+        llPending.st.value = cond;
+        break;
+    }
+    case LA_ENDWHILE:
+        work.push_back(addStmt(llWhile));
+        break;
+    case LA_ELSEIF:
+    case LA_ELSE: {
+        // el mismo nivel sigue con otro bloque: la condicion del else if se
+        // analizo con el if todavia en 'nest'
+        NestFrame& top = nest.back();
+        if (action == LA_ELSEIF) {
+            NodeId cond = llValue();
+            top.kind = NF_ELSEIF;
+            top.arm = newStmt(StmtKind::If, llMark().at);
+            top.arm.value = cond;
         } else {
-            var();
+            top.kind = NF_ELSE;
         }
+        llPending = top;
+        nest.pop_back();
+        break;
     }
-    else {
-        reportError(string("Error sintactico en linea ") + to_string(yylineno) +
-                     ": expresion invalida");
-        synchronize({TK_COMMA, TK_RPAREN, TK_RBRACKET, TK_END, TK_ELSE,
-                     TK_LOOP, TK_NL, TK_EOF});
+    case LA_ENDIF:
+        finishIf(noNode);
+        break;
+    case LA_ENDELSE:
+        finishIf(llElse);
+        break;
     }
-}
\ No newline at end of file
+}
@@ -3,98 +3,297 @@
 
 #include <string>
 #include <iostream>
-#include <initializer_list>
 #include "tokens.h"
+#include "grammar.h"
+#include "ll1.h"
+#include "source.h"
+#include "tokenbuf.h"
+#include "ast.h"
+#include "diagnostics.h"
 
 using namespace std;
 
-// Estos vienen de Flex
-extern int yylex();
-extern char* yytext;
-extern int yylineno;
-extern FILE* yyin;
+// Estos vienen de Flex (scanner reentrante: todo su estado vive en un yyscan_t)
+typedef void* yyscan_t;
+extern int yylex_init(yyscan_t* scanner);
+extern int yylex_destroy(yyscan_t scanner);
+extern int yylex(yyscan_t scanner);
+extern char* yyget_text(yyscan_t scanner);
+extern int yyget_leng(yyscan_t scanner);
+extern int yyget_lineno(yyscan_t scanner);
+extern void yyset_lineno(int line, yyscan_t scanner);
+extern void yyrestart(FILE* input, yyscan_t scanner);
+typedef struct yy_buffer_state* YY_BUFFER_STATE;
+extern YY_BUFFER_STATE yy_create_buffer(FILE* file, int size, yyscan_t scanner);
+extern YY_BUFFER_STATE yy_scan_buffer(char* base, size_t size, yyscan_t scanner);
+extern void yy_switch_to_buffer(YY_BUFFER_STATE buffer, yyscan_t scanner);
+extern void yy_delete_buffer(YY_BUFFER_STATE buffer, yyscan_t scanner);
 
+// De donde lee Flex el archivo
+enum class InputMode {
+    InMemory,  // SourceBuffer: todo el texto en memoria y escaneo en el lugar
+               // (Flex sobre una copia leida; FastLexer sobre un mmap de solo lectura)
+    Stdio      // FILE* con el buffer propio de Flex (camino original)
+};
+
+// Como le llegan los tokens al parser
+enum class LexMode {
+    Interleaved,  // yylex() cada vez que el parser pide un token
+    Buffered      // todo el archivo a un TokenBuffer antes de analizar (usa SourceBuffer)
+};
+
+// Quien produce los tokens. Compilando con -DMINI0_FAST_LEXER el default es Fast.
+enum class LexerBackend {
+    Flex,  // lex.yy.c
+    Fast   // FastLexer: escrito a mano, con tablas y SIMD (usa SourceBuffer)
+};
+
+// Quien recorre la gramatica
+enum class ParserEngine {
+    Descent,  // descenso recursivo escrito a mano: arma el AST
+    Table     // LL(1) con la tabla de ll1.h: el mismo AST, con acciones en las producciones
+};
+
+// Configuracion de un Parser (lo que se elige desde la linea de comandos)
+struct ParserOptions {
+    bool trace = false;
+    LexMode lexMode = LexMode::Interleaved;
+#ifdef MINI0_FAST_LEXER
+    LexerBackend lexer = LexerBackend::Fast;
+#else
+    LexerBackend lexer = LexerBackend::Flex;
+#endif
+    // niveles de anidamiento (bloques, parentesis, indices, operadores sin
+    // reducir, y los del arbol que se arma: a + b + c + ... o una cadena de
+    // else if) antes de cortar con un error; 0 es sin limite. El parser y los
+    // analisis semantico y de tipos no usan la pila de C++, asi que validar
+    // no tiene limite; al compilar el driver pone compileDepthLimit.
+    unsigned maxDepth = 0;
+    ParserEngine engine = ParserEngine::Descent;
+    // errores antes de cortar el analisis; 0 es sin limite (--fail-fast es 1)
+    unsigned maxErrors = 0;
+    // Text: los mensajes salen al final del analisis. Json: quedan en
+    // diagnostics() para que el driver sume los semanticos y escriba el JSON.
+    DiagFormat diagnostics = DiagFormat::Text;
+};
+
+// El optimizador, el impresor, el IR y los backends recorren el arbol
+// recursivamente: al compilar el anidamiento no puede pasar de aca.
+const unsigned compileDepthLimit = 1000;
+
+// Donde empieza un token, y el nodo que se arma con el
+struct SourcePos {
+    int line;
+    int column;  // desde 1, en bytes; 0 si no se sabe (el fuente no queda en memoria)
+};
+
+// Cada Parser tiene su propio scanner, asi varios pueden correr en hilos distintos.
 class Parser {
 public:
     Parser();
+    ~Parser();
+    Parser(const Parser&) = delete;
+    Parser& operator=(const Parser&) = delete;
+
     void parse(const string& filename);
     void setTrace(bool enable);
+    void setOutput(ostream& out, ostream& err);
+    void setInputMode(InputMode mode);
+    void setLexMode(LexMode mode);
+    void setLexer(LexerBackend lexer);
+    void setOptions(const ParserOptions& options);
+    const TokenBuffer& tokenBuffer() const { return tokens; }
+    const Ast& ast() const { return tree; }  // valido hasta el proximo parse
+    Ast& ast() { return tree; }              // las pasadas siguientes lo anotan
     bool hasErrors() const;
+    size_t deepestNesting() const { return deepest; }     // del ultimo parse
+    Diagnostics& diagnostics() { return diags; }          // del ultimo parse
+    const char* sourceText() const;  // a donde apuntan los registros (nullptr: copiados)
+    // llego a maxErrors, en el parse o despues (quedaron registros afuera)
+    bool stoppedEarly() const { return stopped || diags.dropped(); }
+    // en texto, los registros que se sumaron despues del parse (semanticos y
+    // de tipos), y si --max-errors dejo alguno afuera
+    void flushDiagnostics(ostream& errStream);
+    // JSON de los registros (los del parser y los que se sumaron despues)
+    void writeDiagnostics(ostream& errStream, const string& file) const;
 
 private:
+    yyscan_t scanner;
+    InputMode inputMode;
+    LexMode lexMode;
+    LexerBackend backend;
+    ParserEngine engine;
+    SourceBuffer source;
+    TokenBuffer tokens;
+    FastLexer fast;
+    bool useBuffer;     // este parse usa el TokenBuffer
+    bool useFast;       // este parse usa FastLexer
+    size_t cursor;      // modo Buffered: proximo token a consumir
+    size_t scanned;     // modo Buffered: token mas lejano que se miro
+    size_t nextError;   // modo Buffered: proximo error lexico sin reportar
+    ostream* out;  // mensajes normales y traza
+    ostream* err;  // errores
     int currentToken; // aqui guardamos el tipo de token actual (TokenType)
     int lookaheadToken; // buffer para lookahead simple
+    int currentLine;    // linea donde empieza el token actual
+    int lookaheadLine;
+    int currentColumn;
+    int lookaheadColumn;
+    size_t lineStart;   // offset donde empieza la linea del ultimo token leido
     bool hasLookahead;
     bool trace;
     bool hadError;
-    std::string currentLexeme;
-    std::string lookaheadLexeme;
+    unsigned maxDepth;  // ParserOptions::maxDepth
+    bool aborted;       // se paso maxDepth o maxErrors: todo es EOF y no se reporta mas
+    bool stopped;       // el corte fue por maxErrors
+    unsigned maxErrors; // ParserOptions::maxErrors
+    DiagFormat diagFormat;
+    Diagnostics diags;
+    size_t deepest;     // el mayor anidamiento que se vio
+    Lexeme currentLexeme;
+    Lexeme lookaheadLexeme;
+    Symbol currentSymbol;    // TK_ID: simbolo internado al leerlo
+    Symbol lookaheadSymbol;
+    string stdioText;  // en modo Stdio el buffer de Flex se reusa: ahi se copian los lexemas
+    Ast tree;
+    vector<NodeId> work;  // pila de hijos mientras se arma una lista
+    // Niveles de cada subarbol, por nodo: un Expr es uno mas que su hijo mas
+    // alto y un comando uno mas que sus expresiones y bloques (un bloque es
+    // lo que mide su comando mas alto). Es lo que bajan las pasadas
+    // recursivas, y crece aunque el parser no abra niveles: a + b + c + ...
+    // y los else if encadenados quedan anidados en el arbol.
+    vector<uint32_t> exprHeight;
+    vector<uint32_t> stmtHeight;
+    vector<uint32_t> blockHeight;
+
+    // Lo que esta abierto mientras se analiza una expresion: un contexto
+    // (la raiz, un parentesis, un indice, un new o los argumentos de una
+    // llamada) o un operador que espera su operando derecho
+    enum ExprFrameKind : uint8_t { EF_ROOT, EF_PAREN, EF_INDEX, EF_NEW, EF_ARGS, EF_UNARY, EF_BINARY };
+    struct ExprFrame {
+        ExprFrameKind kind;
+        uint8_t op;        // EF_UNARY, EF_BINARY: token - TK_ID
+        uint8_t power;     // EF_BINARY: fuerza del operador; EF_ROOT: la minima que acepta
+        SourcePos at;
+        NodeId node;       // EF_BINARY: lado izquierdo; EF_INDEX: el arreglo
+        Symbol sym;        // EF_ARGS: la funcion
+        size_t first;      // EF_ARGS: comienzo de los argumentos en 'work'
+    };
+    // Un bloque abierto y el comando al que pertenece
+    enum NestKind : uint8_t { NF_BLOCK, NF_IF, NF_ELSEIF, NF_ELSE, NF_WHILE };
+    struct NestFrame {
+        NestKind kind;
+        Stmt st;           // el if o el while
+        Stmt arm;          // NF_ELSEIF: el 'else if' que se esta armando
+        Block block;       // con las variables ya puestas
+        size_t first;      // comienzo de los comandos del bloque en 'work'
+        size_t arms;       // if: comienzo de los 'else if' en 'work'
+    };
+    vector<ExprFrame> exprStack;
+    vector<NestFrame> nest;
+    vector<int> llStack;  // ParserEngine::Table: simbolos por reconocer
+
+    // ParserEngine::Table: lo que las acciones de ll1.h dejan para las que
+    // siguen. ll1Error las mantiene parejas; igual, sacar de una pila vacia
+    // devuelve un valor neutro en vez de romper.
+    struct LlMark {
+        SourcePos at;
+        Symbol sym;
+        int token;
+    };
+    vector<LlMark> llMarks;
+    vector<NodeId> llValues;   // expresiones
+    vector<TypeId> llTypes;
+    vector<size_t> llLists;    // comienzo de cada lista abierta en 'work'
+    NestFrame llPending;       // lo que abre el proximo LA_BLOCK
+    Stmt llWhile;              // el while cerrado, hasta su 'loop'
+    NodeId llElse;             // el else cerrado, hasta su 'end'
+    Func llFunc;               // la funcion que se esta armando
 
+    int scanToken(Lexeme& lexeme, SourcePos& pos, Symbol& symbol);
+    int columnOf(int token, const Lexeme& lexeme);
+    Lexeme scanLexeme(int token);
+    bool lexemesInSource() const;
+    const char* lexemeData(const Lexeme& lexeme) const;
+    string lexemeText(const Lexeme& lexeme) const;
+
+    void run();
     void nextToken();
-    int peekToken();
+    int peekToken(size_t k = 1);  // k > 1 solo en modo Buffered
+    void reachToken(size_t index);
     void match(int expected);
     void skipNL();
-    void reportError(const std::string& message);
-    void synchronize(std::initializer_list<int> recoveryTokens);
+    void report(DiagCode code, int line, const Lexeme& lexeme, int found, int expected = TK_EOF,
+                unsigned value = 0);
+    void stop();
+    void synchronize(TokenSet recovery);
+    void checkDepth();
+
+    // ParserEngine::Table: todo el programa con la tabla de ll1.h
+    void ll1();
+    void ll1Error(int nonterminal);
+    void ll1Action(int action);
+    LlMark llMark();
+    NodeId llValue();
+    TypeId llType();
+    size_t llList();
+    NodeId llCall(const LlMark& name);
 
-    // No terminales principales
+    // No terminales principales (cada uno devuelve el nodo que arma)
     void programa();
     void decl_list();
     void decl();
     void globalDecl();
     void funcion();
-    void opt_tipo();
-    void bloque();
-    void declvar_list();
-    void comando_list();
+    TypeId opt_tipo();
+    NodeId bloque();       // con los if y while anidados (ver NestFrame)
+    void openBlock(NestFrame& frame);
+    void finishIf(NodeId orelse);
+    void declvar_list();   // deja los VarDecl en 'work'
 
     // declaraciones y tipos
-    void declvar();
+    NodeId declvar();
     void params();
     void params_tail();
-    void parametro();
-    void tipo();
-    void tipobase();
-
-    // comandos
-    void comando();
-    void cmdif();
-    void else_if_list();
-    void opt_else();
-    void cmdwhile();
-    void cmdatrib();
-    void cmdreturn();
-    void llamada();
+    NodeId parametro();
+    TypeId tipo();
+    TypeId tipobase();
+
+    // comandos (los if y while los arma bloque)
+    NodeId comando();
+    NodeId cmdatrib();
+    NodeId cmdreturn();
+    NodeId llamada();
     void listaexp();
     void listaexp_tail();
 
     // variables
-    void var();
-    void var_sufijo();
-
-    // expresiones con precedencia
-    void exp();        // alias de exp_or
-    void exp_or();
-    void exp_or_p();
-    void exp_and();
-    void exp_and_p();
-    void exp_eq();
-    void exp_eq_p();
-    void exp_rel();
-    void exp_rel_p();
-    void exp_add();
-    void exp_add_p();
-    void exp_mul();
-    void exp_mul_p();
-    void exp_unary();
-    void exp_primary();
+    NodeId var();
+    NodeId var_sufijo(NodeId base);
+
+    // expresiones con precedencia: exp sube por la tabla de precedencias
+    // hasta minPower con una pila propia (ExprFrame)
+    NodeId exp(int minPower = 1);
+    NodeId closeCall(const ExprFrame& frame);
+
+    // construccion del arbol
+    Span keep(const Lexeme& lexeme);
+    SourcePos here() const { return {currentLine, currentColumn}; }
+    NodeId newExpr(ExprKind kind, SourcePos at);
+    NodeId binary(int op, NodeId lhs, NodeId rhs, SourcePos at);
+    NodeId measure(NodeId expr);  // despues de colgarle los hijos
+    NodeId addStmt(const Stmt& st);
+    NodeId addBlock(const Block& block);
+    uint32_t levels(const Stmt& st) const;
+    uint32_t exprLevels(NodeId expr) const { return expr == noNode ? 0 : exprHeight[expr]; }
+    uint32_t blockLevels(NodeId block) const { return block == noNode ? 0 : blockHeight[block]; }
+    void checkHeight(uint32_t height);
 
     // ayuda
     bool is_type_start();
     bool is_decl_start();
     bool is_comando_start();
 
-    const char* tokenName(int token) const;
 };
 
 #endif
\ No newline at end of file
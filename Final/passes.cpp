@@ -0,0 +1,259 @@
+#include "passes.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include "loops.h"
+
+using namespace std;
+
+static IrValue resolve(vector<IrValue>& repl, IrValue v) {
+    IrValue root = v;
+    while (repl[root] != noValue)
+        root = repl[root];
+    // se acortan las cadenas para la proxima vez
+    while (repl[v] != noValue) {
+        IrValue next = repl[v];
+        repl[v] = root;
+        v = next;
+    }
+    return root;
+}
+
+void replaceUses(IrFunction& f, vector<IrValue>& repl) {
+    for (const IrBlock& b : f.blocks)
+        for (IrValue v : b.instrs) {
+            IrValue* a = f.args(v);
+            for (uint32_t k = 0; k < f.instrs[v].count; k++)
+                a[k] = resolve(repl, a[k]);
+        }
+}
+
+// saca el operando k de un phi (se fue el predecesor k)
+static void dropPhiOperand(IrFunction& f, IrValue phi, size_t k) {
+    IrValue* a = f.args(phi);
+    uint32_t& count = f.instrs[phi].count;
+    copy(a + k + 1, a + count, a + k);
+    count--;
+}
+
+bool removeUnreachable(IrFunction& f) {
+    vector<uint8_t> reachable(f.blocks.size(), 0);
+    for (IrBlockId b : irReversePostorder(f))
+        reachable[b] = 1;
+    bool changed = false;
+    for (IrBlockId b = 0; b < f.blocks.size(); b++) {
+        IrBlock& bl = f.blocks[b];
+        if (reachable[b] || bl.instrs.empty())
+            continue;
+        changed = true;
+        for (uint8_t s = 0; s < bl.succCount; s++) {
+            IrBlock& succ = f.blocks[bl.succ[s]];
+            if (!reachable[bl.succ[s]])
+                continue;
+            auto at = find(succ.preds.begin(), succ.preds.end(), b);
+            if (at == succ.preds.end())
+                continue;
+            size_t k = (size_t)(at - succ.preds.begin());
+            succ.preds.erase(at);
+            for (IrValue v : succ.instrs)
+                if (f.instrs[v].op == I_PHI)
+                    dropPhiOperand(f, v, k);
+        }
+        for (IrValue v : bl.instrs)
+            f.instrs[v].block = noBlock;
+        bl.instrs.clear();
+        bl.preds.clear();
+        bl.succCount = 0;
+    }
+    return changed;
+}
+
+// Un phi es trivial si todos sus operandos son el mismo valor o el phi mismo
+// (un ciclo que no cambia nada): se reemplaza por ese valor. Sacar uno puede
+// volver trivial a otro, asi que se repite hasta que no cambie nada.
+bool simplifyPhis(IrFunction& f) {
+    vector<IrValue> repl(f.instrs.size(), noValue);
+    bool changed = false, again = true;
+    while (again) {
+        again = false;
+        for (IrBlock& b : f.blocks) {
+            for (size_t k = 0; k < b.instrs.size();) {
+                IrValue phi = b.instrs[k];
+                if (f.instrs[phi].op != I_PHI)
+                    break;
+                IrValue same = noValue;
+                bool trivial = true;
+                const IrValue* a = f.args(phi);
+                for (uint32_t i = 0; i < f.instrs[phi].count; i++) {
+                    IrValue op = resolve(repl, a[i]);
+                    if (op == phi || op == same)
+                        continue;
+                    if (same != noValue) {
+                        trivial = false;
+                        break;
+                    }
+                    same = op;
+                }
+                // sin valor propio solo pasa en codigo al que no se llega
+                if (!trivial || same == noValue) {
+                    k++;
+                    continue;
+                }
+                repl[phi] = same;
+                f.instrs[phi].block = noBlock;
+                b.instrs.erase(b.instrs.begin() + (ptrdiff_t)k);
+                changed = again = true;
+            }
+        }
+    }
+    if (changed)
+        replaceUses(f, repl);
+    return changed;
+}
+
+bool eliminateDeadCode(IrFunction& f) {
+    vector<uint8_t> live(f.instrs.size(), 0);
+    vector<IrValue> work;
+    for (const IrBlock& b : f.blocks)
+        for (IrValue v : b.instrs)
+            if (!irPure(f.instrs[v].op)) {
+                live[v] = 1;
+                work.push_back(v);
+            }
+    while (!work.empty()) {
+        IrValue v = work.back();
+        work.pop_back();
+        const IrValue* a = f.args(v);
+        for (uint32_t k = 0; k < f.instrs[v].count; k++)
+            if (!live[a[k]]) {
+                live[a[k]] = 1;
+                work.push_back(a[k]);
+            }
+    }
+    bool changed = false;
+    for (IrBlock& b : f.blocks) {
+        size_t kept = 0;
+        for (IrValue v : b.instrs) {
+            if (live[v])
+                b.instrs[kept++] = v;
+            else
+                f.instrs[v].block = noBlock;
+        }
+        if (kept != b.instrs.size()) {
+            b.instrs.resize(kept);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+bool mergeBlocks(IrFunction& f) {
+    bool changed = false;
+    for (IrBlockId p = 0; p < f.blocks.size(); p++) {
+        // p puede absorber varios bloques seguidos
+        while (!f.blocks[p].instrs.empty() && f.blocks[p].succCount == 1) {
+            IrBlockId b = f.blocks[p].succ[0];
+            IrBlock& next = f.blocks[b];
+            if (b == 0 || b == p || next.preds.size() != 1 ||
+                f.instrs[next.instrs.front()].op == I_PHI)
+                break;
+            IrBlock& prev = f.blocks[p];
+            f.instrs[prev.instrs.back()].block = noBlock;  // el salto
+            prev.instrs.pop_back();
+            for (IrValue v : next.instrs) {
+                f.instrs[v].block = p;
+                prev.instrs.push_back(v);
+            }
+            prev.succCount = next.succCount;
+            for (uint8_t s = 0; s < next.succCount; s++) {
+                prev.succ[s] = next.succ[s];
+                vector<IrBlockId>& preds = f.blocks[next.succ[s]].preds;
+                replace(preds.begin(), preds.end(), b, p);
+            }
+            next.instrs.clear();
+            next.preds.clear();
+            next.succCount = 0;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+PassManager::PassManager() : err(&cerr), verifyEach(false) {}
+
+void PassManager::setOutput(ostream& errStream) {
+    err = &errStream;
+}
+
+void PassManager::setVerify(bool verify) {
+    verifyEach = verify;
+}
+
+void PassManager::add(const string& name, Pass pass) {
+    passes.push_back(move(pass));
+    Stats s;
+    s.name = name;
+    table.push_back(s);
+}
+
+void PassManager::add(const string& name, bool (*pass)(IrFunction&)) {
+    add(name, [pass](IrModule&, IrFunction& f) { return pass(f); });
+}
+
+void PassManager::addCleanup() {
+    add("unreachable", removeUnreachable);
+    add("phis", simplifyPhis);
+    add("dce", eliminateDeadCode);
+    add("blocks", mergeBlocks);
+}
+
+void PassManager::addLoops() {
+    add("licm", hoistInvariants);
+    add("iv", reduceInductionVariables);
+    addCleanup();
+}
+
+bool PassManager::run(IrModule& module) {
+    for (size_t p = 0; p < passes.size(); p++) {
+        Stats& s = table[p];
+        for (IrFunction& f : module.functions) {
+            size_t before = f.liveInstrs();
+            auto start = chrono::steady_clock::now();
+            bool changed = passes[p](module, f);
+            s.seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            s.runs++;
+            s.removed += (long long)before - (long long)f.liveInstrs();
+            if (changed)
+                s.changed++;
+            if (verifyEach && !module.verify(f, *err)) {
+                *err << "(despues del pase '" << s.name << "')" << endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void PassManager::clearStats() {
+    for (Stats& s : table) {
+        s.seconds = 0;
+        s.runs = s.changed = 0;
+        s.removed = 0;
+    }
+}
+
+void PassManager::report(ostream& out) const {
+    double total = 0;
+    for (const Stats& s : table)
+        total += s.seconds;
+    out << "  " << left << setw(14) << "pase" << right << setw(11) << "ms" << setw(8) << "%"
+        << setw(11) << "cambio" << setw(10) << "saco" << "\n";
+    for (const Stats& s : table)
+        out << "  " << left << setw(14) << s.name << right << fixed << setprecision(3) << setw(11)
+            << s.seconds * 1000.0 << setprecision(1) << setw(8)
+            << (total > 0 ? 100.0 * s.seconds / total : 0.0) << setw(5) << s.changed << "/"
+            << left << setw(5) << s.runs << right << setw(10) << s.removed << "\n";
+    out << "  " << left << setw(14) << "total" << right << fixed << setprecision(3) << setw(11)
+        << total * 1000.0 << "\n";
+}
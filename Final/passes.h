@@ -0,0 +1,60 @@
+#ifndef PASSES_H
+#define PASSES_H
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ir.h"
+
+using namespace std;
+
+// Pases sobre el IR. Cada uno recibe una funcion y devuelve true si la
+// cambio. Los que estan aca son la limpieza que necesitan todos los demas.
+bool removeUnreachable(IrFunction& f);  // bloques a los que no se llega
+bool simplifyPhis(IrFunction& f);       // phis con un solo valor distinto de si mismo
+bool eliminateDeadCode(IrFunction& f);  // instrucciones puras que nadie usa
+bool mergeBlocks(IrFunction& f);        // un bloque con un solo predecesor que solo salta a el
+
+// Cambia cada uso de v por repl[v] (noValue: queda igual), siguiendo cadenas
+void replaceUses(IrFunction& f, vector<IrValue>& repl);
+
+// Corre una lista de pases en orden sobre cada funcion del modulo y anota
+// cuanto tardo cada uno, cuantas veces cambio algo y cuantas instrucciones
+// saco. Con setVerify, despues de cada pase se chequea el IR y si queda mal
+// se corta con el nombre del pase que lo rompio.
+class PassManager {
+public:
+    typedef function<bool(IrModule&, IrFunction&)> Pass;
+
+    struct Stats {
+        string name;
+        double seconds = 0;
+        size_t runs = 0;     // funciones
+        size_t changed = 0;  // funciones que cambio
+        long long removed = 0;
+    };
+
+    PassManager();
+
+    void setOutput(ostream& err);
+    void setVerify(bool verify);
+    void add(const string& name, Pass pass);
+    void add(const string& name, bool (*pass)(IrFunction&));
+    void addCleanup();  // unreachable, phis, dce, blocks
+    void addLoops();    // licm, iv (loops.h) y la limpieza de nuevo
+
+    bool run(IrModule& module);
+    const vector<Stats>& stats() const { return table; }
+    void clearStats();
+    void report(ostream& out) const;
+
+private:
+    vector<Pass> passes;
+    vector<Stats> table;
+    ostream* err;
+    bool verifyEach;
+};
+
+#endif
@@ -0,0 +1,213 @@
+#include "printer.h"
+
+using namespace std;
+
+// precedencia de cada nivel de la gramatica: or, and, = <>, relacionales,
+// + -, * /, unarios y primarios
+static int precedence(const Expr& e) {
+    if (e.kind == ExprKind::Unary)
+        return 7;
+    if (e.kind != ExprKind::Binary)
+        return 8;
+    switch (e.opToken()) {
+    case TK_OR: return 1;
+    case TK_AND: return 2;
+    case TK_EQ:
+    case TK_NEQ: return 3;
+    case TK_LT:
+    case TK_LE:
+    case TK_GT:
+    case TK_GE: return 4;
+    case TK_PLUS:
+    case TK_MINUS: return 5;
+    default: return 6;
+    }
+}
+
+static const char* operatorText(int op) {
+    switch (op) {
+    case TK_OR: return "or";
+    case TK_AND: return "and";
+    case TK_EQ: return "=";
+    case TK_NEQ: return "<>";
+    case TK_LT: return "<";
+    case TK_LE: return "<=";
+    case TK_GT: return ">";
+    case TK_GE: return ">=";
+    case TK_PLUS: return "+";
+    case TK_MINUS: return "-";
+    case TK_MUL: return "*";
+    case TK_DIV: return "/";
+    case TK_NOT: return "not ";
+    default: return "?";
+    }
+}
+
+void SourcePrinter::print(const Ast& ast, ostream& outStream) {
+    tree = &ast;
+    out = &outStream;
+    for (NodeId g : ast.globals)
+        *out << decl(g) << "\n";
+    for (size_t i = 0; i < ast.funcs.size(); i++) {
+        if (i > 0 || !ast.globals.empty())
+            *out << "\n";
+        function(ast.funcs[i]);
+    }
+}
+
+string SourcePrinter::decl(NodeId var) const {
+    const VarDecl& v = tree->vars[var];
+    return tree->str(v.name) + " : " + tree->types.name(v.type);
+}
+
+void SourcePrinter::function(const Func& f) {
+    *out << "fun " << tree->str(f.name) << "(";
+    for (const NodeId* p = tree->begin(f.params); p != tree->end(f.params); p++)
+        *out << (p != tree->begin(f.params) ? ", " : "") << decl(*p);
+    *out << ")";
+    if (f.ret != TY_VOID)
+        *out << " : " << tree->types.name(f.ret);
+    *out << "\n";
+    block(f.body, 1);
+    *out << "end\n";
+}
+
+void SourcePrinter::indent(int depth) {
+    for (int i = 0; i < depth; i++)
+        *out << "    ";
+}
+
+void SourcePrinter::block(NodeId id, int depth) {
+    if (id == noNode)
+        return;
+    const Block& b = tree->blocks[id];
+    for (const NodeId* v = tree->begin(b.vars); v != tree->end(b.vars); v++) {
+        indent(depth);
+        *out << decl(*v) << "\n";
+    }
+    if (b.vars.count > 0 && b.stmts.count > 0)
+        *out << "\n";
+    for (const NodeId* s = tree->begin(b.stmts); s != tree->end(b.stmts); s++)
+        stmt(*s, depth);
+}
+
+void SourcePrinter::stmt(NodeId id, int depth) {
+    const Stmt& s = tree->stmts[id];
+    indent(depth);
+    switch (s.kind) {
+    case StmtKind::Assign:
+        expr(s.target, 0);
+        *out << " = ";
+        expr(s.value, 0);
+        *out << "\n";
+        break;
+    case StmtKind::Call:
+        expr(s.value, 0);
+        *out << "\n";
+        break;
+    case StmtKind::Return:
+        *out << "return";
+        if (s.value != noNode) {
+            *out << " ";
+            expr(s.value, 0);
+        }
+        *out << "\n";
+        break;
+    case StmtKind::While:
+        *out << "while ";
+        expr(s.value, 0);
+        *out << "\n";
+        block(s.body, depth + 1);
+        indent(depth);
+        *out << "loop\n";
+        break;
+    case StmtKind::If: {
+        *out << "if ";
+        expr(s.value, 0);
+        *out << "\n";
+        block(s.body, depth + 1);
+        // un else que solo tiene un if se escribe como else if
+        NodeId orelse = s.orelse;
+        while (orelse != noNode) {
+            const Block& b = tree->blocks[orelse];
+            const Stmt* inner = b.vars.count == 0 && b.stmts.count == 1
+                                    ? &tree->stmts[*tree->begin(b.stmts)]
+                                    : nullptr;
+            indent(depth);
+            if (inner && inner->kind == StmtKind::If) {
+                *out << "else if ";
+                expr(inner->value, 0);
+                *out << "\n";
+                block(inner->body, depth + 1);
+                orelse = inner->orelse;
+            } else {
+                *out << "else\n";
+                block(orelse, depth + 1);
+                orelse = noNode;
+            }
+        }
+        indent(depth);
+        *out << "end\n";
+        break;
+    }
+    }
+}
+
+// context: precedencia minima que puede ir sin parentesis en ese lugar
+void SourcePrinter::expr(NodeId id, int context) {
+    const Expr& e = tree->exprs[id];
+    int prec = precedence(e);
+    if (prec < context)
+        *out << "(";
+    switch (e.kind) {
+    case ExprKind::Num:
+    case ExprKind::Str:
+        *out << tree->str(e.text);
+        break;
+    case ExprKind::True:
+        *out << "true";
+        break;
+    case ExprKind::False:
+        *out << "false";
+        break;
+    case ExprKind::Var:
+        *out << tree->str(e.sym);
+        break;
+    case ExprKind::Index:
+        expr(e.lhs, 8);
+        *out << "[";
+        expr(e.rhs, 0);
+        *out << "]";
+        break;
+    case ExprKind::Call:
+        *out << tree->str(e.sym) << "(";
+        for (const NodeId* a = tree->begin(e.args); a != tree->end(e.args); a++) {
+            if (a != tree->begin(e.args))
+                *out << ", ";
+            expr(*a, 0);
+        }
+        *out << ")";
+        break;
+    case ExprKind::New:
+        *out << "new [ ";
+        expr(e.rhs, 0);
+        *out << " ] " << tree->types.name(tree->types.element(e.type));
+        break;
+    case ExprKind::Unary:
+        *out << operatorText(e.opToken());
+        // "- -x" sin el espacio seguiria siendo valido, pero se lee mejor asi
+        if (e.opToken() == TK_MINUS && tree->exprs[e.lhs].kind == ExprKind::Unary)
+            *out << " ";
+        expr(e.lhs, 7);
+        break;
+    case ExprKind::Binary:
+        // todos asocian a la izquierda: el de la derecha con la misma
+        // precedencia necesita parentesis
+        expr(e.lhs, prec);
+        *out << " " << operatorText(e.opToken()) << " ";
+        expr(e.rhs, prec + 1);
+        break;
+    }
+    if (prec < context)
+        *out << ")";
+}
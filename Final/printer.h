@@ -0,0 +1,31 @@
+#ifndef PRINTER_H
+#define PRINTER_H
+
+#include <iostream>
+#include <string>
+#include "ast.h"
+
+using namespace std;
+
+// Escribe un AST como fuente Mini-0 que el parser vuelve a aceptar (para
+// --emit-optimized). Globales primero y despues las funciones, cuatro espacios
+// por nivel, una linea en blanco entre las declaraciones de un bloque y sus
+// comandos, y parentesis solo donde la precedencia los pide. Los comentarios y
+// los numeros de linea del original se pierden.
+class SourcePrinter {
+public:
+    void print(const Ast& tree, ostream& out);
+
+private:
+    const Ast* tree;
+    ostream* out;
+
+    void function(const Func& f);
+    void block(NodeId id, int depth);
+    void stmt(NodeId id, int depth);
+    void expr(NodeId id, int context);
+    void indent(int depth);
+    string decl(NodeId var) const;
+};
+
+#endif
@@ -0,0 +1,424 @@
+#include "ranges.h"
+
+#include <algorithm>
+#include <cstdint>
+
+using namespace std;
+
+namespace {
+
+const Value lowest = INT64_MIN;
+const Value highest = INT64_MAX;
+
+// aritmetica exacta: false si el resultado no entra en 64 bits
+bool add(Value a, Value b, Value& r) {
+    if ((b > 0 && a > highest - b) || (b < 0 && a < lowest - b))
+        return false;
+    r = a + b;
+    return true;
+}
+
+bool sub(Value a, Value b, Value& r) {
+    if ((b < 0 && a > highest + b) || (b > 0 && a < lowest + b))
+        return false;
+    r = a - b;
+    return true;
+}
+
+bool mul(Value a, Value b, Value& r) {
+    if (a == 0 || b == 0) {
+        r = 0;
+        return true;
+    }
+    if (a > 0 ? (b > 0 ? a > highest / b : b < lowest / a)
+              : (b > 0 ? a < lowest / b : (a == lowest || b == lowest || -a > highest / -b)))
+        return false;
+    r = a * b;
+    return true;
+}
+
+struct Range {
+    Value lo, hi;  // lo > hi: vacio (todavia sin valor, o no se llega)
+    bool empty() const { return lo > hi; }
+    bool operator!=(const Range& o) const { return lo != o.lo || hi != o.hi; }
+};
+
+const Range everything = {lowest, highest};
+const Range nothing = {highest, lowest};
+
+// x + k <= y (length: x + k <= largo del arreglo y). noValue es el 0.
+struct Fact {
+    IrValue x, y;
+    Value k;
+    bool length;
+};
+
+class RangeAnalysis {
+public:
+    explicit RangeAnalysis(IrFunction& fn) : f(fn), facts(nullptr) {}
+    bool run();
+
+private:
+    IrFunction& f;
+    vector<IrBlockId> idom;
+    vector<Range> ranges;
+    vector<vector<Fact>> entry;  // por bloque: lo que vale al entrar
+    const vector<Fact>* facts;   // los del lugar que se esta mirando
+
+    void condition(IrValue c, bool taken, vector<Fact>& out) const;
+    void passed(IrValue v, vector<Fact>& out) const;
+    void edge(IrBlockId from, IrBlockId to, vector<Fact>& out) const;
+    bool compute();
+    Range evaluate(IrValue v);
+    Range global(IrValue v) const;
+    Range at(IrValue v, int depth = 1) const;
+    bool noWrap(IrValue v) const;
+    bool below(IrValue i, IrValue x, Value k, int depth) const;
+    bool safe(IrValue check) const;
+};
+
+// hechos que da saber que la condicion c fue (o no) verdadera
+void RangeAnalysis::condition(IrValue c, bool taken, vector<Fact>& out) const {
+    IrOp op = f.instrs[c].op;
+    if (op == I_NOT) {
+        condition(f.arg(c, 0), !taken, out);
+        return;
+    }
+    if (op < I_LT || op > I_NE)
+        return;
+    IrValue a = f.arg(c, 0), b = f.arg(c, 1);
+    if (!taken) {
+        // not (a < b) es b <= a, etc.
+        switch (op) {
+        case I_LT: op = I_GE; break;
+        case I_LE: op = I_GT; break;
+        case I_GT: op = I_LE; break;
+        case I_GE: op = I_LT; break;
+        case I_EQ: op = I_NE; break;
+        default: op = I_EQ; break;
+        }
+    }
+    switch (op) {
+    case I_LT: out.push_back({a, b, 1, false}); break;
+    case I_LE: out.push_back({a, b, 0, false}); break;
+    case I_GT: out.push_back({b, a, 1, false}); break;
+    case I_GE: out.push_back({b, a, 0, false}); break;
+    case I_EQ:
+        out.push_back({a, b, 0, false});
+        out.push_back({b, a, 0, false});
+        break;
+    default: break;
+    }
+}
+
+// lo que vale despues de que v corrio sin error
+void RangeAnalysis::passed(IrValue v, vector<Fact>& out) const {
+    if (f.instrs[v].op == I_NEW) {
+        out.push_back({noValue, f.arg(v, 0), 0, false});
+    } else if (f.instrs[v].op == I_CHECK) {
+        out.push_back({noValue, f.arg(v, 1), 0, false});
+        out.push_back({f.arg(v, 1), f.arg(v, 0), 1, true});
+    }
+}
+
+// lo que vale al pasar de from a to: lo de from y su branch
+void RangeAnalysis::edge(IrBlockId from, IrBlockId to, vector<Fact>& out) const {
+    const IrBlock& b = f.blocks[from];
+    out = entry[from];
+    for (IrValue v : b.instrs)
+        passed(v, out);
+    if (b.succCount == 2 && b.succ[0] != b.succ[1])
+        condition(f.arg(b.instrs.back(), 0), b.succ[0] == to, out);
+}
+
+Range RangeAnalysis::global(IrValue v) const {
+    if (v == noValue)
+        return {0, 0};
+    return ranges[v];
+}
+
+// el intervalo de v achicado con los hechos del lugar; depth: cuantas veces
+// se achica tambien el otro lado de un hecho
+Range RangeAnalysis::at(IrValue v, int depth) const {
+    Range r = global(v);
+    if (v == noValue || r.empty())
+        return r;
+    for (const Fact& h : *facts) {
+        if (h.length)
+            continue;
+        Value bound;
+        if (h.x == v) {
+            Range y = depth > 0 ? at(h.y, depth - 1) : global(h.y);
+            if (!y.empty() && sub(y.hi, h.k, bound))
+                r.hi = min(r.hi, bound);
+        } else if (h.y == v) {
+            Range x = depth > 0 ? at(h.x, depth - 1) : global(h.x);
+            if (!x.empty() && add(x.lo, h.k, bound))
+                r.lo = max(r.lo, bound);
+        } else if (h.x == noValue && h.k >= 0 && f.instrs[h.y].op == I_ADD) {
+            // 0 <= v + q con q >= 0: la suma no dio la vuelta, v <= max - q
+            for (uint32_t side = 0; side < 2; side++) {
+                Range q = global(f.arg(h.y, 1 - side));
+                if (f.arg(h.y, side) == v && !q.empty() && q.lo >= 0)
+                    r.hi = min(r.hi, highest - q.lo);
+            }
+        }
+    }
+    return r;
+}
+
+Range RangeAnalysis::evaluate(IrValue v) {
+    const IrInstr& in = f.instrs[v];
+    Range a = in.count > 0 ? at(f.arg(v, 0)) : nothing;
+    Range b = in.count > 1 ? at(f.arg(v, 1)) : nothing;
+    Range r;
+    switch (in.op) {
+    case I_CONST:
+        return {in.imm, in.imm};
+    case I_ADD:
+        if (a.empty() || b.empty())
+            return nothing;
+        return add(a.lo, b.lo, r.lo) && add(a.hi, b.hi, r.hi) ? r : everything;
+    case I_SUB:
+        if (a.empty() || b.empty())
+            return nothing;
+        return sub(a.lo, b.hi, r.lo) && sub(a.hi, b.lo, r.hi) ? r : everything;
+    case I_MUL: {
+        if (a.empty() || b.empty())
+            return nothing;
+        Value p[4];
+        if (!mul(a.lo, b.lo, p[0]) || !mul(a.lo, b.hi, p[1]) || !mul(a.hi, b.lo, p[2]) ||
+            !mul(a.hi, b.hi, p[3]))
+            return everything;
+        return {*min_element(p, p + 4), *max_element(p, p + 4)};
+    }
+    case I_DIV: {
+        if (a.empty() || b.empty())
+            return nothing;
+        // con divisor positivo los extremos estan en las esquinas
+        if (b.lo <= 0)
+            return everything;
+        Value p[4] = {a.lo / b.lo, a.lo / b.hi, a.hi / b.lo, a.hi / b.hi};
+        return {*min_element(p, p + 4), *max_element(p, p + 4)};
+    }
+    case I_NEG:
+        if (a.empty())
+            return nothing;
+        return a.lo == lowest ? everything : Range{-a.hi, -a.lo};
+    case I_LT:
+    case I_LE:
+    case I_GT:
+    case I_GE:
+    case I_EQ:
+    case I_NE:
+    case I_NOT:
+        return {0, 1};
+    case I_PHI: {
+        r = nothing;
+        const vector<IrBlockId>& preds = f.blocks[in.block].preds;
+        const vector<Fact>* saved = facts;
+        vector<Fact> local;
+        for (uint32_t k = 0; k < in.count; k++) {
+            edge(preds[k], in.block, local);
+            facts = &local;
+            Range op = at(f.arg(v, k));
+            if (!op.empty()) {
+                r.lo = min(r.lo, op.lo);
+                r.hi = max(r.hi, op.hi);
+            }
+        }
+        facts = saved;
+        return r;
+    }
+    default:
+        return everything;
+    }
+}
+
+// Punto fijo: los phis empiezan vacios y solo crecen; uno que crecio mas de
+// dos veces pasa al extremo, asi un bucle no da una vuelta por valor
+bool RangeAnalysis::compute() {
+    vector<IrBlockId> order = irReversePostorder(f);
+    ranges.assign(f.instrs.size(), nothing);
+    vector<uint8_t> growth(f.instrs.size(), 0);
+    for (int round = 0; round < 64; round++) {
+        bool changed = false;
+        for (IrBlockId b : order) {
+            facts = &entry[b];
+            for (IrValue v : f.blocks[b].instrs) {
+                Range old = ranges[v];
+                Range r = evaluate(v);
+                if (f.instrs[v].op == I_PHI && !old.empty()) {
+                    r.lo = min(r.lo, old.lo);
+                    r.hi = max(r.hi, old.hi);
+                    if (r != old && ++growth[v] > 2) {
+                        if (r.lo < old.lo)
+                            r.lo = lowest;
+                        if (r.hi > old.hi)
+                            r.hi = highest;
+                    }
+                }
+                if (r != old) {
+                    ranges[v] = r;
+                    changed = true;
+                }
+            }
+        }
+        if (!changed)
+            return true;
+    }
+    return false;
+}
+
+// v (suma o resta) no dio la vuelta: con los intervalos de los operandos, o
+// porque el resultado no es negativo y sumar algo >= 0 (o restar algo <= 0)
+// solo puede dar la vuelta hacia los negativos (new [n + 1] ya paso)
+bool RangeAnalysis::noWrap(IrValue v) const {
+    Range a = at(f.arg(v, 0)), b = at(f.arg(v, 1)), r = at(v);
+    Value lo, hi;
+    if (a.empty() || b.empty())
+        return false;
+    if (!r.empty() && r.lo >= 0) {
+        if (f.instrs[v].op == I_ADD && (a.lo >= 0 || b.lo >= 0))
+            return true;
+        if (f.instrs[v].op == I_SUB && b.hi <= 0)
+            return true;
+    }
+    if (f.instrs[v].op == I_ADD)
+        return add(a.lo, b.lo, lo) && add(a.hi, b.hi, hi);
+    return sub(a.lo, b.hi, lo) && sub(a.hi, b.lo, hi);
+}
+
+// i + k <= x (noValue es el 0), sin que nada de vuelta en el camino
+bool RangeAnalysis::below(IrValue i, IrValue x, Value k, int depth) const {
+    if (i == x)
+        return k <= 0;
+    Range ri = at(i), rx = at(x);
+    Value t;
+    if (!ri.empty() && !rx.empty() && add(ri.hi, k, t) && t <= rx.lo)
+        return true;
+    for (const Fact& h : *facts) {
+        if (h.length || h.x != i)
+            continue;
+        if (h.y == x && h.k >= k)
+            return true;
+        // i + k <= x si i + h.k <= y y y + (k - h.k) <= x
+        if (depth > 0 && sub(k, h.k, t) && below(h.y, x, t, depth - 1))
+            return true;
+    }
+    if (depth == 0)
+        return false;
+
+    // i = p + q o p - q: se mueve q del otro lado
+    if (i != noValue && (f.instrs[i].op == I_ADD || f.instrs[i].op == I_SUB) && noWrap(i)) {
+        IrValue p = f.arg(i, 0), q = f.arg(i, 1);
+        Range rp = at(p), rq = at(q);
+        if (f.instrs[i].op == I_ADD) {
+            if (add(k, rq.hi, t) && below(p, x, t, depth - 1))
+                return true;
+            if (add(k, rp.hi, t) && below(q, x, t, depth - 1))
+                return true;
+        } else if (sub(k, rq.lo, t) && below(p, x, t, depth - 1)) {
+            return true;
+        }
+    }
+    // x = y + c o y - c
+    if (x != noValue && (f.instrs[x].op == I_ADD || f.instrs[x].op == I_SUB) && noWrap(x)) {
+        IrValue y = f.arg(x, 0), c = f.arg(x, 1);
+        Range ry = at(y), rc = at(c);
+        if (f.instrs[x].op == I_ADD) {
+            if (sub(k, rc.lo, t) && below(i, y, t, depth - 1))
+                return true;
+            if (sub(k, ry.lo, t) && below(i, c, t, depth - 1))
+                return true;
+        } else {
+            if (add(k, rc.hi, t) && below(i, y, t, depth - 1))
+                return true;
+            // 0 + k <= y - c si c + k <= y
+            if (i == noValue && below(c, y, k, depth - 1))
+                return true;
+        }
+    }
+    return false;
+}
+
+bool RangeAnalysis::safe(IrValue check) const {
+    IrValue a = f.arg(check, 0), i = f.arg(check, 1);
+    const int depth = 4;
+    bool created = f.instrs[a].op == I_NEW;
+    bool known = created;
+    for (const Fact& h : *facts)
+        if (h.length && h.y == a)
+            known = true;
+    if (!known || !below(noValue, i, 0, depth))
+        return false;
+    if (created && below(i, f.arg(a, 0), 1, depth))
+        return true;
+    // j + k <= largo: alcanza con i + 1 <= j + k
+    Value t;
+    for (const Fact& h : *facts)
+        if (h.length && h.y == a && sub(1, h.k, t) && below(i, h.x, t, depth))
+            return true;
+    return false;
+}
+
+bool RangeAnalysis::run() {
+    idom = irDominators(f);
+    vector<IrBlockId> order = irReversePostorder(f);
+    // el dominador inmediato va antes en este orden
+    entry.assign(f.blocks.size(), vector<Fact>());
+    for (IrBlockId b : order) {
+        if (b == 0)
+            continue;
+        IrBlockId d = idom[b];
+        if (f.blocks[b].preds.size() == 1)
+            edge(d, b, entry[b]);
+        else {
+            entry[b] = entry[d];
+            for (IrValue v : f.blocks[d].instrs)
+                passed(v, entry[b]);
+        }
+    }
+    if (!compute())
+        return false;
+
+    bool changed = false;
+    vector<Fact> local;
+    for (IrBlockId b : order) {
+        local = entry[b];
+        facts = &local;
+        vector<IrValue> list = f.blocks[b].instrs;
+        for (IrValue v : list) {
+            // un chequeo que se saca igual vale como hecho: nunca falla
+            if (f.instrs[v].op == I_CHECK && safe(v)) {
+                f.remove(v);
+                changed = true;
+            }
+            passed(v, local);
+        }
+    }
+    return changed;
+}
+
+} // namespace
+
+bool eliminateChecks(IrFunction& f) {
+    RangeAnalysis analysis(f);
+    return analysis.run();
+}
+
+bool removeChecks(IrFunction& f) {
+    bool changed = false;
+    for (IrBlock& b : f.blocks)
+        for (size_t k = 0; k < b.instrs.size();) {
+            IrValue v = b.instrs[k];
+            if (f.instrs[v].op == I_CHECK) {
+                f.instrs[v].block = noBlock;
+                b.instrs.erase(b.instrs.begin() + (ptrdiff_t)k);
+                changed = true;
+            } else {
+                k++;
+            }
+        }
+    return changed;
+}
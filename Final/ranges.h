@@ -0,0 +1,24 @@
+#ifndef RANGES_H
+#define RANGES_H
+
+#include "ir.h"
+
+using namespace std;
+
+// Eliminacion de chequeos de indices con analisis de rangos (-O). Por cada
+// valor del IR se calcula un intervalo [min, max] (punto fijo sobre el SSA,
+// con los phis ensanchados a +-infinito si siguen creciendo) y se juntan
+// hechos de la forma x + k <= y que valen en cada bloque:
+//   - la condicion de un branch, en los bloques a los que solo se llega por
+//     una de sus ramas (while i < n: i + 1 <= n en el cuerpo)
+//   - lo que dejan pasar las instrucciones que fallan: despues de new [n],
+//     n >= 0; despues de CHECK a, j: 0 <= j y j + 1 <= largo de a
+// Un CHECK a, i se saca si a no puede ser nulo (sale de un new o ya se
+// chequeo) y se prueba 0 <= i y i + 1 <= largo: con los intervalos, con los
+// hechos o desarmando sumas y restas (a[i - 1], a[n - 1 - i]) sin que den la
+// vuelta. Lo que no se puede probar queda chequeado.
+bool eliminateChecks(IrFunction& f);
+// --unchecked: saca todos los CHECK (codigo en el que se confia)
+bool removeChecks(IrFunction& f);
+
+#endif
@@ -0,0 +1,878 @@
+#include "regvm.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+
+using namespace std;
+
+const char* const regOpNames[R_COUNT] = {
+    "move", "loadi", "loadk", "load_global", "store_global",
+    "add", "sub", "mul", "div", "lt", "le", "gt", "ge", "eq", "ne", "neg", "not",
+    "new_array", "load_index", "store_index",
+    "jump", "jump_false", "jump_true", "call", "ret", "ret_void",
+    "addi", "jlt", "jle", "jgt", "jge", "jeq", "jne",
+    "jlti", "jlei", "jgti", "jgei", "jeqi", "jnei",
+    "load_indexi", "store_indexi",
+};
+
+void RegProgram::clear() {
+    functions.clear();
+    constants.clear();
+    strings.clear();
+    globals = 0;
+    mainFunction = -1;
+    threaded = false;
+}
+
+size_t RegProgram::instructions() const {
+    size_t n = 0;
+    for (const RegFunction& f : functions)
+        n += f.code.size();
+    return n;
+}
+
+void RegProgram::disassemble(ostream& out) const {
+    auto reg = [](int32_t r) { return "r" + to_string(r); };
+    for (const RegFunction& f : functions) {
+        out << "fun " << f.name << " (params " << f.params << ", locales " << f.locals
+            << ", registros " << f.frameSize << ")\n";
+        for (size_t pc = 0; pc < f.code.size(); pc++) {
+            const RegInstr& i = f.code[pc];
+            out << "  " << setw(5) << pc << "  " << left << setw(13) << regOpNames[i.op] << right;
+            switch (i.op) {
+            case R_MOVE: case R_NEG: case R_NOT: case R_NEW_ARRAY:
+                out << reg(i.a) << " " << reg(i.b);
+                break;
+            case R_LOADI:
+                out << reg(i.a) << " " << i.b;
+                break;
+            case R_LOADK: {
+                Value v = constants[i.b];
+                out << reg(i.a) << " ";
+                bool isString = false;
+                for (const string& s : strings)
+                    if (v == (Value)(intptr_t)s.c_str())
+                        isString = true;
+                if (isString)
+                    out << "\"" << (const char*)(intptr_t)v << "\"";
+                else
+                    out << v;
+                break;
+            }
+            case R_LOAD_GLOBAL:
+                out << reg(i.a) << " g" << i.b;
+                break;
+            case R_STORE_GLOBAL:
+                out << "g" << i.a << " " << reg(i.b);
+                break;
+            case R_JUMP:
+                out << i.a;
+                break;
+            case R_JUMP_FALSE: case R_JUMP_TRUE:
+                out << reg(i.a) << " " << i.b;
+                break;
+            case R_CALL:
+                out << (i.a < 0 ? string("-") : reg(i.a)) << " " << functions[i.b].name << " " << reg(i.c);
+                break;
+            case R_RET:
+                out << reg(i.a);
+                break;
+            case R_RET_VOID:
+                break;
+            case R_ADDI: case R_LOAD_INDEXI:
+                out << reg(i.a) << " " << reg(i.b) << " " << i.c;
+                break;
+            case R_JLTI: case R_JLEI: case R_JGTI: case R_JGEI: case R_JEQI: case R_JNEI:
+            case R_STORE_INDEXI:
+                out << reg(i.a) << " " << i.b << " " << (i.op == R_STORE_INDEXI ? reg(i.c) : to_string(i.c));
+                break;
+            case R_JLT: case R_JLE: case R_JGT: case R_JGE: case R_JEQ: case R_JNE:
+                out << reg(i.a) << " " << reg(i.b) << " " << i.c;
+                break;
+            default:
+                out << reg(i.a) << " " << reg(i.b) << " " << reg(i.c);
+                break;
+            }
+            out << "\n";
+        }
+    }
+}
+
+RegisterCompiler::RegisterCompiler()
+    : tree(nullptr), names(nullptr), program(nullptr), fn(nullptr), err(&cerr),
+      errors(0), fusion(true), line(0), nextTemp(0) {}
+
+void RegisterCompiler::setOutput(ostream& errStream) {
+    err = &errStream;
+}
+
+void RegisterCompiler::setFusion(bool enabled) {
+    fusion = enabled;
+}
+
+void RegisterCompiler::error(uint32_t where, const string& message) {
+    errors++;
+    *err << "Error de compilacion en linea " << where << ": " << message << endl;
+}
+
+bool RegisterCompiler::compile(const Ast& ast, const SemanticAnalyzer& resolved, RegProgram& out) {
+    tree = &ast;
+    names = &resolved;
+    program = &out;
+    errors = 0;
+    out.clear();
+    numbers.clear();
+    literals.clear();
+    slots.assign(ast.vars.size(), 0);
+    isGlobal.assign(ast.vars.size(), 0);
+
+    out.globals = (uint32_t)ast.globals.size();
+    for (size_t i = 0; i < ast.globals.size(); i++) {
+        slots[ast.globals[i]] = (int32_t)i;
+        isGlobal[ast.globals[i]] = 1;
+    }
+
+    Symbol mainName = ast.symbols.find("main", 4);
+    out.functions.resize(ast.funcs.size());
+    for (size_t i = 0; i < ast.funcs.size(); i++) {
+        if (ast.funcs[i].name == mainName)
+            out.mainFunction = (int32_t)i;
+        function(ast.funcs[i], out.functions[i]);
+    }
+    fn = nullptr;
+    return errors == 0;
+}
+
+void RegisterCompiler::function(const Func& f, RegFunction& code) {
+    fn = &code;
+    code.name = tree->str(f.name);
+    code.params = f.params.count;
+    line = f.line;
+
+    // todas las variables primero: los temporales van despues de la ultima
+    for (const NodeId* p = tree->begin(f.params); p != tree->end(f.params); p++)
+        declare(*p);
+    vector<NodeId> pending(1, f.body);
+    while (!pending.empty()) {
+        NodeId id = pending.back();
+        pending.pop_back();
+        if (id == noNode)
+            continue;
+        const Block& b = tree->blocks[id];
+        for (const NodeId* v = tree->begin(b.vars); v != tree->end(b.vars); v++)
+            declare(*v);
+        for (const NodeId* s = tree->begin(b.stmts); s != tree->end(b.stmts); s++) {
+            const Stmt& st = tree->stmts[*s];
+            if (st.kind == StmtKind::If)
+                pending.push_back(st.orelse);
+            if (st.kind == StmtKind::If || st.kind == StmtKind::While)
+                pending.push_back(st.body);
+        }
+    }
+    nextTemp = (int32_t)code.locals;
+    code.frameSize = code.locals;
+
+    block(f.body, false);
+
+    // se llego al final sin return: una funcion con tipo devuelve 0
+    if (f.ret != TY_VOID) {
+        int32_t r = temp();
+        emit(R_LOADI, r, 0);
+        emit(R_RET, r);
+    } else {
+        emit(R_RET_VOID);
+    }
+}
+
+void RegisterCompiler::declare(NodeId var) {
+    slots[var] = (int32_t)fn->locals++;
+    isGlobal[var] = 0;
+}
+
+// las variables del cuerpo ya estan en 0 al entrar; las de un bloque anidado
+// se limpian cada vez que se entra al bloque (por ejemplo en cada vuelta)
+void RegisterCompiler::block(NodeId id, bool nested) {
+    if (id == noNode)
+        return;
+    const Block& b = tree->blocks[id];
+    if (nested)
+        for (const NodeId* v = tree->begin(b.vars); v != tree->end(b.vars); v++)
+            emit(R_LOADI, slots[*v], 0);
+    for (const NodeId* s = tree->begin(b.stmts); s != tree->end(b.stmts); s++)
+        stmt(*s);
+}
+
+void RegisterCompiler::stmt(NodeId id) {
+    const Stmt& s = tree->stmts[id];
+    int32_t mark = nextTemp;
+    line = s.line;
+    switch (s.kind) {
+    case StmtKind::Assign: {
+        const Expr& target = tree->exprs[s.target];
+        if (target.kind == ExprKind::Index) {
+            int32_t array = expr(target.lhs, -1);
+            int32_t k;
+            if (fusion && immediate(target.rhs, k)) {
+                int32_t value = expr(s.value, -1);
+                line = target.line;
+                emit(R_STORE_INDEXI, array, k, value);
+            } else {
+                int32_t index = expr(target.rhs, -1);
+                int32_t value = expr(s.value, -1);
+                line = target.line;
+                emit(R_STORE_INDEX, array, index, value);
+            }
+            break;
+        }
+        NodeId var = names->declOf(s.target);
+        if (isGlobal[var])
+            emit(R_STORE_GLOBAL, slots[var], expr(s.value, -1));
+        else
+            expr(s.value, slots[var]);
+        break;
+    }
+    case StmtKind::Call:
+        call(s.value, -1);
+        break;
+    case StmtKind::If: {
+        vector<size_t> skip;
+        cond(s.value, false, skip);
+        block(s.body, true);
+        if (s.orelse != noNode) {
+            vector<size_t> end(1, emit(R_JUMP));
+            patch(skip, fn->code.size());
+            block(s.orelse, true);
+            patch(end, fn->code.size());
+        } else {
+            patch(skip, fn->code.size());
+        }
+        break;
+    }
+    case StmtKind::While: {
+        // condicion al final: una sola instruccion de salto por vuelta
+        vector<size_t> toCond(1, emit(R_JUMP));
+        size_t top = fn->code.size();
+        block(s.body, true);
+        patch(toCond, fn->code.size());
+        line = s.line;
+        vector<size_t> again;
+        cond(s.value, true, again);
+        patch(again, top);
+        break;
+    }
+    case StmtKind::Return:
+        if (s.value != noNode)
+            emit(R_RET, expr(s.value, -1));
+        else
+            emit(R_RET_VOID);
+        break;
+    }
+    nextTemp = mark;
+}
+
+int32_t RegisterCompiler::expr(NodeId id, int32_t dst) {
+    const Expr& e = tree->exprs[id];
+    int32_t mark = nextTemp;
+    switch (e.kind) {
+    case ExprKind::Num: {
+        Value v;
+        if (!parseNumber(tree->text() + e.text.offset, e.text.length, v))
+            error(e.line, "el numero " + tree->str(e.text) + " no entra en un int");
+        int32_t d = target(dst);
+        loadValue(d, v);
+        return d;
+    }
+    case ExprKind::Str: {
+        int32_t d = target(dst);
+        emit(R_LOADK, d, stringConstant(tree->text() + e.text.offset, e.text.length));
+        return d;
+    }
+    case ExprKind::True:
+    case ExprKind::False: {
+        int32_t d = target(dst);
+        emit(R_LOADI, d, e.kind == ExprKind::True ? 1 : 0);
+        return d;
+    }
+    case ExprKind::Var: {
+        NodeId var = names->declOf(id);
+        if (isGlobal[var]) {
+            int32_t d = target(dst);
+            emit(R_LOAD_GLOBAL, d, slots[var]);
+            return d;
+        }
+        // una local ya es un registro: solo se copia si piden otro lugar
+        if (dst >= 0 && dst != slots[var])
+            emit(R_MOVE, dst, slots[var]);
+        return dst >= 0 ? dst : slots[var];
+    }
+    case ExprKind::Index: {
+        int32_t array = expr(e.lhs, -1);
+        int32_t k;
+        if (fusion && immediate(e.rhs, k)) {
+            nextTemp = mark;
+            int32_t d = target(dst);
+            line = e.line;
+            emit(R_LOAD_INDEXI, d, array, k);
+            return d;
+        }
+        int32_t index = expr(e.rhs, -1);
+        nextTemp = mark;
+        int32_t d = target(dst);
+        line = e.line;
+        emit(R_LOAD_INDEX, d, array, index);
+        return d;
+    }
+    case ExprKind::Call: {
+        // el resultado puede quedar donde estaba el primer argumento
+        int32_t d = dst >= 0 ? dst : mark;
+        call(id, d);
+        return dst >= 0 ? dst : temp();
+    }
+    case ExprKind::New: {
+        int32_t length = expr(e.rhs, -1);
+        nextTemp = mark;
+        int32_t d = target(dst);
+        line = e.line;
+        emit(R_NEW_ARRAY, d, length);
+        return d;
+    }
+    case ExprKind::Unary: {
+        int32_t value = expr(e.lhs, -1);
+        nextTemp = mark;
+        int32_t d = target(dst);
+        emit(e.opToken() == TK_NOT ? R_NOT : R_NEG, d, value);
+        return d;
+    }
+    case ExprKind::Binary:
+        break;
+    }
+
+    int op = e.opToken();
+    if (op == TK_AND || op == TK_OR) {
+        // cortocircuito. El resultado se arma en un temporal: si dst fuera una
+        // local que aparece en el operando derecho se pisaria antes de leerla
+        int32_t r = dst >= (int32_t)fn->locals ? dst : temp();
+        expr(e.lhs, r);
+        vector<size_t> end(1, emit(op == TK_AND ? R_JUMP_FALSE : R_JUMP_TRUE, r));
+        expr(e.rhs, r);
+        patch(end, fn->code.size());
+        if (dst >= 0 && r != dst) {
+            nextTemp = mark;
+            emit(R_MOVE, dst, r);
+            return dst;
+        }
+        nextTemp = max(mark, r + 1);
+        return r;
+    }
+
+    int32_t k;
+    if (fusion && op == TK_PLUS && immediate(e.lhs, k)) {
+        int32_t value = expr(e.rhs, -1);
+        nextTemp = mark;
+        int32_t d = target(dst);
+        emit(R_ADDI, d, value, k);
+        return d;
+    }
+    if (fusion && (op == TK_PLUS || op == TK_MINUS) && immediate(e.rhs, k)) {
+        int32_t value = expr(e.lhs, -1);
+        nextTemp = mark;
+        int32_t d = target(dst);
+        emit(R_ADDI, d, value, op == TK_MINUS ? -k : k);
+        return d;
+    }
+
+    int32_t left = expr(e.lhs, -1);
+    int32_t right = expr(e.rhs, -1);
+    nextTemp = mark;
+    int32_t d = target(dst);
+    RegOp code = R_ADD;
+    switch (op) {
+    case TK_PLUS: code = R_ADD; break;
+    case TK_MINUS: code = R_SUB; break;
+    case TK_MUL: code = R_MUL; break;
+    case TK_DIV: code = R_DIV; line = e.line; break;
+    case TK_LT: code = R_LT; break;
+    case TK_LE: code = R_LE; break;
+    case TK_GT: code = R_GT; break;
+    case TK_GE: code = R_GE; break;
+    case TK_EQ: code = R_EQ; break;
+    case TK_NEQ: code = R_NE; break;
+    }
+    emit(code, d, left, right);
+    return d;
+}
+
+// argumentos en temporales seguidos desde nextTemp; dst < 0 descarta el resultado
+void RegisterCompiler::call(NodeId id, int32_t dst) {
+    const Expr& e = tree->exprs[id];
+    int32_t base = nextTemp;
+    for (uint32_t i = 0; i < e.args.count; i++)
+        temp();
+    int32_t r = base;
+    for (const NodeId* a = tree->begin(e.args); a != tree->end(e.args); a++)
+        expr(*a, r++);
+    line = e.line;
+    emit(R_CALL, dst, (int32_t)names->declOf(id), base);
+    nextTemp = base;
+}
+
+void RegisterCompiler::cond(NodeId id, bool when, vector<size_t>& jumps) {
+    const Expr& e = tree->exprs[id];
+    if (e.kind == ExprKind::Unary && e.opToken() == TK_NOT) {
+        cond(e.lhs, !when, jumps);
+        return;
+    }
+    if (e.kind == ExprKind::True || e.kind == ExprKind::False) {
+        if ((e.kind == ExprKind::True) == when)
+            jumps.push_back(emit(R_JUMP));
+        return;
+    }
+    int op = e.kind == ExprKind::Binary ? e.opToken() : 0;
+    if (op == TK_AND || op == TK_OR) {
+        // 'a and b' es verdadero si no falla ninguno; 'a or b', si vale alguno
+        bool stopWhen = op == TK_OR;
+        if (when == stopWhen) {
+            cond(e.lhs, when, jumps);
+            cond(e.rhs, when, jumps);
+        } else {
+            vector<size_t> skip;
+            cond(e.lhs, stopWhen, skip);
+            cond(e.rhs, when, jumps);
+            patch(skip, fn->code.size());
+        }
+        return;
+    }
+
+    int32_t mark = nextTemp;
+    int compare = -1;
+    switch (op) {
+    case TK_LT: compare = 0; break;
+    case TK_LE: compare = 1; break;
+    case TK_GT: compare = 2; break;
+    case TK_GE: compare = 3; break;
+    case TK_EQ: compare = 4; break;
+    case TK_NEQ: compare = 5; break;
+    }
+    if (fusion && compare >= 0) {
+        // saltar cuando es falsa = saltar con la comparacion opuesta
+        static const int opposite[6] = {3, 2, 1, 0, 5, 4};
+        if (!when)
+            compare = opposite[compare];
+        int32_t left = expr(e.lhs, -1);
+        int32_t k;
+        if (immediate(e.rhs, k))
+            jumps.push_back(emit((RegOp)(R_JLTI + compare), left, k));
+        else
+            jumps.push_back(emit((RegOp)(R_JLT + compare), left, expr(e.rhs, -1)));
+        nextTemp = mark;
+        return;
+    }
+    int32_t value = expr(id, -1);
+    jumps.push_back(emit(when ? R_JUMP_TRUE : R_JUMP_FALSE, value));
+    nextTemp = mark;
+}
+
+bool RegisterCompiler::immediate(NodeId id, int32_t& value) {
+    const Expr& e = tree->exprs[id];
+    if (e.kind == ExprKind::True || e.kind == ExprKind::False) {
+        value = e.kind == ExprKind::True ? 1 : 0;
+        return true;
+    }
+    Value v;
+    if (e.kind != ExprKind::Num || !parseNumber(tree->text() + e.text.offset, e.text.length, v) ||
+        v > INT32_MAX)
+        return false;
+    value = (int32_t)v;
+    return true;
+}
+
+int32_t RegisterCompiler::temp() {
+    int32_t r = nextTemp++;
+    fn->frameSize = max(fn->frameSize, (uint32_t)nextTemp);
+    return r;
+}
+
+int32_t RegisterCompiler::target(int32_t dst) {
+    return dst >= 0 ? dst : temp();
+}
+
+void RegisterCompiler::loadValue(int32_t dst, Value v) {
+    if (v >= INT32_MIN && v <= INT32_MAX) {
+        emit(R_LOADI, dst, (int32_t)v);
+        return;
+    }
+    auto it = numbers.find(v);
+    if (it == numbers.end()) {
+        it = numbers.emplace(v, (int32_t)program->constants.size()).first;
+        program->constants.push_back(v);
+    }
+    emit(R_LOADK, dst, it->second);
+}
+
+int32_t RegisterCompiler::stringConstant(const char* text, size_t length) {
+    string value = unescapeLiteral(text, length);
+    auto it = literals.find(value);
+    if (it != literals.end())
+        return it->second;
+    program->strings.push_back(value);
+    int32_t index = (int32_t)program->constants.size();
+    program->constants.push_back((Value)(intptr_t)program->strings.back().c_str());
+    literals.emplace(move(value), index);
+    return index;
+}
+
+size_t RegisterCompiler::emit(RegOp op, int32_t a, int32_t b, int32_t c) {
+    fn->code.push_back({nullptr, op, a, b, c});
+    fn->lines.push_back(line);
+    return fn->code.size() - 1;
+}
+
+// el destino va en el ultimo operando que usa cada salto
+void RegisterCompiler::patch(const vector<size_t>& jumps, size_t target) {
+    for (size_t at : jumps) {
+        RegInstr& i = fn->code[at];
+        if (i.op == R_JUMP)
+            i.a = (int32_t)target;
+        else if (i.op == R_JUMP_FALSE || i.op == R_JUMP_TRUE)
+            i.b = (int32_t)target;
+        else
+            i.c = (int32_t)target;
+    }
+}
+
+RegisterVM::RegisterVM() : registers(registerCount), err(&cerr) {}
+
+RegisterVM::~RegisterVM() {
+    freeHeap();
+}
+
+void RegisterVM::setOutput(ostream& errStream) {
+    err = &errStream;
+}
+
+Value* RegisterVM::newArray(Value length) {
+    Value* a = (Value*)calloc((size_t)length + 1, sizeof(Value));
+    if (a) {
+        a[0] = length;
+        heap.push_back(a);
+    }
+    return a;
+}
+
+void RegisterVM::freeHeap() {
+    for (Value* a : heap)
+        free(a);
+    heap.clear();
+}
+
+void RegisterVM::fail(const RegFunction* fn, const RegInstr* ip, const string& message) {
+    *err << "Error de ejecucion en linea " << fn->lines[ip - fn->code.data()] << " ('"
+         << fn->name << "'): " << message << endl;
+}
+
+bool RegisterVM::run(RegProgram& program, Value& result, Dispatch dispatch) {
+    if (dispatch == Dispatch::Threaded && threadedAvailable())
+        return execute<true>(program, result);
+    return execute<false>(program, result);
+}
+
+// Un solo cuerpo para los dos despachos. Threaded: al final de cada
+// instruccion se salta a la etiqueta de la siguiente (un salto indirecto por
+// instruccion, que el predictor aprende por sitio). Switch: se vuelve siempre
+// al mismo salto del switch.
+template <bool Threaded>
+bool RegisterVM::execute(RegProgram& program, Value& result) {
+#if MINI0_COMPUTED_GOTO
+    static const void* const labels[R_COUNT] = {
+        &&op_MOVE, &&op_LOADI, &&op_LOADK, &&op_LOAD_GLOBAL, &&op_STORE_GLOBAL,
+        &&op_ADD, &&op_SUB, &&op_MUL, &&op_DIV, &&op_LT, &&op_LE, &&op_GT, &&op_GE,
+        &&op_EQ, &&op_NE, &&op_NEG, &&op_NOT,
+        &&op_NEW_ARRAY, &&op_LOAD_INDEX, &&op_STORE_INDEX,
+        &&op_JUMP, &&op_JUMP_FALSE, &&op_JUMP_TRUE, &&op_CALL, &&op_RET, &&op_RET_VOID,
+        &&op_ADDI, &&op_JLT, &&op_JLE, &&op_JGT, &&op_JGE, &&op_JEQ, &&op_JNE,
+        &&op_JLTI, &&op_JLEI, &&op_JGTI, &&op_JGEI, &&op_JEQI, &&op_JNEI,
+        &&op_LOAD_INDEXI, &&op_STORE_INDEXI,
+    };
+    if (Threaded && !program.threaded) {
+        for (RegFunction& f : program.functions)
+            for (RegInstr& i : f.code)
+                i.label = labels[i.op];
+        program.threaded = true;
+    }
+#define NEXT() do { if (Threaded) goto *ip->label; goto dispatch; } while (0)
+#define CASE(name) op_##name: case R_##name
+#else
+#define NEXT() goto dispatch
+#define CASE(name) case R_##name
+#endif
+
+    result = 0;
+    freeHeap();
+    if (program.mainFunction < 0) {
+        *err << "Error de ejecucion: el programa no tiene funcion main" << endl;
+        return false;
+    }
+    const RegFunction* fn = &program.functions[program.mainFunction];
+    if (fn->params != 0) {
+        *err << "Error de ejecucion: main no puede recibir parametros" << endl;
+        return false;
+    }
+    if (fn->frameSize > registers.size()) {
+        *err << "Error de ejecucion: main necesita mas pila de la que hay" << endl;
+        return false;
+    }
+
+    globals.assign(program.globals, 0);
+    frames.clear();
+    Value* end = registers.data() + registers.size();
+    Value* R = registers.data();
+    fill(R, R + fn->locals, 0);
+    const RegInstr* code = fn->code.data();
+    const RegInstr* ip = code;
+    const Value* constants = program.constants.data();
+    const RegFunction* functions = program.functions.data();
+    Value* g = globals.data();
+    Value value = 0;
+    bool ok = true;
+
+#define INDEX_CHECK(array, i) \
+    do { \
+        if (!(array) || (uint64_t)(i) >= (uint64_t)(array)[0]) { \
+            indexError(fn, ip, array, i); \
+            goto error; \
+        } \
+    } while (0)
+    auto indexError = [this](const RegFunction* f, const RegInstr* at, const Value* array, Value i) {
+        if (!array)
+            fail(f, at, "arreglo sin crear (falta new)");
+        else
+            fail(f, at, "indice " + to_string(i) + " fuera de rango (largo " + to_string(array[0]) + ")");
+    };
+
+    // aritmetica en uint64_t: el desborde da la vuelta en vez de ser UB
+    NEXT();
+dispatch:
+    switch (ip->op) {
+    CASE(MOVE):
+        R[ip->a] = R[ip->b];
+        ip++;
+        NEXT();
+    CASE(LOADI):
+        R[ip->a] = ip->b;
+        ip++;
+        NEXT();
+    CASE(LOADK):
+        R[ip->a] = constants[ip->b];
+        ip++;
+        NEXT();
+    CASE(LOAD_GLOBAL):
+        R[ip->a] = g[ip->b];
+        ip++;
+        NEXT();
+    CASE(STORE_GLOBAL):
+        g[ip->a] = R[ip->b];
+        ip++;
+        NEXT();
+    CASE(ADD):
+        R[ip->a] = (Value)((uint64_t)R[ip->b] + (uint64_t)R[ip->c]);
+        ip++;
+        NEXT();
+    CASE(SUB):
+        R[ip->a] = (Value)((uint64_t)R[ip->b] - (uint64_t)R[ip->c]);
+        ip++;
+        NEXT();
+    CASE(MUL):
+        R[ip->a] = (Value)((uint64_t)R[ip->b] * (uint64_t)R[ip->c]);
+        ip++;
+        NEXT();
+    CASE(DIV): {
+        Value n = R[ip->b], d = R[ip->c];
+        if (d == 0) {
+            fail(fn, ip, "division por cero");
+            goto error;
+        }
+        // INT64_MIN / -1 no entra: da la vuelta como la multiplicacion
+        R[ip->a] = d == -1 ? (Value)(0 - (uint64_t)n) : n / d;
+        ip++;
+        NEXT();
+    }
+    CASE(LT):
+        R[ip->a] = R[ip->b] < R[ip->c];
+        ip++;
+        NEXT();
+    CASE(LE):
+        R[ip->a] = R[ip->b] <= R[ip->c];
+        ip++;
+        NEXT();
+    CASE(GT):
+        R[ip->a] = R[ip->b] > R[ip->c];
+        ip++;
+        NEXT();
+    CASE(GE):
+        R[ip->a] = R[ip->b] >= R[ip->c];
+        ip++;
+        NEXT();
+    CASE(EQ):
+        R[ip->a] = R[ip->b] == R[ip->c];
+        ip++;
+        NEXT();
+    CASE(NE):
+        R[ip->a] = R[ip->b] != R[ip->c];
+        ip++;
+        NEXT();
+    CASE(NEG):
+        R[ip->a] = (Value)(0 - (uint64_t)R[ip->b]);
+        ip++;
+        NEXT();
+    CASE(NOT):
+        R[ip->a] = R[ip->b] == 0;
+        ip++;
+        NEXT();
+    CASE(NEW_ARRAY): {
+        Value n = R[ip->b];
+        if (n < 0) {
+            fail(fn, ip, "new con tamano negativo (" + to_string(n) + ")");
+            goto error;
+        }
+        Value* a = newArray(n);
+        if (!a) {
+            fail(fn, ip, "no hay memoria para un arreglo de " + to_string(n) + " elementos");
+            goto error;
+        }
+        R[ip->a] = (Value)(intptr_t)a;
+        ip++;
+        NEXT();
+    }
+    CASE(LOAD_INDEX): {
+        Value* a = (Value*)(intptr_t)R[ip->b];
+        Value i = R[ip->c];
+        INDEX_CHECK(a, i);
+        R[ip->a] = a[1 + i];
+        ip++;
+        NEXT();
+    }
+    CASE(STORE_INDEX): {
+        Value* a = (Value*)(intptr_t)R[ip->a];
+        Value i = R[ip->b];
+        INDEX_CHECK(a, i);
+        a[1 + i] = R[ip->c];
+        ip++;
+        NEXT();
+    }
+    CASE(JUMP):
+        ip = code + ip->a;
+        NEXT();
+    CASE(JUMP_FALSE):
+        ip = R[ip->a] == 0 ? code + ip->b : ip + 1;
+        NEXT();
+    CASE(JUMP_TRUE):
+        ip = R[ip->a] != 0 ? code + ip->b : ip + 1;
+        NEXT();
+    CASE(CALL): {
+        // la ventana del llamado empieza en los argumentos
+        const RegFunction* callee = &functions[ip->b];
+        Value* calleeBase = R + ip->c;
+        if (calleeBase + callee->frameSize > end || frames.size() >= maxFrames) {
+            fail(fn, ip, "desborde de pila (recursion demasiado profunda)");
+            goto error;
+        }
+        frames.push_back({fn, ip + 1, R, ip->a});
+        fill(calleeBase + callee->params, calleeBase + callee->locals, 0);
+        R = calleeBase;
+        fn = callee;
+        code = fn->code.data();
+        ip = code;
+        NEXT();
+    }
+    CASE(RET):
+        value = R[ip->a];
+        goto leave;
+    CASE(RET_VOID):
+        value = 0;
+        goto leave;
+    CASE(ADDI):
+        R[ip->a] = (Value)((uint64_t)R[ip->b] + (uint64_t)(Value)ip->c);
+        ip++;
+        NEXT();
+    CASE(JLT):
+        ip = R[ip->a] < R[ip->b] ? code + ip->c : ip + 1;
+        NEXT();
+    CASE(JLE):
+        ip = R[ip->a] <= R[ip->b] ? code + ip->c : ip + 1;
+        NEXT();
+    CASE(JGT):
+        ip = R[ip->a] > R[ip->b] ? code + ip->c : ip + 1;
+        NEXT();
+    CASE(JGE):
+        ip = R[ip->a] >= R[ip->b] ? code + ip->c : ip + 1;
+        NEXT();
+    CASE(JEQ):
+        ip = R[ip->a] == R[ip->b] ? code + ip->c : ip + 1;
+        NEXT();
+    CASE(JNE):
+        ip = R[ip->a] != R[ip->b] ? code + ip->c : ip + 1;
+        NEXT();
+    CASE(JLTI):
+        ip = R[ip->a] < ip->b ? code + ip->c : ip + 1;
+        NEXT();
+    CASE(JLEI):
+        ip = R[ip->a] <= ip->b ? code + ip->c : ip + 1;
+        NEXT();
+    CASE(JGTI):
+        ip = R[ip->a] > ip->b ? code + ip->c : ip + 1;
+        NEXT();
+    CASE(JGEI):
+        ip = R[ip->a] >= ip->b ? code + ip->c : ip + 1;
+        NEXT();
+    CASE(JEQI):
+        ip = R[ip->a] == ip->b ? code + ip->c : ip + 1;
+        NEXT();
+    CASE(JNEI):
+        ip = R[ip->a] != ip->b ? code + ip->c : ip + 1;
+        NEXT();
+    CASE(LOAD_INDEXI): {
+        Value* a = (Value*)(intptr_t)R[ip->b];
+        INDEX_CHECK(a, ip->c);
+        R[ip->a] = a[1 + ip->c];
+        ip++;
+        NEXT();
+    }
+    CASE(STORE_INDEXI): {
+        Value* a = (Value*)(intptr_t)R[ip->a];
+        INDEX_CHECK(a, ip->b);
+        a[1 + ip->b] = R[ip->c];
+        ip++;
+        NEXT();
+    }
+    default:
+        fail(fn, ip, "opcode invalido " + to_string(ip->op));
+        goto error;
+    }
+
+leave:
+    if (frames.empty()) {
+        result = value;
+        goto done;
+    }
+    {
+        const Frame& f = frames.back();
+        R = f.base;
+        fn = f.fn;
+        ip = f.ip;
+        code = fn->code.data();
+        if (f.dst >= 0)
+            R[f.dst] = value;
+        frames.pop_back();
+    }
+    NEXT();
+
+error:
+    ok = false;
+done:
+    freeHeap();
+    return ok;
+#undef NEXT
+#undef CASE
+#undef INDEX_CHECK
+}
@@ -0,0 +1,205 @@
+#ifndef REGVM_H
+#define REGVM_H
+
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ast.h"
+#include "bytecode.h"
+#include "semantic.h"
+
+using namespace std;
+
+// Despacho con etiquetas como valores (goto *p): solo GCC y clang. En otro
+// compilador (o con -DMINI0_NO_COMPUTED_GOTO) el interprete usa siempre el switch.
+#if defined(__GNUC__) && !defined(MINI0_NO_COMPUTED_GOTO)
+#define MINI0_COMPUTED_GOTO 1
+#else
+#define MINI0_COMPUTED_GOTO 0
+#endif
+
+// Codigo de registros: cada funcion tiene una ventana de registros con los
+// parametros, despues las locales y despues los temporales de las
+// expresiones. Los operandos nombran registros directamente, asi que "a = b + c"
+// con variables locales es una sola instruccion (en la VM de pila son cuatro).
+// a, b, c: registro, inmediato o destino de salto segun el opcode.
+enum RegOp : uint8_t {
+    R_MOVE,          // a = b
+    R_LOADI,         // a = inmediato b
+    R_LOADK,         // a = constants[b]
+    R_LOAD_GLOBAL,   // a = globals[b]
+    R_STORE_GLOBAL,  // globals[a] = b
+    R_ADD,           // a = b op c
+    R_SUB,
+    R_MUL,
+    R_DIV,
+    R_LT,
+    R_LE,
+    R_GT,
+    R_GE,
+    R_EQ,
+    R_NE,
+    R_NEG,           // a = -b
+    R_NOT,           // a = not b
+    R_NEW_ARRAY,     // a = new [b]
+    R_LOAD_INDEX,    // a = b[c]
+    R_STORE_INDEX,   // a[b] = c
+    R_JUMP,          // ir a a
+    R_JUMP_FALSE,    // si a == 0 ir a b
+    R_JUMP_TRUE,     // si a != 0 ir a b
+    R_CALL,          // a = funcion b con argumentos desde el registro c (a < 0: sin valor)
+    R_RET,           // devuelve a
+    R_RET_VOID,
+
+    // superinstrucciones (RegisterCompiler::setFusion)
+    R_ADDI,          // a = b + inmediato c         (x = x + 1, x = x - 1)
+    R_JLT,           // si a op b ir a c            (condicion de while/if)
+    R_JLE,
+    R_JGT,
+    R_JGE,
+    R_JEQ,
+    R_JNE,
+    R_JLTI,          // si a op inmediato b ir a c  (i < 10)
+    R_JLEI,
+    R_JGTI,
+    R_JGEI,
+    R_JEQI,
+    R_JNEI,
+    R_LOAD_INDEXI,   // a = b[inmediato c]
+    R_STORE_INDEXI,  // a[inmediato b] = c
+    R_COUNT
+};
+
+extern const char* const regOpNames[R_COUNT];
+
+struct RegInstr {
+    const void* label;  // despacho threaded: direccion del codigo del opcode
+    RegOp op;
+    int32_t a, b, c;
+};
+
+struct RegFunction {
+    string name;
+    uint32_t params;
+    uint32_t locals;     // incluye los parametros
+    uint32_t frameSize;  // locales + temporales
+    vector<RegInstr> code;
+    vector<uint32_t> lines;  // linea de cada instruccion
+
+    RegFunction() : params(0), locals(0), frameSize(0) {}
+};
+
+struct RegProgram {
+    vector<RegFunction> functions;  // mismo orden que Ast::funcs
+    vector<Value> constants;        // los que no entran en un inmediato de 32 bits
+    deque<string> strings;
+    uint32_t globals = 0;
+    int32_t mainFunction = -1;
+    bool threaded = false;          // ya tiene las etiquetas del despacho threaded
+
+    RegProgram() = default;
+    RegProgram(const RegProgram&) = delete;
+    RegProgram& operator=(const RegProgram&) = delete;
+    RegProgram(RegProgram&&) = default;
+    RegProgram& operator=(RegProgram&&) = default;
+
+    void clear();
+    void disassemble(ostream& out) const;
+    size_t instructions() const;
+};
+
+// Traduce un AST ya chequeado a codigo de registros. Las variables locales son
+// registros fijos; los temporales se reservan como una pila mientras se compila
+// una sentencia. Una llamada pone los argumentos en temporales seguidos y esa
+// zona pasa a ser la ventana de la funcion llamada (sin copiar).
+class RegisterCompiler {
+public:
+    RegisterCompiler();
+
+    void setOutput(ostream& err);
+    // false: solo las instrucciones basicas (para medir lo que aportan las fusionadas)
+    void setFusion(bool enabled);
+    bool compile(const Ast& tree, const SemanticAnalyzer& names, RegProgram& program);
+
+private:
+    const Ast* tree;
+    const SemanticAnalyzer* names;
+    RegProgram* program;
+    RegFunction* fn;
+    ostream* err;
+    size_t errors;
+    bool fusion;
+    uint32_t line;
+    int32_t nextTemp;
+    vector<int32_t> slots;     // por VarDecl: registro o global
+    vector<uint8_t> isGlobal;  // por VarDecl
+    unordered_map<Value, int32_t> numbers;
+    unordered_map<string, int32_t> literals;
+
+    void function(const Func& f, RegFunction& code);
+    void declare(NodeId var);
+    void block(NodeId id, bool nested);
+    void stmt(NodeId id);
+    // deja el valor en dst (o donde convenga si dst < 0) y devuelve el registro
+    int32_t expr(NodeId id, int32_t dst);
+    void call(NodeId id, int32_t dst);
+    // salta a los destinos que quedan en jumps si la condicion vale 'when'
+    void cond(NodeId id, bool when, vector<size_t>& jumps);
+    bool immediate(NodeId id, int32_t& value);
+
+    int32_t temp();
+    int32_t target(int32_t dst);
+    void loadValue(int32_t dst, Value v);
+    int32_t stringConstant(const char* text, size_t length);
+    size_t emit(RegOp op, int32_t a = 0, int32_t b = 0, int32_t c = 0);
+    void patch(const vector<size_t>& jumps, size_t target);
+    void error(uint32_t line, const string& message);
+};
+
+enum class Dispatch {
+    Switch,    // un switch por instruccion
+    Threaded   // cada instruccion salta directo a la siguiente (goto *ip->label)
+};
+
+// Interprete del codigo de registros. Mismos valores y mismos errores de
+// ejecucion que la VM de pila.
+class RegisterVM {
+public:
+    static const size_t registerCount = 1 << 20;  // valores (8 MB)
+    static const size_t maxFrames = 1 << 18;
+
+    RegisterVM();
+    ~RegisterVM();
+    RegisterVM(const RegisterVM&) = delete;
+    RegisterVM& operator=(const RegisterVM&) = delete;
+
+    void setOutput(ostream& err);
+    static bool threadedAvailable() { return MINI0_COMPUTED_GOTO != 0; }
+    // el despacho threaded completa las etiquetas de program la primera vez
+    bool run(RegProgram& program, Value& result, Dispatch dispatch = Dispatch::Threaded);
+
+private:
+    struct Frame {
+        const RegFunction* fn;
+        const RegInstr* ip;  // donde sigue el que llamo
+        Value* base;
+        int32_t dst;         // registro del que llamo para el resultado
+    };
+
+    vector<Value> registers;
+    vector<Frame> frames;
+    vector<Value> globals;
+    vector<Value*> heap;
+    ostream* err;
+
+    template <bool Threaded>
+    bool execute(RegProgram& program, Value& result);
+    Value* newArray(Value length);
+    void freeHeap();
+    void fail(const RegFunction* fn, const RegInstr* ip, const string& message);
+};
+
+#endif
@@ -0,0 +1,36 @@
+/* Runtime de los programas compilados a ensamblador (mini0 --emit-asm):
+   main y las funciones que llama el codigo generado. Usa lo mismo que el
+   codigo de --emit-c (mini0_rt.h), asi los dos caminos dan los mismos
+   valores y mensajes.
+
+   cc -o programa programa.s mini0_rt.c */
+#include "mini0_rt.h"
+
+m0_value mini0_entry(void);
+
+m0_value m0_rt_new(m0_value n, int line, const char* fn) {
+    return m0_new(n, line, fn);
+}
+
+void m0_rt_index_error(const m0_value* a, m0_value i, int line, const char* fn) {
+    m0_index_error(a, i, line, fn);
+}
+
+void m0_rt_div_zero(int line, const char* fn) {
+    m0_fail(line, fn, "division por cero");
+}
+
+void m0_rt_no_main(void) {
+    fprintf(stderr, "Error de ejecucion: el programa no tiene funcion main\n");
+    exit(1);
+}
+
+void m0_rt_main_params(void) {
+    fprintf(stderr, "Error de ejecucion: main no puede recibir parametros\n");
+    exit(1);
+}
+
+/* el codigo de salida es lo que devuelve main (mod 256), como en --run */
+int main(void) {
+    return (int)(mini0_entry() & 0xFF);
+}
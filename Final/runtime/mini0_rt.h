@@ -0,0 +1,93 @@
+/* Runtime de los programas Mini-0 traducidos a C (mini0 --emit-c).
+   Mismos valores que la VM: todo valor es un int64_t, los string son punteros
+   a literales y un arreglo es un bloque de int64_t con el largo en [0] y los
+   elementos despues. Los errores de ejecucion imprimen el mismo mensaje que
+   la VM y terminan con codigo 1. Los arreglos no se liberan nunca: viven
+   hasta que termina el proceso. */
+#ifndef MINI0_RT_H
+#define MINI0_RT_H
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef int64_t m0_value;
+
+#if defined(__GNUC__)
+#define M0_NORETURN __attribute__((noreturn, cold, noinline))
+#define M0_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define M0_NORETURN
+#define M0_UNLIKELY(x) (x)
+#endif
+
+static M0_NORETURN void m0_fail(int line, const char* fn, const char* message) {
+    fflush(stdout);
+    fprintf(stderr, "Error de ejecucion en linea %d ('%s'): %s\n", line, fn, message);
+    exit(1);
+}
+
+#ifndef M0_UNCHECKED
+static M0_NORETURN void m0_index_error(const m0_value* a, m0_value i, int line, const char* fn) {
+    char message[96];
+    if (!a)
+        m0_fail(line, fn, "arreglo sin crear (falta new)");
+    snprintf(message, sizeof message, "indice %" PRId64 " fuera de rango (largo %" PRId64 ")", i, a[0]);
+    m0_fail(line, fn, message);
+}
+#endif
+
+/* aritmetica en uint64_t: el desborde da la vuelta en vez de ser UB */
+static inline m0_value m0_add(m0_value a, m0_value b) { return (m0_value)((uint64_t)a + (uint64_t)b); }
+static inline m0_value m0_sub(m0_value a, m0_value b) { return (m0_value)((uint64_t)a - (uint64_t)b); }
+static inline m0_value m0_mul(m0_value a, m0_value b) { return (m0_value)((uint64_t)a * (uint64_t)b); }
+static inline m0_value m0_neg(m0_value a) { return (m0_value)(0 - (uint64_t)a); }
+
+static inline m0_value m0_div(m0_value a, m0_value b, int line, const char* fn) {
+    if (M0_UNLIKELY(b == 0))
+        m0_fail(line, fn, "division por cero");
+    /* INT64_MIN / -1 no entra: da la vuelta como la multiplicacion */
+    return b == -1 ? m0_neg(a) : a / b;
+}
+
+static inline m0_value m0_new(m0_value n, int line, const char* fn) {
+    char message[96];
+    m0_value* a;
+    if (n < 0) {
+        snprintf(message, sizeof message, "new con tamano negativo (%" PRId64 ")", n);
+        m0_fail(line, fn, message);
+    }
+    a = (m0_value*)calloc((size_t)n + 1, sizeof(m0_value));
+    if (!a) {
+        snprintf(message, sizeof message, "no hay memoria para un arreglo de %" PRId64 " elementos", n);
+        m0_fail(line, fn, message);
+    }
+    a[0] = n;
+    return (m0_value)(intptr_t)a;
+}
+
+/* con M0_UNCHECKED (mini0 --unchecked) los indices no se chequean */
+#ifdef M0_UNCHECKED
+#define M0_CHECK(a, i, line, fn) ((void)(line), (void)(fn))
+#else
+#define M0_CHECK(a, i, line, fn) \
+    do { \
+        if (M0_UNLIKELY(!(a) || (uint64_t)(i) >= (uint64_t)(a)[0])) \
+            m0_index_error(a, i, line, fn); \
+    } while (0)
+#endif
+
+static inline m0_value m0_load(m0_value array, m0_value i, int line, const char* fn) {
+    const m0_value* a = (const m0_value*)(intptr_t)array;
+    M0_CHECK(a, i, line, fn);
+    return a[1 + i];
+}
+
+static inline void m0_store(m0_value array, m0_value i, m0_value v, int line, const char* fn) {
+    m0_value* a = (m0_value*)(intptr_t)array;
+    M0_CHECK(a, i, line, fn);
+    a[1 + i] = v;
+}
+
+#endif
@@ -0,0 +1,225 @@
+#include "semantic.h"
+
+using namespace std;
+
+SemanticAnalyzer::SemanticAnalyzer() : tree(nullptr), err(&cerr), sink(nullptr), errors(0) {}
+
+void SemanticAnalyzer::setOutput(ostream& errStream) {
+    err = &errStream;
+}
+
+void SemanticAnalyzer::setDiagnostics(Diagnostics* diagnostics) {
+    sink = diagnostics;
+}
+
+void SemanticAnalyzer::error(DiagCode code, uint32_t line, uint16_t column,
+                             const string& message) {
+    errors++;
+    (sink ? sink : &own)->addCheck(code, line, column, message, tree->source(),
+                                   tree->sourceLength());
+}
+
+void SemanticAnalyzer::openScope() {
+    scopes.push_back((uint32_t)bindings.size());
+}
+
+void SemanticAnalyzer::closeScope() {
+    uint32_t mark = scopes.back();
+    scopes.pop_back();
+    for (size_t i = bindings.size(); i > mark; i--) {
+        const Binding& b = bindings[i - 1];
+        innermost[b.sym] = b.shadowed;
+    }
+    bindings.resize(mark);
+}
+
+void SemanticAnalyzer::declare(NodeId var) {
+    const VarDecl& v = tree->vars[var];
+    if (v.name == noSymbol)
+        return;
+    uint32_t current = innermost[v.name];
+    // visible y abierto en este mismo alcance: es una redeclaracion
+    if (current != 0 && current - 1 >= scopes.back()) {
+        const VarDecl& first = tree->vars[bindings[current - 1].decl];
+        error(DG_REDECLARADA, v.line, v.column, "'" + tree->str(v.name) + "' ya fue declarada en este bloque (linea " +
+                      to_string(first.line) + ")");
+        return;
+    }
+    bindings.push_back({v.name, var, current});
+    innermost[v.name] = (uint32_t)bindings.size();
+}
+
+NodeId SemanticAnalyzer::lookup(Symbol sym) const {
+    uint32_t b = innermost[sym];
+    return b != 0 ? bindings[b - 1].decl : noNode;
+}
+
+bool SemanticAnalyzer::check(const Ast& ast) {
+    tree = &ast;
+    errors = 0;
+    own.clear();
+    // assign conserva la capacidad: entre archivos no se vuelve a reservar
+    innermost.assign(ast.symbols.size(), 0);
+    funcOf.assign(ast.symbols.size(), noNode);
+    refs.assign(ast.exprs.size(), noNode);
+    bindings.clear();
+    scopes.clear();
+    open.clear();
+    pending.clear();
+
+    openScope();
+    for (NodeId g : ast.globals)
+        declare(g);
+    for (size_t i = 0; i < ast.funcs.size(); i++) {
+        const Func& f = ast.funcs[i];
+        if (f.name == noSymbol)
+            continue;
+        if (funcOf[f.name] != noNode) {
+            error(DG_REDECLARADA, f.line, f.column,
+                  "la funcion '" + ast.str(f.name) + "' ya fue declarada en la linea " +
+                          to_string(ast.funcs[funcOf[f.name]].line));
+            continue;
+        }
+        funcOf[f.name] = (NodeId)i;
+    }
+
+    for (const Func& f : ast.funcs)
+        function(f);
+    closeScope();
+
+    if (!sink) {
+        own.flush(*err, nullptr);
+        if (errors > 0)
+            *err << "Analisis semantico completado con errores\n";
+    }
+    return errors == 0;
+}
+
+void SemanticAnalyzer::function(const Func& f) {
+    // parametros y variables del cuerpo comparten alcance
+    openScope();
+    for (const NodeId* p = tree->begin(f.params); p != tree->end(f.params); p++)
+        declare(*p);
+    body(f.body);
+    closeScope();
+}
+
+// El cuerpo y todo lo anidado: un if/while deja sus bloques encima del que
+// lo contiene, que sigue cuando se terminan
+void SemanticAnalyzer::body(NodeId block) {
+    if (block != noNode)
+        open.push_back({block, 0, false, false});
+    while (!open.empty()) {
+        size_t depth = open.size();
+        OpenBlock& top = open.back();
+        const Block& b = tree->blocks[top.block];
+        if (!top.entered) {
+            top.entered = true;
+            if (top.scoped)
+                openScope();
+            for (const NodeId* v = tree->begin(b.vars); v != tree->end(b.vars); v++)
+                declare(*v);
+        }
+        // stmt puede apilar bloques (y mover open): top ya no vale despues
+        const NodeId* s = tree->begin(b.stmts) + top.next;
+        while (s != tree->end(b.stmts) && open.size() == depth)
+            stmt(*s++);
+        if (open.size() != depth) {
+            open[depth - 1].next = (uint32_t)(s - tree->begin(b.stmts));
+            continue;
+        }
+        if (open.back().scoped)
+            closeScope();
+        open.pop_back();
+    }
+}
+
+void SemanticAnalyzer::stmt(NodeId id) {
+    const Stmt& s = tree->stmts[id];
+    switch (s.kind) {
+    case StmtKind::Assign:
+        expr(s.target);
+        expr(s.value);
+        break;
+    case StmtKind::Call:
+    case StmtKind::Return:
+        expr(s.value);
+        break;
+    case StmtKind::If:
+    case StmtKind::While:
+        expr(s.value);
+        // arriba el cuerpo, que va primero
+        if (s.orelse != noNode)
+            open.push_back({s.orelse, 0, true, false});
+        if (s.body != noNode)
+            open.push_back({s.body, 0, true, false});
+        break;
+    }
+}
+
+// Baja siempre por el hijo izquierdo y deja el resto en pending; una llamada
+// se anota (marcada con callMark) debajo de sus argumentos y se resuelve
+// cuando salen todos
+void SemanticAnalyzer::expr(NodeId root) {
+    size_t base = pending.size();
+    NodeId id = root;
+    while (true) {
+        while (id != noNode) {
+            const Expr& e = tree->exprs[id];
+            switch (e.kind) {
+            case ExprKind::Var:
+                if (e.sym != noSymbol) {
+                    refs[id] = lookup(e.sym);
+                    if (refs[id] == noNode)
+                        error(DG_NO_DECLARADA, e.line, e.column, "variable '" + tree->str(e.sym) + "' no declarada");
+                }
+                id = noNode;
+                break;
+            case ExprKind::Call:
+                pending.push_back(id | callMark);
+                for (const NodeId* a = tree->end(e.args); a != tree->begin(e.args); a--)
+                    if (a[-1] != noNode)
+                        pending.push_back(a[-1]);
+                id = noNode;
+                break;
+            case ExprKind::Index:
+            case ExprKind::Unary:
+            case ExprKind::Binary:
+            case ExprKind::New:
+                if (e.rhs != noNode)
+                    pending.push_back(e.rhs);
+                id = e.lhs;
+                break;
+            case ExprKind::Num:
+            case ExprKind::Str:
+            case ExprKind::True:
+            case ExprKind::False:
+                id = noNode;
+                break;
+            }
+        }
+        if (pending.size() == base)
+            return;
+        id = pending.back();
+        pending.pop_back();
+        if (id & callMark) {
+            call(id & ~callMark);
+            id = noNode;
+        }
+    }
+}
+
+void SemanticAnalyzer::call(NodeId id) {
+    const Expr& e = tree->exprs[id];
+    if (e.sym == noSymbol)
+        return;
+    NodeId f = funcOf[e.sym];
+    refs[id] = f;
+    if (f == noNode) {
+        error(DG_NO_DECLARADA, e.line, e.column, "funcion '" + tree->str(e.sym) + "' no declarada");
+    } else if (tree->funcs[f].params.count != e.args.count) {
+        error(DG_ARGUMENTOS, e.line, e.column, "'" + tree->str(e.sym) + "' espera " +
+                      to_string(tree->funcs[f].params.count) + " argumentos y recibe " +
+                      to_string(e.args.count));
+    }
+}
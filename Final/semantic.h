@@ -0,0 +1,86 @@
+#ifndef SEMANTIC_H
+#define SEMANTIC_H
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ast.h"
+#include "diagnostics.h"
+
+using namespace std;
+
+// Analisis semantico: cada nombre usado tiene que estar declarado y cada
+// llamada tiene que ir a una funcion que existe, con la cantidad correcta de
+// argumentos. Corre sobre el AST de un parse sin errores, en una pasada lineal
+// y sin recursion: el arbol puede venir anidado tan hondo como quiera.
+//
+// Alcances: las globales y las funciones valen en todo el programa (se pueden
+// usar antes de declararlas); parametros y variables del cuerpo forman el
+// alcance de la funcion, y cada bloque de if/else/while abre uno nuevo que
+// puede ocultar nombres de afuera. Funciones y variables no se mezclan.
+class SemanticAnalyzer {
+public:
+    SemanticAnalyzer();
+
+    void setOutput(ostream& err);
+    // con sink los errores van ahi (y cuentan para su limite); sin sink se
+    // escriben en err al final de check
+    void setDiagnostics(Diagnostics* sink);
+    bool check(const Ast& tree);  // true si no hay errores
+    size_t errorCount() const { return errors; }
+
+    // Var -> VarDecl, Call -> Func (noNode si no se resolvio); valido hasta el proximo check
+    NodeId declOf(NodeId expr) const { return refs[expr]; }
+
+private:
+    // Los simbolos son densos, asi que el mapa de cada alcance es un arreglo
+    // indexado por Symbol (hash identidad, sin sondeos). Declarar apila un
+    // Binding que recuerda al que oculta; cerrar un alcance restaura esos y
+    // trunca la pila, sin liberar nada.
+    struct Binding {
+        Symbol sym;
+        NodeId decl;       // VarDecl
+        uint32_t shadowed; // binding anterior del mismo simbolo (+1), 0 si no habia
+    };
+
+    // Los bloques abiertos (cada uno sabe por que comando va) y lo que falta
+    // de la expresion actual van en pilas propias, no en la de C++. El orden
+    // es el de un recorrido recursivo: los errores salen como aparecen.
+    struct OpenBlock {
+        NodeId block;
+        uint32_t next;  // proximo comando
+        bool scoped;    // if/else/while: abre un alcance (el cuerpo de la funcion no)
+        bool entered;   // ya se abrio el alcance y se declararon sus variables
+    };
+    // en pending: llamada cuyos argumentos ya se recorrieron (un indice de
+    // Expr no llega a 2^31)
+    static const NodeId callMark = 0x80000000u;
+
+    const Ast* tree;
+    ostream* err;
+    Diagnostics* sink;
+    Diagnostics own;  // los errores cuando no hay sink
+    size_t errors;
+    vector<uint32_t> innermost;  // por simbolo: binding visible (+1), 0 si ninguno
+    vector<Binding> bindings;
+    vector<uint32_t> scopes;     // bindings.size() al abrir cada alcance
+    vector<NodeId> funcOf;       // por simbolo: Func declarada con ese nombre
+    vector<NodeId> refs;         // por Expr
+    vector<OpenBlock> open;
+    vector<NodeId> pending;      // hijos por recorrer de la expresion actual
+
+    void openScope();
+    void closeScope();
+    void declare(NodeId var);
+    NodeId lookup(Symbol sym) const;
+
+    void function(const Func& f);
+    void body(NodeId block);
+    void stmt(NodeId id);
+    void expr(NodeId root);
+    void call(NodeId id);
+    void error(DiagCode code, uint32_t line, uint16_t column, const string& message);
+};
+
+#endif
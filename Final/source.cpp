@@ -0,0 +1,140 @@
+#include "source.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+SourceBuffer::SourceBuffer()
+        : base(nullptr),
+            length(0),
+            mapLength(0) {
+}
+
+SourceBuffer::~SourceBuffer() {
+    close();
+}
+
+void SourceBuffer::close() {
+#ifndef _WIN32
+    if (mapLength != 0)
+        munmap(base, mapLength);
+#endif
+    base = nullptr;
+    length = 0;
+    mapLength = 0;
+    owned.clear();
+}
+
+bool SourceBuffer::open(const string& path, bool readOnly) {
+    close();
+
+#ifdef _WIN32
+    int fd = ::_open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+#endif
+    if (fd < 0)
+        return false;
+
+    bool ok = false;
+    size_t fileSize = 0;  // 0: no se sabe (pipes)
+    struct stat st;
+#ifndef _WIN32
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        fileSize = (size_t)st.st_size;
+        if (readOnly && fileSize >= mapMinimum)
+            ok = mapFile(fd, fileSize);
+    }
+#else
+    (void)st;
+    (void)readOnly;
+#endif
+    if (!ok)
+        ok = readAll(fd, fileSize);
+
+#ifdef _WIN32
+    ::_close(fd);
+#else
+    ::close(fd);
+#endif
+    return ok;
+}
+
+// Mapea el archivo, solo lectura, sobre una region anonima un poco mas grande:
+// los bytes despues del fin de archivo quedan en cero y sirven de relleno sin
+// copiar nada. Antes Flex escaneaba aca con PROT_WRITE: cada pagina donde
+// escribia un '\0' se copiaba (copy-on-write, y con MAP_POPULATE todas), y
+// lexear con Flex salia mas lento que con FILE* (en un archivo de 9 MB, 97 ms
+// contra 74). Por eso Flex usa readAll y esto queda para FastLexer.
+bool SourceBuffer::mapFile(int fd, size_t fileSize) {
+#ifdef _WIN32
+    (void)fd;
+    (void)fileSize;
+    return false;
+#else
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t total = (fileSize + padding + page - 1) / page * page;
+
+    void* region = mmap(nullptr, total, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED)
+        return false;
+
+    int flags = MAP_PRIVATE | MAP_FIXED;
+#ifdef MAP_POPULATE
+    flags |= MAP_POPULATE;  // pre-carga las paginas: menos fallos de pagina al escanear
+#endif
+    void* file = mmap(region, fileSize, PROT_READ, flags, fd, 0);
+    if (file == MAP_FAILED) {
+        munmap(region, total);
+        return false;
+    }
+    madvise(region, total, MADV_SEQUENTIAL);
+
+    base = static_cast<char*>(region);
+    length = fileSize;
+    mapLength = total;
+    return true;
+#endif
+}
+
+// Copia propia del texto (una sola pasada de read): la que Flex puede
+// escribir, y la de entradas que no se pueden mapear. Con el tamano del
+// archivo se lee de una vez; si no (pipes, fileSize 0), por bloques.
+bool SourceBuffer::readAll(int fd, size_t fileSize) {
+    const size_t chunk = 64 * 1024;
+    owned.clear();
+    size_t used = 0;
+    while (true) {
+        size_t want = used < fileSize ? fileSize - used : chunk;
+        owned.resize(used + want);
+#ifdef _WIN32
+        int n = ::_read(fd, owned.data() + used, (unsigned)want);
+#else
+        ssize_t n = ::read(fd, owned.data() + used, want);
+#endif
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            owned.clear();
+            return false;
+        }
+        if (n == 0)
+            break;
+        used += (size_t)n;
+    }
+    owned.resize(used);
+    owned.resize(used + padding, '\0');
+
+    base = owned.data();
+    length = used;
+    return true;
+}
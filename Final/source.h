@@ -0,0 +1,50 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Texto fuente completo en memoria, seguido de 'padding' bytes en cero: los dos
+// centinelas que pide yy_scan_buffer de Flex y espacio para que el lexer
+// rapido lea de a bloques SIMD sin salirse. Flex escanea en el lugar y escribe
+// '\0' temporales al final de cada token, asi que por defecto el archivo se
+// lee a un buffer propio. Con readOnly (FastLexer, que no escribe) un archivo
+// regular de al menos mapMinimum bytes se mapea con mmap de solo lectura, sin
+// copiarlo; pipes y /dev/stdin se leen por bloques.
+class SourceBuffer {
+public:
+    static const size_t padding = 64;
+    // mas chico, mmap + munmap cuestan mas que copiar el texto
+    static const size_t mapMinimum = 1 << 20;
+
+    SourceBuffer();
+    ~SourceBuffer();
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+    bool open(const string& path, bool readOnly = false);
+    void close();
+
+    const char* data() const { return base; }
+    size_t size() const { return length; }
+
+    // buffer para Flex: el texto mas los dos centinelas.
+    // Flex escribe '\0' temporales dentro, por eso no es const
+    // (nullptr si se mapeo con readOnly).
+    char* scanBase() { return mapLength != 0 ? nullptr : base; }
+    size_t scanSize() const { return length + 2; }
+
+private:
+    char* base;
+    size_t length;
+    size_t mapLength;    // != 0 si base viene de mmap
+    vector<char> owned;  // respaldo cuando no se puede mapear
+
+    bool mapFile(int fd, size_t fileSize);
+    bool readAll(int fd, size_t fileSize);
+};
+
+#endif
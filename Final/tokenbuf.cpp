@@ -0,0 +1,98 @@
+#include "tokenbuf.h"
+
+#include <cstring>
+
+using namespace std;
+
+extern int yylex(yyscan_t scanner);
+extern char* yyget_text(yyscan_t scanner);
+extern int yyget_leng(yyscan_t scanner);
+extern int yyget_lineno(yyscan_t scanner);
+
+static_assert(TK_ERROR - TK_ID < 256, "los tipos de token deben caber en un byte");
+
+static int countNewlines(const char* text, size_t length) {
+    int count = 0;
+    const char* end = text + length;
+    while ((text = (const char*)memchr(text, '\n', end - text)) != nullptr) {
+        count++;
+        text++;
+    }
+    return count;
+}
+
+void TokenBuffer::clear() {
+    base = nullptr;
+    kinds.clear();
+    offsets.clear();
+    lengths.clear();
+    lines.clear();
+    syms.clear();
+    lexErrors.clear();
+}
+
+void TokenBuffer::push(int kind, size_t offset, size_t length, int line, Symbol symbol) {
+    kinds.push_back((uint8_t)(kind - TK_ID));
+    offsets.push_back((uint32_t)offset);
+    lengths.push_back((uint32_t)length);
+    lines.push_back((uint32_t)line);
+    syms.push_back(symbol);
+}
+
+namespace {
+
+// Lexer con la interfaz minima que usa fill(): Flex o FastLexer
+struct FlexSource {
+    yyscan_t scanner;
+    int next() {
+        int token = yylex(scanner);
+        return token == 0 ? TK_EOF : token;
+    }
+    const char* text() const { return yyget_text(scanner); }
+    size_t length() const { return (size_t)yyget_leng(scanner); }
+    int lineno() const { return yyget_lineno(scanner); }
+};
+
+} // namespace
+
+template <class Lexer>
+void TokenBuffer::fillFrom(Lexer& lexer, const char* sourceBase, Interner* symbols) {
+    clear();
+    base = sourceBase;
+
+    while (true) {
+        int token = lexer.next();
+        int after = lexer.lineno();
+        if (token == TK_EOF) {
+            push(TK_EOF, 0, 0, after);
+            break;
+        }
+
+        const char* text = lexer.text();
+        size_t length = lexer.length();
+        size_t offset = (size_t)(text - base);
+        if (token == TK_ERROR) {
+            lexErrors.push_back({kinds.size(), {offset, length}, after});
+            continue;
+        }
+        // solo \n y los strings pueden cruzar lineas
+        int line = after;
+        if (token == TK_NL)
+            line--;
+        else if (token == TK_LITSTRING)
+            line -= countNewlines(text, length);
+        Symbol symbol = noSymbol;
+        if (token == TK_ID && symbols)
+            symbol = symbols->intern(text, length);
+        push(token, offset, length, line, symbol);
+    }
+}
+
+void TokenBuffer::fill(yyscan_t scanner, const char* sourceBase, Interner* symbols) {
+    FlexSource flex{scanner};
+    fillFrom(flex, sourceBase, symbols);
+}
+
+void TokenBuffer::fill(FastLexer& lexer, const char* sourceBase, Interner* symbols) {
+    fillFrom(lexer, sourceBase, symbols);
+}
@@ -0,0 +1,56 @@
+#ifndef TOKENBUF_H
+#define TOKENBUF_H
+
+#include <cstdint>
+#include <vector>
+#include "tokens.h"
+#include "fastlex.h"
+#include "intern.h"
+
+using namespace std;
+
+typedef void* yyscan_t;
+
+// Todos los tokens de un archivo, lexeados de una vez y guardados en arreglos
+// paralelos (estructura de arreglos): el parser los indexa en O(1) con
+// cualquier lookahead y las pasadas siguientes pueden recorrerlos de nuevo.
+// El ultimo token siempre es TK_EOF; leer mas alla devuelve ese mismo.
+class TokenBuffer {
+public:
+    // Simbolo invalido: no va en los arreglos, se reporta cuando el parser
+    // llega al token numero 'before'.
+    struct LexError {
+        size_t before;
+        Lexeme lexeme;
+        int line;  // la del simbolo (no cruza lineas)
+    };
+
+    // lexea el buffer actual del scanner; base es el inicio del texto fuente.
+    // Con symbols, cada TK_ID se interna al leerlo.
+    void fill(yyscan_t scanner, const char* base, Interner* symbols = nullptr);
+    void fill(FastLexer& lexer, const char* base, Interner* symbols = nullptr);
+    void clear();
+
+    size_t size() const { return kinds.size(); }
+    int kind(size_t i) const { return TK_ID + kinds[clamp(i)]; }
+    Lexeme lexeme(size_t i) const { return {offsets[clamp(i)], lengths[clamp(i)]}; }
+    int line(size_t i) const { return (int)lines[clamp(i)]; }
+    Symbol symbol(size_t i) const { return syms[clamp(i)]; }  // noSymbol si no es TK_ID
+    const vector<LexError>& errors() const { return lexErrors; }
+
+private:
+    const char* base = nullptr;
+    vector<uint8_t> kinds;    // TokenType - TK_ID
+    vector<uint32_t> offsets;
+    vector<uint32_t> lengths;
+    vector<uint32_t> lines;   // linea donde empieza el token
+    vector<Symbol> syms;
+    vector<LexError> lexErrors;
+
+    size_t clamp(size_t i) const { return i < kinds.size() ? i : kinds.size() - 1; }
+    void push(int kind, size_t offset, size_t length, int line, Symbol symbol = noSymbol);
+    template <class Lexer>
+    void fillFrom(Lexer& lexer, const char* base, Interner* symbols);
+};
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef TOKENS_H
 #define TOKENS_H
 
+#include <cstddef>
 #include <string>
 using namespace std;
 
@@ -55,6 +56,13 @@ enum TokenType {
     TK_ERROR
 };
 
+// Lexema como vista (offset, largo) dentro del texto fuente: no copia nada.
+// El string se arma solo cuando hace falta (errores, traza).
+struct Lexeme {
+    size_t offset;
+    size_t length;
+};
+
 struct Token {
     TokenType type;
     string lexeme;
@@ -0,0 +1,294 @@
+#include "typecheck.h"
+
+using namespace std;
+
+TypeChecker::TypeChecker()
+    : tree(nullptr), names(nullptr), err(&cerr), sink(nullptr), errors(0), function(nullptr) {}
+
+void TypeChecker::setOutput(ostream& errStream) {
+    err = &errStream;
+}
+
+void TypeChecker::setDiagnostics(Diagnostics* diagnostics) {
+    sink = diagnostics;
+}
+
+void TypeChecker::error(DiagCode code, uint32_t line, uint16_t column, const string& message) {
+    errors++;
+    (sink ? sink : &own)->addCheck(code, line, column, message, tree->source(),
+                                   tree->sourceLength());
+}
+
+// TY_ERROR ya fue reportado mas abajo: no repetir
+bool TypeChecker::mismatch(TypeId got, TypeId want) const {
+    return got != want && got != TY_ERROR && want != TY_ERROR;
+}
+
+void TypeChecker::expect(TypeId got, TypeId want, uint32_t line, uint16_t column,
+                         const char* what) {
+    if (mismatch(got, want))
+        error(DG_TIPO_DISTINTO, line, column, string(what) + " debe ser " + name(want) + " y es " + name(got));
+}
+
+bool TypeChecker::check(Ast& ast, const SemanticAnalyzer& resolved) {
+    tree = &ast;
+    names = &resolved;
+    errors = 0;
+    own.clear();
+    open.clear();
+    pending.clear();
+    values.clear();
+    argsDone.clear();
+    for (const Func& f : ast.funcs) {
+        function = &f;
+        body(f.body);
+    }
+    function = nullptr;
+
+    if (!sink) {
+        own.flush(*err, nullptr);
+        if (errors > 0)
+            *err << "Analisis de tipos completado con errores\n";
+    }
+    return errors == 0;
+}
+
+// Igual que en el semantico: los bloques de un if/while van encima del que
+// los contiene, que sigue cuando se terminan
+void TypeChecker::body(NodeId block) {
+    if (block != noNode)
+        open.push_back({block, 0});
+    while (!open.empty()) {
+        size_t depth = open.size();
+        const Block& b = tree->blocks[open.back().block];
+        const NodeId* s = tree->begin(b.stmts) + open.back().next;
+        while (s != tree->end(b.stmts) && open.size() == depth)
+            stmt(*s++);
+        if (open.size() != depth)
+            open[depth - 1].next = (uint32_t)(s - tree->begin(b.stmts));
+        else
+            open.pop_back();
+    }
+}
+
+void TypeChecker::stmt(NodeId id) {
+    const Stmt& s = tree->stmts[id];
+    switch (s.kind) {
+    case StmtKind::Assign: {
+        TypeId target = expr(s.target);
+        expect(expr(s.value), target, s.line, s.column, "el valor asignado");
+        break;
+    }
+    case StmtKind::Call:
+        expr(s.value, false);
+        break;
+    case StmtKind::If:
+        expect(expr(s.value), TY_BOOL, s.line, s.column, "la condicion del if");
+        // arriba el cuerpo, que va primero
+        if (s.orelse != noNode)
+            open.push_back({s.orelse, 0});
+        if (s.body != noNode)
+            open.push_back({s.body, 0});
+        break;
+    case StmtKind::While:
+        expect(expr(s.value), TY_BOOL, s.line, s.column, "la condicion del while");
+        if (s.body != noNode)
+            open.push_back({s.body, 0});
+        break;
+    case StmtKind::Return: {
+        // los mensajes se arman solo si hay error: esto corre en cada return
+        TypeId ret = function->ret;
+        if (ret == TY_VOID) {
+            if (s.value != noNode) {
+                expr(s.value);
+                error(DG_RETORNO, s.line, s.column,
+                      "la funcion '" + tree->str(function->name) + "' no devuelve valor");
+            }
+        } else if (s.value == noNode) {
+            error(DG_RETORNO, s.line, s.column,
+                  "la funcion '" + tree->str(function->name) + "' debe devolver " + name(ret));
+        } else {
+            TypeId got = expr(s.value);
+            if (mismatch(got, ret))
+                error(DG_RETORNO, s.line, s.column,
+                      "la funcion '" + tree->str(function->name) + "' debe devolver " + name(ret) +
+                          " y devuelve " + name(got));
+        }
+        break;
+    }
+    }
+}
+
+// Postorden sin recursion: baja por el hijo izquierdo dejando en pending el
+// resto y el paso que tipa al nodo cuando sus hijos estan en values.
+// needValue: false solo si root es una llamada usada como comando
+TypeId TypeChecker::expr(NodeId root, bool needValue) {
+    size_t base = pending.size();
+    NodeId id = root;
+    while (true) {
+        while (id != noNode) {
+            Expr& e = tree->exprs[id];
+            switch (e.kind) {
+            case ExprKind::Num:
+                values.push_back(e.type = TY_INT);
+                id = noNode;
+                break;
+            case ExprKind::Str:
+                values.push_back(e.type = TY_STRING);
+                id = noNode;
+                break;
+            case ExprKind::True:
+            case ExprKind::False:
+                values.push_back(e.type = TY_BOOL);
+                id = noNode;
+                break;
+            case ExprKind::Var:
+                values.push_back(e.type = tree->vars[names->declOf(id)].type);
+                id = noNode;
+                break;
+            case ExprKind::Call:
+                // cada argumento se chequea apenas se calcula, antes del siguiente
+                argsDone.push_back(0);
+                pending.push_back(id | TS_FINISH);
+                for (const NodeId* a = tree->end(e.args); a != tree->begin(e.args); a--) {
+                    pending.push_back(id | TS_ARG);
+                    pending.push_back(a[-1]);
+                }
+                id = noNode;
+                break;
+            case ExprKind::New:
+                pending.push_back(id | TS_FINISH);
+                id = e.rhs;
+                break;
+            case ExprKind::Unary:
+                pending.push_back(id | TS_FINISH);
+                id = e.lhs;
+                break;
+            case ExprKind::Index:
+            case ExprKind::Binary:
+                pending.push_back(id | TS_FINISH);
+                pending.push_back(e.rhs);
+                id = e.lhs;
+                break;
+            }
+        }
+        if (pending.size() == base)
+            break;
+        NodeId step = pending.back();
+        pending.pop_back();
+        id = step & ~TS_MASK;
+        switch (step & TS_MASK) {
+        case TS_VISIT:
+            continue;
+        case TS_ARG:
+            argument(id);
+            break;
+        default:
+            finish(id, id != root || needValue);
+            break;
+        }
+        id = noNode;
+    }
+    TypeId t = values.back();
+    values.pop_back();
+    return t;
+}
+
+void TypeChecker::argument(NodeId id) {
+    const Expr& e = tree->exprs[id];
+    const Func& f = tree->funcs[names->declOf(id)];
+    uint32_t index = ++argsDone.back();
+    TypeId got = values.back();
+    values.pop_back();
+    TypeId want = tree->vars[tree->begin(f.params)[index - 1]].type;
+    if (mismatch(got, want))
+        error(DG_TIPO_DISTINTO, e.line, e.column, "el argumento " + to_string(index) + " de '" + tree->str(e.sym) +
+                      "' debe ser " + name(want) + " y es " + name(got));
+}
+
+// needValue: la llamada esta dentro de una expresion
+TypeId TypeChecker::call(NodeId id, bool needValue) {
+    Expr& e = tree->exprs[id];
+    const Func& f = tree->funcs[names->declOf(id)];
+    argsDone.pop_back();
+    if (needValue && f.ret == TY_VOID) {
+        error(DG_SIN_VALOR, e.line, e.column, "la funcion '" + tree->str(e.sym) + "' no devuelve valor");
+        return e.type = TY_ERROR;
+    }
+    return e.type = f.ret;
+}
+
+// Los hijos de id ya se recorrieron y sus tipos estan arriba de values
+void TypeChecker::finish(NodeId id, bool needValue) {
+    Expr& e = tree->exprs[id];
+    TypeId t = TY_ERROR;
+    switch (e.kind) {
+    case ExprKind::Call:
+        values.push_back(call(id, needValue));
+        return;
+    case ExprKind::Index: {
+        TypeId index = values.back();
+        values.pop_back();
+        TypeId base = values.back();
+        values.pop_back();
+        expect(index, TY_INT, e.line, e.column, "el indice");
+        if (base != TY_ERROR && !tree->types.isArray(base))
+            error(DG_NO_ARREGLO, e.line, e.column, "se indexa un valor de tipo " + name(base) + ", que no es arreglo");
+        else if (base != TY_ERROR)
+            t = tree->types.element(base);
+        break;
+    }
+    case ExprKind::New:
+        expect(values.back(), TY_INT, e.line, e.column, "el tamano de new");
+        values.back() = e.type;  // [ ] T, ya lo puso el parser
+        return;
+    case ExprKind::Unary: {
+        TypeId want = e.opToken() == TK_NOT ? TY_BOOL : TY_INT;
+        expect(values.back(), want, e.line, e.column, e.opToken() == TK_NOT ? "el operando de 'not'" : "el operando de '-'");
+        t = want;
+        values.pop_back();
+        break;
+    }
+    case ExprKind::Binary: {
+        TypeId rhs = values.back();
+        values.pop_back();
+        TypeId lhs = values.back();
+        values.pop_back();
+        switch (e.opToken()) {
+        case TK_PLUS:
+        case TK_MINUS:
+        case TK_MUL:
+        case TK_DIV:
+            expect(lhs, TY_INT, e.line, e.column, "el operando izquierdo");
+            expect(rhs, TY_INT, e.line, e.column, "el operando derecho");
+            t = TY_INT;
+            break;
+        case TK_AND:
+        case TK_OR:
+            expect(lhs, TY_BOOL, e.line, e.column, "el operando izquierdo");
+            expect(rhs, TY_BOOL, e.line, e.column, "el operando derecho");
+            t = TY_BOOL;
+            break;
+        case TK_LT:
+        case TK_LE:
+        case TK_GT:
+        case TK_GE:
+            if (lhs != TY_ERROR && lhs != TY_INT && lhs != TY_CHAR)
+                error(DG_COMPARACION, e.line, e.column, "solo se comparan int o char, no " + name(lhs));
+            else
+                expect(rhs, lhs, e.line, e.column, "el operando derecho");
+            t = TY_BOOL;
+            break;
+        default:  // TK_EQ, TK_NEQ
+            if (lhs != TY_ERROR && rhs != TY_ERROR && lhs != rhs)
+                error(DG_COMPARACION, e.line, e.column, "se comparan " + name(lhs) + " y " + name(rhs));
+            t = TY_BOOL;
+            break;
+        }
+        break;
+    }
+    default:  // las hojas no dejan paso pendiente
+        break;
+    }
+    values.push_back(e.type = t);
+}
@@ -0,0 +1,73 @@
+#ifndef TYPECHECK_H
+#define TYPECHECK_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ast.h"
+#include "diagnostics.h"
+#include "semantic.h"
+
+using namespace std;
+
+// Chequeo de tipos: una pasada lineal sobre el AST que deja en cada Expr su
+// TypeId, asi los backends no necesitan etiquetas de tipo en tiempo de
+// ejecucion. Necesita los nombres ya resueltos (SemanticAnalyzer sin errores).
+// No es recursivo: como el semantico, aguanta cualquier anidamiento.
+//
+// Reglas: + - * / y el - unario son de int; < <= > >= comparan dos int o dos
+// char; == y <> dos valores del mismo tipo; and, or y not son de bool. Se
+// indexa un arreglo con un int. Asignaciones, argumentos y return tienen que
+// coincidir exactamente con el tipo declarado, y las condiciones ser bool.
+class TypeChecker {
+public:
+    TypeChecker();
+
+    void setOutput(ostream& err);
+    // con sink los errores van ahi (y cuentan para su limite); sin sink se
+    // escriben en err al final de check
+    void setDiagnostics(Diagnostics* sink);
+    bool check(Ast& tree, const SemanticAnalyzer& names);  // true si no hay errores
+    size_t errorCount() const { return errors; }
+
+private:
+    // Bloques abiertos: cada uno sabe por que comando va
+    struct OpenBlock {
+        NodeId block;
+        uint32_t next;
+    };
+    // Pasos pendientes de la expresion actual: el Expr y en los dos bits
+    // altos que hacer con el (un indice de Expr no llega a 2^30)
+    enum : NodeId {
+        TS_VISIT = 0,            // recorrerlo
+        TS_ARG = 0x40000000u,    // llamada: el argumento que se acaba de calcular
+        TS_FINISH = 0x80000000u, // los hijos ya estan en values: tiparlo
+        TS_MASK = 0xC0000000u
+    };
+
+    Ast* tree;
+    const SemanticAnalyzer* names;
+    ostream* err;
+    Diagnostics* sink;
+    Diagnostics own;  // los errores cuando no hay sink
+    size_t errors;
+    const Func* function;  // la que se esta chequeando (para return)
+    vector<OpenBlock> open;
+    vector<NodeId> pending;
+    vector<TypeId> values;     // tipos de los hijos ya recorridos
+    vector<uint32_t> argsDone; // por llamada abierta: argumentos ya chequeados
+
+    void body(NodeId block);
+    void stmt(NodeId id);
+    TypeId expr(NodeId root, bool needValue = true);
+    void finish(NodeId id, bool needValue);
+    void argument(NodeId call);
+    TypeId call(NodeId id, bool needValue);
+    bool mismatch(TypeId got, TypeId want) const;
+    // donde se reporta: la linea y columna del nodo
+    void expect(TypeId got, TypeId want, uint32_t line, uint16_t column, const char* what);
+    string name(TypeId t) const { return "'" + tree->types.name(t) + "'"; }
+    void error(DiagCode code, uint32_t line, uint16_t column, const string& message);
+};
+
+#endif
@@ -0,0 +1,43 @@
+#include "types.h"
+
+using namespace std;
+
+TypeTable::TypeTable() {
+    clear();
+}
+
+void TypeTable::clear() {
+    elems.assign(TY_BASIC_COUNT, TY_ERROR);
+    arrays.assign(TY_BASIC_COUNT, TY_ERROR);
+}
+
+TypeId TypeTable::arrayOf(TypeId elem) {
+    if (elem == TY_ERROR || elem == TY_VOID)
+        return TY_ERROR;
+    if (arrays[elem] != TY_ERROR)
+        return arrays[elem];
+    if (elems.size() > UINT16_MAX)
+        return TY_ERROR;  // 65k dimensiones anidadas: no es un programa real
+
+    TypeId id = (TypeId)elems.size();
+    elems.push_back(elem);
+    arrays.push_back(TY_ERROR);
+    arrays[elem] = id;
+    return id;
+}
+
+string TypeTable::name(TypeId t) const {
+    string prefix;
+    while (isArray(t)) {
+        prefix += "[ ] ";
+        t = elems[t];
+    }
+    switch (t) {
+    case TY_VOID: return prefix + "void";
+    case TY_INT: return prefix + "int";
+    case TY_BOOL: return prefix + "bool";
+    case TY_CHAR: return prefix + "char";
+    case TY_STRING: return prefix + "string";
+    default: return prefix + "?";
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef TYPES_H
+#define TYPES_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Cada tipo distinto es un entero chico: los basicos son fijos y cada arreglo
+// se crea una sola vez, asi "[ ] [ ] int" siempre da el mismo id y comparar
+// tipos es comparar enteros.
+typedef uint16_t TypeId;
+
+enum : TypeId {
+    TY_ERROR,   // expresion mal tipada (no se reportan errores en cascada)
+    TY_VOID,    // funcion sin ':' tipo
+    TY_INT,
+    TY_BOOL,
+    TY_CHAR,
+    TY_STRING,
+    TY_BASIC_COUNT
+};
+
+class TypeTable {
+public:
+    TypeTable();
+
+    TypeId arrayOf(TypeId elem);  // O(1): el arreglo de cada tipo se recuerda
+    bool isArray(TypeId t) const { return elems[t] != TY_ERROR; }
+    TypeId element(TypeId t) const { return elems[t]; }
+    size_t size() const { return elems.size(); }
+    string name(TypeId t) const;  // como se escribe en Mini-0
+
+    void clear();  // quedan solo los basicos
+
+private:
+    vector<TypeId> elems;   // por tipo: tipo de sus elementos (TY_ERROR si no es arreglo)
+    vector<TypeId> arrays;  // por tipo: su arreglo (TY_ERROR si todavia no se uso)
+};
+
+#endif
@@ -0,0 +1,306 @@
+#include "vm.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+
+static inline uint32_t readU16(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+}
+
+static inline uint32_t readU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+VM::VM() : stack(stackSize), err(&cerr), executed(0) {}
+
+VM::~VM() {
+    freeHeap();
+}
+
+void VM::setOutput(ostream& errStream) {
+    err = &errStream;
+}
+
+Value* VM::newArray(Value length) {
+    Value* a = (Value*)calloc((size_t)length + 1, sizeof(Value));
+    if (a) {
+        a[0] = length;
+        heap.push_back(a);
+    }
+    return a;
+}
+
+void VM::freeHeap() {
+    for (Value* a : heap)
+        free(a);
+    heap.clear();
+}
+
+void VM::fail(const FunctionCode* fn, const uint8_t* ip, const string& message) {
+    *err << "Error de ejecucion en linea " << fn->lineAt(ip - fn->code.data()) << " ('"
+         << fn->name << "'): " << message << endl;
+}
+
+bool VM::run(const Program& program, Value& result) {
+    return execute<false>(program, result, nullptr);
+}
+
+bool VM::profile(const Program& program, Value& result, vector<uint64_t>& pairs) {
+    pairs.assign(OP_COUNT * OP_COUNT, 0);
+    return execute<true>(program, result, pairs.data());
+}
+
+// Profile: cuenta cada par (opcode anterior, opcode) en pairs[anterior * OP_COUNT + op]
+template <bool Profile>
+bool VM::execute(const Program& program, Value& result, uint64_t* pairs) {
+    result = 0;
+    executed = 0;
+    freeHeap();
+    if (program.mainFunction < 0) {
+        *err << "Error de ejecucion: el programa no tiene funcion main" << endl;
+        return false;
+    }
+    const FunctionCode* fn = &program.functions[program.mainFunction];
+    if (fn->params != 0) {
+        *err << "Error de ejecucion: main no puede recibir parametros" << endl;
+        return false;
+    }
+
+    globals.assign(program.globals, 0);
+    frames.clear();
+    Value* stackEnd = stack.data() + stack.size();
+    Value* base = stack.data();
+    if (fn->locals + fn->maxStack > stack.size()) {
+        *err << "Error de ejecucion: main necesita mas pila de la que hay" << endl;
+        return false;
+    }
+    fill(base, base + fn->locals, 0);
+    Value* sp = base + fn->locals;  // proximo lugar libre
+    const uint8_t* code = fn->code.data();
+    const uint8_t* ip = code;
+    const Value* constants = program.constants.data();
+    const FunctionCode* functions = program.functions.data();
+    Value* g = globals.data();
+    uint64_t count = 0;
+    uint32_t prev = OP_COUNT;
+    bool ok = true;
+
+    // aritmetica en uint64_t: el desborde da la vuelta en vez de ser UB
+    for (;;) {
+        count++;
+        if (Profile) {
+            if (prev != OP_COUNT)
+                pairs[prev * OP_COUNT + *ip]++;
+            prev = *ip;
+        }
+        switch ((Opcode)*ip) {
+        case OP_CONST:
+            *sp++ = constants[readU32(ip + 1)];
+            ip += 5;
+            break;
+        case OP_LOAD:
+            *sp++ = base[readU16(ip + 1)];
+            ip += 3;
+            break;
+        case OP_STORE:
+            base[readU16(ip + 1)] = *--sp;
+            ip += 3;
+            break;
+        case OP_LOAD_GLOBAL:
+            *sp++ = g[readU32(ip + 1)];
+            ip += 5;
+            break;
+        case OP_STORE_GLOBAL:
+            g[readU32(ip + 1)] = *--sp;
+            ip += 5;
+            break;
+        case OP_CLEAR:
+            base[readU16(ip + 1)] = 0;
+            ip += 3;
+            break;
+        case OP_NEW_ARRAY: {
+            Value n = sp[-1];
+            if (n < 0) {
+                fail(fn, ip, "new con tamano negativo (" + to_string(n) + ")");
+                ok = false;
+                goto done;
+            }
+            Value* a = newArray(n);
+            if (!a) {
+                fail(fn, ip, "no hay memoria para un arreglo de " + to_string(n) + " elementos");
+                ok = false;
+                goto done;
+            }
+            sp[-1] = (Value)(intptr_t)a;
+            ip++;
+            break;
+        }
+        case OP_LOAD_INDEX:
+        case OP_STORE_INDEX: {
+            bool store = *ip == OP_STORE_INDEX;
+            Value* slot = store ? sp - 3 : sp - 2;
+            Value* a = (Value*)(intptr_t)slot[0];
+            Value i = slot[1];
+            if (!a) {
+                fail(fn, ip, "arreglo sin crear (falta new)");
+                ok = false;
+                goto done;
+            }
+            if ((uint64_t)i >= (uint64_t)a[0]) {
+                fail(fn, ip, "indice " + to_string(i) + " fuera de rango (largo " + to_string(a[0]) + ")");
+                ok = false;
+                goto done;
+            }
+            if (store) {
+                a[1 + i] = slot[2];
+                sp -= 3;
+            } else {
+                slot[0] = a[1 + i];
+                sp--;
+            }
+            ip++;
+            break;
+        }
+        case OP_ADD:
+            sp[-2] = (Value)((uint64_t)sp[-2] + (uint64_t)sp[-1]);
+            sp--;
+            ip++;
+            break;
+        case OP_SUB:
+            sp[-2] = (Value)((uint64_t)sp[-2] - (uint64_t)sp[-1]);
+            sp--;
+            ip++;
+            break;
+        case OP_MUL:
+            sp[-2] = (Value)((uint64_t)sp[-2] * (uint64_t)sp[-1]);
+            sp--;
+            ip++;
+            break;
+        case OP_DIV:
+            if (sp[-1] == 0) {
+                fail(fn, ip, "division por cero");
+                ok = false;
+                goto done;
+            }
+            // INT64_MIN / -1 no entra: da la vuelta como la multiplicacion
+            sp[-2] = sp[-1] == -1 ? (Value)(0 - (uint64_t)sp[-2]) : sp[-2] / sp[-1];
+            sp--;
+            ip++;
+            break;
+        case OP_NEG:
+            sp[-1] = (Value)(0 - (uint64_t)sp[-1]);
+            ip++;
+            break;
+        case OP_NOT:
+            sp[-1] = sp[-1] == 0;
+            ip++;
+            break;
+        case OP_LT:
+            sp[-2] = sp[-2] < sp[-1];
+            sp--;
+            ip++;
+            break;
+        case OP_LE:
+            sp[-2] = sp[-2] <= sp[-1];
+            sp--;
+            ip++;
+            break;
+        case OP_GT:
+            sp[-2] = sp[-2] > sp[-1];
+            sp--;
+            ip++;
+            break;
+        case OP_GE:
+            sp[-2] = sp[-2] >= sp[-1];
+            sp--;
+            ip++;
+            break;
+        case OP_EQ:
+            sp[-2] = sp[-2] == sp[-1];
+            sp--;
+            ip++;
+            break;
+        case OP_NE:
+            sp[-2] = sp[-2] != sp[-1];
+            sp--;
+            ip++;
+            break;
+        case OP_JUMP:
+            ip = code + readU32(ip + 1);
+            break;
+        case OP_JUMP_FALSE:
+            ip = *--sp == 0 ? code + readU32(ip + 1) : ip + 5;
+            break;
+        case OP_JUMP_TRUE:
+            ip = *--sp != 0 ? code + readU32(ip + 1) : ip + 5;
+            break;
+        case OP_AND:
+            if (sp[-1] == 0) {
+                ip = code + readU32(ip + 1);
+            } else {
+                sp--;
+                ip += 5;
+            }
+            break;
+        case OP_OR:
+            if (sp[-1] != 0) {
+                ip = code + readU32(ip + 1);
+            } else {
+                sp--;
+                ip += 5;
+            }
+            break;
+        case OP_CALL: {
+            const FunctionCode* callee = &functions[readU32(ip + 1)];
+            Value* calleeBase = sp - callee->params;
+            if (calleeBase + callee->locals + callee->maxStack > stackEnd || frames.size() >= maxFrames) {
+                fail(fn, ip, "desborde de pila (recursion demasiado profunda)");
+                ok = false;
+                goto done;
+            }
+            frames.push_back({fn, ip + 5, base});
+            fill(sp, calleeBase + callee->locals, 0);
+            sp = calleeBase + callee->locals;
+            base = calleeBase;
+            fn = callee;
+            code = fn->code.data();
+            ip = code;
+            break;
+        }
+        case OP_RET:
+        case OP_RET_VOID: {
+            bool value = *ip == OP_RET;
+            Value v = value ? sp[-1] : 0;
+            if (frames.empty()) {
+                result = v;
+                goto done;
+            }
+            const Frame& f = frames.back();
+            sp = base;
+            if (value)
+                *sp++ = v;
+            fn = f.fn;
+            ip = f.ip;
+            base = f.base;
+            code = fn->code.data();
+            frames.pop_back();
+            break;
+        }
+        case OP_POP:
+            sp--;
+            ip++;
+            break;
+        default:
+            fail(fn, ip, "opcode invalido " + to_string(*ip));
+            ok = false;
+            goto done;
+        }
+    }
+
+done:
+    executed = count;
+    freeHeap();
+    return ok;
+}
@@ -0,0 +1,56 @@
+#ifndef VM_H
+#define VM_H
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "bytecode.h"
+
+using namespace std;
+
+// Maquina de pila que ejecuta un Program empezando por main. Cada llamada usa
+// una ventana de la pila de valores: parametros, locales y despues los
+// operandos. Los arreglos se liberan todos juntos al terminar la ejecucion.
+// Errores de ejecucion (indice fuera de rango, arreglo sin crear, division
+// por cero, recursion demasiado profunda) cortan la ejecucion con un mensaje.
+class VM {
+public:
+    static const size_t stackSize = 1 << 20;  // valores (8 MB)
+    static const size_t maxFrames = 1 << 18;
+
+    VM();
+    ~VM();
+    VM(const VM&) = delete;
+    VM& operator=(const VM&) = delete;
+
+    void setOutput(ostream& err);
+    // result: lo que devuelve main (0 si no devuelve nada)
+    bool run(const Program& program, Value& result);
+    uint64_t instructions() const { return executed; }  // de la ultima ejecucion
+    // como run, contando cuantas veces se ejecuta cada par de opcodes seguidos
+    // (pairs[primero * OP_COUNT + segundo]); sirve para elegir superinstrucciones
+    bool profile(const Program& program, Value& result, vector<uint64_t>& pairs);
+
+private:
+    struct Frame {
+        const FunctionCode* fn;
+        const uint8_t* ip;  // donde sigue el que llamo
+        Value* base;
+    };
+
+    vector<Value> stack;
+    vector<Frame> frames;
+    vector<Value> globals;
+    vector<Value*> heap;
+    ostream* err;
+    uint64_t executed;
+
+    template <bool Profile>
+    bool execute(const Program& program, Value& result, uint64_t* pairs);
+    Value* newArray(Value length);
+    void freeHeap();
+    void fail(const FunctionCode* fn, const uint8_t* ip, const string& message);
+};
+
+#endif
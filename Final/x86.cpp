@@ -0,0 +1,220 @@
+#include "x86.h"
+
+using namespace std;
+
+static const char* const regNames[16] = {
+    "%rax", "%rcx", "%rdx", "%rbx", "%rsp", "%rbp", "%rsi", "%rdi",
+    "%r8", "%r9", "%r10", "%r11", "%r12", "%r13", "%r14", "%r15"};
+static const char* const byteNames[16] = {
+    "%al", "%cl", "%dl", "%bl", "%spl", "%bpl", "%sil", "%dil",
+    "%r8b", "%r9b", "%r10b", "%r11b", "%r12b", "%r13b", "%r14b", "%r15b"};
+static const char* const dwordNames[16] = {
+    "%eax", "%ecx", "%edx", "%ebx", "%esp", "%ebp", "%esi", "%edi",
+    "%r8d", "%r9d", "%r10d", "%r11d", "%r12d", "%r13d", "%r14d", "%r15d"};
+
+static const char* condName(Cond c) {
+    switch (c) {
+    case CC_B: return "b";
+    case CC_AE: return "ae";
+    case CC_E: return "e";
+    case CC_NE: return "ne";
+    case CC_L: return "l";
+    case CC_GE: return "ge";
+    case CC_LE: return "le";
+    case CC_G: return "g";
+    }
+    return "?";
+}
+
+X86Text::X86Text() : labels(0) {}
+
+AsmSymbol X86Text::function(const string& name) {
+    symbols.push_back(name);
+    return (AsmSymbol)symbols.size() - 1;
+}
+
+AsmSymbol X86Text::external(const string& name) {
+    symbols.push_back(name);
+    return (AsmSymbol)symbols.size() - 1;
+}
+
+AsmSymbol X86Text::variable(const string& name) {
+    symbols.push_back(name);
+    globals.push_back(name);
+    return (AsmSymbol)symbols.size() - 1;
+}
+
+AsmSymbol X86Text::data(const string& bytes) {
+    string name = ".Lstr" + to_string(symbols.size());
+    string escaped;
+    for (unsigned char c : bytes) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += (char)c;
+        } else if (c < 32 || c > 126) {
+            char octal[5] = {'\\', (char)('0' + (c >> 6)), (char)('0' + ((c >> 3) & 7)),
+                             (char)('0' + (c & 7)), 0};
+            escaped += octal;
+        } else {
+            escaped += (char)c;
+        }
+    }
+    rodata += name + ":\n    .string \"" + escaped + "\"\n";
+    symbols.push_back(name);
+    return (AsmSymbol)symbols.size() - 1;
+}
+
+void X86Text::begin(AsmSymbol fn) {
+    const string& name = symbols[fn];
+    text += "\n    .globl " + name + "\n    .type " + name + ", @function\n" + name + ":\n";
+}
+
+void X86Text::end(AsmSymbol fn) {
+    text += "    .size " + symbols[fn] + ", .-" + symbols[fn] + "\n";
+}
+
+AsmLabel X86Text::label() {
+    return labels++;
+}
+
+void X86Text::place(AsmLabel l) {
+    text += ".L" + to_string(l) + ":\n";
+}
+
+void X86Text::write(ostream& out) const {
+    out << "# generado por mini0 --emit-asm\n"
+        << "    .text\n"
+        << text
+        << "\n    .section .rodata\n" << rodata;
+    if (!globals.empty()) {
+        out << "\n    .bss\n    .p2align 3\n";
+        for (const string& g : globals)
+            out << g << ":\n    .zero 8\n";
+    }
+    out << "\n    .section .note.GNU-stack,\"\",@progbits\n";
+}
+
+string X86Text::mem(const Mem& m) const {
+    if (m.symbol != noAsmSymbol)
+        return symbols[m.symbol] + (m.disp ? "+" + to_string(m.disp) : "") + "(%rip)";
+    string s = m.disp ? to_string(m.disp) : "";
+    s += "(";
+    s += regNames[m.base];
+    if (m.scale) {
+        s += ",";
+        s += regNames[m.index];
+        s += "," + to_string(m.scale);
+    }
+    return s + ")";
+}
+
+string X86Text::operand(const Operand& o) const {
+    switch (o.kind) {
+    case Operand::Register:
+        return regNames[o.reg];
+    case Operand::Memory:
+        return mem(o.mem);
+    case Operand::Immediate:
+        break;
+    }
+    return "$" + to_string(o.imm);
+}
+
+void X86Text::mov(Reg64 dst, const Operand& src) {
+    if (src.kind == Operand::Immediate)
+        movImm(dst, src.imm);
+    else if (src.kind == Operand::Memory || src.reg != dst)
+        emit("movq " + operand(src) + ", " + regNames[dst]);
+}
+
+void X86Text::movImm(Reg64 dst, int64_t value) {
+    if (value == 0)
+        emit(string("xorl ") + dwordNames[dst] + ", " + dwordNames[dst]);
+    else if (value > 0 && value <= UINT32_MAX)
+        emit("movl $" + to_string(value) + ", " + dwordNames[dst]);
+    else if (value >= INT32_MIN && value < 0)
+        emit("movq $" + to_string(value) + ", " + regNames[dst]);
+    else
+        emit("movabsq $" + to_string(value) + ", " + regNames[dst]);
+}
+
+void X86Text::store(const Mem& dst, Reg64 src) {
+    emit(string("movq ") + regNames[src] + ", " + mem(dst));
+}
+
+void X86Text::storeImm(const Mem& dst, int32_t value) {
+    emit("movq $" + to_string(value) + ", " + mem(dst));
+}
+
+void X86Text::lea(Reg64 dst, const Mem& src) {
+    emit("leaq " + mem(src) + ", " + regNames[dst]);
+}
+
+void X86Text::alu(AluOp op, Reg64 dst, const Operand& src) {
+    static const char* const names[8] = {"addq", "orq", "", "", "andq", "subq", "xorq", "cmpq"};
+    emit(string(names[op]) + " " + operand(src) + ", " + regNames[dst]);
+}
+
+void X86Text::imul(Reg64 dst, const Operand& src) {
+    emit("imulq " + operand(src) + ", " + regNames[dst]);
+}
+
+void X86Text::test(Reg64 a, Reg64 b) {
+    emit(string("testq ") + regNames[b] + ", " + regNames[a]);
+}
+
+void X86Text::neg(Reg64 r) {
+    emit(string("negq ") + regNames[r]);
+}
+
+void X86Text::shift(ShiftOp op, Reg64 r, uint8_t count) {
+    static const char* const names[8] = {"", "", "", "", "shlq", "shrq", "", "sarq"};
+    emit(string(names[op]) + " $" + to_string(count) + ", " + regNames[r]);
+}
+
+void X86Text::set(Cond c, Reg64 r) {
+    emit(string("set") + condName(c) + " " + byteNames[r]);
+    emit(string("movzbl ") + byteNames[r] + ", " + dwordNames[r]);
+}
+
+void X86Text::cqo() {
+    emit("cqto");
+}
+
+void X86Text::idiv(Reg64 r) {
+    emit(string("idivq ") + regNames[r]);
+}
+
+void X86Text::push(Reg64 r) {
+    emit(string("pushq ") + regNames[r]);
+}
+
+void X86Text::pop(Reg64 r) {
+    emit(string("popq ") + regNames[r]);
+}
+
+void X86Text::call(AsmSymbol fn) {
+    emit("call " + symbols[fn]);
+}
+
+void X86Text::jmp(AsmLabel target) {
+    emit("jmp .L" + to_string(target));
+}
+
+void X86Text::jcc(Cond c, AsmLabel target) {
+    emit(string("j") + condName(c) + " .L" + to_string(target));
+}
+
+void X86Text::leave() {
+    emit("leave");
+}
+
+void X86Text::ret() {
+    emit("ret");
+}
+
+void X86Text::emit(const string& instr) {
+    text += "    ";
+    text += instr;
+    text += '\n';
+}
@@ -0,0 +1,172 @@
+#ifndef X86_H
+#define X86_H
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Registros de 64 bits con su numero de codificacion (los que pasan de 7
+// necesitan el prefijo REX)
+enum Reg64 : uint8_t {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+// Condiciones de salto/set con su numero de codificacion (la opuesta es c ^ 1)
+enum Cond : uint8_t {
+    CC_B = 0x2,
+    CC_AE = 0x3,
+    CC_E = 0x4,
+    CC_NE = 0x5,
+    CC_L = 0xC,
+    CC_GE = 0xD,
+    CC_LE = 0xE,
+    CC_G = 0xF
+};
+
+inline Cond opposite(Cond c) { return (Cond)(c ^ 1); }
+
+// Operaciones aritmeticas de dos operandos; el valor es el /digito de 0x81/0x83
+enum AluOp : uint8_t {
+    ALU_ADD = 0,
+    ALU_OR = 1,
+    ALU_AND = 4,
+    ALU_SUB = 5,
+    ALU_XOR = 6,
+    ALU_CMP = 7
+};
+
+// Desplazamientos por una cantidad fija; el valor es el /digito de 0xC1
+enum ShiftOp : uint8_t {
+    SH_SHL = 4,
+    SH_SHR = 5,
+    SH_SAR = 7
+};
+
+typedef uint32_t AsmLabel;
+typedef uint32_t AsmSymbol;
+const AsmSymbol noAsmSymbol = 0xFFFFFFFFu;
+
+// Direccion de memoria: disp(base, index, scale), o sym+disp relativo a rip
+// si symbol != noAsmSymbol
+struct Mem {
+    Reg64 base;
+    Reg64 index;
+    uint8_t scale;  // 0: sin indice
+    int32_t disp;
+    AsmSymbol symbol;
+
+    static Mem at(Reg64 base, int32_t disp) { return {base, RAX, 0, disp, noAsmSymbol}; }
+    static Mem indexed(Reg64 base, Reg64 index, uint8_t scale, int32_t disp) {
+        return {base, index, scale, disp, noAsmSymbol};
+    }
+    static Mem rip(AsmSymbol symbol) { return {RAX, RAX, 0, 0, symbol}; }
+};
+
+// Operando fuente: registro, memoria o inmediato de 32 bits (con signo)
+struct Operand {
+    enum Kind : uint8_t { Register, Memory, Immediate } kind;
+    Reg64 reg;
+    Mem mem;
+    int32_t imm;
+
+    static Operand r(Reg64 reg) { return {Register, reg, Mem::at(RAX, 0), 0}; }
+    static Operand m(const Mem& mem) { return {Memory, RAX, mem, 0}; }
+    static Operand i(int32_t imm) { return {Immediate, RAX, Mem::at(RAX, 0), imm}; }
+};
+
+// Destino de las instrucciones de x86-64 que usa AsmGenerator. Las
+// instrucciones son siempre de 64 bits. Los simbolos y etiquetas los
+// numera cada implementacion: X86Text escribe ensamblador de GNU as y
+// X86Encoder (x86enc.h) codigo de maquina dentro de un objeto ELF.
+class X86Emitter {
+public:
+    virtual ~X86Emitter() {}
+
+    // simbolos: funcion global en .text, funcion externa (el runtime),
+    // variable de 8 bytes en .bss y texto terminado en 0 en .rodata
+    virtual AsmSymbol function(const string& name) = 0;
+    virtual AsmSymbol external(const string& name) = 0;
+    virtual AsmSymbol variable(const string& name) = 0;
+    virtual AsmSymbol data(const string& bytes) = 0;
+
+    virtual void begin(AsmSymbol fn) = 0;  // el codigo que sigue es de fn
+    virtual void end(AsmSymbol fn) = 0;
+    virtual AsmLabel label() = 0;
+    virtual void place(AsmLabel l) = 0;
+
+    virtual void mov(Reg64 dst, const Operand& src) = 0;
+    virtual void movImm(Reg64 dst, int64_t value) = 0;
+    virtual void store(const Mem& dst, Reg64 src) = 0;
+    virtual void storeImm(const Mem& dst, int32_t value) = 0;
+    virtual void lea(Reg64 dst, const Mem& src) = 0;
+    virtual void alu(AluOp op, Reg64 dst, const Operand& src) = 0;
+    virtual void imul(Reg64 dst, const Operand& src) = 0;
+    virtual void test(Reg64 a, Reg64 b) = 0;
+    virtual void neg(Reg64 r) = 0;
+    virtual void shift(ShiftOp op, Reg64 r, uint8_t count) = 0;
+    virtual void set(Cond c, Reg64 r) = 0;  // r = 1 si vale c, si no 0
+    virtual void cqo() = 0;
+    virtual void idiv(Reg64 r) = 0;
+    virtual void push(Reg64 r) = 0;
+    virtual void pop(Reg64 r) = 0;
+    virtual void call(AsmSymbol fn) = 0;
+    virtual void jmp(AsmLabel target) = 0;
+    virtual void jcc(Cond c, AsmLabel target) = 0;
+    virtual void leave() = 0;
+    virtual void ret() = 0;
+};
+
+// Ensamblador de GNU as en sintaxis AT&T (mini0 --emit-asm)
+class X86Text : public X86Emitter {
+public:
+    X86Text();
+
+    void write(ostream& out) const;
+
+    AsmSymbol function(const string& name) override;
+    AsmSymbol external(const string& name) override;
+    AsmSymbol variable(const string& name) override;
+    AsmSymbol data(const string& bytes) override;
+    void begin(AsmSymbol fn) override;
+    void end(AsmSymbol fn) override;
+    AsmLabel label() override;
+    void place(AsmLabel l) override;
+
+    void mov(Reg64 dst, const Operand& src) override;
+    void movImm(Reg64 dst, int64_t value) override;
+    void store(const Mem& dst, Reg64 src) override;
+    void storeImm(const Mem& dst, int32_t value) override;
+    void lea(Reg64 dst, const Mem& src) override;
+    void alu(AluOp op, Reg64 dst, const Operand& src) override;
+    void imul(Reg64 dst, const Operand& src) override;
+    void test(Reg64 a, Reg64 b) override;
+    void neg(Reg64 r) override;
+    void shift(ShiftOp op, Reg64 r, uint8_t count) override;
+    void set(Cond c, Reg64 r) override;
+    void cqo() override;
+    void idiv(Reg64 r) override;
+    void push(Reg64 r) override;
+    void pop(Reg64 r) override;
+    void call(AsmSymbol fn) override;
+    void jmp(AsmLabel target) override;
+    void jcc(Cond c, AsmLabel target) override;
+    void leave() override;
+    void ret() override;
+
+private:
+    vector<string> symbols;  // por AsmSymbol: nombre o etiqueta
+    vector<string> globals;  // variables de .bss
+    string text;
+    string rodata;
+    uint32_t labels;
+
+    string operand(const Operand& o) const;
+    string mem(const Mem& m) const;
+    void emit(const string& instr);
+};
+
+#endif
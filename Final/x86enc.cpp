@@ -0,0 +1,292 @@
+#include "x86enc.h"
+
+using namespace std;
+
+static bool fitsByte(int64_t v) {
+    return v >= -128 && v <= 127;
+}
+
+X86Encoder::X86Encoder(ElfObject& obj) : object(obj), code(obj.text), start(0) {}
+
+AsmSymbol X86Encoder::function(const string& name) {
+    targets.push_back({object.addSymbol(name, ElfObject::Text, 0, 0, ElfObject::Function, true), 0});
+    return (AsmSymbol)targets.size() - 1;
+}
+
+AsmSymbol X86Encoder::external(const string& name) {
+    targets.push_back({object.addSymbol(name, ElfObject::Undefined, 0, 0, ElfObject::NoType, true), 0});
+    return (AsmSymbol)targets.size() - 1;
+}
+
+AsmSymbol X86Encoder::variable(const string& name) {
+    uint32_t sym = object.addSymbol(name, ElfObject::Bss, object.bssSize, 8, ElfObject::Object, false);
+    object.bssSize += 8;
+    targets.push_back({sym, 0});
+    return (AsmSymbol)targets.size() - 1;
+}
+
+AsmSymbol X86Encoder::data(const string& bytes) {
+    int64_t offset = (int64_t)object.rodata.size();
+    object.rodata.insert(object.rodata.end(), bytes.begin(), bytes.end());
+    object.rodata.push_back(0);
+    targets.push_back({object.sectionSymbol(ElfObject::Rodata), offset});
+    return (AsmSymbol)targets.size() - 1;
+}
+
+void X86Encoder::begin(AsmSymbol) {
+    start = code.size();
+}
+
+// los saltos hacia adelante de la funcion ya tienen destino
+void X86Encoder::end(AsmSymbol fn) {
+    for (const Jump& j : jumps) {
+        int64_t rel = (int64_t)labels[j.target] - (int64_t)(j.at + 4);
+        for (int i = 0; i < 4; i++)
+            code[j.at + i] = (uint8_t)((uint64_t)rel >> (8 * i));
+    }
+    jumps.clear();
+    object.setSymbol(targets[fn].symbol, start, code.size() - start);
+}
+
+AsmLabel X86Encoder::label() {
+    labels.push_back(unplaced);
+    return (AsmLabel)labels.size() - 1;
+}
+
+void X86Encoder::place(AsmLabel l) {
+    labels[l] = code.size();
+}
+
+void X86Encoder::imm32(int32_t v) {
+    for (int i = 0; i < 4; i++)
+        byte((uint8_t)((uint32_t)v >> (8 * i)));
+}
+
+void X86Encoder::rex(bool wide, unsigned reg, unsigned index, unsigned base, bool byteRegs) {
+    uint8_t r = (uint8_t)(0x40 | (wide ? 8 : 0) | ((reg >> 3) & 1) << 2 | ((index >> 3) & 1) << 1 |
+                          ((base >> 3) & 1));
+    if (r != 0x40 || byteRegs)
+        byte(r);
+}
+
+void X86Encoder::opcode(unsigned op) {
+    if (op > 0xFF)
+        byte((uint8_t)(op >> 8));
+    byte((uint8_t)op);
+}
+
+void X86Encoder::regInstr(unsigned op, unsigned reg, unsigned rm, bool wide, bool byteRegs) {
+    rex(wide, reg, 0, rm, byteRegs);
+    opcode(op);
+    byte((uint8_t)(0xC0 | (reg & 7) << 3 | (rm & 7)));
+}
+
+void X86Encoder::memInstr(unsigned op, unsigned reg, const Mem& m, size_t trailing) {
+    if (m.symbol != noAsmSymbol) {
+        // [rip + disp32]: el enlazador pone la distancia desde el final de la instruccion
+        rex(true, reg, 0, 0);
+        opcode(op);
+        byte((uint8_t)(0x05 | (reg & 7) << 3));
+        const Target& t = targets[m.symbol];
+        object.relocate(code.size(), t.symbol, ElfObject::PC32,
+                        t.offset + m.disp - 4 - (int64_t)trailing);
+        imm32(0);
+        return;
+    }
+    rex(true, reg, m.scale ? m.index : 0, m.base);
+    opcode(op);
+    // rbp y r13 no tienen forma sin desplazamiento
+    unsigned mod = m.disp == 0 && (m.base & 7) != RBP ? 0 : fitsByte(m.disp) ? 1 : 2;
+    if (m.scale) {
+        unsigned scaleBits = m.scale == 8 ? 3 : m.scale == 4 ? 2 : m.scale == 2 ? 1 : 0;
+        byte((uint8_t)(mod << 6 | (reg & 7) << 3 | 4));
+        byte((uint8_t)(scaleBits << 6 | (m.index & 7) << 3 | (m.base & 7)));
+    } else if ((m.base & 7) == RSP) {
+        // rsp y r12 como base necesitan SIB sin indice
+        byte((uint8_t)(mod << 6 | (reg & 7) << 3 | 4));
+        byte(0x24);
+    } else {
+        byte((uint8_t)(mod << 6 | (reg & 7) << 3 | (m.base & 7)));
+    }
+    if (mod == 1)
+        byte((uint8_t)(int8_t)m.disp);
+    else if (mod == 2)
+        imm32(m.disp);
+}
+
+void X86Encoder::mov(Reg64 dst, const Operand& src) {
+    switch (src.kind) {
+    case Operand::Register:
+        if (src.reg != dst)
+            regInstr(0x8B, dst, src.reg);
+        return;
+    case Operand::Memory:
+        memInstr(0x8B, dst, src.mem);
+        return;
+    case Operand::Immediate:
+        movImm(dst, src.imm);
+        return;
+    }
+}
+
+// la forma mas corta: xor de 32 bits, mov de 32 bits (pone en 0 la parte
+// alta), mov con inmediato de 32 bits con signo, o movabs de 64
+void X86Encoder::movImm(Reg64 dst, int64_t value) {
+    if (value == 0) {
+        regInstr(0x31, dst, dst, false);
+    } else if (value > 0 && value <= UINT32_MAX) {
+        rex(false, 0, 0, dst);
+        byte((uint8_t)(0xB8 + (dst & 7)));
+        imm32((int32_t)(uint32_t)value);
+    } else if (value >= INT32_MIN && value < 0) {
+        regInstr(0xC7, 0, dst);
+        imm32((int32_t)value);
+    } else {
+        rex(true, 0, 0, dst);
+        byte((uint8_t)(0xB8 + (dst & 7)));
+        for (int i = 0; i < 8; i++)
+            byte((uint8_t)((uint64_t)value >> (8 * i)));
+    }
+}
+
+void X86Encoder::store(const Mem& dst, Reg64 src) {
+    memInstr(0x89, src, dst);
+}
+
+void X86Encoder::storeImm(const Mem& dst, int32_t value) {
+    memInstr(0xC7, 0, dst, 4);
+    imm32(value);
+}
+
+void X86Encoder::lea(Reg64 dst, const Mem& src) {
+    memInstr(0x8D, dst, src);
+}
+
+void X86Encoder::alu(AluOp op, Reg64 dst, const Operand& src) {
+    switch (src.kind) {
+    case Operand::Register:
+        regInstr(op * 8u + 3, dst, src.reg);
+        return;
+    case Operand::Memory:
+        memInstr(op * 8u + 3, dst, src.mem);
+        return;
+    case Operand::Immediate:
+        break;
+    }
+    if (fitsByte(src.imm)) {
+        regInstr(0x83, op, dst);
+        byte((uint8_t)(int8_t)src.imm);
+    } else if (dst == RAX) {
+        rex(true, 0, 0, 0);
+        byte((uint8_t)(op * 8u + 5));
+        imm32(src.imm);
+    } else {
+        regInstr(0x81, op, dst);
+        imm32(src.imm);
+    }
+}
+
+void X86Encoder::imul(Reg64 dst, const Operand& src) {
+    switch (src.kind) {
+    case Operand::Register:
+        regInstr(0x0FAF, dst, src.reg);
+        return;
+    case Operand::Memory:
+        memInstr(0x0FAF, dst, src.mem);
+        return;
+    case Operand::Immediate:
+        break;
+    }
+    if (fitsByte(src.imm)) {
+        regInstr(0x6B, dst, dst);
+        byte((uint8_t)(int8_t)src.imm);
+    } else {
+        regInstr(0x69, dst, dst);
+        imm32(src.imm);
+    }
+}
+
+void X86Encoder::test(Reg64 a, Reg64 b) {
+    regInstr(0x85, b, a);
+}
+
+void X86Encoder::neg(Reg64 r) {
+    regInstr(0xF7, 3, r);
+}
+
+void X86Encoder::shift(ShiftOp op, Reg64 r, uint8_t count) {
+    // por 1 hay una forma sin el byte de la cantidad (la que elige as)
+    if (count == 1) {
+        regInstr(0xD1, op, r);
+        return;
+    }
+    regInstr(0xC1, op, r);
+    byte(count);
+}
+
+void X86Encoder::set(Cond c, Reg64 r) {
+    regInstr(0x0F90 + c, 0, r, false, r >= RSP);
+    regInstr(0x0FB6, r, r, false, r >= RSP);  // movzbl
+}
+
+void X86Encoder::cqo() {
+    byte(0x48);
+    byte(0x99);
+}
+
+void X86Encoder::idiv(Reg64 r) {
+    regInstr(0xF7, 7, r);
+}
+
+void X86Encoder::push(Reg64 r) {
+    rex(false, 0, 0, r);
+    byte((uint8_t)(0x50 + (r & 7)));
+}
+
+void X86Encoder::pop(Reg64 r) {
+    rex(false, 0, 0, r);
+    byte((uint8_t)(0x58 + (r & 7)));
+}
+
+// las llamadas van siempre por el simbolo (PLT32), tambien entre funciones
+// del mismo objeto: el enlazador resuelve y el objeto se puede mezclar con otros
+void X86Encoder::call(AsmSymbol fn) {
+    byte(0xE8);
+    const Target& t = targets[fn];
+    object.relocate(code.size(), t.symbol, ElfObject::PLT32, t.offset - 4);
+    imm32(0);
+}
+
+void X86Encoder::branch(unsigned shortOp, unsigned longOp, AsmLabel target) {
+    if (labels[target] != unplaced) {
+        int64_t rel = (int64_t)labels[target] - (int64_t)(code.size() + 2);
+        if (fitsByte(rel)) {
+            byte((uint8_t)shortOp);
+            byte((uint8_t)(int8_t)rel);
+            return;
+        }
+        opcode(longOp);
+        rel = (int64_t)labels[target] - (int64_t)(code.size() + 4);
+        imm32((int32_t)rel);
+        return;
+    }
+    opcode(longOp);
+    jumps.push_back({code.size(), target});
+    imm32(0);
+}
+
+void X86Encoder::jmp(AsmLabel target) {
+    branch(0xEB, 0xE9, target);
+}
+
+void X86Encoder::jcc(Cond c, AsmLabel target) {
+    branch(0x70u + c, 0x0F80u + c, target);
+}
+
+void X86Encoder::leave() {
+    byte(0xC9);
+}
+
+void X86Encoder::ret() {
+    byte(0xC3);
+}
@@ -0,0 +1,85 @@
+#ifndef X86ENC_H
+#define X86ENC_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "elfobj.h"
+#include "x86.h"
+
+using namespace std;
+
+// Codificador de x86-64: escribe los bytes de cada instruccion directo en
+// ElfObject::text, sin pasar por un ensamblador. Las llamadas y los accesos
+// a .rodata/.bss (siempre relativos a rip) quedan como reubicaciones del
+// objeto; los saltos se resuelven aca al terminar cada funcion. Un salto
+// hacia atras que entra en un byte usa la forma corta; hacia adelante
+// siempre la de 32 bits (no se conoce el destino todavia).
+class X86Encoder : public X86Emitter {
+public:
+    explicit X86Encoder(ElfObject& object);
+
+    AsmSymbol function(const string& name) override;
+    AsmSymbol external(const string& name) override;
+    AsmSymbol variable(const string& name) override;
+    AsmSymbol data(const string& bytes) override;
+    void begin(AsmSymbol fn) override;
+    void end(AsmSymbol fn) override;
+    AsmLabel label() override;
+    void place(AsmLabel l) override;
+
+    void mov(Reg64 dst, const Operand& src) override;
+    void movImm(Reg64 dst, int64_t value) override;
+    void store(const Mem& dst, Reg64 src) override;
+    void storeImm(const Mem& dst, int32_t value) override;
+    void lea(Reg64 dst, const Mem& src) override;
+    void alu(AluOp op, Reg64 dst, const Operand& src) override;
+    void imul(Reg64 dst, const Operand& src) override;
+    void test(Reg64 a, Reg64 b) override;
+    void neg(Reg64 r) override;
+    void shift(ShiftOp op, Reg64 r, uint8_t count) override;
+    void set(Cond c, Reg64 r) override;
+    void cqo() override;
+    void idiv(Reg64 r) override;
+    void push(Reg64 r) override;
+    void pop(Reg64 r) override;
+    void call(AsmSymbol fn) override;
+    void jmp(AsmLabel target) override;
+    void jcc(Cond c, AsmLabel target) override;
+    void leave() override;
+    void ret() override;
+
+private:
+    // AsmSymbol -> simbolo del objeto y desplazamiento (los textos de
+    // .rodata se nombran con el simbolo de la seccion)
+    struct Target {
+        uint32_t symbol;
+        int64_t offset;
+    };
+    struct Jump {
+        size_t at;  // donde va el desplazamiento de 32 bits
+        AsmLabel target;
+    };
+    static constexpr size_t unplaced = SIZE_MAX;
+
+    ElfObject& object;
+    vector<uint8_t>& code;
+    vector<Target> targets;
+    vector<size_t> labels;  // por AsmLabel: posicion en .text
+    vector<Jump> jumps;
+    size_t start;  // comienzo de la funcion actual
+
+    void byte(uint8_t b) { code.push_back(b); }
+    void imm32(int32_t v);
+    // byteRegs: operando de 8 bits (spl, bpl, sil y dil piden REX aunque sea vacio)
+    void rex(bool wide, unsigned reg, unsigned index, unsigned base, bool byteRegs = false);
+    void opcode(unsigned op);  // 0x0Fxx son dos bytes
+    // instruccion de 64 bits con operando en memoria; trailing: bytes de
+    // inmediato que siguen al desplazamiento (cuentan para la reubicacion
+    // relativa a rip)
+    void memInstr(unsigned op, unsigned reg, const Mem& m, size_t trailing = 0);
+    void regInstr(unsigned op, unsigned reg, unsigned rm, bool wide = true, bool byteRegs = false);
+    void branch(unsigned shortOp, unsigned longOp, AsmLabel target);
+};
+
+#endif